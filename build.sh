@@ -1,6 +1,10 @@
 #!/bin/bash
 
 # === Handmade Hero build script ===
+#   ./build.sh               debug build of the game library and the platform
+#   ./build.sh release       optimized build, use this for benchmark runs
+#   ./build.sh game          rebuild only libhandmade.so, a running prog reloads it
+#   ./build.sh game release  same, optimized
 
 # Exit on error
 set -e
@@ -13,12 +17,53 @@ SDL_PKG_PATH="../SDL/build"
 # Ensure build directory exists
 mkdir -p "$BUILD_DIR"
 
+# Optimization level, use "./build.sh release" for benchmark runs
+# debug builds also turn on HANDMADE_SLOW checks (asserts, arena overflow)
+OPT_FLAGS="-O0 -DHANDMADE_SLOW=1"
+GAME_ONLY=0
+for arg in "$@"; do
+    if [ "$arg" == "release" ]; then
+        OPT_FLAGS="-O2 -DHANDMADE_SLOW=0"
+    elif [ "$arg" == "game" ]; then
+        GAME_ONLY=1
+    fi
+done
+
+# game code is every handmade*.c except the software renderer, which the platform runs on the
+# game's render commands, so the platform layer is sdl_*.c plus handmade_render.c
+RENDERER_SOURCES="$SRC_DIR/handmade_render.c"
+GAME_SOURCES=$(ls $SRC_DIR/handmade*.c | grep -v -x -F "$RENDERER_SOURCES")
+PLATFORM_SOURCES="$(ls $SRC_DIR/sdl_*.c) $RENDERER_SOURCES"
+
+# the game library calls back into Platform* functions exported by prog
+if [ "$(uname)" == "Darwin" ]; then
+    SHARED_FLAGS="-dynamiclib -undefined dynamic_lookup"
+else
+    SHARED_FLAGS="-shared"
+fi
+
+# Compile the game library, written to a temp name and renamed so prog never loads a half written file
+echo "🔨 Building game library..."
+gcc -g $OPT_FLAGS -fPIC $SHARED_FLAGS $GAME_SOURCES -o "$BUILD_DIR/libhandmade.so.tmp" -lm
+mv "$BUILD_DIR/libhandmade.so.tmp" "$BUILD_DIR/libhandmade.so"
+
+if [ "$GAME_ONLY" == "1" ]; then
+    echo "✅ Game library rebuilt, a running prog picks it up on its next frame"
+    exit 0
+fi
+
 # Let pkg-config find SDL3
 export PKG_CONFIG_PATH="$SDL_PKG_PATH:$PKG_CONFIG_PATH"
 
 # Compile the program
 echo "🔨 Building Handmade Hero..."
-gcc -g $SRC_DIR/*.c -o "$BUILD_DIR/prog" $(pkg-config --cflags --libs sdl3) -lm
+gcc -g $OPT_FLAGS -rdynamic $PLATFORM_SOURCES -o "$BUILD_DIR/prog" $(pkg-config --cflags --libs sdl3) -ldl -lm
+
+# Offline asset packer, then the pack the game maps at startup (name=path, names from handmade_asset.h)
+echo "🔨 Packing assets..."
+gcc -g $OPT_FLAGS $SRC_DIR/tools/asset_packer.c -o "$BUILD_DIR/asset_packer"
+ASSETS="test_text=$SRC_DIR/test.txt"
+"$BUILD_DIR/asset_packer" "$BUILD_DIR/assets.hha" $ASSETS
 
 echo "✅ Build complete!"
-echo "Run the program with: $BUILD_DIR/prog"
\ No newline at end of file
+echo "Run the program with: $BUILD_DIR/prog"
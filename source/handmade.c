@@ -1,86 +1,429 @@
 
 #include "handmade.h"
+#include "handmade_render_group.h"
+#include "handmade_asset.h"
+#include "handmade_bitmap.h"
+#include "handmade_audio.h"
+#include "handmade_wav.h"
+#include "handmade_debug.h"
+#include "handmade_input.h"
+#include "handmade_entity.h"
+#include "handmade_world.h"
 #define PI 3.14159265358979323846
 
-global_variable char *button_names[6] = {
+// entity benchmark, every step replaces a few entities and runs proximity queries the size of a small view
+#define DEBUG_ENTITY_SPACING 8.0f           // world side per square root of an entity, about 10% of it covered
+#define DEBUG_ENTITY_CHURN 64
+#define DEBUG_ENTITY_QUERY_COUNT 256
+#define DEBUG_ENTITY_QUERY_SIZE 32.0f
+
+// tile world benchmark, the camera laps a circle about a chunk a step and paints the chunk under it, so
+// every step streams a row of chunks and the second lap reads back what the first one wrote
+#define DEBUG_WORLD_ORBIT 640.0f            // tiles from the origin
+#define DEBUG_WORLD_LAP_STEPS 240
+#define DEBUG_WORLD_PAINT_COUNT 16
+#define DEBUG_WORLD_LOOKUP_COUNT 4096
+
+global_variable char *button_names[GameButton_Count] = {
     "moveUp", "moveDown", "moveLeft", "moveRight", "actionA", "actionB"
 };
 
 
-void GameUpdateAndRender(GameMemory *game_memory, RenderBuffer *buffer,float t, AudioSystem *audio_system, SoundState *sound_state, bool soundBufferNeedsFilling,
+void GameUpdateAndRender(GameMemory *game_memory, RenderBuffer *buffer, AudioSystem *audio_system, bool soundBufferNeedsFilling,
                         GameInputState *input){
+    TIMED_FUNCTION();
+    BEGIN_DEBUG_TIMER(game_memory, GameUpdateAndRender);
     GameState *game_state = (GameState *)game_memory->permanent_storage;
     
     if(!game_memory->is_inititialized){
+        // the GameState is the first push, after that its arena owns the rest of permanent storage
+        MemoryArena permanent_arena;
+        InitializeArena(&permanent_arena, game_memory->permanent_storage_size, game_memory->permanent_storage,
+                        &game_memory->permanent_storage_committed);
+        game_state = PushStruct(&permanent_arena, GameState);
+        if(!game_state){
+            END_DEBUG_TIMER(game_memory, GameUpdateAndRender);
+            return;
+        }
+        game_state->permanent_arena = permanent_arena;
+        InitializeArena(&game_state->transient_arena, game_memory->transient_storage_size, game_memory->transient_storage,
+                        &game_memory->transient_storage_committed);
+
         // file loading (note '/' at start is important for absolute path)
         char filename[128];
         realpath("source/test.txt", filename);
-        printf("Trying to open file: %s\n", filename);
+        PlatformLog(LogLevel_Debug, "Trying to open file: %s", filename);
+
+        // an I/O thread fills the buffer, the frame checks on it below instead of waiting here
+        game_state->test_file_size = PlatformGetFileSize(filename);
+        if(game_state->test_file_size){
+            game_state->test_file = PushSize(&game_state->permanent_arena, game_state->test_file_size);
+            if(game_state->test_file){
+                game_state->test_file_read = PlatformBeginAsyncRead(filename, 0, game_state->test_file_size,
+                                                                    game_state->test_file, NULL, NULL);
+            }
+        }
+
+        // the cache lives in transient storage with its bookkeeping, a loop edit restore never splits them
+        game_state->assets = PushStruct(&game_state->transient_arena, GameAssets);
+        if(game_state->assets && game_memory->asset_pack_path){
+            if(OpenAssetPack(game_state->assets, &game_state->transient_arena, game_memory->asset_pack_path, ASSET_CACHE_SIZE)){
+                char *test_text = (char *)GetAsset(game_state->assets, AssetID_TestText, NULL);
+                PlatformLog(LogLevel_Info, "Loaded test_text from the asset pack: %.32s", test_text ? test_text : "(missing)");
+            } else {
+                PlatformLog(LogLevel_Warning, "No asset pack at '%s', run build.sh to make one", game_memory->asset_pack_path);
+            }
+        }
+
+        // the platform decides premultiplied or straight before the first frame, it is baked in at load
+        game_state->test_sprite = PushStruct(&game_state->permanent_arena, LoadedBitmap);
+        if(game_state->test_sprite){
+            *game_state->test_sprite = LoadBitmap(&game_state->permanent_arena, "source/test_sprite.bmp",
+                                                  game_memory->debug_sprites_premultiplied);
+        }
+
+        // lives for the whole run, BeginRenderCommands empties it every frame
+        game_state->render_commands = PushStruct(&game_state->transient_arena, RenderCommands);
+        void *push_buffer = PushSize(&game_state->transient_arena, RENDER_COMMAND_BUFFER_SIZE);
+        if(game_state->render_commands && push_buffer){
+            InitializeRenderCommands(game_state->render_commands, push_buffer, RENDER_COMMAND_BUFFER_SIZE);
+        } else {
+            game_state->render_commands = NULL;
+        }
+
+        // the steady test tone that used to be the whole of the audio, plus --voices for the mixer benchmark
+        game_state->audio_state = PushStruct(&game_state->permanent_arena, AudioState);
+        if(game_state->audio_state){
+            InitializeAudioState(game_state->audio_state, &game_state->permanent_arena);
+            PlayingSound *tone = PlayTone(game_state->audio_state, 256.0f);
+            if(tone){
+                ChangeVolume(tone, 0.0f, 0.10f, 0.0f);
+            }
+            game_state->test_sound = MakeTestSound(&game_state->permanent_arena);
+            if(game_memory->debug_voice_count){
+                StartDebugVoices(game_state, game_memory->debug_voice_count);
+            }
+
+            // --music, looped so a benchmark never runs out of track
+            if(game_memory->music_path){
+                game_state->music = PushStruct(&game_state->permanent_arena, WavStream);
+                if(game_state->music && OpenWavStream(game_state->music, &game_state->permanent_arena, game_memory->music_path, true)){
+                    PlayingSound *music = PlayStream(game_state->audio_state, game_state->music);
+                    if(music){
+                        ChangeVolume(music, 0.0f, 0.5f, 0.0f);
+                    }
+                } else {
+                    game_state->music = NULL;
+                }
+            }
+        }
 
-        void *bitmap_memory = PlatformReadEntireFile(filename);
-        if(bitmap_memory){
-            printf("success");
-            PlatformFreeFileMemory(bitmap_memory);
-            bitmap_memory = NULL;
+        if(game_memory->debug_entity_count){
+            SpawnDebugEntities(game_state, game_memory->debug_entity_count);
+        }
+        if(game_memory->debug_world_radius && game_memory->world_path){
+            OpenDebugWorld(game_memory, game_state);
         }
 
         game_state->counter = 0;
         game_memory->is_inititialized = true;
     }
-    UpdatePixels(buffer,t);
-    UpdateGameInput(input);
+
+    if(game_state->test_file_read){
+        uint32 read_state = PlatformGetAsyncReadState(game_state->test_file_read);
+        if(read_state != AsyncRead_Pending){
+            if(read_state == AsyncRead_Done){
+                PlatformLog(LogLevel_Debug, "Test file read finished");
+            }
+            PlatformEndAsyncRead(game_state->test_file_read);
+            game_state->test_file_read = 0;
+        }
+    }
+
+    GameAssets *assets = game_state->assets;
+    if(assets){
+        BeginAssetFrame(assets);
+        GetAsset(assets, AssetID_TestText, NULL);
+    }
+
+    // fixed steps, however many the platform's scheduler says real time has moved on by
+    uint32 event_index = 0;
+    for(uint32 update_index = 0; update_index < input->update_count; ++update_index){
+        // each step only sees the input from before it ended
+        UpdateGameInput(game_state, input, &event_index, InputStepEndTime(input, update_index), update_index);
+
+        // a few of the benchmark voices start a new fade every step, so the mixer always has ramps to do
+        if(game_state->debug_voices){
+            for(uint32 fade_index = 0; fade_index < 4; ++fade_index){
+                uint32 voice_index = (game_state->counter * 4 + fade_index) % game_memory->debug_voice_count;
+                uint32 hash = (game_state->counter * 4 + fade_index + 1) * 2654435761u;
+                float32 volume = (float32)(hash & 0xFF) / 255.0f / (float32)game_memory->debug_voice_count;
+                float32 pan = (float32)((hash >> 8) & 0xFF) / 127.5f - 1.0f;
+                ChangeVolume(game_state->debug_voices[voice_index], 0.25f, volume, pan);
+            }
+        }
+        if(game_state->entities && input->update_hz){
+            UpdateDebugEntities(game_memory, game_state, 1.0f / (float32)input->update_hz);
+        }
+        if(game_state->world){
+            UpdateDebugWorld(game_memory, game_state);
+        }
+        ++game_state->counter;
+        ClearInputTransitions(game_state->controllers);
+    }
+    if(game_state->entities && game_memory->debug_entity_checksum_wanted){
+        game_memory->debug_entity_stats.checksum = HashEntities(game_state->entities);
+    }
+    if(game_state->world && game_memory->debug_world_checksum_wanted){
+        // reads still in flight would make it depend on how fast the disk was
+        FinishTileChunkLoads(game_state->world);
+        game_state->world->stats.checksum = HashTileWorld(game_state->world);
+    }
+
+    // what came after the last step is the next step's, what overflowed the events only the platform's state has
+    UpdateGameInput(game_state, input, &event_index, UINT64_MAX, input->update_count);
+    if(input->dropped_event_count){
+        CopyControllerState(game_state->controllers, input->controllers);
+    }
+    LogGameInput(game_state);
+
+    // the frame is drawn between the last step and the next one, counter - 1 is the step just simulated
+    float t = 0.0f;
+    if(game_state->counter && input->update_hz){
+        t = (float)(((double64)(game_state->counter - 1) + input->interpolation) / (double64)input->update_hz);
+    }
+
+    // the game only describes the frame, the platform's renderer draws it after we return
+    RenderCommands *render_commands = game_state->render_commands;
+    game_memory->render_commands = render_commands;
+    if(render_commands){
+        BeginRenderCommands(render_commands, buffer->width, buffer->height);
+        PushGradient(render_commands, 0, game_memory->debug_still_background ? 0.0f : t);
+
+        LoadedBitmap *sprite = game_state->test_sprite;
+        if(game_memory->debug_sprite_count && sprite && sprite->pixels){
+            PushTestSprites(render_commands, 1, sprite, game_memory->debug_sprite_count, buffer->width, buffer->height, t);
+        }
+    }
+
+    // decodes ahead every frame, whether or not this one mixes
+    if(game_state->music){
+        UpdateWavStream(game_state->music);
+    }
 
     if(soundBufferNeedsFilling){
-        UpdateAudio(audio_system, sound_state);
+        TIMED_BLOCK("MixAudio");
+        BEGIN_DEBUG_TIMER(game_memory, MixAudio);
+        if(game_state->audio_state && audio_system->sound_buffer){
+            game_memory->debug_voices_mixed = OutputPlayingSounds(game_state->audio_state, audio_system->sound_buffer,
+                                                                  audio_system->frames_to_write, &game_state->transient_arena);
+        }
+        END_DEBUG_TIMER(game_memory, MixAudio);
+    }
+
+    CheckArena(&game_state->transient_arena);
+    if(assets){
+        game_memory->debug_asset_stats = assets->stats;
+    }
+    if(game_state->music){
+        game_memory->debug_stream_stats = game_state->music->stats;
+    }
+    if(game_state->world){
+        game_memory->debug_world_stats = game_state->world->stats;
     }
+    END_DEBUG_TIMER(game_memory, GameUpdateAndRender);
 }
 
-internal_func void UpdatePixels(RenderBuffer *buffer, float t){
-    // write directly to the buffers pixels
+// spreads the sprites over the target from a hash of their index, drifting with t, partly off screen at the edges
+internal_func void PushTestSprites(RenderCommands *commands, uint32 layer, LoadedBitmap *sprite,
+                                   uint32 sprite_count, uint32 width, uint32 height, float t){
+    uint32 range_x = width + sprite->width;
+    uint32 range_y = height + sprite->height;
+    uint32 drift = (uint32)(t * 60.0f);
 
-    uint32 height = buffer->height;
-    uint32 width = buffer->width;
-    uint32 *pixels = (uint32 *)buffer->pixels;
+    for(uint32 sprite_index = 0; sprite_index < sprite_count; ++sprite_index){
+        uint32 hash = (sprite_index + 1) * 2654435761u;
+        uint32 start_x = (uint32)(((uint64)(hash & 0xFFFF) * range_x) >> 16);
+        uint32 start_y = (uint32)(((uint64)(hash >> 16) * range_y) >> 16);
+        int32 x = (int32)((start_x + drift) % range_x) - (int32)sprite->width;
+        int32 y = (int32)start_y - (int32)sprite->height;
+        PushBitmap(commands, layer, sprite, x, y);
+    }
+}
+
+// half a second of a plucked two note chord, mono, so the mixer has a buffer to play without any files
+internal_func LoadedSound *MakeTestSound(MemoryArena *arena){
+    LoadedSound *sound = PushStruct(arena, LoadedSound);
+    uint32 sample_count = SOUND_FREQ / 2;
+    float32 *samples = PushArray(arena, sample_count, float32);
+    if(!sound || !samples){
+        return NULL;
+    }
 
-    for(uint32 y = 0; y < height; ++y){
-        uint32 *row = (uint32 *)pixels + (y * width); // pointer to the start of the current row
-        for(uint32 x = 0; x < width; ++x){
-            uint8 red = (uint8)((sin((x + t *100) * 0.01f) * 0.5f + 0.5f) *255);
-            uint8 blue = (uint8)((sin((x + y + t *100) * 0.01f) * 0.5f + 0.5f) *255);
-            uint8 green = (uint8)((sin((y + t *100) * 0.01f) * 0.5f + 0.5f) *255);;
-            uint8 alpha = 255;
-            // dereference the pointer to set the pixel value
-            *(row + x) = blue | (green << 8) | (red << 16) | (alpha << 24);
+    for(uint32 i = 0; i < sample_count; ++i){
+        float32 time = (float32)i / (float32)SOUND_FREQ;
+        samples[i] = 0.6f * sinf(2.0f * (float32)PI * 440.0f * time) * expf(-6.0f * time) +
+                     0.3f * sinf(2.0f * (float32)PI * 660.0f * time) * expf(-9.0f * time);
+    }
+    sound->sample_count = sample_count;
+    sound->channel_count = 1;
+    sound->samples[0] = sound->samples[1] = samples;
+    return sound;
+}
+
+// every other voice is a looping test sound, the rest tones, spread over pitch and pan from a hash of the index
+internal_func void StartDebugVoices(GameState *game_state, uint32 voice_count){
+    game_state->debug_voices = PushArray(&game_state->permanent_arena, voice_count, PlayingSound *);
+    if(!game_state->debug_voices){
+        return;
+    }
+
+    for(uint32 voice_index = 0; voice_index < voice_count; ++voice_index){
+        uint32 hash = (voice_index + 1) * 2654435761u;
+        PlayingSound *voice = ((voice_index & 1) && game_state->test_sound) ?
+            PlaySound(game_state->audio_state, game_state->test_sound, true) :
+            PlayTone(game_state->audio_state, 110.0f + (float32)(hash & 0x3FF));
+        if(!voice){
+            game_state->debug_voices = NULL;
+            return;
         }
+        ChangeVolume(voice, 0.0f, 1.0f / (float32)voice_count, (float32)((hash >> 16) & 0xFF) / 127.5f - 1.0f);
+        game_state->debug_voices[voice_index] = voice;
+    }
+}
+
+// xorshift, the state must never be 0, returns 0..1
+internal_func float32 NextDebugRandom(uint32 *state){
+    uint32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (float32)(x >> 8) / 16777216.0f;
+}
+
+internal_func void SpawnDebugEntity(EntityStore *store, uint32 *random){
+    float32 half_w = 0.25f + 1.75f * NextDebugRandom(random);
+    float32 half_h = 0.25f + 1.75f * NextDebugRandom(random);
+    float32 x = half_w + (store->world_width - 2.0f * half_w) * NextDebugRandom(random);
+    float32 y = half_h + (store->world_height - 2.0f * half_h) * NextDebugRandom(random);
+    float32 vel_x = 40.0f * NextDebugRandom(random) - 20.0f;
+    float32 vel_y = 40.0f * NextDebugRandom(random) - 20.0f;
+    AddEntity(store, x, y, vel_x, vel_y, half_w, half_h);
+}
+
+// a square world that keeps the density the same whatever the count
+internal_func void SpawnDebugEntities(GameState *game_state, uint32 entity_count){
+    float32 world_size = sqrtf((float32)entity_count) * DEBUG_ENTITY_SPACING;
+    EntityStore *store = PushStruct(&game_state->permanent_arena, EntityStore);
+    if(!store || !InitializeEntityStore(store, &game_state->permanent_arena, entity_count, world_size, world_size)){
+        PlatformLog(LogLevel_Warning, "No room for %u entities in permanent storage", entity_count);
+        return;
+    }
+
+    uint32 random = 0x2545F491u;
+    for(uint32 entity_index = 0; entity_index < entity_count; ++entity_index){
+        SpawnDebugEntity(store, &random);
+    }
+    game_state->entities = store;
+}
+
+internal_func void UpdateDebugEntities(GameMemory *game_memory, GameState *game_state, float32 dt){
+    EntityStore *store = game_state->entities;
+    EntityStats *stats = &game_memory->debug_entity_stats;
+    uint32 random = ((game_state->counter + 1) * 2654435761u) | 1;
+
+    // a few die and as many are born, so the swap-remove and the free slot list get used every step
+    for(uint32 churn_index = 0; churn_index < DEBUG_ENTITY_CHURN && store->count; ++churn_index){
+        uint32 dense_index = (uint32)(NextDebugRandom(&random) * (float32)store->count) % store->count;
+        RemoveEntity(store, GetEntityHandle(store, dense_index));
+        SpawnDebugEntity(store, &random);
     }
+
+    uint32 path = EntityPath_Scalar;
+    if(game_memory->debug_entity_path == RenderPath_AVX2){
+        path = EntityPath_AVX2;
+    } else if(game_memory->debug_entity_path == RenderPath_SSE2){
+        path = EntityPath_SSE2;
+    }
+    BEGIN_DEBUG_TIMER(game_memory, MoveEntities);
+    MoveEntities(store, dt, path);
+    END_DEBUG_TIMER(game_memory, MoveEntities);
+
+    BEGIN_DEBUG_TIMER(game_memory, BuildEntityGrid);
+    BuildEntityGrid(store);
+    END_DEBUG_TIMER(game_memory, BuildEntityGrid);
+
+    BEGIN_DEBUG_TIMER(game_memory, CollideEntities);
+    stats->overlaps += CollideEntities(store, &stats->pairs_tested);
+    uint32 results[64];
+    float32 range_x = fmaxf(store->world_width - DEBUG_ENTITY_QUERY_SIZE, 0.0f);
+    float32 range_y = fmaxf(store->world_height - DEBUG_ENTITY_QUERY_SIZE, 0.0f);
+    for(uint32 query_index = 0; query_index < DEBUG_ENTITY_QUERY_COUNT; ++query_index){
+        float32 min_x = range_x * NextDebugRandom(&random);
+        float32 min_y = range_y * NextDebugRandom(&random);
+        stats->query_results += QueryEntities(store, min_x, min_y, min_x + DEBUG_ENTITY_QUERY_SIZE,
+                                              min_y + DEBUG_ENTITY_QUERY_SIZE, results, 64);
+    }
+    stats->queries += DEBUG_ENTITY_QUERY_COUNT;
+    END_DEBUG_TIMER(game_memory, CollideEntities);
+
+    stats->entity_count = store->count;
+    stats->occupied_buckets = store->occupied_buckets;
+    ++stats->steps;
 }
 
-internal_func void UpdateAudio(AudioSystem *audio_system, SoundState *sound_state) {
-    GenerateSineWave(audio_system, sound_state);
-    //GenerateSquareWave(audio_system, sound_state);
+internal_func void OpenDebugWorld(GameMemory *game_memory, GameState *game_state){
+    TileWorld *world = PushStruct(&game_state->permanent_arena, TileWorld);
+    if(!world || !InitializeTileWorld(world, &game_state->permanent_arena, game_memory->world_path, game_memory->debug_world_radius)){
+        PlatformLog(LogLevel_Warning, "No room for a tile world of radius %u in permanent storage", game_memory->debug_world_radius);
+        return;
+    }
+    game_state->world = world;
 }
 
-internal_func void GenerateSineWave(AudioSystem *audio_system, SoundState *sound_state){
-    uint32 frames = audio_system->frames_per_buffer;
-    float *samples = audio_system->sound_buffer;
-    // Generate a simple sine wave
-    for (uint32 i = 0; i < frames; ++i) {
-        float sample = sinf(2.0f * (float)PI * sound_state->frequency * ((float)i / SOUND_FREQ) + sound_state->phase)
-                        * sound_state->amplitude;
-        for (uint32 c = 0; c < SOUND_CHANNELS; ++c){
-            samples[i * SOUND_CHANNELS + c] = sample;
-        }       
-    }
-
-    // Phase stores where the last sine wave ended.
-    // Advance the phase for continuous playback so that the buffer begins where the last one ended
-    // This ensures a smooth sine wave of sound
-    sound_state->phase += 2.0f * (float)PI * sound_state->frequency * ((float)frames / SOUND_FREQ);
-    if (sound_state->phase > 2.0f * (float)PI){
-        sound_state->phase -= 2.0f * (float)PI;
-    }
-        
+internal_func void UpdateDebugWorld(GameMemory *game_memory, GameState *game_state){
+    TileWorld *world = game_state->world;
+    WorldStats *stats = &world->stats;
+    uint32 random = ((game_state->counter + 1) * 2654435761u) | 1;
+
+    float32 angle = 2.0f * (float32)PI * (float32)(game_state->counter % DEBUG_WORLD_LAP_STEPS) / (float32)DEBUG_WORLD_LAP_STEPS;
+    int32 camera_x = (int32)floorf(DEBUG_WORLD_ORBIT * cosf(angle));
+    int32 camera_y = (int32)floorf(DEBUG_WORLD_ORBIT * sinf(angle));
+
+    // only the chunk under the camera is sure to be in, so that is all that gets painted
+    BEGIN_DEBUG_TIMER(game_memory, UpdateWorld);
+    UpdateWorldResidency(world, camera_x, camera_y);
+    int32 chunk_x = camera_x & ~TILE_CHUNK_MASK;
+    int32 chunk_y = camera_y & ~TILE_CHUNK_MASK;
+    for(uint32 paint_index = 0; paint_index < DEBUG_WORLD_PAINT_COUNT; ++paint_index){
+        int32 x = chunk_x + (int32)(NextDebugRandom(&random) * TILE_CHUNK_DIM);
+        int32 y = chunk_y + (int32)(NextDebugRandom(&random) * TILE_CHUNK_DIM);
+        SetTile(world, x, y, (uint16)(0x1000 | (game_state->counter & 0x0FFF)));
+    }
+    END_DEBUG_TIMER(game_memory, UpdateWorld);
+
+    // anywhere in the resident square, so the lookups hit every chunk and not just the one in cache
+    BEGIN_DEBUG_TIMER(game_memory, LookupTiles);
+    uint32 span = (uint32)(2 * world->radius + 1) * TILE_CHUNK_DIM;
+    int32 min_x = (camera_x & ~TILE_CHUNK_MASK) - world->radius * TILE_CHUNK_DIM;
+    int32 min_y = (camera_y & ~TILE_CHUNK_MASK) - world->radius * TILE_CHUNK_DIM;
+    uint32 misses = 0;
+    for(uint32 lookup_index = 0; lookup_index < DEBUG_WORLD_LOOKUP_COUNT; ++lookup_index){
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        int32 x = min_x + (int32)(((random & 0xFFFF) * span) >> 16);
+        int32 y = min_y + (int32)(((random >> 16) * span) >> 16);
+        misses += (GetTile(world, x, y) == TILE_UNLOADED);
+    }
+    END_DEBUG_TIMER(game_memory, LookupTiles);
+
+    stats->lookups += DEBUG_WORLD_LOOKUP_COUNT;
+    stats->lookup_misses += misses;
+    ++stats->steps;
 }
+
 /*
     ---------- Button Logic ---------------
 
@@ -88,47 +431,71 @@ internal_func void GenerateSineWave(AudioSystem *audio_system, SoundState *sound
         oldBState->ended_down = false
         isDown = true
         newBState->ended_down = true
-        newBState->half_transition_count = 1 (because state changed)
+        newBState->half_transition_count += 1 (because state changed)
 
     2. Button is released this frame (was down, now up) -> ie: the button just went up.
         oldBState->ended_down = true
         isDown = false
         newBState->ended_down = false
-        newBState->half_transition_count = 1 (because state changed)
+        newBState->half_transition_count += 1 (because state changed)
 
     3. Button is held down (was down, still down) -> ie: the button is being held.
         oldBState->ended_down = true
         isDown = true
         newBState->ended_down = true
-        newBState->half_transition_count = 0 (no change)
+        newBState->half_transition_count += 0 (no change)
 
     4. Button is not pressed (was up, still up) -> ie: the button is idle.
         oldBState->ended_down = false
         isDown = false
         newBState->ended_down = false
-        newBState->half_transition_count = 0 (no change)
+        newBState->half_transition_count += 0 (no change)
 
+    The count starts at 0 every fixed step and every event adds to it, so
+    pressed and released inside one step is ended_down = false with 2.
 */
-internal_func void UpdateGameInput(GameInputState *input){
+internal_func void UpdateGameInput(GameState *game_state, GameInputState *input, uint32 *event_index, uint64 until, uint32 step_index){
+    InputEvent *event;
+    while((event = NextInputEvent(input, event_index, until))){
+        // a bad event from a replayed or corrupt input file is skipped, not indexed with
+        if(event->controller_index >= MAX_CONTROLLER_COUNT ||
+           (event->type == InputEvent_Button && event->index >= GameButton_Count)){
+            continue;
+        }
+        bool was_connected = game_state->controllers[event->controller_index].is_connected;
+        ApplyInputEvent(game_state->controllers, event);
 
-    
-    for (int i = 0; i < 6; ++i) {   // 6 buttons in your union array
-        ButtonState *btn = &input->keys[i];
+        // how long before the step's end it happened, the input latency fixed steps add
+        double64 early_ms = (until != UINT64_MAX) ? (double64)(until - event->timestamp) / 1e6 : 0.0;
+        if(event->type == InputEvent_Button){
+            PlatformLog(LogLevel_Info, "controller %u %s %s, step %u, %.2f ms before it ended", event->controller_index,
+                        button_names[event->index], event->is_down ? "pressed" : "released", step_index, early_ms);
+        } else if(event->type == InputEvent_Connected && !was_connected){
+            PlatformLog(LogLevel_Info, "controller %u connected", event->controller_index);
+        } else if(event->type == InputEvent_Disconnected){
+            PlatformLog(LogLevel_Info, "controller %u disconnected", event->controller_index);
+        }
+    }
+}
 
-        if (btn->half_transition_count && btn->ended_down) {
-            printf("%s pressed\n", button_names[i]);
-        } else if (btn->half_transition_count && !btn->ended_down) {
-            printf("%s released\n", button_names[i]);
-        } else if (!btn->half_transition_count && btn->ended_down) {
-            printf("%s held down\n", button_names[i]);
+internal_func void LogGameInput(GameState *game_state){
+    for(uint32 controller_index = 0; controller_index < MAX_CONTROLLER_COUNT; ++controller_index){
+        GameControllerInput *controller = game_state->controllers + controller_index;
+        if(!controller->is_connected){
+            continue;
         }
 
-        // Reset transition count after processing
-        btn->half_transition_count = 0;
-    }
+        // every frame a button is held, so only at debug level
+        for(uint32 button_index = 0; button_index < GameButton_Count; ++button_index){
+            if(controller->keys[button_index].ended_down){
+                PlatformLog(LogLevel_Debug, "controller %u %s held down", controller_index, button_names[button_index]);
+            }
+        }
 
-    // there has been stick movement
-    if(input->is_analog){
-        printf("Analog end_x = %.3f   end_y = %.3f\n", input->end_x, input->end_y);
+        // there has been stick movement
+        if(controller->is_analog){
+            PlatformLog(LogLevel_Debug, "controller %u analog end_x = %.3f   end_y = %.3f", controller_index,
+                        controller->end_x, controller->end_y);
+        }
     }
 }
\ No newline at end of file
@@ -5,13 +5,31 @@
 #include <stdio.h>
 #include <stdint.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define HANDMADE_X86 1
+#include <immintrin.h>
+#else
+#define HANDMADE_X86 0
+#endif
+
 #define internal_func        static
 #define local_persist   static
 #define global_variable static
 
+// HANDMADE_SLOW=1 is set by debug builds, it turns on checks that cost time
+#if HANDMADE_SLOW
+#define Assert(Expression) if(!(Expression)) {*(volatile int *)0 = 0;}
+#else
+#define Assert(Expression)
+#endif
+
 #define Kilobytes(Value) ((Value) * 1024LL)
 #define Megabytes(Value) (Kilobytes(Value) * 1024LL)
 #define Gigabytes(Value) (Megabytes(Value) * 1024LL)
+#define Terabytes(Value) (Gigabytes(Value) * 1024LL)
+
+// storage is reserved up front and committed in steps of this size as the game grows into it
+#define MEMORY_COMMIT_GRANULARITY Megabytes(2)
 
 #define BUFFER_SECONDS 0.2f  // length of each buffer (100ms)
 #define SOUND_FREQ 48000
@@ -24,11 +42,124 @@ typedef uint64_t uint64;
 typedef uint8_t uint8;
 typedef uint16_t uint16;
 typedef int16_t int16;
+typedef int32_t int32;
 typedef uint8_t uint8;
 typedef bool bool32;
 typedef float float32;
 typedef double double64;
 
+// DEBUG timers, filled in every frame by the game and the renderer, read back by the platform benchmark
+enum {
+    DebugTimer_GameUpdateAndRender,
+    DebugTimer_MixAudio,
+    DebugTimer_MoveEntities,        // the entity benchmark's integration, summed over fixed steps
+    DebugTimer_BuildEntityGrid,
+    DebugTimer_CollideEntities,     // pair tests and proximity queries
+    DebugTimer_UpdateWorld,         // the tile world benchmark's chunk residency and painting
+    DebugTimer_LookupTiles,         // its random tile lookups around the camera
+    DebugTimer_RenderCommands,      // the whole RenderCommandsToOutput
+    DebugTimer_SortRenderCommands,
+    DebugTimer_DrawGradient,        // gradient batches, summed over tiles
+    DebugTimer_DrawBitmaps,         // bitmap batches, summed over tiles
+    DebugTimer_Upscale,             // the platform stretching a dynamic resolution frame over the window
+    DebugTimer_Count
+};
+
+typedef struct {
+    uint64 elapsed;     // platform wall clock ticks spent in the block this frame
+    uint64 cycles;      // time stamp counter ticks, 0 where there is no cheap counter
+    uint32 hit_count;   // how many times the block ran this frame
+} DebugTimer;
+
+internal_func inline uint64 ReadCycleCounter(void){
+#if HANDMADE_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// file headers are little endian and not always aligned, read them a byte at a time
+internal_func inline uint32 ReadU32(uint8 *at){
+    return (uint32)at[0] | ((uint32)at[1] << 8) | ((uint32)at[2] << 16) | ((uint32)at[3] << 24);
+}
+
+internal_func inline uint16 ReadU16(uint8 *at){
+    return (uint16)(at[0] | (at[1] << 8));
+}
+
+// asset cache counters, kept up to date by the game and printed by the platform benchmark
+typedef struct {
+    uint64 open_ticks;          // cold start, mapping the pack and checking the index
+    uint64 decode_ticks;        // every miss, copying out of the pack
+    uint32 hits;
+    uint32 misses;
+    uint32 evictions;
+    uint64 cache_size;
+    uint64 cache_used;          // decoded bytes plus block headers
+} AssetStats;
+
+// streamed music counters, the platform benchmark turns them into decoded seconds per CPU second
+typedef struct {
+    uint32 sample_rate;         // of the file, 0 while nothing streams
+    uint32 channel_count;
+    uint64 frames_decoded;      // file frames converted to float
+    uint64 frames_resampled;    // SOUND_FREQ frames handed to the mixer
+    uint64 decode_ticks;
+    uint64 resample_ticks;
+    uint32 starved_mixes;       // mixes that ran out of decoded frames before the track ended
+} StreamStats;
+
+// entity benchmark totals over every fixed step, the platform divides them out
+typedef struct {
+    uint32 entity_count;
+    uint32 occupied_buckets;    // of the last grid built
+    uint64 steps;
+    uint64 pairs_tested;        // candidates from the grid, same cell and not already tested
+    uint64 overlaps;
+    uint64 queries;
+    uint64 query_results;
+    uint64 checksum;            // of positions and velocities, only on the frame the platform asks for it
+} EntityStats;
+
+// tile world streaming, kept by the world and copied out by the game for the platform benchmark
+typedef struct {
+    uint32 radius;              // chunks kept resident on each side of the camera's chunk
+    uint32 chunk_capacity;      // the pool, the square one past the radius plus room for writes in flight
+    uint32 resident_chunks;     // at the last update
+    uint64 memory_size;         // pool and hash table, all of it pushed at startup
+    uint64 chunks_generated;    // never written out, made from their coordinate
+    uint64 chunks_loaded;       // read back from their files
+    uint64 chunks_evicted;
+    uint64 chunks_written;      // evicted with changes
+    uint64 chunks_revived;      // wanted back while their write was still in flight
+    uint64 load_ticks;          // wall clock from starting a read to the I/O thread finishing it, summed
+    uint64 load_ticks_min;
+    uint64 load_ticks_max;
+    float32 average_probe;      // table entries a lookup of a resident chunk walks, as of the last change
+    uint32 longest_probe;
+
+    // the game's benchmark steps
+    uint64 steps;
+    uint64 lookups;
+    uint64 lookup_misses;       // tiles whose chunk was not in yet
+    uint64 checksum;            // of the tiles around the camera, only on the frame the platform asks for it
+} WorldStats;
+
+// work queue served by the platform's worker threads, opaque to the game
+typedef struct PlatformWorkQueue PlatformWorkQueue;
+typedef void PlatformWorkQueueCallback(PlatformWorkQueue *queue, void *data);
+
+// which fill and blend implementations the renderer runs, the platform picks one for benchmarks
+enum {
+    RenderPath_Auto,        // best one the cpu supports
+    RenderPath_Scalar,      // reference, three sin() calls per pixel
+    RenderPath_Separable,   // per-frame sine tables, plain C fill
+    RenderPath_SSE2,
+    RenderPath_AVX2,
+    RenderPath_Count
+};
+
 // uint8* is a pointer to the first byte of a memory region.
 typedef struct{
     bool32 is_inititialized;
@@ -36,24 +167,74 @@ typedef struct{
     uint8 *permanent_storage;    // must be initialized to zero at startup
     uint64 transient_storage_size;
     uint8 *transient_storage;    // must be initialized to zero at startup
+
+    // bytes from the start of each region that are backed and writable, only these may be touched
+    uint64 permanent_storage_committed;
+    uint64 transient_storage_committed;
+
+    PlatformWorkQueue *render_queue;
+    char *asset_pack_path;       // assets.hha next to the executable
+    char *music_path;            // --music, a WAV streamed from disk while it plays
+
+    // set by the game every frame, the platform renders it once GameUpdateAndRender returns
+    struct RenderCommands *render_commands;
+
+    // sprite benchmark, the platform sets how many to draw and reads back how many pixels that blended
+    uint32 debug_sprite_count;
+    bool32 debug_sprites_premultiplied;
+    uint64 debug_sprite_pixels;
+
+    // --still, the gradient stops scrolling so only the sprites change from frame to frame
+    bool32 debug_still_background;
+
+    // mixer benchmark, the platform sets how many extra voices to start and reads back how many were mixed
+    uint32 debug_voice_count;
+    uint32 debug_voices_mixed;
+
+    // entity benchmark, the platform sets how many to spawn and the RenderPath_* whose vector width
+    // integrates them, and wants the checksum on the last frame only, hashing 100k entities is not free
+    uint32 debug_entity_count;
+    uint32 debug_entity_path;
+    bool32 debug_entity_checksum_wanted;
+    EntityStats debug_entity_stats;
+
+    // tile world benchmark, the platform sets the residency radius in chunks and the directory evicted
+    // chunks are written to, and wants the checksum on the last frame only, it waits for loads in flight
+    uint32 debug_world_radius;
+    char *world_path;
+    bool32 debug_world_checksum_wanted;
+    WorldStats debug_world_stats;
+
+    DebugTimer debug_timers[DebugTimer_Count];
+    AssetStats debug_asset_stats;
+    StreamStats debug_stream_stats;
 } GameMemory;
 
+// the dirty tracker's squares, one uint64 of bits per row of them, the last row and column take
+// whatever is left of buffers bigger than 64 of them (4096 pixels)
+#define DIRTY_TILE_SHIFT 6
+#define DIRTY_TILE_SIZE (1 << DIRTY_TILE_SHIFT)
+#define DIRTY_TILE_ROWS 64
+#define DIRTY_TILE_COLUMNS 64
+
 typedef struct{
     uint32 width;
     uint32 height;
     uint32 bytesPerPixel;
     uint32 pitch; // how many bytes a pointer needs to move to get to the next row
     void *pixels;
-} RenderBuffer;
 
-typedef struct {
-    float32 phase;
-    float32 frequency;
-    float32 amplitude;
-} SoundState;
+    // bit x of dirty_tiles[y] is set once anything wrote into that DIRTY_TILE_SIZE square,
+    // the platform uploads the set ones and clears them
+    uint64 dirty_tiles[DIRTY_TILE_ROWS];
+    // what each render tile drew last frame, the renderer skips a tile that would draw the same again,
+    // NULL when the pixels do not survive until the next frame, 0 entries always redraw
+    uint64 *tile_hashes;
+} RenderBuffer;
 
 typedef struct {
-    uint32 frames_per_buffer;
+    uint32 frames_per_buffer;   // capacity of sound_buffer
+    uint32 frames_to_write;     // what the platform wants mixed this frame, at most frames_per_buffer
     uint32 samples_per_buffer;
     uint32 channels;
     float32 *sound_buffer;
@@ -62,10 +243,25 @@ typedef struct {
 
 typedef struct {
     bool ended_down;          // // Is the button currently pressed?
-    uint8 half_transition_count; // // Did the button change state this frame? 0 or 1
+    uint8 half_transition_count; // // How often it changed state this frame, a tap inside one frame is 2
 } ButtonState;
 
+// the order of GameControllerInput's buttons
+enum {
+    GameButton_MoveUp,
+    GameButton_MoveDown,
+    GameButton_MoveLeft,
+    GameButton_MoveRight,
+    GameButton_ActionA,
+    GameButton_ActionB,
+    GameButton_Count
+};
+
+#define MAX_CONTROLLER_COUNT 5      // the keyboard is controller 0, gamepads get 1..4 as they are plugged in
+#define INPUT_EVENT_COUNT 256       // per frame, more than that still changes the state but loses its timestamp
+
 typedef struct{
+    bool is_connected;
     bool is_analog;
 
     //analog stick state last frame
@@ -91,25 +287,281 @@ typedef struct{
             ButtonState action_A;    // key q, a button
             ButtonState action_B;    // key e, b button
         };
-        ButtonState keys[6]; // legacy array, union gives named buttons
+        ButtonState keys[GameButton_Count]; // legacy array, union gives named buttons
     };
+} GameControllerInput;
+
+enum {
+    InputEvent_Button,
+    InputEvent_Axis,
+    InputEvent_Connected,       // also resets a controller that was already connected to idle
+    InputEvent_Disconnected,    // releases everything the controller held
+};
+
+enum {
+    GameAxis_StickX,
+    GameAxis_StickY,
+};
+
+typedef struct {
+    uint64 timestamp;           // ns on SDL_GetTicksNS's clock, from the SDL_Event
+    uint8 type;                 // InputEvent_*
+    uint8 controller_index;
+    uint8 index;                // GameButton_* or GameAxis_*
+    uint8 is_down;
+    float32 value;              // axes, -1..1 with the deadzone already cut out
+} InputEvent;
+
+typedef struct{
+    // where every controller ended up this frame, with all the transitions on the way
+    GameControllerInput controllers[MAX_CONTROLLER_COUNT];
+
+    // the same changes one by one, oldest first, see handmade_input.h for walking them a fixed step at a time
+    uint64 timestamp;           // when the platform handed the frame over, on the events' clock
+    uint32 event_count;
+    uint32 dropped_event_count; // arrived after events filled up, only the controllers above saw them
+    InputEvent events[INPUT_EVENT_COUNT];
+
+    // filled in by the platform's frame scheduler, part of the input so a loop edit replays the same steps
+    uint32 update_count;        // fixed simulation steps to run this frame, can be 0 when frames outpace updates
+    uint32 update_hz;           // steps per second
+    float32 interpolation;      // 0..1, how far real time is past the last step, the renderer draws there
 } GameInputState;
 
+// how PlatformReadEntireFile hands back the contents
+enum {
+    PlatformFile_Copy,      // heap copy the caller may write to
+    PlatformFile_Map,       // read-only view of the file itself, nothing is copied, writes fault
+};
+
+typedef struct {
+    uint64 size;
+    void *contents;         // NULL if the read failed
+    uint32 mode;            // PlatformFile_*, PlatformFreeFileMemory needs it to release contents
+} PlatformFile;
+
+// DEBUG PLATFORM IO functions
+PlatformFile PlatformReadEntireFile(char *filename, uint32 mode);
+void PlatformFreeFileMemory(PlatformFile *file);
+uint64 PlatformGetFileSize(char *filename);     // 0 if the file is missing or empty
+bool32 PlatformReadFileIntoMemory(char *filename, uint64 size, void *memory);
+// the old contents stay intact until the new ones are on disk, a crash never leaves a half written file
+bool32 PlatformWriteEntireFile(char *filename, uint64 memory_size, void *memory);
+uint64 PlatformGetWallClock(void);
+
+// PlatformLog levels, anything below --log-level is dropped before a byte is copied
+enum {
+    LogLevel_Debug,
+    LogLevel_Info,
+    LogLevel_Warning,
+    LogLevel_Error,
+    LogLevel_Count
+};
+// printf style without the newline, never blocks and never touches stdio: the arguments are copied
+// into a fixed size record (%s strings too, they may be temporary) and a platform thread formats
+// and writes it later, a full ring drops the message and counts it
+void PlatformLog(uint32 level, char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// makes reserved game memory readable/writable, address and size are MEMORY_COMMIT_GRANULARITY aligned
+bool32 PlatformCommitMemory(void *address, uint64 size);
+
+// only the main thread adds work, any thread may run it
+void PlatformAddWorkEntry(PlatformWorkQueue *queue, PlatformWorkQueueCallback *callback, void *data);
+void PlatformCompleteAllWork(PlatformWorkQueue *queue);
+
+// async file reads, served by the platform's I/O threads so a load never stalls a frame
+typedef uint32 PlatformAsyncRead;   // handle, 0 is never a valid one
+enum {
+    AsyncRead_Invalid,              // unknown or already ended handle
+    AsyncRead_Pending,
+    AsyncRead_Done,
+    AsyncRead_Failed,
+};
+// runs on an I/O thread once the read has finished, the handle is still valid
+typedef void PlatformAsyncReadCallback(void *dest, uint64 bytes_read, bool32 succeeded, void *data);
+
+// main thread only, dest (usually an arena push) must stay valid until the read is ended
+PlatformAsyncRead PlatformBeginAsyncRead(char *filename, uint64 offset, uint64 size, void *dest,
+                                         PlatformAsyncReadCallback *callback, void *data);
+uint32 PlatformGetAsyncReadState(PlatformAsyncRead handle);   // AsyncRead_*, never blocks
+uint32 PlatformWaitForAsyncRead(PlatformAsyncRead handle);    // blocks until Done or Failed
+void PlatformEndAsyncRead(PlatformAsyncRead handle);          // waits if still pending, then frees the handle
+// PlatformWriteEntireFile on an I/O thread, source must not change until the write is ended, the handle
+// goes through the three calls above and reads Done once the file is on disk
+PlatformAsyncRead PlatformBeginAsyncWrite(char *filename, uint64 size, void *source,
+                                          PlatformAsyncReadCallback *callback, void *data);
+
+// wraps a block with wall clock and cycle timing, ID is the name after DebugTimer_
+#define BEGIN_DEBUG_TIMER(memory, ID) uint64 debug_timer_start_##ID = PlatformGetWallClock(); \
+    uint64 debug_cycles_start_##ID = ReadCycleCounter();
+#define END_DEBUG_TIMER(memory, ID) \
+    (memory)->debug_timers[DebugTimer_##ID].cycles += ReadCycleCounter() - debug_cycles_start_##ID; \
+    (memory)->debug_timers[DebugTimer_##ID].elapsed += PlatformGetWallClock() - debug_timer_start_##ID; \
+    ++(memory)->debug_timers[DebugTimer_##ID].hit_count;
+
+// ------------------------------------------------------------
+// Memory arenas
+// ------------------------------------------------------------
+/*
+    Linear allocator over a slice of GameMemory. Pushes bump `used` and never
+    free individually; whole groups are released by ending a TemporaryMemory
+    or by starting the arena over. An arena that starts a storage region also
+    owns committing it, `committed` points at the GameMemory counter for that
+    region and the arena commits more in MEMORY_COMMIT_GRANULARITY steps as
+    pushes pass the end. Sub-arenas are pushed out of an already committed
+    parent and leave `committed` NULL.
+*/
+#define DEFAULT_ARENA_ALIGNMENT 16
+
+typedef struct {
+    uint64 size;
+    uint8 *base;
+    uint64 used;
+    uint64 *committed;  // GameMemory counter for root arenas, NULL when all of base is usable
+    int32 temp_count;   // open TemporaryMemory scopes, must be zero at frame boundaries
+} MemoryArena;
+
+typedef struct {
+    MemoryArena *arena;
+    uint64 used;
+} TemporaryMemory;
+
+#define PushStruct(arena, type) (type *)PushSize_(arena, sizeof(type), _Alignof(type))
+#define PushArray(arena, count, type) (type *)PushSize_(arena, (count) * sizeof(type), _Alignof(type))
+#define PushSize(arena, size) PushSize_(arena, size, DEFAULT_ARENA_ALIGNMENT)
+#define PushStructAligned(arena, type, alignment) (type *)PushSize_(arena, sizeof(type), alignment)
+#define PushArrayAligned(arena, count, type, alignment) (type *)PushSize_(arena, (count) * sizeof(type), alignment)
+#define PushSizeAligned(arena, size, alignment) PushSize_(arena, size, alignment)
+
+// grows the committed part of a storage region to cover the first `needed` bytes
+internal_func inline bool32 CommitStorage(uint8 *storage, uint64 storage_size, uint64 *committed, uint64 needed){
+    if(needed <= *committed){
+        return true;
+    }
+    if(needed > storage_size){
+        return false;
+    }
+
+    uint64 new_committed = (needed + MEMORY_COMMIT_GRANULARITY - 1) & ~(uint64)(MEMORY_COMMIT_GRANULARITY - 1);
+    if(new_committed > storage_size){
+        new_committed = storage_size;
+    }
+
+    if(!PlatformCommitMemory(storage + *committed, new_committed - *committed)){
+        return false;
+    }
+    *committed = new_committed;
+    return true;
+}
+
+internal_func inline void InitializeArena(MemoryArena *arena, uint64 size, void *base, uint64 *committed){
+    arena->size = size;
+    arena->base = (uint8 *)base;
+    arena->used = 0;
+    arena->committed = committed;
+    arena->temp_count = 0;
+}
+
+internal_func inline uint64 GetAlignmentOffset(MemoryArena *arena, uint64 alignment){
+    // alignment has to be a power of two
+    uint64 result_pointer = (uint64)(uintptr_t)arena->base + arena->used;
+    uint64 alignment_mask = alignment - 1;
+    uint64 alignment_offset = 0;
+    if(result_pointer & alignment_mask){
+        alignment_offset = alignment - (result_pointer & alignment_mask);
+    }
+    return alignment_offset;
+}
+
+internal_func inline uint64 GetArenaSizeRemaining(MemoryArena *arena, uint64 alignment){
+    return arena->size - (arena->used + GetAlignmentOffset(arena, alignment));
+}
+
+// returns NULL when the arena is out of space (or can't commit), debug builds stop right there
+internal_func inline void *PushSize_(MemoryArena *arena, uint64 size_init, uint64 alignment){
+    uint64 alignment_offset = GetAlignmentOffset(arena, alignment);
+    uint64 size = size_init + alignment_offset;
+
+    Assert((arena->used + size) <= arena->size);
+    if((arena->used + size) > arena->size){
+        return NULL;
+    }
+
+    if(arena->committed &&
+       !CommitStorage(arena->base, arena->size, arena->committed, arena->used + size)){
+        Assert(!"Failed to commit arena memory");
+        return NULL;
+    }
+
+    void *result = arena->base + arena->used + alignment_offset;
+    arena->used += size;
+    return result;
+}
+
+internal_func inline bool32 SubArena(MemoryArena *result, MemoryArena *arena, uint64 size, uint64 alignment){
+    void *base = PushSize_(arena, size, alignment);
+    InitializeArena(result, base ? size : 0, base, NULL);
+    return base != NULL;
+}
+
+internal_func inline TemporaryMemory BeginTemporaryMemory(MemoryArena *arena){
+    TemporaryMemory result;
+    result.arena = arena;
+    result.used = arena->used;
+    ++arena->temp_count;
+    return result;
+}
+
+internal_func inline void EndTemporaryMemory(TemporaryMemory temp_memory){
+    MemoryArena *arena = temp_memory.arena;
+    Assert(arena->used >= temp_memory.used);
+    Assert(arena->temp_count > 0);
+    arena->used = temp_memory.used;
+    --arena->temp_count;
+}
+
+internal_func inline void CheckArena(MemoryArena *arena){
+    Assert(arena->temp_count == 0);
+}
+
 typedef struct{
+    MemoryArena permanent_arena;    // the whole permanent storage, this GameState is its first push
+    MemoryArena transient_arena;    // the whole transient storage, long lived systems (asset cache, render commands)
+                                    // are pushed once at init, per frame work goes in TemporaryMemory scopes
     uint32 counter;
+
+    PlatformAsyncRead test_file_read;   // non-zero until the game has seen the read finish
+    uint8 *test_file;                   // permanent arena, filled in by an I/O thread
+    uint64 test_file_size;
+
+    struct GameAssets *assets;          // transient arena, with the cache it manages
+    struct LoadedBitmap *test_sprite;   // permanent arena, drawn by the sprite benchmark
+    struct RenderCommands *render_commands; // transient arena, refilled every frame
+
+    struct AudioState *audio_state;     // permanent arena, so loop edits restore what is playing
+    struct LoadedSound *test_sound;     // permanent arena, played by the mixer benchmark
+    struct PlayingSound **debug_voices; // the --voices sounds, faded around every frame
+    struct WavStream *music;            // permanent arena, fixed size however long the track
+    struct EntityStore *entities;       // permanent arena, only with --entities for now
+    struct TileWorld *world;            // permanent arena, only with --world-radius for now
+
+    // the platform's input events applied one fixed step at a time, so loop edits restore it too
+    GameControllerInput controllers[MAX_CONTROLLER_COUNT];
 } GameState;
 
-// DEBUG PLATFORM IO functions
-void *PlatformReadEntireFile(char *filename);
-void PlatformFreeFileMemory(void *memory);
-bool32 PlatformWriteEntireFile(char *filename, uint32 memory_size, void *memory);
-
-// platform independent functions
-void GameUpdateAndRender(GameMemory *game_memory, RenderBuffer *buffer, float t, AudioSystem *audio_system, SoundState *sound_state, bool soundBufferNeedsFilling,
-                        GameInputState *input);
-
-internal_func void UpdatePixels(RenderBuffer *buffer,float t);
-internal_func void UpdateAudio(AudioSystem *audio_system, SoundState *sound_state);
-internal_func void GenerateSineWave(AudioSystem *audio_system, SoundState *sound_state);
-// void GenerateSquareWave(AudioSystem *audio_system, SoundState *sound_state);
-internal_func void UpdateGameInput(GameInputState *input);
\ No newline at end of file
+// platform independent functions, exported by libhandmade.so and looked up by name
+#define GAME_UPDATE_AND_RENDER(name) void name(GameMemory *game_memory, RenderBuffer *buffer, AudioSystem *audio_system, bool soundBufferNeedsFilling, \
+                                               GameInputState *input)
+typedef GAME_UPDATE_AND_RENDER(GameUpdateAndRenderFunc);
+GAME_UPDATE_AND_RENDER(GameUpdateAndRender);
+
+internal_func void PushTestSprites(struct RenderCommands *commands, uint32 layer, struct LoadedBitmap *sprite,
+                                   uint32 sprite_count, uint32 width, uint32 height, float t);
+internal_func struct LoadedSound *MakeTestSound(MemoryArena *arena);
+internal_func void StartDebugVoices(GameState *game_state, uint32 voice_count);
+internal_func void SpawnDebugEntities(GameState *game_state, uint32 entity_count);
+internal_func void UpdateDebugEntities(GameMemory *game_memory, GameState *game_state, float32 dt);
+internal_func void OpenDebugWorld(GameMemory *game_memory, GameState *game_state);
+internal_func void UpdateDebugWorld(GameMemory *game_memory, GameState *game_state);
+internal_func void UpdateGameInput(GameState *game_state, GameInputState *input, uint32 *event_index, uint64 until, uint32 step_index);
+internal_func void LogGameInput(GameState *game_state);
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "handmade_asset.h"
+#include <string.h>
+
+internal_func void InsertBlockAfter(AssetMemoryBlock *prev, AssetMemoryBlock *block){
+    block->prev = prev;
+    block->next = prev->next;
+    block->prev->next = block;
+    block->next->prev = block;
+}
+
+internal_func void RemoveBlock(AssetMemoryBlock *block){
+    block->prev->next = block->next;
+    block->next->prev = block->prev;
+}
+
+internal_func void RemoveFromLRU(Asset *asset){
+    asset->lru_prev->lru_next = asset->lru_next;
+    asset->lru_next->lru_prev = asset->lru_prev;
+}
+
+internal_func void InsertAtLRUFront(GameAssets *assets, Asset *asset){
+    asset->lru_prev = &assets->lru_sentinel;
+    asset->lru_next = assets->lru_sentinel.lru_next;
+    asset->lru_prev->lru_next = asset;
+    asset->lru_next->lru_prev = asset;
+}
+
+bool32 OpenAssetPack(GameAssets *assets, MemoryArena *arena, char *filename, uint64 cache_size){
+    uint64 start = PlatformGetWallClock();
+
+    assets->lru_sentinel.lru_prev = &assets->lru_sentinel;
+    assets->lru_sentinel.lru_next = &assets->lru_sentinel;
+    assets->block_sentinel.prev = &assets->block_sentinel;
+    assets->block_sentinel.next = &assets->block_sentinel;
+    assets->stats.cache_size = cache_size;
+
+    // the whole cache starts as one free block
+    AssetMemoryBlock *block = (AssetMemoryBlock *)PushSizeAligned(arena, cache_size, ASSET_DATA_ALIGNMENT);
+    if(!block){
+        return false;
+    }
+    block->size = cache_size - sizeof(AssetMemoryBlock);
+    block->used = false;
+    InsertBlockAfter(&assets->block_sentinel, block);
+
+    assets->pack = PlatformReadEntireFile(filename, PlatformFile_Map);
+    if(!assets->pack.contents){
+        return false;
+    }
+
+    AssetPackHeader *header = (AssetPackHeader *)assets->pack.contents;
+    if((assets->pack.size < sizeof(AssetPackHeader)) ||
+       (header->magic != ASSET_PACK_MAGIC) ||
+       (header->version != ASSET_PACK_VERSION) ||
+       (header->total_size != assets->pack.size) ||
+       (header->index_offset + (uint64)header->asset_count * sizeof(PackedAsset) > assets->pack.size)){
+        PlatformLog(LogLevel_Error, "'%s' is not a version %u asset pack", filename, ASSET_PACK_VERSION);
+        PlatformFreeFileMemory(&assets->pack);
+        return false;
+    }
+
+    // a pack from an older packer has fewer ids, the missing ones just never load
+    assets->index = (PackedAsset *)((uint8 *)assets->pack.contents + header->index_offset);
+    assets->asset_count = header->asset_count;
+    if(assets->asset_count > AssetID_Count){
+        assets->asset_count = AssetID_Count;
+    }
+    for(uint32 asset_id = 0; asset_id < assets->asset_count; ++asset_id){
+        PackedAsset *packed = assets->index + asset_id;
+        if(packed->offset + packed->size > assets->pack.size){
+            PlatformLog(LogLevel_Error, "Asset %u runs past the end of '%s'", asset_id, filename);
+            PlatformFreeFileMemory(&assets->pack);
+            return false;
+        }
+    }
+
+    assets->stats.open_ticks = PlatformGetWallClock() - start;
+    return true;
+}
+
+void BeginAssetFrame(GameAssets *assets){
+    ++assets->frame_index;
+}
+
+// first fit, the remainder is split off as a new free block when it is worth a header
+internal_func AssetMemoryBlock *FindFreeBlock(GameAssets *assets, uint64 size){
+    for(AssetMemoryBlock *block = assets->block_sentinel.next; block != &assets->block_sentinel; block = block->next){
+        if(block->used || block->size < size){
+            continue;
+        }
+
+        uint64 remaining = block->size - size;
+        if(remaining > sizeof(AssetMemoryBlock) + ASSET_DATA_ALIGNMENT){
+            AssetMemoryBlock *split = (AssetMemoryBlock *)((uint8 *)(block + 1) + size);
+            split->size = remaining - sizeof(AssetMemoryBlock);
+            split->used = false;
+            InsertBlockAfter(block, split);
+            block->size = size;
+        }
+        block->used = true;
+        return block;
+    }
+    return NULL;
+}
+
+internal_func void MergeIfFree(GameAssets *assets, AssetMemoryBlock *first, AssetMemoryBlock *second){
+    if(first != &assets->block_sentinel && second != &assets->block_sentinel && !first->used && !second->used &&
+       (uint8 *)(first + 1) + first->size == (uint8 *)second){
+        RemoveBlock(second);
+        first->size += sizeof(AssetMemoryBlock) + second->size;
+    }
+}
+
+// drops the least recently used asset not needed this frame, false when there is none
+internal_func bool32 EvictAsset(GameAssets *assets){
+    Asset *victim = assets->lru_sentinel.lru_prev;
+    if(victim == &assets->lru_sentinel || victim->last_used_frame == assets->frame_index){
+        return false;
+    }
+
+    AssetMemoryBlock *block = victim->block;
+    RemoveFromLRU(victim);
+    victim->block = NULL;
+    victim->memory = NULL;
+    victim->size = 0;
+
+    // counted before merging, block may be folded into its neighbour below
+    assets->stats.cache_used -= sizeof(AssetMemoryBlock) + block->size;
+    ++assets->stats.evictions;
+
+    block->used = false;
+    AssetMemoryBlock *prev = block->prev;
+    MergeIfFree(assets, block, block->next);
+    MergeIfFree(assets, prev, block);
+    return true;
+}
+
+void *GetAsset(GameAssets *assets, uint32 asset_id, uint64 *size){
+    if(size){
+        *size = 0;
+    }
+    if(asset_id >= assets->asset_count || assets->index[asset_id].offset == 0){
+        return NULL;
+    }
+
+    Asset *asset = assets->assets + asset_id;
+    if(asset->block){
+        ++assets->stats.hits;
+        RemoveFromLRU(asset);
+    } else {
+        ++assets->stats.misses;
+        uint64 start = PlatformGetWallClock();
+
+        PackedAsset *packed = assets->index + asset_id;
+        uint64 decoded_size = packed->size + ((packed->type == AssetType_Text) ? 1 : 0);
+        uint64 block_size = (decoded_size + ASSET_DATA_ALIGNMENT - 1) & ~(uint64)(ASSET_DATA_ALIGNMENT - 1);
+
+        AssetMemoryBlock *block = FindFreeBlock(assets, block_size);
+        while(!block && EvictAsset(assets)){
+            block = FindFreeBlock(assets, block_size);
+        }
+        if(!block){
+            return NULL;
+        }
+
+        asset->block = block;
+        asset->memory = block + 1;
+        asset->size = packed->size;
+        block->asset_id = asset_id;
+        memcpy(asset->memory, (uint8 *)assets->pack.contents + packed->offset, packed->size);
+        if(packed->type == AssetType_Text){
+            ((char *)asset->memory)[packed->size] = 0;
+        }
+
+        assets->stats.cache_used += sizeof(AssetMemoryBlock) + block->size;
+        assets->stats.decode_ticks += PlatformGetWallClock() - start;
+    }
+
+    asset->last_used_frame = assets->frame_index;
+    InsertAtLRUFront(assets, asset);
+
+    if(size){
+        *size = asset->size;
+    }
+    return asset->memory;
+}
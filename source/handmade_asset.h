@@ -0,0 +1,104 @@
+#pragma once
+#include "handmade.h"
+
+/*
+    ---------- Asset pack (.hha) ---------------
+
+    Written offline by source/tools/asset_packer.c, read by the game:
+
+        AssetPackHeader
+        PackedAsset index[asset_count]      // indexed by AssetID_*, so lookup is one array access
+        data blobs, each ASSET_DATA_ALIGNMENT aligned
+
+    Offsets are from the start of the file. The game maps the pack once and
+    copies (decodes) an asset out of the mapping the first time it is asked
+    for, into a fixed size cache carved out of transient storage. The least
+    recently used assets are evicted when the cache runs out of room.
+*/
+#define ASSET_PACK_MAGIC (((uint32)'h' << 0) | ((uint32)'h' << 8) | ((uint32)'a' << 16) | ((uint32)'f' << 24))
+#define ASSET_PACK_VERSION 1
+#define ASSET_DATA_ALIGNMENT 64
+#define ASSET_PACK_FILENAME "assets.hha"
+#define ASSET_CACHE_SIZE Megabytes(16)
+
+// what the packer found, decides how the game decodes it
+enum {
+    AssetType_Raw,      // bytes as they were on disk
+    AssetType_Text,     // decoded with a terminating 0 so it can be used as a C string
+    AssetType_Count
+};
+
+// ids are stable across builds of the pack, new assets go at the end
+enum {
+    AssetID_TestText,
+    AssetID_Count
+};
+
+// names the packer accepts on its command line, in AssetID_* order, kept next to the ids so a new asset
+// is added in one place, only the packer defines HANDMADE_ASSET_PACKER and gets a copy
+#if HANDMADE_ASSET_PACKER
+global_variable char *asset_id_names[AssetID_Count] = {
+    "test_text",
+};
+#endif
+
+typedef struct {
+    uint32 magic;           // ASSET_PACK_MAGIC
+    uint32 version;         // ASSET_PACK_VERSION
+    uint32 asset_count;     // index entries, AssetID_Count of the packer that wrote it
+    uint32 reserved;
+    uint64 index_offset;    // PackedAsset[asset_count]
+    uint64 total_size;      // of the whole file, a truncated pack is rejected
+} AssetPackHeader;
+
+typedef struct {
+    uint32 type;            // AssetType_*
+    uint32 reserved;
+    uint64 offset;          // 0 when the asset was not packed
+    uint64 size;
+} PackedAsset;
+
+// ------------------------------------------------------------
+// Runtime cache
+// ------------------------------------------------------------
+// cache memory is a list of blocks, each starts with this header, free neighbours are merged
+// the header is padded to ASSET_DATA_ALIGNMENT so the contents after it stay aligned
+typedef struct AssetMemoryBlock AssetMemoryBlock;
+struct AssetMemoryBlock {
+    _Alignas(ASSET_DATA_ALIGNMENT) AssetMemoryBlock *prev;
+    AssetMemoryBlock *next;
+    uint64 size;            // usable bytes after the header
+    uint32 asset_id;        // owner, only meaningful while used
+    bool32 used;
+};
+
+typedef struct Asset Asset;
+struct Asset {
+    AssetMemoryBlock *block;    // NULL while the asset is not in the cache
+    void *memory;               // decoded contents, in the block
+    uint64 size;
+    uint32 last_used_frame;     // assets used this frame are never evicted
+
+    Asset *lru_prev;            // most recently used is sentinel.lru_next
+    Asset *lru_next;
+};
+
+typedef struct GameAssets {
+    PlatformFile pack;          // read-only mapping, kept open for the whole run
+    PackedAsset *index;
+    uint32 asset_count;
+
+    Asset assets[AssetID_Count];
+    Asset lru_sentinel;
+    AssetMemoryBlock block_sentinel;
+    uint32 frame_index;
+
+    AssetStats stats;
+} GameAssets;
+
+// carves cache_size bytes out of the arena, returns false if the pack is missing or malformed
+bool32 OpenAssetPack(GameAssets *assets, MemoryArena *arena, char *filename, uint64 cache_size);
+// call once per frame before any GetAsset
+void BeginAssetFrame(GameAssets *assets);
+// decoded contents, stays valid until the end of the frame, NULL if missing or the cache is full
+void *GetAsset(GameAssets *assets, uint32 asset_id, uint64 *size);
@@ -0,0 +1,337 @@
+#include "handmade_audio.h"
+#include "handmade_intrinsics.h"
+#include "handmade_wav.h"
+#include <string.h>
+
+// tones and streams are generated this many frames at a time into scratch and then mixed like a buffer
+#define AUDIO_TONE_BLOCK 256
+#define TWO_PI_F (2.0f * PI_F)
+
+void InitializeAudioState(AudioState *audio_state, MemoryArena *permanent_arena){
+    audio_state->permanent_arena = permanent_arena;
+    audio_state->first_playing_sound = NULL;
+    audio_state->first_free_playing_sound = NULL;
+    audio_state->playing_count = 0;
+    audio_state->master_volume = 1.0f;
+}
+
+internal_func PlayingSound *AllocatePlayingSound(AudioState *audio_state){
+    PlayingSound *result = audio_state->first_free_playing_sound;
+    if(result){
+        audio_state->first_free_playing_sound = result->next;
+    } else {
+        result = PushStruct(audio_state->permanent_arena, PlayingSound);
+        if(!result){
+            return NULL;
+        }
+    }
+
+    *result = (PlayingSound){0};
+    result->current_volume[0] = result->current_volume[1] = 1.0f;
+    result->target_volume[0] = result->target_volume[1] = 1.0f;
+
+    result->next = audio_state->first_playing_sound;
+    audio_state->first_playing_sound = result;
+    ++audio_state->playing_count;
+    return result;
+}
+
+PlayingSound *PlaySound(AudioState *audio_state, LoadedSound *sound, bool32 looping){
+    PlayingSound *result = AllocatePlayingSound(audio_state);
+    if(result){
+        result->type = PlayingSound_Buffer;
+        result->sound = sound;
+        result->looping = looping;
+    }
+    return result;
+}
+
+PlayingSound *PlayTone(AudioState *audio_state, float32 frequency){
+    PlayingSound *result = AllocatePlayingSound(audio_state);
+    if(result){
+        result->type = PlayingSound_Tone;
+        result->frequency = frequency;
+    }
+    return result;
+}
+
+PlayingSound *PlayStream(AudioState *audio_state, WavStream *stream){
+    PlayingSound *result = AllocatePlayingSound(audio_state);
+    if(result){
+        result->type = PlayingSound_Stream;
+        result->stream = stream;
+    }
+    return result;
+}
+
+void ChangeVolume(PlayingSound *playing_sound, float32 fade_seconds, float32 volume, float32 pan){
+    // balance law, the middle plays both sides at full volume
+    if(pan < -1.0f) pan = -1.0f;
+    if(pan > 1.0f) pan = 1.0f;
+    playing_sound->target_volume[0] = volume * ((pan > 0.0f) ? 1.0f - pan : 1.0f);
+    playing_sound->target_volume[1] = volume * ((pan < 0.0f) ? 1.0f + pan : 1.0f);
+
+    uint32 fade_frames = (uint32)(fade_seconds * (float32)SOUND_FREQ);
+    playing_sound->fade_frames_remaining = fade_frames;
+    for(uint32 channel = 0; channel < 2; ++channel){
+        if(fade_frames){
+            playing_sound->d_volume[channel] = (playing_sound->target_volume[channel] - playing_sound->current_volume[channel]) /
+                                               (float32)fade_frames;
+        } else {
+            playing_sound->current_volume[channel] = playing_sound->target_volume[channel];
+            playing_sound->d_volume[channel] = 0.0f;
+        }
+    }
+}
+
+void StopSound(PlayingSound *playing_sound, float32 fade_seconds){
+    ChangeVolume(playing_sound, fade_seconds, 0.0f, 0.0f);
+    playing_sound->stop_after_fade = true;
+}
+
+// ------------------------------------------------------------
+// Mixing kernels
+// ------------------------------------------------------------
+// dest[i] += source[i] * (volume + d_volume * i) for both channels
+internal_func void MixSamplesScalar(float32 *dest0, float32 *dest1, float32 *source0, float32 *source1, uint32 count,
+                                    float32 volume0, float32 d_volume0, float32 volume1, float32 d_volume1){
+    for(uint32 i = 0; i < count; ++i){
+        dest0[i] += source0[i] * (volume0 + d_volume0 * (float32)i);
+        dest1[i] += source1[i] * (volume1 + d_volume1 * (float32)i);
+    }
+}
+
+#if HANDMADE_X86
+internal_func void MixSamplesSSE(float32 *dest0, float32 *dest1, float32 *source0, float32 *source1, uint32 count,
+                                 float32 volume0, float32 d_volume0, float32 volume1, float32 d_volume1){
+    __m128 ramp = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 volume0_4 = _mm_add_ps(_mm_set1_ps(volume0), _mm_mul_ps(_mm_set1_ps(d_volume0), ramp));
+    __m128 volume1_4 = _mm_add_ps(_mm_set1_ps(volume1), _mm_mul_ps(_mm_set1_ps(d_volume1), ramp));
+    __m128 step0 = _mm_set1_ps(4.0f * d_volume0);
+    __m128 step1 = _mm_set1_ps(4.0f * d_volume1);
+
+    uint32 i = 0;
+    for(; i + 4 <= count; i += 4){
+        __m128 mixed0 = _mm_add_ps(_mm_loadu_ps(dest0 + i), _mm_mul_ps(_mm_loadu_ps(source0 + i), volume0_4));
+        __m128 mixed1 = _mm_add_ps(_mm_loadu_ps(dest1 + i), _mm_mul_ps(_mm_loadu_ps(source1 + i), volume1_4));
+        _mm_storeu_ps(dest0 + i, mixed0);
+        _mm_storeu_ps(dest1 + i, mixed1);
+        volume0_4 = _mm_add_ps(volume0_4, step0);
+        volume1_4 = _mm_add_ps(volume1_4, step1);
+    }
+    MixSamplesScalar(dest0 + i, dest1 + i, source0 + i, source1 + i, count - i,
+                     volume0 + d_volume0 * (float32)i, d_volume0, volume1 + d_volume1 * (float32)i, d_volume1);
+}
+
+__attribute__((target("avx")))
+internal_func void MixSamplesAVX(float32 *dest0, float32 *dest1, float32 *source0, float32 *source1, uint32 count,
+                                 float32 volume0, float32 d_volume0, float32 volume1, float32 d_volume1){
+    __m256 ramp = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 volume0_8 = _mm256_add_ps(_mm256_set1_ps(volume0), _mm256_mul_ps(_mm256_set1_ps(d_volume0), ramp));
+    __m256 volume1_8 = _mm256_add_ps(_mm256_set1_ps(volume1), _mm256_mul_ps(_mm256_set1_ps(d_volume1), ramp));
+    __m256 step0 = _mm256_set1_ps(8.0f * d_volume0);
+    __m256 step1 = _mm256_set1_ps(8.0f * d_volume1);
+
+    uint32 i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m256 mixed0 = _mm256_add_ps(_mm256_loadu_ps(dest0 + i), _mm256_mul_ps(_mm256_loadu_ps(source0 + i), volume0_8));
+        __m256 mixed1 = _mm256_add_ps(_mm256_loadu_ps(dest1 + i), _mm256_mul_ps(_mm256_loadu_ps(source1 + i), volume1_8));
+        _mm256_storeu_ps(dest0 + i, mixed0);
+        _mm256_storeu_ps(dest1 + i, mixed1);
+        volume0_8 = _mm256_add_ps(volume0_8, step0);
+        volume1_8 = _mm256_add_ps(volume1_8, step1);
+    }
+    MixSamplesSSE(dest0 + i, dest1 + i, source0 + i, source1 + i, count - i,
+                  volume0 + d_volume0 * (float32)i, d_volume0, volume1 + d_volume1 * (float32)i, d_volume1);
+}
+#endif
+
+// dest[i] = sin(phase + d_phase * i), returns the phase after count frames
+internal_func float32 GenerateTone(float32 *dest, uint32 count, float32 phase, float32 d_phase){
+    uint32 i = 0;
+#if HANDMADE_X86
+    __m128 phase_4 = _mm_add_ps(_mm_set1_ps(phase), _mm_mul_ps(_mm_set1_ps(d_phase), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)));
+    __m128 step = _mm_set1_ps(4.0f * d_phase);
+    for(; i + 4 <= count; i += 4){
+        _mm_storeu_ps(dest + i, FastSin4(phase_4));
+        phase_4 = _mm_add_ps(phase_4, step);
+    }
+#endif
+    for(; i < count; ++i){
+        dest[i] = FastSin(phase + d_phase * (float32)i);
+    }
+
+    phase = fmodf(phase + d_phase * (float32)count, TWO_PI_F);
+    return phase;
+}
+
+// ------------------------------------------------------------
+// Output
+// ------------------------------------------------------------
+// true once the sound is done and can go back on the free list
+// tone_block is two AUDIO_TONE_BLOCKs, a stream resamples its left and right into them
+internal_func bool32 MixPlayingSound(PlayingSound *playing_sound, float32 *mix0, float32 *mix1, uint32 frame_count,
+                                     float32 *tone_block, bool32 use_avx){
+    if(playing_sound->stop_after_fade && !playing_sound->fade_frames_remaining){
+        return true;
+    }
+    LoadedSound *sound = playing_sound->sound;
+    if(playing_sound->type == PlayingSound_Buffer && (!sound || !sound->sample_count)){
+        return true;
+    }
+    WavStream *stream = playing_sound->stream;
+    if(playing_sound->type == PlayingSound_Stream && (!stream || WavStreamFinished(stream))){
+        return true;
+    }
+
+    uint32 frames_mixed = 0;
+    while(frames_mixed < frame_count){
+        uint32 count = frame_count - frames_mixed;
+        float32 *source0;
+        float32 *source1;
+        if(playing_sound->type == PlayingSound_Buffer){
+            uint32 remaining = sound->sample_count - playing_sound->samples_played;
+            if(count > remaining){
+                count = remaining;
+            }
+            source0 = sound->samples[0] + playing_sound->samples_played;
+            source1 = sound->samples[(sound->channel_count > 1) ? 1 : 0] + playing_sound->samples_played;
+        } else {
+            if(count > AUDIO_TONE_BLOCK){
+                count = AUDIO_TONE_BLOCK;
+            }
+            source0 = tone_block;
+            source1 = (playing_sound->type == PlayingSound_Stream) ? tone_block + AUDIO_TONE_BLOCK : tone_block;
+        }
+
+        // a fade that ends inside this run is mixed up to its end and then snapped to the target
+        bool32 fade_ends = false;
+        if(playing_sound->fade_frames_remaining && count >= playing_sound->fade_frames_remaining){
+            count = playing_sound->fade_frames_remaining;
+            fade_ends = true;
+        }
+
+        // a short read is either the end of the track or the disk falling behind, the rest of this mix stays silent
+        bool32 stream_ran_short = false;
+        if(playing_sound->type == PlayingSound_Tone){
+            playing_sound->phase = GenerateTone(tone_block, count, playing_sound->phase,
+                                                TWO_PI_F * playing_sound->frequency / (float32)SOUND_FREQ);
+        } else if(playing_sound->type == PlayingSound_Stream){
+            uint32 frames_read = ReadWavStream(stream, source0, source1, count);
+            if(frames_read < count){
+                count = frames_read;
+                fade_ends = false;
+                stream_ran_short = true;
+            }
+        }
+
+        float32 *volume = playing_sound->current_volume;
+        float32 *d_volume = playing_sound->d_volume;
+#if HANDMADE_X86
+        if(use_avx){
+            MixSamplesAVX(mix0 + frames_mixed, mix1 + frames_mixed, source0, source1, count,
+                          volume[0], d_volume[0], volume[1], d_volume[1]);
+        } else {
+            MixSamplesSSE(mix0 + frames_mixed, mix1 + frames_mixed, source0, source1, count,
+                          volume[0], d_volume[0], volume[1], d_volume[1]);
+        }
+#else
+        MixSamplesScalar(mix0 + frames_mixed, mix1 + frames_mixed, source0, source1, count,
+                         volume[0], d_volume[0], volume[1], d_volume[1]);
+#endif
+        frames_mixed += count;
+
+        if(playing_sound->fade_frames_remaining){
+            playing_sound->fade_frames_remaining -= count;
+            volume[0] += d_volume[0] * (float32)count;
+            volume[1] += d_volume[1] * (float32)count;
+        }
+        if(fade_ends){
+            volume[0] = playing_sound->target_volume[0];
+            volume[1] = playing_sound->target_volume[1];
+            d_volume[0] = d_volume[1] = 0.0f;
+            if(playing_sound->stop_after_fade){
+                return true;
+            }
+        }
+
+        if(playing_sound->type == PlayingSound_Buffer){
+            playing_sound->samples_played += count;
+            if(playing_sound->samples_played == sound->sample_count){
+                if(!playing_sound->looping){
+                    return true;
+                }
+                playing_sound->samples_played = 0;
+            }
+        }
+        if(stream_ran_short){
+            if(WavStreamFinished(stream)){
+                return true;
+            }
+            ++stream->stats.starved_mixes;
+            break;
+        }
+    }
+    return false;
+}
+
+// the one conversion to the stream format: master volume, clamp, interleave left and right
+internal_func void WriteInterleaved(float32 *output, float32 *mix0, float32 *mix1, uint32 frame_count, float32 master_volume){
+    uint32 i = 0;
+#if HANDMADE_X86
+    __m128 master = _mm_set1_ps(master_volume);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 minus_one = _mm_set1_ps(-1.0f);
+    for(; i + 4 <= frame_count; i += 4){
+        __m128 left = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(mix0 + i), master), minus_one), one);
+        __m128 right = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(mix1 + i), master), minus_one), one);
+        _mm_storeu_ps(output + 2 * i, _mm_unpacklo_ps(left, right));
+        _mm_storeu_ps(output + 2 * i + 4, _mm_unpackhi_ps(left, right));
+    }
+#endif
+    for(; i < frame_count; ++i){
+        float32 left = mix0[i] * master_volume;
+        float32 right = mix1[i] * master_volume;
+        output[2 * i] = (left < -1.0f) ? -1.0f : (left > 1.0f) ? 1.0f : left;
+        output[2 * i + 1] = (right < -1.0f) ? -1.0f : (right > 1.0f) ? 1.0f : right;
+    }
+}
+
+uint32 OutputPlayingSounds(AudioState *audio_state, float32 *output, uint32 frame_count, MemoryArena *temp_arena){
+    TemporaryMemory mix_memory = BeginTemporaryMemory(temp_arena);
+
+    uint32 padded_count = (frame_count + 7) & ~7u;
+    float32 *mix0 = PushArrayAligned(temp_arena, padded_count, float32, 32);
+    float32 *mix1 = PushArrayAligned(temp_arena, padded_count, float32, 32);
+    float32 *tone_block = PushArrayAligned(temp_arena, 2 * AUDIO_TONE_BLOCK, float32, 32);
+    if(!mix0 || !mix1 || !tone_block){
+        memset(output, 0, sizeof(float32) * SOUND_CHANNELS * frame_count);
+        EndTemporaryMemory(mix_memory);
+        return 0;
+    }
+    memset(mix0, 0, sizeof(float32) * padded_count);
+    memset(mix1, 0, sizeof(float32) * padded_count);
+
+    bool32 use_avx = false;
+#if HANDMADE_X86
+    use_avx = __builtin_cpu_supports("avx");
+#endif
+
+    uint32 sounds_mixed = 0;
+    for(PlayingSound **playing_sound_ptr = &audio_state->first_playing_sound; *playing_sound_ptr;){
+        PlayingSound *playing_sound = *playing_sound_ptr;
+        ++sounds_mixed;
+        if(MixPlayingSound(playing_sound, mix0, mix1, frame_count, tone_block, use_avx)){
+            *playing_sound_ptr = playing_sound->next;
+            playing_sound->next = audio_state->first_free_playing_sound;
+            audio_state->first_free_playing_sound = playing_sound;
+            --audio_state->playing_count;
+        } else {
+            playing_sound_ptr = &playing_sound->next;
+        }
+    }
+
+    WriteInterleaved(output, mix0, mix1, frame_count, audio_state->master_volume);
+    EndTemporaryMemory(mix_memory);
+    return sounds_mixed;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "handmade.h"
+
+/*
+    ---------- Audio mixer ---------------
+
+    Every playing sound, a tone, a LoadedSound or a streamed WAV
+    (handmade_wav.h), sits on one list in AudioState. OutputPlayingSounds
+    mixes the whole list into two planar float buffers (left, right) pushed
+    on a temporary arena, 4 or 8 frames at a time with SSE or AVX, and only
+    at the end clamps and interleaves into the SDL_AUDIO_F32 stereo buffer
+    the platform queues.
+
+    Volume is per channel with the pan folded in, a fade moves it linearly
+    every frame towards a target, so a change never clicks. Sounds that
+    end, or were stopped and have faded out, go back on a free list, the
+    PlayingSound structs themselves are pushed on the permanent arena and
+    so are part of a loop edit snapshot.
+*/
+typedef struct LoadedSound {
+    uint32 sample_count;        // frames, at SOUND_FREQ
+    uint32 channel_count;       // 1 or 2, mono plays the same samples on both sides
+    float32 *samples[2];        // planar, samples[1] is samples[0] for mono
+} LoadedSound;
+
+enum {
+    PlayingSound_Tone,
+    PlayingSound_Buffer,
+    PlayingSound_Stream,
+};
+
+typedef struct PlayingSound {
+    uint32 type;
+    bool32 looping;
+
+    LoadedSound *sound;         // buffers
+    uint32 samples_played;
+    struct WavStream *stream;   // streams, looping is the stream's own
+    float32 frequency;          // tones, Hz
+    float32 phase;              // tones, radians in [0, 2pi)
+
+    float32 current_volume[2];  // left, right, pan already applied
+    float32 d_volume[2];        // change per frame while fading
+    float32 target_volume[2];
+    uint32 fade_frames_remaining;
+    bool32 stop_after_fade;
+
+    struct PlayingSound *next;
+} PlayingSound;
+
+typedef struct AudioState {
+    MemoryArena *permanent_arena;
+    PlayingSound *first_playing_sound;
+    PlayingSound *first_free_playing_sound;
+    uint32 playing_count;
+    float32 master_volume;
+} AudioState;
+
+void InitializeAudioState(AudioState *audio_state, MemoryArena *permanent_arena);
+
+// start at full volume in the middle, NULL when the permanent arena is out of space
+PlayingSound *PlaySound(AudioState *audio_state, LoadedSound *sound, bool32 looping);
+PlayingSound *PlayTone(AudioState *audio_state, float32 frequency);
+// the stream must stay open while it plays, the game keeps calling UpdateWavStream on it
+PlayingSound *PlayStream(AudioState *audio_state, struct WavStream *stream);
+
+// volume is 0..1, pan -1 (left) .. 1 (right), reached after fade_seconds, 0 jumps straight there
+void ChangeVolume(PlayingSound *playing_sound, float32 fade_seconds, float32 volume, float32 pan);
+// fades out and then frees the sound, the pointer must not be used after this
+void StopSound(PlayingSound *playing_sound, float32 fade_seconds);
+
+// mixes frame_count frames of every playing sound into output, interleaved stereo in [-1, 1]
+// returns how many sounds were mixed, the mix buffers come from temp_arena and are gone afterwards
+uint32 OutputPlayingSounds(AudioState *audio_state, float32 *output, uint32 frame_count, MemoryArena *temp_arena);
@@ -0,0 +1,102 @@
+#include "handmade_bitmap.h"
+
+// the on-disk headers are packed and little endian, read them field by field
+#define BMP_FILE_HEADER_SIZE 14
+#define BMP_COMPRESSION_RGB 0
+#define BMP_COMPRESSION_BITFIELDS 3
+
+// shift that brings an 8-bit channel mask down to bit 0, masks must be whole bytes
+internal_func bool32 MaskShift(uint32 mask, uint32 *shift){
+    for(uint32 bit = 0; bit < 32; bit += 8){
+        if(mask == (0xFFu << bit)){
+            *shift = bit;
+            return true;
+        }
+    }
+    return false;
+}
+
+LoadedBitmap LoadBitmap(MemoryArena *arena, char *filename, bool32 premultiply){
+    LoadedBitmap result = {0};
+
+    PlatformFile file = PlatformReadEntireFile(filename, PlatformFile_Map);
+    uint8 *contents = (uint8 *)file.contents;
+    if(!contents){
+        return result;
+    }
+
+    uint8 *info = contents + BMP_FILE_HEADER_SIZE;
+    if(file.size < BMP_FILE_HEADER_SIZE + 40 || contents[0] != 'B' || contents[1] != 'M'){
+        PlatformLog(LogLevel_Error, "'%s' is not a BMP file", filename);
+        PlatformFreeFileMemory(&file);
+        return result;
+    }
+
+    uint32 pixel_offset = ReadU32(contents + 10);
+    uint32 info_size = ReadU32(info + 0);
+    int32 width = (int32)ReadU32(info + 4);
+    int32 height = (int32)ReadU32(info + 8);
+    uint16 bits_per_pixel = ReadU16(info + 14);
+    uint32 compression = ReadU32(info + 16);
+
+    // BI_RGB 32-bit is 0xXXRRGGBB, bitfields carry their masks right after the 40 byte header
+    uint32 red_mask = 0x00FF0000, green_mask = 0x0000FF00, blue_mask = 0x000000FF, alpha_mask = 0;
+    if(compression == BMP_COMPRESSION_BITFIELDS && file.size >= BMP_FILE_HEADER_SIZE + 52){
+        red_mask = ReadU32(info + 40);
+        green_mask = ReadU32(info + 44);
+        blue_mask = ReadU32(info + 48);
+        if(info_size >= 56){
+            alpha_mask = ReadU32(info + 52);
+        }
+    }
+
+    bool32 top_down = (height < 0);
+    uint32 abs_height = (uint32)(top_down ? -height : height);
+    uint64 source_size = (uint64)width * abs_height * 4;
+    uint32 red_shift, green_shift, blue_shift, alpha_shift = 0;
+    if(bits_per_pixel != 32 || width <= 0 || abs_height == 0 ||
+       (compression != BMP_COMPRESSION_RGB && compression != BMP_COMPRESSION_BITFIELDS) ||
+       pixel_offset + source_size > file.size ||
+       !MaskShift(red_mask, &red_shift) || !MaskShift(green_mask, &green_shift) || !MaskShift(blue_mask, &blue_shift) ||
+       (alpha_mask && !MaskShift(alpha_mask, &alpha_shift))){
+        PlatformLog(LogLevel_Error, "'%s' is not an uncompressed 32-bit BMP", filename);
+        PlatformFreeFileMemory(&file);
+        return result;
+    }
+
+    uint32 pitch = ((uint32)width * 4 + 15) & ~15u;
+    uint32 *pixels = (uint32 *)PushSizeAligned(arena, (uint64)pitch * abs_height, 16);
+    if(!pixels){
+        PlatformFreeFileMemory(&file);
+        return result;
+    }
+
+    uint32 *source = (uint32 *)(contents + pixel_offset);
+    for(uint32 y = 0; y < abs_height; ++y){
+        uint32 source_y = top_down ? y : (abs_height - 1 - y);
+        uint32 *source_row = source + (size_t)source_y * (uint32)width;
+        uint32 *dest_row = (uint32 *)((uint8 *)pixels + (size_t)y * pitch);
+        for(uint32 x = 0; x < (uint32)width; ++x){
+            uint32 texel = source_row[x];
+            uint32 red = (texel >> red_shift) & 0xFF;
+            uint32 green = (texel >> green_shift) & 0xFF;
+            uint32 blue = (texel >> blue_shift) & 0xFF;
+            uint32 alpha = alpha_mask ? ((texel >> alpha_shift) & 0xFF) : 0xFF;
+            if(premultiply){
+                red = Div255(red * alpha);
+                green = Div255(green * alpha);
+                blue = Div255(blue * alpha);
+            }
+            dest_row[x] = (alpha << 24) | (red << 16) | (green << 8) | blue;
+        }
+    }
+
+    PlatformFreeFileMemory(&file);
+
+    result.width = (uint32)width;
+    result.height = abs_height;
+    result.pitch = pitch;
+    result.pixels = pixels;
+    result.premultiplied = premultiply;
+    return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "handmade.h"
+
+/*
+    ---------- Bitmaps ---------------
+
+    LoadBitmap reads an uncompressed 32-bit BMP (BI_RGB or BI_BITFIELDS,
+    bottom-up or top-down) and converts it to the RenderBuffer layout,
+    0xAARRGGBB with rows top to bottom, in memory pushed on an arena.
+
+    The renderer's DrawBitmap (handmade_render.c) alpha blends with 8-bit
+    integer math, every path gives the same bytes:
+        straight        dest = src * a / 255 + dest * (255 - a) / 255
+        premultiplied   dest = src + dest * (255 - a) / 255
+    where x / 255 is rounded to nearest. The alpha channel follows the same
+    formula with src alpha as its colour, so an opaque target stays opaque.
+    A bitmap loaded premultiplied skips the per-pixel multiply of src.
+*/
+typedef struct LoadedBitmap {
+    uint32 width;
+    uint32 height;
+    uint32 pitch;               // bytes between rows, rows are 16 byte aligned
+    uint32 *pixels;             // 0xAARRGGBB, top row first
+    bool32 premultiplied;       // colour channels already scaled by alpha
+} LoadedBitmap;
+
+// x / 255 rounded to nearest for x in [0, 255 * 255], the SIMD paths use mulhi for the same thing
+internal_func inline uint32 Div255(uint32 x){
+    return ((x + 128) * 257) >> 16;
+}
+
+// pixels go on the arena, returns a zero sized bitmap if the file is missing or unsupported
+LoadedBitmap LoadBitmap(MemoryArena *arena, char *filename, bool32 premultiply);
@@ -0,0 +1,115 @@
+#pragma once
+#include "handmade.h"
+
+/*
+    ---------- Timed blocks ---------------
+
+    TIMED_BLOCK("name") records a begin event where it is declared and an
+    end event when the enclosing scope exits, however it exits (the end is
+    a cleanup attribute, so early returns are covered). TIMED_FUNCTION()
+    names the block after the function.
+
+    Every thread writes into its own ring of DebugEvents, so recording is a
+    clock read, three stores and a release store of the write index, no
+    locks and no shared cache lines. The platform registers a thread the
+    first time it records and drains every ring once a frame into the last
+    DEBUG_FRAME_COUNT frames, which --trace and the T key write out as a
+    Chrome trace (chrome://tracing or ui.perfetto.dev).
+
+    Names are pointers to string literals, the platform copies them when it
+    drains the rings, and drains before a game code reload unmaps the old
+    library's literals. A full ring drops events and counts them, the
+    collector only pairs a begin with its own end, so a drop costs one block.
+
+    The clock is the time stamp counter where there is one and the
+    platform's performance counter elsewhere, the platform calibrates one
+    against the other when it writes a trace.
+*/
+#ifndef HANDMADE_PROFILE
+#define HANDMADE_PROFILE 1
+#endif
+
+#define DEBUG_THREAD_EVENT_COUNT 8192       // per thread ring, power of two, drained every frame
+
+enum {
+    DebugEvent_BeginBlock,
+    DebugEvent_EndBlock,
+};
+
+typedef struct {
+    uint64 clock;
+    char *name;                 // string literal in whichever module recorded it
+    uint32 type;                // DebugEvent_*
+} DebugEvent;
+
+typedef struct {
+    uint32 write_index;         // only the owning thread stores this
+    uint32 read_index;          // only the platform's collector stores this
+    uint32 dropped_count;       // events lost to a full ring, owning thread only
+    uint64 thread_id;
+    char name[32];
+    DebugEvent events[DEBUG_THREAD_EVENT_COUNT];
+} DebugThreadEvents;
+
+// the calling thread's ring, registered on first use, NULL if every slot is taken
+DebugThreadEvents *PlatformGetDebugThreadEvents(void);
+
+#if HANDMADE_X86
+#define DEBUG_CLOCK_IS_CYCLE_COUNTER 1
+internal_func inline uint64 ReadDebugClock(void){
+    return __rdtsc();
+}
+#else
+#define DEBUG_CLOCK_IS_CYCLE_COUNTER 0
+internal_func inline uint64 ReadDebugClock(void){
+    return PlatformGetWallClock();
+}
+#endif
+
+#if HANDMADE_PROFILE
+// one per translation unit and thread, a miss just asks the platform again
+global_variable _Thread_local DebugThreadEvents *debug_thread_events;
+
+internal_func inline void RecordDebugEvent(char *name, uint32 type){
+    DebugThreadEvents *thread = debug_thread_events;
+    if(!thread){
+        thread = debug_thread_events = PlatformGetDebugThreadEvents();
+        if(!thread){
+            return;
+        }
+    }
+
+    uint32 write_index = thread->write_index;
+    if(write_index - __atomic_load_n(&thread->read_index, __ATOMIC_ACQUIRE) >= DEBUG_THREAD_EVENT_COUNT){
+        ++thread->dropped_count;
+        return;
+    }
+    DebugEvent *event = thread->events + (write_index & (DEBUG_THREAD_EVENT_COUNT - 1));
+    event->clock = ReadDebugClock();
+    event->name = name;
+    event->type = type;
+    __atomic_store_n(&thread->write_index, write_index + 1, __ATOMIC_RELEASE);
+}
+
+typedef struct {
+    char *name;
+} TimedBlock;
+
+internal_func inline TimedBlock BeginTimedBlock(char *name){
+    RecordDebugEvent(name, DebugEvent_BeginBlock);
+    TimedBlock block = {name};
+    return block;
+}
+
+internal_func inline void EndTimedBlock(TimedBlock *block){
+    RecordDebugEvent(block->name, DebugEvent_EndBlock);
+}
+
+#define TIMED_BLOCK__(name, line) TimedBlock timed_block_##line __attribute__((cleanup(EndTimedBlock))) = BeginTimedBlock(name)
+#define TIMED_BLOCK_(name, line) TIMED_BLOCK__(name, line)
+#define TIMED_BLOCK(name) TIMED_BLOCK_(name, __LINE__)
+#define TIMED_FUNCTION() TIMED_BLOCK((char *)__func__)
+#else
+#define TIMED_BLOCK(name)
+#define TIMED_FUNCTION()
+#endif
@@ -0,0 +1,431 @@
+#include "handmade_entity.h"
+#include "handmade_debug.h"
+#include <string.h>
+
+// cells are packed 16 bits a side, which is what limits the world to 65535 cells across
+#define ENTITY_MAX_CELLS 65535u
+
+internal_func inline uint32 EntityCellKey(uint32 cell_x, uint32 cell_y){
+    return (cell_x & 0xFFFF) | (cell_y << 16);
+}
+
+// the row major cell index wrapped to the bucket count, cells next to each other in a row are next to
+// each other in the buckets too, so a row of three neighbours is one contiguous run
+internal_func inline uint32 EntityBucket(EntityStore *store, uint32 cell_x, uint32 cell_y){
+    return (cell_y * store->cells_across + cell_x) & store->bucket_mask;
+}
+
+internal_func inline uint32 EntityCell(float32 position){
+    // everything was clamped into the world by the last move, so positions are never negative here
+    uint32 cell = (uint32)(position * (1.0f / ENTITY_CELL_SIZE));
+    return (cell < ENTITY_MAX_CELLS) ? cell : ENTITY_MAX_CELLS - 1;
+}
+
+bool32 InitializeEntityStore(EntityStore *store, MemoryArena *arena, uint32 capacity, float32 world_width, float32 world_height){
+    memset(store, 0, sizeof(*store));
+    capacity = (capacity + 7) & ~7u;
+
+    // about two buckets per entity, most cells stay empty and the rest hold one or two
+    uint32 bucket_count = 16;
+    while(bucket_count < 2 * capacity){
+        bucket_count *= 2;
+    }
+
+    // both sets of components are 32 byte aligned, either can be the one MoveEntities loads from
+    float32 **float_arrays[] = {
+        &store->pos_x, &store->pos_y, &store->vel_x, &store->vel_y, &store->half_w, &store->half_h,
+        &store->next_pos_x, &store->next_pos_y, &store->next_vel_x, &store->next_vel_y, &store->next_half_w, &store->next_half_h,
+    };
+    uint32 **index_arrays[] = {&store->slot_of, &store->cell_key, &store->next_slot_of, &store->next_cell_key};
+    bool32 pushed = true;
+    for(uint32 array_index = 0; array_index < sizeof(float_arrays) / sizeof(float_arrays[0]); ++array_index){
+        *float_arrays[array_index] = PushArrayAligned(arena, capacity, float32, 32);
+        pushed = pushed && *float_arrays[array_index];
+    }
+    for(uint32 array_index = 0; array_index < sizeof(index_arrays) / sizeof(index_arrays[0]); ++array_index){
+        *index_arrays[array_index] = PushArray(arena, capacity, uint32);
+        pushed = pushed && *index_arrays[array_index];
+    }
+    store->slots = PushArray(arena, capacity, EntitySlot);
+    store->bucket_start = PushArray(arena, bucket_count + 2, uint32);
+    if(!pushed || !store->slots || !store->bucket_start){
+        memset(store, 0, sizeof(*store));
+        return false;
+    }
+
+    store->capacity = capacity;
+    store->bucket_mask = bucket_count - 1;
+    store->world_width = fminf(world_width, ENTITY_CELL_SIZE * (float32)ENTITY_MAX_CELLS);
+    store->world_height = fminf(world_height, ENTITY_CELL_SIZE * (float32)ENTITY_MAX_CELLS);
+    store->cells_across = EntityCell(store->world_width) + 1;
+
+    // every slot starts free, generation 1 so a zeroed handle never matches
+    for(uint32 slot = 0; slot < capacity; ++slot){
+        store->slots[slot].dense_index = (slot + 1 < capacity) ? slot + 1 : ENTITY_INVALID_INDEX;
+        store->slots[slot].generation = 1;
+    }
+    store->first_free_slot = 0;
+    return true;
+}
+
+EntityHandle AddEntity(EntityStore *store, float32 x, float32 y, float32 vel_x, float32 vel_y, float32 half_w, float32 half_h){
+    EntityHandle handle = {0};
+    uint32 slot = store->first_free_slot;
+    if(slot == ENTITY_INVALID_INDEX || store->count == store->capacity){
+        return handle;
+    }
+    store->first_free_slot = store->slots[slot].dense_index;
+
+    uint32 index = store->count++;
+    store->slots[slot].dense_index = index;
+    store->slot_of[index] = slot;
+    store->pos_x[index] = x;
+    store->pos_y[index] = y;
+    store->vel_x[index] = vel_x;
+    store->vel_y[index] = vel_y;
+    store->half_w[index] = fminf(half_w, ENTITY_MAX_HALF_SIZE);
+    store->half_h[index] = fminf(half_h, ENTITY_MAX_HALF_SIZE);
+
+    handle.slot = slot;
+    handle.generation = store->slots[slot].generation;
+    return handle;
+}
+
+uint32 GetEntityIndex(EntityStore *store, EntityHandle handle){
+    if(handle.slot >= store->capacity || !handle.generation || store->slots[handle.slot].generation != handle.generation){
+        return ENTITY_INVALID_INDEX;
+    }
+    return store->slots[handle.slot].dense_index;
+}
+
+EntityHandle GetEntityHandle(EntityStore *store, uint32 dense_index){
+    EntityHandle handle = {0};
+    if(dense_index < store->count){
+        handle.slot = store->slot_of[dense_index];
+        handle.generation = store->slots[handle.slot].generation;
+    }
+    return handle;
+}
+
+bool32 RemoveEntity(EntityStore *store, EntityHandle handle){
+    uint32 index = GetEntityIndex(store, handle);
+    if(index == ENTITY_INVALID_INDEX){
+        return false;
+    }
+
+    // the last entity fills the hole, only its slot has to learn where it went
+    uint32 last = --store->count;
+    if(index != last){
+        store->pos_x[index] = store->pos_x[last];
+        store->pos_y[index] = store->pos_y[last];
+        store->vel_x[index] = store->vel_x[last];
+        store->vel_y[index] = store->vel_y[last];
+        store->half_w[index] = store->half_w[last];
+        store->half_h[index] = store->half_h[last];
+        store->slot_of[index] = store->slot_of[last];
+        store->slots[store->slot_of[index]].dense_index = index;
+    }
+
+    // skipping 0 on wrap keeps zeroed handles dead
+    EntitySlot *slot = store->slots + handle.slot;
+    slot->generation = (slot->generation + 1) ? slot->generation + 1 : 1;
+    slot->dense_index = store->first_free_slot;
+    store->first_free_slot = handle.slot;
+    return true;
+}
+
+// ------------------------------------------------------------
+// Integration
+// ------------------------------------------------------------
+/*
+    All three paths do the same single precision operations in the same
+    order (one multiply, one add, the clamps are min/max), so whichever
+    moved the entities HashEntities comes out the same.
+*/
+internal_func void MoveEntitiesScalar(EntityStore *store, uint32 first, float32 dt){
+    float32 world_width = store->world_width;
+    float32 world_height = store->world_height;
+    for(uint32 i = first; i < store->count; ++i){
+        float32 x = store->pos_x[i] + store->vel_x[i] * dt;
+        float32 min_x = store->half_w[i];
+        float32 max_x = world_width - store->half_w[i];
+        if(x < min_x){
+            x = min_x;
+            store->vel_x[i] = fabsf(store->vel_x[i]);
+        } else if(x > max_x){
+            x = max_x;
+            store->vel_x[i] = -fabsf(store->vel_x[i]);
+        }
+        store->pos_x[i] = x;
+
+        float32 y = store->pos_y[i] + store->vel_y[i] * dt;
+        float32 min_y = store->half_h[i];
+        float32 max_y = world_height - store->half_h[i];
+        if(y < min_y){
+            y = min_y;
+            store->vel_y[i] = fabsf(store->vel_y[i]);
+        } else if(y > max_y){
+            y = max_y;
+            store->vel_y[i] = -fabsf(store->vel_y[i]);
+        }
+        store->pos_y[i] = y;
+    }
+}
+
+#if HANDMADE_X86
+// one axis of four entities, velocity turns towards the inside wherever the position was clamped
+internal_func inline void MoveAxis4x(float32 *position, float32 *velocity, float32 *half, __m128 dt, __m128 world, __m128 sign_mask){
+    __m128 p = _mm_add_ps(_mm_load_ps(position), _mm_mul_ps(_mm_load_ps(velocity), dt));
+    __m128 h = _mm_load_ps(half);
+    __m128 lo = h;
+    __m128 hi = _mm_sub_ps(world, h);
+    __m128 below = _mm_cmplt_ps(p, lo);
+    __m128 above = _mm_cmpgt_ps(p, hi);
+    __m128 v = _mm_load_ps(velocity);
+    __m128 speed = _mm_andnot_ps(sign_mask, v);
+    v = _mm_or_ps(_mm_andnot_ps(_mm_or_ps(below, above), v),
+                  _mm_or_ps(_mm_and_ps(below, speed), _mm_and_ps(above, _mm_or_ps(speed, sign_mask))));
+    _mm_store_ps(position, _mm_min_ps(_mm_max_ps(p, lo), hi));
+    _mm_store_ps(velocity, v);
+}
+
+internal_func uint32 MoveEntitiesSSE2(EntityStore *store, float32 dt){
+    __m128 dt_4 = _mm_set1_ps(dt);
+    __m128 width_4 = _mm_set1_ps(store->world_width);
+    __m128 height_4 = _mm_set1_ps(store->world_height);
+    __m128 sign_mask = _mm_set1_ps(-0.0f);
+    uint32 i = 0;
+    for(; i + 4 <= store->count; i += 4){
+        MoveAxis4x(store->pos_x + i, store->vel_x + i, store->half_w + i, dt_4, width_4, sign_mask);
+        MoveAxis4x(store->pos_y + i, store->vel_y + i, store->half_h + i, dt_4, height_4, sign_mask);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+internal_func inline void MoveAxis8x(float32 *position, float32 *velocity, float32 *half, __m256 dt, __m256 world, __m256 sign_mask){
+    __m256 p = _mm256_add_ps(_mm256_load_ps(position), _mm256_mul_ps(_mm256_load_ps(velocity), dt));
+    __m256 h = _mm256_load_ps(half);
+    __m256 hi = _mm256_sub_ps(world, h);
+    __m256 below = _mm256_cmp_ps(p, h, _CMP_LT_OQ);
+    __m256 above = _mm256_cmp_ps(p, hi, _CMP_GT_OQ);
+    __m256 v = _mm256_load_ps(velocity);
+    __m256 speed = _mm256_andnot_ps(sign_mask, v);
+    v = _mm256_blendv_ps(v, speed, below);
+    v = _mm256_blendv_ps(v, _mm256_or_ps(speed, sign_mask), above);
+    _mm256_store_ps(position, _mm256_min_ps(_mm256_max_ps(p, h), hi));
+    _mm256_store_ps(velocity, v);
+}
+
+__attribute__((target("avx2")))
+internal_func uint32 MoveEntitiesAVX2(EntityStore *store, float32 dt){
+    __m256 dt_8 = _mm256_set1_ps(dt);
+    __m256 width_8 = _mm256_set1_ps(store->world_width);
+    __m256 height_8 = _mm256_set1_ps(store->world_height);
+    __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    uint32 i = 0;
+    for(; i + 8 <= store->count; i += 8){
+        MoveAxis8x(store->pos_x + i, store->vel_x + i, store->half_w + i, dt_8, width_8, sign_mask);
+        MoveAxis8x(store->pos_y + i, store->vel_y + i, store->half_h + i, dt_8, height_8, sign_mask);
+    }
+    return i;
+}
+#endif
+
+void MoveEntities(EntityStore *store, float32 dt, uint32 path){
+    TIMED_FUNCTION();
+    uint32 done = 0;
+#if HANDMADE_X86
+    if(path == EntityPath_AVX2){
+        done = MoveEntitiesAVX2(store, dt);
+    } else if(path == EntityPath_SSE2){
+        done = MoveEntitiesSSE2(store, dt);
+    }
+#endif
+    // whatever is left over from the wide loops
+    MoveEntitiesScalar(store, done, dt);
+}
+
+// ------------------------------------------------------------
+// Broadphase
+// ------------------------------------------------------------
+void BuildEntityGrid(EntityStore *store){
+    TIMED_FUNCTION();
+    uint32 *start = store->bucket_start;
+    memset(start, 0, sizeof(uint32) * (store->bucket_mask + 3));
+
+    // counts land two entries up, the prefix sum then leaves each bucket's start one entry up,
+    // each entity's cell is kept in the old order for the scatter to read back
+    uint32 occupied = 0;
+    for(uint32 i = 0; i < store->count; ++i){
+        uint32 cell_x = EntityCell(store->pos_x[i]);
+        uint32 cell_y = EntityCell(store->pos_y[i]);
+        store->cell_key[i] = EntityCellKey(cell_x, cell_y);
+        occupied += (start[EntityBucket(store, cell_x, cell_y) + 2]++ == 0);
+    }
+    store->occupied_buckets = occupied;
+
+    uint32 sum = 0;
+    for(uint32 bucket = 2; bucket < store->bucket_mask + 3; ++bucket){
+        sum += start[bucket];
+        start[bucket] = sum;
+    }
+
+    // scattering moves each start up one, to where it belongs
+    for(uint32 i = 0; i < store->count; ++i){
+        uint32 key = store->cell_key[i];
+        uint32 at = start[EntityBucket(store, key & 0xFFFF, key >> 16) + 1]++;
+        store->next_cell_key[at] = key;
+        store->next_pos_x[at] = store->pos_x[i];
+        store->next_pos_y[at] = store->pos_y[i];
+        store->next_vel_x[at] = store->vel_x[i];
+        store->next_vel_y[at] = store->vel_y[i];
+        store->next_half_w[at] = store->half_w[i];
+        store->next_half_h[at] = store->half_h[i];
+        store->next_slot_of[at] = store->slot_of[i];
+    }
+
+#define SWAP_ENTITY_ARRAYS(type, a, b) { type *swap = (a); (a) = (b); (b) = swap; }
+    SWAP_ENTITY_ARRAYS(uint32, store->cell_key, store->next_cell_key);
+    SWAP_ENTITY_ARRAYS(float32, store->pos_x, store->next_pos_x);
+    SWAP_ENTITY_ARRAYS(float32, store->pos_y, store->next_pos_y);
+    SWAP_ENTITY_ARRAYS(float32, store->vel_x, store->next_vel_x);
+    SWAP_ENTITY_ARRAYS(float32, store->vel_y, store->next_vel_y);
+    SWAP_ENTITY_ARRAYS(float32, store->half_w, store->next_half_w);
+    SWAP_ENTITY_ARRAYS(float32, store->half_h, store->next_half_h);
+    SWAP_ENTITY_ARRAYS(uint32, store->slot_of, store->next_slot_of);
+#undef SWAP_ENTITY_ARRAYS
+
+    // every handle's slot learns its entity's new dense index
+    for(uint32 i = 0; i < store->count; ++i){
+        store->slots[store->slot_of[i]].dense_index = i;
+    }
+}
+
+// equal masses, so an elastic bounce along one axis just swaps the two velocities on it
+internal_func void SeparateEntities(EntityStore *store, uint32 a, uint32 b, float32 dx, float32 dy, float32 overlap_x, float32 overlap_y){
+    float32 *pos = store->pos_x;
+    float32 *vel = store->vel_x;
+    float32 delta = dx;
+    float32 overlap = overlap_x;
+    if(overlap_y < overlap_x){
+        pos = store->pos_y;
+        vel = store->vel_y;
+        delta = dy;
+        overlap = overlap_y;
+    }
+
+    float32 push = (delta < 0.0f) ? -0.5f * overlap : 0.5f * overlap;
+    pos[a] -= push;
+    pos[b] += push;
+    if((vel[b] - vel[a]) * delta < 0.0f){
+        float32 swap = vel[a];
+        vel[a] = vel[b];
+        vel[b] = swap;
+    }
+}
+
+// tests entity k against the entries of buckets first_bucket..last_bucket (wrapping around the end)
+// whose cell is min_key..max_key, one row of cells, and that come at or after first_index
+internal_func inline uint32 CollideEntityRun(EntityStore *store, uint32 k, uint32 first_bucket, uint32 last_bucket,
+                                             uint32 min_key, uint32 max_key, uint32 first_index, uint64 *tested){
+    uint32 overlaps = 0;
+    uint32 *start = store->bucket_start;
+    uint32 run_end = (last_bucket >= first_bucket) ? last_bucket : store->bucket_mask;
+    for(uint32 run = 0; run < 2; ++run){
+        uint32 first = (start[first_bucket] > first_index) ? start[first_bucket] : first_index;
+        for(uint32 m = first; m < start[run_end + 1]; ++m){
+            // cells that only share the bucket
+            uint32 key = store->cell_key[m];
+            if(key < min_key || key > max_key){
+                continue;
+            }
+            ++*tested;
+            // positions as earlier pairs left them, either may already have been pushed this step
+            float32 dx = store->pos_x[m] - store->pos_x[k];
+            float32 dy = store->pos_y[m] - store->pos_y[k];
+            float32 overlap_x = store->half_w[k] + store->half_w[m] - fabsf(dx);
+            float32 overlap_y = store->half_h[k] + store->half_h[m] - fabsf(dy);
+            if(overlap_x > 0.0f && overlap_y > 0.0f){
+                SeparateEntities(store, k, m, dx, dy, overlap_x, overlap_y);
+                ++overlaps;
+            }
+        }
+        if(last_bucket >= first_bucket){
+            break;
+        }
+        first_bucket = 0;
+        run_end = last_bucket;
+    }
+    return overlaps;
+}
+
+uint32 CollideEntities(EntityStore *store, uint64 *pairs_tested){
+    TIMED_FUNCTION();
+    uint32 overlaps = 0;
+    uint64 tested = 0;
+
+    // each pair of neighbouring cells is tested once, from the one that comes first in row major
+    // order, so an entity looks at the later entries of its own cell, the cell to its right and
+    // the three below it. Dense order is bucket order, so all of them move along with k.
+    for(uint32 k = 0; k < store->count; ++k){
+        uint32 key = store->cell_key[k];
+        uint32 cell_x = key & 0xFFFF;
+        uint32 cell_y = key >> 16;
+        uint32 bucket = EntityBucket(store, cell_x, cell_y);
+        uint32 right_bucket = EntityBucket(store, cell_x + 1, cell_y);
+        uint32 left_x = cell_x ? cell_x - 1 : 0;
+
+        overlaps += CollideEntityRun(store, k, bucket, bucket, key, key, k + 1, &tested);
+        overlaps += CollideEntityRun(store, k, right_bucket, right_bucket, key + 1, key + 1, 0, &tested);
+        overlaps += CollideEntityRun(store, k, EntityBucket(store, left_x, cell_y + 1), EntityBucket(store, cell_x + 1, cell_y + 1),
+                                     EntityCellKey(left_x, cell_y + 1), EntityCellKey(cell_x + 1, cell_y + 1), 0, &tested);
+    }
+
+    if(pairs_tested){
+        *pairs_tested += tested;
+    }
+    return overlaps;
+}
+
+uint32 QueryEntities(EntityStore *store, float32 min_x, float32 min_y, float32 max_x, float32 max_y,
+                     uint32 *results, uint32 max_results){
+    // centers up to the biggest half size outside the rectangle can still reach into it
+    uint32 first_x = EntityCell(fmaxf(min_x - ENTITY_MAX_HALF_SIZE, 0.0f));
+    uint32 first_y = EntityCell(fmaxf(min_y - ENTITY_MAX_HALF_SIZE, 0.0f));
+    uint32 last_x = EntityCell(fmaxf(max_x + ENTITY_MAX_HALF_SIZE, 0.0f));
+    uint32 last_y = EntityCell(fmaxf(max_y + ENTITY_MAX_HALF_SIZE, 0.0f));
+
+    uint32 found = 0;
+    for(uint32 cell_y = first_y; cell_y <= last_y; ++cell_y){
+        for(uint32 cell_x = first_x; cell_x <= last_x; ++cell_x){
+            uint32 key = EntityCellKey(cell_x, cell_y);
+            uint32 bucket = EntityBucket(store, cell_x, cell_y);
+            for(uint32 m = store->bucket_start[bucket]; m < store->bucket_start[bucket + 1]; ++m){
+                if(store->cell_key[m] != key ||
+                   store->pos_x[m] + store->half_w[m] <= min_x || store->pos_x[m] - store->half_w[m] >= max_x ||
+                   store->pos_y[m] + store->half_h[m] <= min_y || store->pos_y[m] - store->half_h[m] >= max_y){
+                    continue;
+                }
+                if(found < max_results){
+                    results[found] = m;
+                }
+                ++found;
+            }
+        }
+    }
+    return found;
+}
+
+uint64 HashEntities(EntityStore *store){
+    uint64 hash = 14695981039346656037ULL;
+    float32 *arrays[] = {store->pos_x, store->pos_y, store->vel_x, store->vel_y};
+    for(uint32 array_index = 0; array_index < 4; ++array_index){
+        uint8 *bytes = (uint8 *)arrays[array_index];
+        for(uint64 i = 0; i < sizeof(float32) * (uint64)store->count; ++i){
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "handmade.h"
+
+/*
+    ---------- Entities ---------------
+
+    The world is an EntityStore pushed once into permanent storage, so loop
+    edits snapshot and restore it with everything else. Each hot component
+    is its own array indexed by a dense index, live entities are always
+    0..count-1 with no holes, and a pass over positions and velocities
+    streams through memory four or eight lanes at a time:
+
+        pos_x[]  pos_y[]  vel_x[]  vel_y[]  half_w[]  half_h[]  slot_of[]
+
+    A dense index moves whenever something before the end is removed (the
+    last entity is swapped into the hole), so the game holds EntityHandles
+    instead. A handle is a slot in a table that points at the current dense
+    index, plus the slot's generation, which goes up when the entity dies,
+    so a handle to a removed entity stops resolving instead of finding
+    whoever reused the slot. Free slots are a linked list through the table.
+
+    The broadphase is a uniform grid of ENTITY_CELL_SIZE squares hashed into
+    a power of two number of buckets by their row major index, so a row of
+    neighbouring cells is a run of neighbouring buckets. It is rebuilt every
+    step with a counting sort (count each bucket, prefix sum, scatter) that
+    moves the entities themselves into a second set of arrays, which then
+    swaps with the first: dense order is bucket order. The pair tests walk
+    short contiguous runs, and as nothing moves far in a step the next count
+    and scatter read and write almost in order too. Dense indices change
+    with every build, handles do not.
+
+    An entity goes in the one bucket its center falls in. No entity is wider
+    or taller than a cell, so anything it can touch has its center in the
+    3x3 cells around it. Every entry keeps its packed cell, so cells that
+    share a bucket never see each other's entities.
+*/
+#define ENTITY_CELL_SIZE 4.0f           // no entity is bigger than this in either direction
+#define ENTITY_MAX_HALF_SIZE (0.5f * ENTITY_CELL_SIZE)
+#define ENTITY_INVALID_INDEX 0xFFFFFFFFu
+
+// which integration loop MoveEntities runs, the game maps the platform's RenderPath_* to one
+enum {
+    EntityPath_Scalar,
+    EntityPath_SSE2,
+    EntityPath_AVX2,
+};
+
+typedef struct {
+    uint32 slot;                    // into EntityStore.slots
+    uint32 generation;              // 0 is never a live generation, so a zeroed handle is no entity
+} EntityHandle;
+
+typedef struct {
+    uint32 dense_index;             // where the entity is now, or the next free slot once it is dead
+    uint32 generation;
+} EntitySlot;
+
+typedef struct EntityStore {
+    uint32 capacity;                // a multiple of 8, the arrays are 32 byte aligned
+    uint32 count;
+    float32 world_width;            // entities bounce off the edges of 0..world_width x 0..world_height
+    float32 world_height;
+
+    // hot components, dense
+    float32 *pos_x;
+    float32 *pos_y;
+    float32 *vel_x;
+    float32 *vel_y;
+    float32 *half_w;
+    float32 *half_h;
+    uint32 *slot_of;                // dense index to slot, for fixing the slot of whoever gets swapped
+
+    EntitySlot *slots;
+    uint32 first_free_slot;         // ENTITY_INVALID_INDEX when every slot is used
+
+    // broadphase, rebuilt by BuildEntityGrid
+    uint32 bucket_mask;             // bucket count - 1
+    uint32 cells_across;
+    uint32 *bucket_start;           // bucket_mask + 3 entries, bucket b is dense bucket_start[b]..bucket_start[b+1]
+    uint32 *cell_key;               // per dense index, the cell its center was in at the last build
+    uint32 occupied_buckets;
+
+    // where BuildEntityGrid scatters to, swapped with the arrays above once it is done
+    float32 *next_pos_x;
+    float32 *next_pos_y;
+    float32 *next_vel_x;
+    float32 *next_vel_y;
+    float32 *next_half_w;
+    float32 *next_half_h;
+    uint32 *next_slot_of;
+    uint32 *next_cell_key;
+} EntityStore;
+
+// pushes every array for capacity entities, false (and nothing usable) if the arena is out of room
+bool32 InitializeEntityStore(EntityStore *store, MemoryArena *arena, uint32 capacity, float32 world_width, float32 world_height);
+
+// a zeroed handle if the store is full, half sizes are clamped to ENTITY_MAX_HALF_SIZE
+EntityHandle AddEntity(EntityStore *store, float32 x, float32 y, float32 vel_x, float32 vel_y, float32 half_w, float32 half_h);
+
+// the last entity takes the removed one's dense index, false if the handle was already dead
+bool32 RemoveEntity(EntityStore *store, EntityHandle handle);
+
+// ENTITY_INVALID_INDEX once the entity is gone, only good until the next RemoveEntity or BuildEntityGrid
+uint32 GetEntityIndex(EntityStore *store, EntityHandle handle);
+EntityHandle GetEntityHandle(EntityStore *store, uint32 dense_index);
+
+// position += velocity * dt, bouncing off the world's edges, path is EntityPath_*
+void MoveEntities(EntityStore *store, float32 dt, uint32 path);
+
+// buckets every entity by its center and reorders them to match, call after moving, adding or removing and before
+// colliding or querying, dense indices from before it are stale
+void BuildEntityGrid(EntityStore *store);
+
+// pushes every overlapping pair apart and swaps their velocities along the axis they overlap
+// least on, returns how many pairs overlapped, pairs_tested counts the candidates
+uint32 CollideEntities(EntityStore *store, uint64 *pairs_tested);
+
+// dense indices of up to max_results entities whose bounds overlap the rectangle, returns how many
+// overlapped in total, which can be more than max_results, positions are as of the last build
+// plus whatever CollideEntities pushed them since
+uint32 QueryEntities(EntityStore *store, float32 min_x, float32 min_y, float32 max_x, float32 max_y,
+                     uint32 *results, uint32 max_results);
+
+// FNV-1a over the positions and velocities, equal stores hash the same whichever path moved them
+uint64 HashEntities(EntityStore *store);
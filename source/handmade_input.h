@@ -0,0 +1,132 @@
+#pragma once
+#include "handmade.h"
+
+/*
+    ---------- Input events ---------------
+
+    The platform turns every SDL key, gamepad button, stick and hot-plug
+    event into an InputEvent with the SDL_Event's own timestamp and keeps
+    them in GameInputState.events, sorted oldest first. It also applies
+    each one to GameInputState.controllers as it arrives, so a game that
+    only wants "where did the buttons end up" reads those and ignores the
+    events, a tap inside one frame still shows up as two half transitions.
+
+    A game that wants the latency back walks the events instead. The
+    scheduler's steps each end at a point on the same clock, the last one
+    interpolation steps before input->timestamp, so a step only sees what
+    happened before it ended:
+
+        for each step:
+            while((event = NextInputEvent(input, &event_index, InputStepEndTime(input, step))))
+                ApplyInputEvent(controllers, event);
+            simulate the step
+            ClearInputTransitions(controllers);
+
+    Events after the last step's end go on to the next frame's first step.
+    Platform and game share ApplyInputEvent, so walking the events ends
+    exactly where the platform's controllers did, unless events overflowed
+    (dropped_event_count), then the game copies the platform's state over.
+
+    The stick doubles as a dpad, an axis only moves the two buttons on its
+    own axis and only when the value crosses STICK_DPAD_THRESHOLD, so stick
+    noise never releases a dpad button held at the same time.
+*/
+#define STICK_DPAD_THRESHOLD 0.5f
+
+internal_func inline void SetInputButton(ButtonState *button, bool is_down){
+    if(button->ended_down != is_down){
+        button->ended_down = is_down;
+        if(button->half_transition_count < 255){
+            ++button->half_transition_count;
+        }
+    }
+}
+
+internal_func inline void ClearInputTransitions(GameControllerInput *controllers){
+    for(uint32 controller_index = 0; controller_index < MAX_CONTROLLER_COUNT; ++controller_index){
+        for(uint32 button_index = 0; button_index < GameButton_Count; ++button_index){
+            controllers[controller_index].keys[button_index].half_transition_count = 0;
+        }
+    }
+}
+
+internal_func inline void ApplyInputEvent(GameControllerInput *controllers, InputEvent *event){
+    if(event->controller_index >= MAX_CONTROLLER_COUNT){
+        return;
+    }
+    GameControllerInput *controller = controllers + event->controller_index;
+
+    switch(event->type){
+        case InputEvent_Button:{
+            if(event->index < GameButton_Count){
+                SetInputButton(&controller->keys[event->index], event->is_down);
+            }
+        }
+        break;
+
+        case InputEvent_Axis:{
+            bool is_x = (event->index == GameAxis_StickX);
+            float32 *axis = is_x ? &controller->end_x : &controller->end_y;
+            float32 *min = is_x ? &controller->min_x : &controller->min_y;
+            float32 *max = is_x ? &controller->max_x : &controller->max_y;
+            float32 old_value = *axis;
+            float32 value = event->value;
+            *axis = value;
+            if(value < *min) *min = value;
+            if(value > *max) *max = value;
+            controller->is_analog = (controller->end_x != 0.0f || controller->end_y != 0.0f);
+
+            // up and left are negative
+            ButtonState *negative = is_x ? &controller->move_left : &controller->move_up;
+            ButtonState *positive = is_x ? &controller->move_right : &controller->move_down;
+            if((old_value < -STICK_DPAD_THRESHOLD) != (value < -STICK_DPAD_THRESHOLD)){
+                SetInputButton(negative, value < -STICK_DPAD_THRESHOLD);
+            }
+            if((old_value > STICK_DPAD_THRESHOLD) != (value > STICK_DPAD_THRESHOLD)){
+                SetInputButton(positive, value > STICK_DPAD_THRESHOLD);
+            }
+        }
+        break;
+
+        case InputEvent_Connected:
+        case InputEvent_Disconnected:{
+            for(uint32 button_index = 0; button_index < GameButton_Count; ++button_index){
+                SetInputButton(&controller->keys[button_index], false);
+            }
+            controller->start_x = controller->end_x = controller->min_x = controller->max_x = 0.0f;
+            controller->start_y = controller->end_y = controller->min_y = controller->max_y = 0.0f;
+            controller->is_analog = false;
+            controller->is_connected = (event->type == InputEvent_Connected);
+        }
+        break;
+    }
+}
+
+// when fixed step step_index of this frame ends, on the events' clock
+internal_func inline uint64 InputStepEndTime(GameInputState *input, uint32 step_index){
+    if(!input->update_hz || step_index >= input->update_count){
+        return input->timestamp;
+    }
+    double64 steps_behind = (double64)(input->update_count - 1 - step_index) + (double64)input->interpolation;
+    uint64 behind_ns = (uint64)(steps_behind * 1e9 / (double64)input->update_hz);
+    return (behind_ns < input->timestamp) ? input->timestamp - behind_ns : 0;
+}
+
+// the next event at or before until, NULL once there is none, event_index starts at 0 every frame
+internal_func inline InputEvent *NextInputEvent(GameInputState *input, uint32 *event_index, uint64 until){
+    if(*event_index < input->event_count && input->events[*event_index].timestamp <= until){
+        return input->events + (*event_index)++;
+    }
+    return NULL;
+}
+
+// where source's controllers are without touching dest's transitions, for after events were dropped
+internal_func inline void CopyControllerState(GameControllerInput *dest, GameControllerInput *source){
+    for(uint32 controller_index = 0; controller_index < MAX_CONTROLLER_COUNT; ++controller_index){
+        GameControllerInput copy = source[controller_index];
+        for(uint32 button_index = 0; button_index < GameButton_Count; ++button_index){
+            copy.keys[button_index].half_transition_count = dest[controller_index].keys[button_index].half_transition_count;
+        }
+        dest[controller_index] = copy;
+    }
+}
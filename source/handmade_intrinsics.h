@@ -0,0 +1,55 @@
+#pragma once
+#include "handmade.h"
+
+#define TWO_PI_HI 6.28125f                  // exact in a float
+#define TWO_PI_LO 1.9353071795864769e-3f    // 2pi - TWO_PI_HI
+#define INV_TWO_PI 0.15915494309189535f
+#define PI_F 3.14159265358979323846f
+
+/*
+    ---------- Fast sine ---------------
+
+    1. range reduce to [-pi, pi] with a two part 2pi so large t stays accurate
+    2. fold to [-pi/2, pi/2] using sin(x) = sin(pi - x)
+    3. odd Taylor polynomial up to x^9, error is below 4e-6 on that range
+
+    That is far inside the 1/255 step of a colour channel, so the gradient
+    matches the double precision sin() to within one unit per channel, and
+    around -108 dB for the mixer's tones.
+*/
+#if HANDMADE_X86
+internal_func inline __m128 FastSin4(__m128 x){
+    __m128 k = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(INV_TWO_PI))));
+    x = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(TWO_PI_HI)));
+    x = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(TWO_PI_LO)));
+
+    __m128 sign = _mm_and_ps(x, _mm_set1_ps(-0.0f));
+    __m128 abs_x = _mm_xor_ps(x, sign);
+    __m128 folded = _mm_min_ps(abs_x, _mm_sub_ps(_mm_set1_ps(PI_F), abs_x));
+    x = _mm_or_ps(folded, sign);
+
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 p = _mm_set1_ps(2.7557319e-6f);
+    p = _mm_sub_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.9841270e-4f));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(8.3333333e-3f));
+    p = _mm_sub_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.6666667e-1f));
+    return _mm_add_ps(x, _mm_mul_ps(_mm_mul_ps(x, x2), p));
+}
+#endif
+
+internal_func inline float FastSin(float x){
+    float k = floorf(x * INV_TWO_PI + 0.5f);
+    x = x - k * TWO_PI_HI;
+    x = x - k * TWO_PI_LO;
+
+    float abs_x = fabsf(x);
+    float folded = fminf(abs_x, PI_F - abs_x);
+    x = copysignf(folded, x);
+
+    float x2 = x * x;
+    float p = 2.7557319e-6f;
+    p = p * x2 - 1.9841270e-4f;
+    p = p * x2 + 8.3333333e-3f;
+    p = p * x2 - 1.6666667e-1f;
+    return x + x * x2 * p;
+}
@@ -0,0 +1,1103 @@
+#include "handmade_render.h"
+#include "handmade_intrinsics.h"
+#include "handmade_debug.h"
+#include <string.h>
+
+// every table is padded to a whole cache line so the next one starts aligned
+#define TABLE_PAD(count) (((count) + 15) & ~15u)
+
+uint32 ResolveRenderPath(uint32 requested){
+#if HANDMADE_X86
+    bool has_avx2 = __builtin_cpu_supports("avx2");
+    switch (requested) {
+        case RenderPath_Scalar:
+        case RenderPath_Separable:
+        case RenderPath_SSE2:
+            return requested;
+        case RenderPath_AVX2:
+            return has_avx2 ? RenderPath_AVX2 : RenderPath_SSE2;
+        default:
+            return has_avx2 ? RenderPath_AVX2 : RenderPath_SSE2;
+    }
+#else
+    // no x86 vector units, the portable separable path is the fastest we have
+    if (requested == RenderPath_Scalar) {
+        return RenderPath_Scalar;
+    }
+    return RenderPath_Separable;
+#endif
+}
+
+// the last row and column also cover anything past DIRTY_TILE_ROWS / DIRTY_TILE_COLUMNS squares
+internal_func inline uint32 DirtyTileIndex(uint32 coordinate, uint32 count){
+    uint32 index = coordinate >> DIRTY_TILE_SHIFT;
+    return (index < count) ? index : count - 1;
+}
+
+void MarkDirtyRectangle(RenderBuffer *buffer, uint32 min_x, uint32 min_y, uint32 max_x, uint32 max_y){
+    if(min_x >= max_x || min_y >= max_y){
+        return;
+    }
+    uint32 first_column = DirtyTileIndex(min_x, DIRTY_TILE_COLUMNS);
+    uint32 last_column = DirtyTileIndex(max_x - 1, DIRTY_TILE_COLUMNS);
+    uint32 first_row = DirtyTileIndex(min_y, DIRTY_TILE_ROWS);
+    uint32 last_row = DirtyTileIndex(max_y - 1, DIRTY_TILE_ROWS);
+    uint64 mask = (~0ull >> (63 - last_column)) & (~0ull << first_column);
+
+    // render tiles next to each other share a row's word, the plain load keeps the locked or off
+    // the common path where another draw in the same square already set the bits
+    for(uint32 row = first_row; row <= last_row; ++row){
+        if((__atomic_load_n(buffer->dirty_tiles + row, __ATOMIC_RELAXED) & mask) != mask){
+            __atomic_fetch_or(buffer->dirty_tiles + row, mask, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+size_t GradientTablesSize(uint32 width, uint32 height){
+    return sizeof(uint32) * (TABLE_PAD(width) + TABLE_PAD(height) + TABLE_PAD(width + height));
+}
+
+#if HANDMADE_X86
+// table[i] = channel(sin((i + t * 100) * 0.01)) << shift | or_bits, 4 entries at a time
+internal_func void BuildChannelTable(uint32 *table, uint32 count, float t, uint32 shift, uint32 or_bits){
+    __m128 offset = _mm_set1_ps(t * 100);
+    __m128 scale = _mm_set1_ps(0.01f);
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 max_channel = _mm_set1_ps(255.0f);
+    __m128 index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 four = _mm_set1_ps(4.0f);
+    __m128i bits = _mm_set1_epi32((int)or_bits);
+    __m128i shift_count = _mm_cvtsi32_si128((int)shift);
+
+    // tables are padded to 16 entries so the last partial group can be written whole
+    for (uint32 i = 0; i < count; i += 4) {
+        __m128 s = FastSin4(_mm_mul_ps(_mm_add_ps(index, offset), scale));
+        __m128i channel = _mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(s, half), half), max_channel));
+        channel = _mm_or_si128(_mm_sll_epi32(channel, shift_count), bits);
+        _mm_store_si128((__m128i *)(table + i), channel);
+        index = _mm_add_ps(index, four);
+    }
+}
+#else
+// sine in [-1, 1] to a channel value in [0, 255], same scale as FillGradientScalar
+internal_func uint32 SineToChannel(float s){
+    return (uint32)((s * 0.5f + 0.5f) * 255.0f);
+}
+
+internal_func void BuildChannelTable(uint32 *table, uint32 count, float t, uint32 shift, uint32 or_bits){
+    for (uint32 i = 0; i < count; ++i) {
+        float s = FastSin((i + t * 100) * 0.01f);
+        table[i] = (SineToChannel(s) << shift) | or_bits;
+    }
+}
+#endif
+
+// memory must be 16 byte aligned and GradientTablesSize bytes long
+void BuildGradientTables(GradientTables *tables, uint32 width, uint32 height, float t, void *memory){
+    tables->red = (uint32 *)memory;
+    tables->green = tables->red + TABLE_PAD(width);
+    tables->blue = tables->green + TABLE_PAD(height);
+
+    uint32 alpha = 255u << 24;
+    BuildChannelTable(tables->red, width, t, 16, alpha);
+    BuildChannelTable(tables->green, height, t, 8, 0);
+    BuildChannelTable(tables->blue, width + height, t, 0, 0);
+}
+
+// reference implementation, the other paths must match it to within 1 per channel
+internal_func void FillGradientScalar(RenderBuffer *buffer, float t,
+                                      uint32 min_x, uint32 min_y, uint32 max_x, uint32 max_y){
+    for (uint32 y = min_y; y < max_y; ++y) {
+        uint32 *row = (uint32 *)((uint8 *)buffer->pixels + (size_t)y * buffer->pitch);
+        for (uint32 x = min_x; x < max_x; ++x) {
+            uint8 red = (uint8)((sin((x + t *100) * 0.01f) * 0.5f + 0.5f) *255);
+            uint8 blue = (uint8)((sin((x + y + t *100) * 0.01f) * 0.5f + 0.5f) *255);
+            uint8 green = (uint8)((sin((y + t *100) * 0.01f) * 0.5f + 0.5f) *255);
+            uint8 alpha = 255;
+            row[x] = blue | (green << 8) | (red << 16) | (alpha << 24);
+        }
+    }
+    MarkDirtyRectangle(buffer, min_x, min_y, max_x, max_y);
+}
+
+internal_func void FillGradientSeparable(RenderBuffer *buffer, GradientTables *tables,
+                                         uint32 min_x, uint32 min_y, uint32 max_x, uint32 max_y){
+    for (uint32 y = min_y; y < max_y; ++y) {
+        uint32 *row = (uint32 *)((uint8 *)buffer->pixels + (size_t)y * buffer->pitch);
+        uint32 *blue = tables->blue + y;
+        uint32 green = tables->green[y];
+        for (uint32 x = min_x; x < max_x; ++x) {
+            row[x] = tables->red[x] | blue[x] | green;
+        }
+    }
+}
+
+#if HANDMADE_X86
+internal_func void FillGradientSSE2(RenderBuffer *buffer, GradientTables *tables,
+                                    uint32 min_x, uint32 min_y, uint32 max_x, uint32 max_y){
+    for (uint32 y = min_y; y < max_y; ++y) {
+        uint32 *row = (uint32 *)((uint8 *)buffer->pixels + (size_t)y * buffer->pitch);
+        uint32 *blue = tables->blue + y;
+        uint32 green = tables->green[y];
+        __m128i green4 = _mm_set1_epi32((int)green);
+
+        uint32 x = min_x;
+        for (; x + 4 <= max_x; x += 4) {
+            __m128i red4 = _mm_loadu_si128((__m128i *)(tables->red + x));
+            __m128i blue4 = _mm_loadu_si128((__m128i *)(blue + x));
+            _mm_storeu_si128((__m128i *)(row + x), _mm_or_si128(_mm_or_si128(red4, blue4), green4));
+        }
+        for (; x < max_x; ++x) {
+            row[x] = tables->red[x] | blue[x] | green;
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+internal_func void FillGradientAVX2(RenderBuffer *buffer, GradientTables *tables,
+                                    uint32 min_x, uint32 min_y, uint32 max_x, uint32 max_y){
+    for (uint32 y = min_y; y < max_y; ++y) {
+        uint32 *row = (uint32 *)((uint8 *)buffer->pixels + (size_t)y * buffer->pitch);
+        uint32 *blue = tables->blue + y;
+        uint32 green = tables->green[y];
+        __m256i green8 = _mm256_set1_epi32((int)green);
+
+        uint32 x = min_x;
+        for (; x + 8 <= max_x; x += 8) {
+            __m256i red8 = _mm256_loadu_si256((__m256i *)(tables->red + x));
+            __m256i blue8 = _mm256_loadu_si256((__m256i *)(blue + x));
+            _mm256_storeu_si256((__m256i *)(row + x), _mm256_or_si256(_mm256_or_si256(red8, blue8), green8));
+        }
+        for (; x < max_x; ++x) {
+            row[x] = tables->red[x] | blue[x] | green;
+        }
+    }
+}
+#endif
+
+void FillGradient(RenderBuffer *buffer, GradientTables *tables,
+                  uint32 min_x, uint32 min_y, uint32 max_x, uint32 max_y, uint32 render_path){
+    switch (render_path) {
+#if HANDMADE_X86
+        case RenderPath_AVX2:
+            FillGradientAVX2(buffer, tables, min_x, min_y, max_x, max_y);
+            break;
+        case RenderPath_SSE2:
+            FillGradientSSE2(buffer, tables, min_x, min_y, max_x, max_y);
+            break;
+#endif
+        default:
+            FillGradientSeparable(buffer, tables, min_x, min_y, max_x, max_y);
+            break;
+    }
+    MarkDirtyRectangle(buffer, min_x, min_y, max_x, max_y);
+}
+
+// ------------------------------------------------------------
+// Blending, one row span per call
+// ------------------------------------------------------------
+internal_func void BlendSpanScalar(uint32 *dest, uint32 *source, uint32 count, bool32 premultiplied){
+    for(uint32 i = 0; i < count; ++i){
+        uint32 s = source[i];
+        uint32 d = dest[i];
+        uint32 alpha = s >> 24;
+        uint32 inv_alpha = 255 - alpha;
+
+        uint32 result = 0;
+        for(uint32 shift = 0; shift < 32; shift += 8){
+            uint32 s_channel = (s >> shift) & 0xFF;
+            uint32 d_channel = (d >> shift) & 0xFF;
+            if(!premultiplied && shift != 24){
+                s_channel = Div255(s_channel * alpha);
+            }
+            uint32 channel = s_channel + Div255(d_channel * inv_alpha);
+            // only a bitmap with colour above its alpha gets here, the SIMD packs saturate the same way
+            if(channel > 255){
+                channel = 255;
+            }
+            result |= channel << shift;
+        }
+        dest[i] = result;
+    }
+}
+
+#if HANDMADE_X86
+/*
+    Both SIMD paths widen to 16 bits per channel, two pixels per 128 bits:
+        alpha   broadcast of each pixel's alpha to its four channels
+        s'      straight: Div255(s * alpha), with 255 in the alpha lane so alpha passes through
+        out     s' + Div255(d * (255 - alpha))
+    Div255(x) is mulhi(x + 128, 257), exact for every 8-bit product.
+*/
+internal_func __m128i Div255_4x(__m128i x){
+    return _mm_mulhi_epu16(_mm_add_epi16(x, _mm_set1_epi16(128)), _mm_set1_epi16(257));
+}
+
+internal_func __m128i BlendPixels2x(__m128i s, __m128i d, bool32 premultiplied){
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF);
+    __m128i inv_alpha = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+    if(!premultiplied){
+        __m128i alpha_lane = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+        __m128i scale = _mm_or_si128(_mm_andnot_si128(alpha_lane, alpha), _mm_and_si128(alpha_lane, _mm_set1_epi16(255)));
+        s = Div255_4x(_mm_mullo_epi16(s, scale));
+    }
+    return _mm_add_epi16(s, Div255_4x(_mm_mullo_epi16(d, inv_alpha)));
+}
+
+internal_func void BlendSpanSSE2(uint32 *dest, uint32 *source, uint32 count, bool32 premultiplied){
+    __m128i zero = _mm_setzero_si128();
+    uint32 i = 0;
+    for(; i + 4 <= count; i += 4){
+        __m128i s = _mm_loadu_si128((__m128i *)(source + i));
+        __m128i d = _mm_loadu_si128((__m128i *)(dest + i));
+
+        __m128i lo = BlendPixels2x(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), premultiplied);
+        __m128i hi = BlendPixels2x(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), premultiplied);
+        _mm_storeu_si128((__m128i *)(dest + i), _mm_packus_epi16(lo, hi));
+    }
+    BlendSpanScalar(dest + i, source + i, count - i, premultiplied);
+}
+
+__attribute__((target("avx2")))
+internal_func __m256i Div255_8x(__m256i x){
+    return _mm256_mulhi_epu16(_mm256_add_epi16(x, _mm256_set1_epi16(128)), _mm256_set1_epi16(257));
+}
+
+__attribute__((target("avx2")))
+internal_func __m256i BlendPixels4x(__m256i s, __m256i d, bool32 premultiplied){
+    __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, 0xFF), 0xFF);
+    __m256i inv_alpha = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+    if(!premultiplied){
+        __m256i alpha_lane = _mm256_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1);
+        __m256i scale = _mm256_blendv_epi8(alpha, _mm256_set1_epi16(255), alpha_lane);
+        s = Div255_8x(_mm256_mullo_epi16(s, scale));
+    }
+    return _mm256_add_epi16(s, Div255_8x(_mm256_mullo_epi16(d, inv_alpha)));
+}
+
+// unpack and pack both work inside 128-bit lanes, so pixel order comes back unchanged
+__attribute__((target("avx2")))
+internal_func void BlendSpanAVX2(uint32 *dest, uint32 *source, uint32 count, bool32 premultiplied){
+    __m256i zero = _mm256_setzero_si256();
+    uint32 i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m256i s = _mm256_loadu_si256((__m256i *)(source + i));
+        __m256i d = _mm256_loadu_si256((__m256i *)(dest + i));
+
+        __m256i lo = BlendPixels4x(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero), premultiplied);
+        __m256i hi = BlendPixels4x(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero), premultiplied);
+        _mm256_storeu_si256((__m256i *)(dest + i), _mm256_packus_epi16(lo, hi));
+    }
+    BlendSpanSSE2(dest + i, source + i, count - i, premultiplied);
+}
+#endif
+
+uint32 DrawBitmap(RenderBuffer *buffer, LoadedBitmap *bitmap, int32 x, int32 y,
+                  int32 clip_min_x, int32 clip_min_y, int32 clip_max_x, int32 clip_max_y, uint32 render_path){
+    if(clip_min_x < 0) clip_min_x = 0;
+    if(clip_min_y < 0) clip_min_y = 0;
+    if(clip_max_x > (int32)buffer->width) clip_max_x = (int32)buffer->width;
+    if(clip_max_y > (int32)buffer->height) clip_max_y = (int32)buffer->height;
+
+    int32 min_x = x;
+    int32 min_y = y;
+    int32 max_x = x + (int32)bitmap->width;
+    int32 max_y = y + (int32)bitmap->height;
+
+    int32 source_x = 0;
+    int32 source_y = 0;
+    if(min_x < clip_min_x){
+        source_x = clip_min_x - min_x;
+        min_x = clip_min_x;
+    }
+    if(min_y < clip_min_y){
+        source_y = clip_min_y - min_y;
+        min_y = clip_min_y;
+    }
+    if(max_x > clip_max_x){
+        max_x = clip_max_x;
+    }
+    if(max_y > clip_max_y){
+        max_y = clip_max_y;
+    }
+    if(min_x >= max_x || min_y >= max_y){
+        return 0;
+    }
+
+    uint32 count = (uint32)(max_x - min_x);
+    uint8 *source_row = (uint8 *)bitmap->pixels + (size_t)source_y * bitmap->pitch + (size_t)source_x * 4;
+    uint8 *dest_row = (uint8 *)buffer->pixels + (size_t)min_y * buffer->pitch + (size_t)min_x * 4;
+
+    for(int32 row = min_y; row < max_y; ++row){
+        switch(render_path){
+#if HANDMADE_X86
+            case RenderPath_AVX2:
+                BlendSpanAVX2((uint32 *)dest_row, (uint32 *)source_row, count, bitmap->premultiplied);
+                break;
+            case RenderPath_SSE2:
+                BlendSpanSSE2((uint32 *)dest_row, (uint32 *)source_row, count, bitmap->premultiplied);
+                break;
+#endif
+            default:
+                BlendSpanScalar((uint32 *)dest_row, (uint32 *)source_row, count, bitmap->premultiplied);
+                break;
+        }
+        source_row += bitmap->pitch;
+        dest_row += buffer->pitch;
+    }
+    MarkDirtyRectangle(buffer, (uint32)min_x, (uint32)min_y, (uint32)max_x, (uint32)max_y);
+    return count * (uint32)(max_y - min_y);
+}
+
+// ------------------------------------------------------------
+// Render commands
+// ------------------------------------------------------------
+typedef struct {
+    uint64 key;         // layer << 32 | type << 24 | material
+    uint32 offset;      // of the command in the push buffer
+    uint32 index;       // gradients only, which GradientTables to fill from
+} RenderSortEntry;
+
+typedef struct {
+    uint32 type;
+    uint32 material;
+    uint32 first_entry;
+    uint32 entry_count;
+} RenderBatch;
+
+typedef struct {
+    RenderCommands *commands;
+    RenderBuffer *target;
+    RenderSortEntry *entries;
+    RenderBatch *batches;
+    uint32 batch_count;
+    GradientTables *gradient_tables;
+    uint32 render_path;
+
+    uint32 min_x;
+    uint32 min_y;
+    uint32 max_x;
+    uint32 max_y;
+    uint64 *tile_hash;      // the target's slot for this tile, NULL when nothing is skipped
+
+    // written once when the tile is done, summed after every tile is
+    uint64 gradient_ticks;
+    uint64 gradient_cycles;
+    uint64 bitmap_ticks;
+    uint64 bitmap_cycles;
+    uint64 bitmap_pixels;
+    uint32 gradient_batches;
+    uint32 bitmap_batches;
+    bool32 skipped;
+} TileRenderWork;
+
+internal_func uint64 RenderSortKey(RenderCommandHeader *header){
+    return ((uint64)header->layer << 32) | ((uint64)header->type << 24) | (header->material & 0xFFFFFF);
+}
+
+// the backend also runs buffers read back from disk, so every size is checked before use
+internal_func bool32 IsValidRenderCommand(RenderCommands *commands, uint32 offset){
+    if(offset + sizeof(RenderCommandHeader) > commands->push_buffer_size){
+        return false;
+    }
+    RenderCommandHeader *header = (RenderCommandHeader *)(commands->push_buffer + offset);
+    local_persist uint32 command_sizes[RenderCommand_Count] = {
+        sizeof(RenderCommandClear), sizeof(RenderCommandGradient), sizeof(RenderCommandRectangle), sizeof(RenderCommandBitmap)
+    };
+    return (header->type < RenderCommand_Count) && (header->size >= command_sizes[header->type]) &&
+           (offset + header->size <= commands->push_buffer_size);
+}
+
+// bottom up merge sort, stable, returns whichever of the two arrays holds the result
+internal_func RenderSortEntry *SortRenderEntries(RenderSortEntry *entries, RenderSortEntry *temp, uint32 count){
+    RenderSortEntry *source = entries;
+    RenderSortEntry *dest = temp;
+
+    for(uint32 width = 1; width < count; width *= 2){
+        for(uint32 start = 0; start < count; start += 2 * width){
+            uint32 middle = (start + width < count) ? start + width : count;
+            uint32 end = (start + 2 * width < count) ? start + 2 * width : count;
+            uint32 a = start;
+            uint32 b = middle;
+            uint32 out = start;
+
+            // <= keeps the earlier push first when the keys are equal
+            while(a < middle && b < end){
+                dest[out++] = (source[a].key <= source[b].key) ? source[a++] : source[b++];
+            }
+            while(a < middle){
+                dest[out++] = source[a++];
+            }
+            while(b < end){
+                dest[out++] = source[b++];
+            }
+        }
+
+        RenderSortEntry *swap = source;
+        source = dest;
+        dest = swap;
+    }
+    return source;
+}
+
+// [min_x, max_x) x [min_y, max_y) already clipped to the buffer
+internal_func void FillRectangle(RenderBuffer *buffer, uint32 min_x, uint32 min_y, uint32 max_x, uint32 max_y, uint32 color){
+    for(uint32 y = min_y; y < max_y; ++y){
+        uint32 *row = (uint32 *)((uint8 *)buffer->pixels + (size_t)y * buffer->pitch);
+        for(uint32 x = min_x; x < max_x; ++x){
+            row[x] = color;
+        }
+    }
+    MarkDirtyRectangle(buffer, min_x, min_y, max_x, max_y);
+}
+
+internal_func uint64 HashRenderWords(uint64 hash, void *data, uint32 size){
+    uint64 *words = (uint64 *)data;
+    for(uint32 word_index = 0; word_index < size / 8; ++word_index){
+        hash = (hash ^ words[word_index]) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+/*
+    Two frames whose commands touching a tile hash the same draw the same
+    pixels there, as long as the first thing drawn covers the whole tile:
+    blending the same sprites again over last frame's result would not give
+    last frame's result. So only tiles that start with a clear or gradient
+    get a hash, any other tile hashes to 0 and always draws.
+
+    The hash covers the tile, the target size and render path, and each
+    touching command's bytes, bitmaps by their pointers as well since the
+    index is only this frame's.
+*/
+internal_func uint64 HashTileCommands(TileRenderWork *work){
+    RenderCommands *commands = work->commands;
+    if(!work->batch_count ||
+       (work->batches[0].type != RenderCommand_Clear && work->batches[0].type != RenderCommand_Gradient)){
+        return 0;
+    }
+
+    uint64 frame[4] = {
+        work->min_x | ((uint64)work->min_y << 32), work->max_x | ((uint64)work->max_y << 32),
+        work->target->width | ((uint64)work->target->height << 32), work->render_path
+    };
+    uint64 hash = HashRenderWords(0xCBF29CE484222325ull, frame, sizeof(frame));
+
+    int32 min_x = (int32)work->min_x, min_y = (int32)work->min_y;
+    int32 max_x = (int32)work->max_x, max_y = (int32)work->max_y;
+    for(uint32 batch_index = 0; batch_index < work->batch_count; ++batch_index){
+        RenderBatch *batch = work->batches + batch_index;
+        LoadedBitmap *bitmap = NULL;
+        if(batch->type == RenderCommand_Bitmap){
+            bitmap = (batch->material < commands->bitmap_count) ? commands->bitmaps[batch->material] : NULL;
+            if(!bitmap || !bitmap->pixels){
+                continue;
+            }
+            uint64 identity[2] = { (uint64)(uintptr_t)bitmap, (uint64)(uintptr_t)bitmap->pixels };
+            hash = HashRenderWords(hash, identity, sizeof(identity));
+        }
+
+        RenderSortEntry *entry = work->entries + batch->first_entry;
+        RenderSortEntry *end = entry + batch->entry_count;
+        for(; entry < end; ++entry){
+            RenderCommandHeader *header = (RenderCommandHeader *)(commands->push_buffer + entry->offset);
+            if(header->type == RenderCommand_Rectangle){
+                RenderCommandRectangle *command = (RenderCommandRectangle *)header;
+                if(command->max_x <= min_x || command->min_x >= max_x || command->max_y <= min_y || command->min_y >= max_y){
+                    continue;
+                }
+            } else if(header->type == RenderCommand_Bitmap){
+                RenderCommandBitmap *command = (RenderCommandBitmap *)header;
+                if(command->x + (int32)bitmap->width <= min_x || command->x >= max_x ||
+                   command->y + (int32)bitmap->height <= min_y || command->y >= max_y){
+                    continue;
+                }
+            }
+            hash = HashRenderWords(hash, header, header->size);
+        }
+    }
+    return hash ? hash : 1;
+}
+
+internal_func void DoTileRenderWork(PlatformWorkQueue *queue, void *data){
+    TIMED_FUNCTION();
+    TileRenderWork *work = (TileRenderWork *)data;
+    RenderCommands *commands = work->commands;
+    RenderBuffer *target = work->target;
+
+    // the target still holds what these commands drew here last frame
+    if(work->tile_hash){
+        uint64 hash = HashTileCommands(work);
+        if(hash && *work->tile_hash == hash){
+            work->skipped = true;
+            return;
+        }
+        *work->tile_hash = hash;
+    }
+
+    uint64 gradient_ticks = 0, gradient_cycles = 0;
+    uint64 bitmap_ticks = 0, bitmap_cycles = 0, bitmap_pixels = 0;
+
+    for(uint32 batch_index = 0; batch_index < work->batch_count; ++batch_index){
+        RenderBatch *batch = work->batches + batch_index;
+        RenderSortEntry *entry = work->entries + batch->first_entry;
+        RenderSortEntry *end = entry + batch->entry_count;
+
+        switch(batch->type){
+            case RenderCommand_Clear:{
+                for(; entry < end; ++entry){
+                    RenderCommandClear *command = (RenderCommandClear *)(commands->push_buffer + entry->offset);
+                    FillRectangle(target, work->min_x, work->min_y, work->max_x, work->max_y, command->color);
+                }
+            } break;
+
+            case RenderCommand_Gradient:{
+                uint64 start_ticks = PlatformGetWallClock();
+                uint64 start_cycles = ReadCycleCounter();
+                for(; entry < end; ++entry){
+                    RenderCommandGradient *command = (RenderCommandGradient *)(commands->push_buffer + entry->offset);
+                    if(work->render_path == RenderPath_Scalar){
+                        FillGradientScalar(target, command->t, work->min_x, work->min_y, work->max_x, work->max_y);
+                    } else {
+                        FillGradient(target, work->gradient_tables + entry->index,
+                                     work->min_x, work->min_y, work->max_x, work->max_y, work->render_path);
+                    }
+                }
+                gradient_cycles += ReadCycleCounter() - start_cycles;
+                gradient_ticks += PlatformGetWallClock() - start_ticks;
+                ++work->gradient_batches;
+            } break;
+
+            case RenderCommand_Rectangle:{
+                for(; entry < end; ++entry){
+                    RenderCommandRectangle *command = (RenderCommandRectangle *)(commands->push_buffer + entry->offset);
+                    int32 min_x = (command->min_x > (int32)work->min_x) ? command->min_x : (int32)work->min_x;
+                    int32 min_y = (command->min_y > (int32)work->min_y) ? command->min_y : (int32)work->min_y;
+                    int32 max_x = (command->max_x < (int32)work->max_x) ? command->max_x : (int32)work->max_x;
+                    int32 max_y = (command->max_y < (int32)work->max_y) ? command->max_y : (int32)work->max_y;
+                    if(min_x < max_x && min_y < max_y){
+                        FillRectangle(target, (uint32)min_x, (uint32)min_y, (uint32)max_x, (uint32)max_y, command->color);
+                    }
+                }
+            } break;
+
+            case RenderCommand_Bitmap:{
+                // the material is the bitmap, so a batch looks it up once
+                LoadedBitmap *bitmap = (batch->material < commands->bitmap_count) ? commands->bitmaps[batch->material] : NULL;
+                if(!bitmap || !bitmap->pixels){
+                    break;
+                }
+
+                uint64 start_ticks = PlatformGetWallClock();
+                uint64 start_cycles = ReadCycleCounter();
+                for(; entry < end; ++entry){
+                    RenderCommandBitmap *command = (RenderCommandBitmap *)(commands->push_buffer + entry->offset);
+                    bitmap_pixels += DrawBitmap(target, bitmap, command->x, command->y,
+                                                (int32)work->min_x, (int32)work->min_y, (int32)work->max_x, (int32)work->max_y,
+                                                work->render_path);
+                }
+                bitmap_cycles += ReadCycleCounter() - start_cycles;
+                bitmap_ticks += PlatformGetWallClock() - start_ticks;
+                ++work->bitmap_batches;
+            } break;
+        }
+    }
+
+    work->gradient_ticks = gradient_ticks;
+    work->gradient_cycles = gradient_cycles;
+    work->bitmap_ticks = bitmap_ticks;
+    work->bitmap_cycles = bitmap_cycles;
+    work->bitmap_pixels = bitmap_pixels;
+}
+
+internal_func uint32 CountGradientCommands(RenderCommands *commands){
+    uint32 gradient_count = 0;
+    uint32 offset = 0;
+    for(uint32 command_index = 0; command_index < commands->command_count; ++command_index){
+        if(!IsValidRenderCommand(commands, offset)){
+            break;
+        }
+        RenderCommandHeader *header = (RenderCommandHeader *)(commands->push_buffer + offset);
+        gradient_count += (header->type == RenderCommand_Gradient);
+        offset += header->size;
+    }
+    return gradient_count;
+}
+
+uint64 RenderCommandsScratchSize(RenderCommands *commands, uint32 width, uint32 height){
+    uint64 count = commands->command_count;
+    uint64 gradient_count = CountGradientCommands(commands);
+
+    // every push may pay up to 64 bytes of alignment
+    uint64 size = 2 * count * sizeof(RenderSortEntry) + count * sizeof(RenderBatch) +
+                  gradient_count * (sizeof(GradientTables) + GradientTablesSize(width, height)) +
+                  MAX_RENDER_TILES * sizeof(TileRenderWork);
+    return size + (6 + gradient_count) * 64;
+}
+
+void RenderCommandsToOutput(RenderCommands *commands, RenderBuffer *target, PlatformWorkQueue *queue,
+                            uint32 render_path, MemoryArena *scratch, DebugTimer *debug_timers, RenderStats *stats){
+    uint64 sort_start_ticks = PlatformGetWallClock();
+    uint64 sort_start_cycles = ReadCycleCounter();
+    if(stats){
+        *stats = (RenderStats){0};
+    }
+
+    uint32 gradient_count = CountGradientCommands(commands);
+    RenderSortEntry *entries = PushArray(scratch, commands->command_count, RenderSortEntry);
+    RenderSortEntry *temp = PushArray(scratch, commands->command_count, RenderSortEntry);
+    RenderBatch *batches = PushArray(scratch, commands->command_count, RenderBatch);
+    GradientTables *gradient_tables = PushArray(scratch, gradient_count, GradientTables);
+    TileRenderWork *work_array = PushArray(scratch, MAX_RENDER_TILES, TileRenderWork);
+    if(!entries || !temp || !batches || !gradient_tables || !work_array){
+        return;
+    }
+
+    // one entry per command in push order, the game usually pushes in layer order already
+    uint32 entry_count = 0;
+    uint32 gradient_index = 0;
+    bool32 sorted = true;
+    uint32 offset = 0;
+    for(uint32 command_index = 0; command_index < commands->command_count; ++command_index){
+        if(!IsValidRenderCommand(commands, offset)){
+            break;
+        }
+        RenderCommandHeader *header = (RenderCommandHeader *)(commands->push_buffer + offset);
+        RenderSortEntry *entry = entries + entry_count;
+        entry->key = RenderSortKey(header);
+        entry->offset = offset;
+        entry->index = 0;
+        if(entry_count && entry->key < entry[-1].key){
+            sorted = false;
+        }
+
+        // tables only depend on the command and the target size, so they are built once for every tile
+        if(header->type == RenderCommand_Gradient && render_path != RenderPath_Scalar){
+            void *table_memory = PushSizeAligned(scratch, GradientTablesSize(target->width, target->height), 64);
+            if(!table_memory){
+                break;
+            }
+            entry->index = gradient_index++;
+            BuildGradientTables(gradient_tables + entry->index, target->width, target->height,
+                                ((RenderCommandGradient *)header)->t, table_memory);
+        }
+
+        ++entry_count;
+        offset += header->size;
+    }
+    if(!sorted){
+        entries = SortRenderEntries(entries, temp, entry_count);
+    }
+
+    // runs of one key share everything a batch sets up
+    uint32 batch_count = 0;
+    for(uint32 entry_index = 0; entry_index < entry_count; ++entry_index){
+        if(!batch_count || entries[entry_index].key != entries[entry_index - 1].key){
+            RenderBatch *batch = batches + batch_count++;
+            batch->type = (uint32)(entries[entry_index].key >> 24) & 0xFF;
+            batch->material = (uint32)entries[entry_index].key & 0xFFFFFF;
+            batch->first_entry = entry_index;
+            batch->entry_count = 0;
+        }
+        ++batches[batch_count - 1].entry_count;
+    }
+
+    if(debug_timers){
+        debug_timers[DebugTimer_SortRenderCommands].cycles += ReadCycleCounter() - sort_start_cycles;
+        debug_timers[DebugTimer_SortRenderCommands].elapsed += PlatformGetWallClock() - sort_start_ticks;
+        ++debug_timers[DebugTimer_SortRenderCommands].hit_count;
+    }
+
+    // without a queue the whole target is one tile on this thread
+    uint32 tile_width = queue ? RENDER_TILE_WIDTH : target->width;
+    uint32 tile_height = queue ? RENDER_TILE_HEIGHT : target->height;
+    uint32 tile_count_x = (target->width + tile_width - 1) / tile_width;
+    uint32 tile_count_y = (target->height + tile_height - 1) / tile_height;
+
+    // very large buffers get taller tiles rather than overflowing the work array
+    while (tile_count_x * tile_count_y > MAX_RENDER_TILES) {
+        tile_height *= 2;
+        tile_count_y = (target->height + tile_height - 1) / tile_height;
+    }
+
+    uint32 work_count = 0;
+    for (uint32 tile_y = 0; tile_y < tile_count_y; ++tile_y) {
+        for (uint32 tile_x = 0; tile_x < tile_count_x; ++tile_x) {
+            TileRenderWork *work = work_array + work_count;
+            *work = (TileRenderWork){0};
+            work->tile_hash = target->tile_hashes ? target->tile_hashes + work_count : NULL;
+            ++work_count;
+            work->commands = commands;
+            work->target = target;
+            work->entries = entries;
+            work->batches = batches;
+            work->batch_count = batch_count;
+            work->gradient_tables = gradient_tables;
+            work->render_path = render_path;
+            work->min_x = tile_x * tile_width;
+            work->min_y = tile_y * tile_height;
+            work->max_x = work->min_x + tile_width;
+            work->max_y = work->min_y + tile_height;
+            if (work->max_x > target->width) work->max_x = target->width;
+            if (work->max_y > target->height) work->max_y = target->height;
+
+            if (queue) {
+                PlatformAddWorkEntry(queue, DoTileRenderWork, work);
+            } else {
+                DoTileRenderWork(NULL, work);
+            }
+        }
+    }
+    if (queue) {
+        PlatformCompleteAllWork(queue);
+    }
+
+    for (uint32 work_index = 0; work_index < work_count; ++work_index) {
+        TileRenderWork *work = work_array + work_index;
+        if (stats) {
+            stats->bitmap_pixels += work->bitmap_pixels;
+            stats->skipped_tiles += work->skipped;
+            ++stats->tile_count;
+        }
+        if (!debug_timers) {
+            continue;
+        }
+        debug_timers[DebugTimer_DrawGradient].elapsed += work->gradient_ticks;
+        debug_timers[DebugTimer_DrawGradient].cycles += work->gradient_cycles;
+        debug_timers[DebugTimer_DrawGradient].hit_count += work->gradient_batches;
+        debug_timers[DebugTimer_DrawBitmaps].elapsed += work->bitmap_ticks;
+        debug_timers[DebugTimer_DrawBitmaps].cycles += work->bitmap_cycles;
+        debug_timers[DebugTimer_DrawBitmaps].hit_count += work->bitmap_batches;
+    }
+}
+
+// ------------------------------------------------------------
+// Upscaling
+// ------------------------------------------------------------
+// what every band shares, the column tables are built once per call
+typedef struct {
+    RenderBuffer *source;
+    RenderBuffer *dest;
+    uint32 filter;
+    uint32 render_path;
+    uint32 *x0;             // source column left of each destination column's centre
+    uint32 *x1;             // and right of it, x0 + 1 clamped, bilinear only
+    uint32 *x_weight;       // weight of x1 in 1/256ths, repeated in both 16 bit halves, bilinear only
+} UpscaleFrame;
+
+typedef struct {
+    UpscaleFrame *frame;
+    uint32 min_y;
+    uint32 max_y;
+    uint32 *stretched_rows[2];  // bilinear, source rows already stretched to the destination width
+    uint32 stretched_y[2];      // which source row each holds, UINT32_MAX for none
+    uint32 rows_written;
+} UpscaleWork;
+
+// source sample under the centre of destination pixel i, 8 fraction bits, clamped to the first pixel
+internal_func inline uint32 UpscaleSourcePosition(uint32 i, uint32 source_size, uint32 dest_size){
+    uint64 centre = ((2 * (uint64)i + 1) * source_size * 256) / (2 * (uint64)dest_size);
+    return (centre > 128) ? (uint32)(centre - 128) : 0;
+}
+
+// a * (256 - weight) + b * weight, every channel on its own, weight in 1/256ths
+internal_func inline uint32 LerpPixel(uint32 a, uint32 b, uint32 weight){
+    uint32 rb = ((a & 0x00FF00FF) * (256 - weight) + (b & 0x00FF00FF) * weight) >> 8;
+    uint32 ag = ((a >> 8) & 0x00FF00FF) * (256 - weight) + ((b >> 8) & 0x00FF00FF) * weight;
+    return (rb & 0x00FF00FF) | (ag & 0xFF00FF00);
+}
+
+#if HANDMADE_X86
+// LerpPixel on 4 pixels, both channel pairs in 16 bit lanes so the products fit, weights repeated per 16 bits
+internal_func inline __m128i LerpPixels4x(__m128i a, __m128i b, __m128i weight){
+    __m128i mask = _mm_set1_epi32(0x00FF00FF);
+    __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(256), weight);
+    __m128i rb = _mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(a, mask), inverse), _mm_mullo_epi16(_mm_and_si128(b, mask), weight));
+    __m128i ag = _mm_add_epi16(_mm_mullo_epi16(_mm_srli_epi16(a, 8), inverse), _mm_mullo_epi16(_mm_srli_epi16(b, 8), weight));
+    return _mm_or_si128(_mm_srli_epi16(rb, 8), _mm_andnot_si128(mask, ag));
+}
+
+__attribute__((target("avx2")))
+internal_func inline __m256i LerpPixels8x(__m256i a, __m256i b, __m256i weight){
+    __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+    __m256i inverse = _mm256_sub_epi16(_mm256_set1_epi16(256), weight);
+    __m256i rb = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_and_si256(a, mask), inverse), _mm256_mullo_epi16(_mm256_and_si256(b, mask), weight));
+    __m256i ag = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_srli_epi16(a, 8), inverse), _mm256_mullo_epi16(_mm256_srli_epi16(b, 8), weight));
+    return _mm256_or_si256(_mm256_srli_epi16(rb, 8), _mm256_andnot_si256(mask, ag));
+}
+#endif
+
+#if HANDMADE_X86
+__attribute__((target("avx2")))
+internal_func uint32 BlendRowsAVX2(uint32 *dest, uint32 *row0, uint32 *row1, uint32 count, uint32 weight){
+    __m256i weight8 = _mm256_set1_epi16((int16)weight);
+    uint32 x = 0;
+    for(; x + 8 <= count; x += 8){
+        __m256i a = _mm256_loadu_si256((__m256i *)(row0 + x));
+        __m256i b = _mm256_loadu_si256((__m256i *)(row1 + x));
+        _mm256_storeu_si256((__m256i *)(dest + x), LerpPixels8x(a, b, weight8));
+    }
+    return x;
+}
+#endif
+
+// dest = row0 * (256 - weight) + row1 * weight per channel
+internal_func void BlendRows(uint32 *dest, uint32 *row0, uint32 *row1, uint32 count, uint32 weight, uint32 render_path){
+    uint32 x = 0;
+#if HANDMADE_X86
+    if(render_path == RenderPath_AVX2){
+        x = BlendRowsAVX2(dest, row0, row1, count, weight);
+    } else if(render_path == RenderPath_SSE2){
+        __m128i weight4 = _mm_set1_epi16((int16)weight);
+        for(; x + 4 <= count; x += 4){
+            __m128i a = _mm_loadu_si128((__m128i *)(row0 + x));
+            __m128i b = _mm_loadu_si128((__m128i *)(row1 + x));
+            _mm_storeu_si128((__m128i *)(dest + x), LerpPixels4x(a, b, weight4));
+        }
+    }
+#endif
+    for(; x < count; ++x){
+        dest[x] = LerpPixel(row0[x], row1[x], weight);
+    }
+}
+
+#if HANDMADE_X86
+__attribute__((target("avx2")))
+internal_func void UpscaleRowAVX2(UpscaleFrame *frame, uint32 *dest, uint32 *source, uint32 count){
+    uint32 x = 0;
+    if(frame->filter == UpscaleFilter_Bilinear){
+        for(; x + 8 <= count; x += 8){
+            __m256i a = _mm256_i32gather_epi32((int *)source, _mm256_loadu_si256((__m256i *)(frame->x0 + x)), 4);
+            __m256i b = _mm256_i32gather_epi32((int *)source, _mm256_loadu_si256((__m256i *)(frame->x1 + x)), 4);
+            __m256i weight = _mm256_loadu_si256((__m256i *)(frame->x_weight + x));
+            _mm256_storeu_si256((__m256i *)(dest + x), LerpPixels8x(a, b, weight));
+        }
+        for(; x < count; ++x){
+            dest[x] = LerpPixel(source[frame->x0[x]], source[frame->x1[x]], frame->x_weight[x] & 0xFFFF);
+        }
+    } else {
+        for(; x + 8 <= count; x += 8){
+            __m256i pixels = _mm256_i32gather_epi32((int *)source, _mm256_loadu_si256((__m256i *)(frame->x0 + x)), 4);
+            _mm256_storeu_si256((__m256i *)(dest + x), pixels);
+        }
+        for(; x < count; ++x){
+            dest[x] = source[frame->x0[x]];
+        }
+    }
+}
+
+// no gather before AVX2, the loads stay scalar and the lerp goes 4 wide
+internal_func void UpscaleRowSSE2(UpscaleFrame *frame, uint32 *dest, uint32 *source, uint32 count){
+    uint32 x = 0;
+    if(frame->filter == UpscaleFilter_Bilinear){
+        uint32 *x0 = frame->x0, *x1 = frame->x1;
+        for(; x + 4 <= count; x += 4){
+            __m128i a = _mm_setr_epi32((int)source[x0[x]], (int)source[x0[x + 1]], (int)source[x0[x + 2]], (int)source[x0[x + 3]]);
+            __m128i b = _mm_setr_epi32((int)source[x1[x]], (int)source[x1[x + 1]], (int)source[x1[x + 2]], (int)source[x1[x + 3]]);
+            __m128i weight = _mm_loadu_si128((__m128i *)(frame->x_weight + x));
+            _mm_storeu_si128((__m128i *)(dest + x), LerpPixels4x(a, b, weight));
+        }
+        for(; x < count; ++x){
+            dest[x] = LerpPixel(source[x0[x]], source[x1[x]], frame->x_weight[x] & 0xFFFF);
+        }
+    } else {
+        for(; x < count; ++x){
+            dest[x] = source[frame->x0[x]];
+        }
+    }
+}
+#endif
+
+internal_func void UpscaleRowScalar(UpscaleFrame *frame, uint32 *dest, uint32 *source, uint32 count){
+    if(frame->filter == UpscaleFilter_Bilinear){
+        for(uint32 x = 0; x < count; ++x){
+            dest[x] = LerpPixel(source[frame->x0[x]], source[frame->x1[x]], frame->x_weight[x] & 0xFFFF);
+        }
+    } else {
+        for(uint32 x = 0; x < count; ++x){
+            dest[x] = source[frame->x0[x]];
+        }
+    }
+}
+
+internal_func void StretchRow(UpscaleFrame *frame, uint32 *dest, uint32 *source, uint32 count){
+    switch(frame->render_path){
+#if HANDMADE_X86
+        case RenderPath_AVX2:
+            UpscaleRowAVX2(frame, dest, source, count);
+            break;
+        case RenderPath_SSE2:
+            UpscaleRowSSE2(frame, dest, source, count);
+            break;
+#endif
+        default:
+            UpscaleRowScalar(frame, dest, source, count);
+            break;
+    }
+}
+
+// source row y stretched to the destination width, the two cached rows hold the last two asked for, keep_y is not evicted
+internal_func uint32 *GetStretchedRow(UpscaleWork *work, uint32 y, uint32 keep_y){
+    for(uint32 slot = 0; slot < 2; ++slot){
+        if(work->stretched_y[slot] == y){
+            return work->stretched_rows[slot];
+        }
+    }
+    uint32 slot = (work->stretched_y[0] == keep_y) ? 1 : 0;
+    RenderBuffer *source = work->frame->source;
+    StretchRow(work->frame, work->stretched_rows[slot], (uint32 *)((uint8 *)source->pixels + (size_t)y * source->pitch),
+               work->frame->dest->width);
+    work->stretched_y[slot] = y;
+    return work->stretched_rows[slot];
+}
+
+// nearest stretches straight into the destination and copies repeated rows, bilinear stretches
+// every source row once and blends each destination row from two of them
+internal_func void DoUpscaleWork(PlatformWorkQueue *queue, void *data){
+    TIMED_FUNCTION();
+    UpscaleWork *work = (UpscaleWork *)data;
+    UpscaleFrame *frame = work->frame;
+    RenderBuffer *source = frame->source;
+    RenderBuffer *dest = frame->dest;
+    size_t row_bytes = (size_t)dest->width * sizeof(uint32);
+
+    uint32 *previous_row = NULL;
+    uint32 previous_y = UINT32_MAX;
+    for(uint32 y = work->min_y; y < work->max_y; ++y){
+        uint32 *dest_row = (uint32 *)((uint8 *)dest->pixels + (size_t)y * dest->pitch);
+        if(frame->filter == UpscaleFilter_Bilinear){
+            uint32 position = UpscaleSourcePosition(y, source->height, dest->height);
+            uint32 y0 = (position >> 8 < source->height) ? position >> 8 : source->height - 1;
+            uint32 y1 = (y0 + 1 < source->height) ? y0 + 1 : y0;
+            uint32 weight = (y1 != y0) ? (position & 0xFF) : 0;
+            uint32 *row0 = GetStretchedRow(work, y0, y1);
+            if(weight){
+                BlendRows(dest_row, row0, GetStretchedRow(work, y1, y0), dest->width, weight, frame->render_path);
+            } else {
+                memcpy(dest_row, row0, row_bytes);
+            }
+        } else {
+            uint32 source_y = (uint32)(((2 * (uint64)y + 1) * source->height) / (2 * (uint64)dest->height));
+            if(source_y == previous_y){
+                memcpy(dest_row, previous_row, row_bytes);
+            } else {
+                StretchRow(frame, dest_row, (uint32 *)((uint8 *)source->pixels + (size_t)source_y * source->pitch), dest->width);
+            }
+            previous_row = dest_row;
+            previous_y = source_y;
+        }
+    }
+    work->rows_written = work->max_y - work->min_y;
+    MarkDirtyRectangle(dest, 0, work->min_y, dest->width, work->max_y);
+}
+
+// whether any source square a band reads from was drawn this frame
+internal_func bool32 UpscaleBandIsDirty(RenderBuffer *source, RenderBuffer *dest, uint32 min_y, uint32 max_y){
+    // bilinear samples half a source pixel up and one row down from the nearest row
+    uint32 source_min_y = (uint32)(((uint64)min_y * source->height) / dest->height);
+    source_min_y = source_min_y ? source_min_y - 1 : 0;
+    uint32 source_max_y = (uint32)(((uint64)max_y * source->height + dest->height - 1) / dest->height) + 1;
+    if(source_max_y > source->height) source_max_y = source->height;
+    uint32 first_row = DirtyTileIndex(source_min_y, DIRTY_TILE_ROWS);
+    uint32 last_row = DirtyTileIndex(source_max_y - 1, DIRTY_TILE_ROWS);
+    for(uint32 row = first_row; row <= last_row; ++row){
+        if(source->dirty_tiles[row]){
+            return true;
+        }
+    }
+    return false;
+}
+
+internal_func uint32 UpscaleBandHeight(uint32 dest_height){
+    uint32 band_height = UPSCALE_BAND_HEIGHT;
+    while((dest_height + band_height - 1) / band_height > MAX_UPSCALE_BANDS){
+        band_height *= 2;
+    }
+    return band_height;
+}
+
+uint64 UpscaleScratchSize(RenderBuffer *source, RenderBuffer *dest){
+    uint32 band_count = (dest->height + UpscaleBandHeight(dest->height) - 1) / UpscaleBandHeight(dest->height);
+    uint64 tables = 3 * ((uint64)dest->width * sizeof(uint32) + 64);
+    uint64 bands = band_count * (sizeof(UpscaleWork) + 2 * ((uint64)dest->width * sizeof(uint32) + 64));
+    return sizeof(UpscaleFrame) + tables + bands + 64;
+}
+
+uint32 UpscaleRenderBuffer(RenderBuffer *source, RenderBuffer *dest, uint32 filter, bool32 redraw_all,
+                           PlatformWorkQueue *queue, uint32 render_path, MemoryArena *scratch){
+    if(!source->pixels || !dest->pixels || !source->width || !source->height || !dest->width || !dest->height){
+        return 0;
+    }
+    UpscaleFrame *frame = PushStruct(scratch, UpscaleFrame);
+    uint32 *x0 = PushSizeAligned(scratch, (uint64)dest->width * sizeof(uint32), 64);
+    uint32 *x1 = PushSizeAligned(scratch, (uint64)dest->width * sizeof(uint32), 64);
+    uint32 *x_weight = PushSizeAligned(scratch, (uint64)dest->width * sizeof(uint32), 64);
+    if(!frame || !x0 || !x1 || !x_weight){
+        return 0;
+    }
+
+    bool32 bilinear = (filter == UpscaleFilter_Bilinear);
+    for(uint32 x = 0; x < dest->width; ++x){
+        if(bilinear){
+            uint32 position = UpscaleSourcePosition(x, source->width, dest->width);
+            x0[x] = (position >> 8 < source->width) ? position >> 8 : source->width - 1;
+            x1[x] = (x0[x] + 1 < source->width) ? x0[x] + 1 : x0[x];
+            x_weight[x] = (x1[x] != x0[x]) ? (position & 0xFF) * 0x10001 : 0;
+        } else {
+            x0[x] = (uint32)(((2 * (uint64)x + 1) * source->width) / (2 * (uint64)dest->width));
+            x1[x] = x0[x];
+            x_weight[x] = 0;
+        }
+    }
+    frame->source = source;
+    frame->dest = dest;
+    frame->filter = filter;
+    frame->render_path = render_path;
+    frame->x0 = x0;
+    frame->x1 = x1;
+    frame->x_weight = x_weight;
+
+    uint32 band_height = UpscaleBandHeight(dest->height);
+    uint32 band_count = (dest->height + band_height - 1) / band_height;
+    UpscaleWork *work_array = PushArray(scratch, band_count, UpscaleWork);
+    if(!work_array){
+        return 0;
+    }
+    uint32 work_count = 0;
+    for(uint32 min_y = 0; min_y < dest->height; min_y += band_height){
+        uint32 max_y = (min_y + band_height < dest->height) ? min_y + band_height : dest->height;
+        if(!redraw_all && !UpscaleBandIsDirty(source, dest, min_y, max_y)){
+            continue;
+        }
+        UpscaleWork *work = work_array + work_count++;
+        *work = (UpscaleWork){0};
+        work->frame = frame;
+        work->min_y = min_y;
+        work->max_y = max_y;
+        if(bilinear){
+            for(uint32 slot = 0; slot < 2; ++slot){
+                work->stretched_rows[slot] = PushSizeAligned(scratch, (uint64)dest->width * sizeof(uint32), 64);
+                work->stretched_y[slot] = UINT32_MAX;
+            }
+            if(!work->stretched_rows[0] || !work->stretched_rows[1]){
+                --work_count;
+                break;
+            }
+        }
+        if(queue){
+            PlatformAddWorkEntry(queue, DoUpscaleWork, work);
+        } else {
+            DoUpscaleWork(NULL, work);
+        }
+    }
+    if(queue){
+        PlatformCompleteAllWork(queue);
+    }
+
+    uint32 rows_written = 0;
+    for(uint32 work_index = 0; work_index < work_count; ++work_index){
+        rows_written += work_array[work_index].rows_written;
+    }
+    return rows_written;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include "handmade.h"
+#include "handmade_render_group.h"
+
+/*
+    ---------- Software renderer ---------------
+
+    Executes a frame's RenderCommands (handmade_render_group.h) into a
+    RenderBuffer. This file is built into the platform executable, not the
+    game library: the game only pushes commands, so the backend can be
+    swapped or replayed without game code loaded.
+
+    1. sort entries by (layer, type, material), stable so equal keys keep
+       the order they were pushed in, skipped when the buffer is already
+       in order
+    2. runs of equal keys become batches, a batch resolves its material
+       (bitmap, blend function, gradient tables) once
+    3. the target is split into tiles on the render queue, every tile
+       executes every batch clipped to itself, so each pixel is touched
+       by one thread and the tile stays in L2 while layers stack on it
+    4. before a tile draws it hashes the commands that touch it, if the
+       target kept last frame's pixels (tile_hashes) and the hash is the
+       one it drew then, the tile is already right and is skipped
+
+    Everything that writes pixels marks the DIRTY_TILE_SIZE squares it
+    touched in the target's dirty_tiles, so the platform only uploads
+    what changed. A skipped tile marks nothing.
+*/
+
+/*
+    ---------- Separable gradient ---------------
+
+    The test gradient only ever needs three 1D functions:
+        red   = f(x + t)
+        green = f(y + t)
+        blue  = f(x + y + t)
+    so each frame we evaluate them once into tables (width, height and
+    width + height entries) and every pixel becomes two loads and two ORs.
+    The blue table is indexed by x + y, so for a fixed row it is just the
+    table shifted by y and still reads contiguously.
+*/
+typedef struct {
+    uint32 *red;    // width entries, alpha and red already shifted into place
+    uint32 *green;  // height entries, shifted into the green byte
+    uint32 *blue;   // width + height entries, indexed by x + y
+} GradientTables;
+
+// 256 x 64 pixels is 64KB of output per tile, plus ~2KB of table reads, so a tile stays in L2
+#define RENDER_TILE_WIDTH 256
+#define RENDER_TILE_HEIGHT 64
+#define MAX_RENDER_TILES 512
+
+uint32 ResolveRenderPath(uint32 requested);
+
+// [min_x, max_x) x [min_y, max_y), any thread, already clipped to the buffer
+void MarkDirtyRectangle(RenderBuffer *buffer, uint32 min_x, uint32 min_y, uint32 max_x, uint32 max_y);
+size_t GradientTablesSize(uint32 width, uint32 height);
+void BuildGradientTables(GradientTables *tables, uint32 width, uint32 height, float t, void *memory);
+
+// fills the rectangle [min_x, max_x) x [min_y, max_y) of the buffer from the tables
+void FillGradient(RenderBuffer *buffer, GradientTables *tables,
+                  uint32 min_x, uint32 min_y, uint32 max_x, uint32 max_y, uint32 render_path);
+
+// top left corner at (x, y), clipped to [clip_min_x, clip_max_x) x [clip_min_y, clip_max_y) and the buffer
+// returns how many pixels were blended
+uint32 DrawBitmap(RenderBuffer *buffer, LoadedBitmap *bitmap, int32 x, int32 y,
+                  int32 clip_min_x, int32 clip_min_y, int32 clip_max_x, int32 clip_max_y, uint32 render_path);
+
+// upper bound on the scratch RenderCommandsToOutput pushes for these commands on a width x height target
+uint64 RenderCommandsScratchSize(RenderCommands *commands, uint32 width, uint32 height);
+
+typedef struct {
+    uint64 bitmap_pixels;       // blended
+    uint32 tile_count;
+    uint32 skipped_tiles;       // drew the same as last frame, left alone
+} RenderStats;
+
+// runs the commands into target and returns once every tile is done, queue may be NULL
+// scratch is only used for the duration of the call, the timers for the sort, gradient and
+// bitmap batches are added to debug_timers (batch times summed over tiles, so over threads)
+void RenderCommandsToOutput(RenderCommands *commands, RenderBuffer *target, PlatformWorkQueue *queue,
+                            uint32 render_path, MemoryArena *scratch, DebugTimer *debug_timers, RenderStats *stats);
+
+/*
+    ---------- Upscaling ---------------
+
+    With dynamic resolution the game renders into a buffer smaller than the
+    window and UpscaleRenderBuffer stretches it over a window sized one.
+    Both filters sample at pixel centres through column tables built once
+    per call: nearest is one gather per pixel, bilinear blends the two
+    source rows a destination row needs into one row first and then lerps
+    two gathered pixels, every channel in its own 16 bit lane with 8 bit
+    weights, so the scalar and vector paths give the same bytes.
+
+    Destination rows go out in bands on the render queue. A band whose
+    source rows have no dirty square is left as it was, a band that draws
+    marks its whole width dirty in the destination.
+*/
+enum {
+    UpscaleFilter_Nearest,
+    UpscaleFilter_Bilinear,
+    UpscaleFilter_Count,
+};
+
+#define UPSCALE_BAND_HEIGHT 32
+#define MAX_UPSCALE_BANDS 256
+
+uint64 UpscaleScratchSize(RenderBuffer *source, RenderBuffer *dest);
+
+// stretches source over all of dest, only the bands that read dirty source rows unless redraw_all
+// returns how many destination rows were written, scratch is only used for the duration of the call
+uint32 UpscaleRenderBuffer(RenderBuffer *source, RenderBuffer *dest, uint32 filter, bool32 redraw_all,
+                           PlatformWorkQueue *queue, uint32 render_path, MemoryArena *scratch);
@@ -0,0 +1,177 @@
+#pragma once
+#include "handmade.h"
+#include "handmade_bitmap.h"
+
+/*
+    ---------- Render commands ---------------
+
+    The game never writes pixels. Each frame it pushes typed commands into
+    a RenderCommands buffer carved out of transient storage, and after
+    GameUpdateAndRender returns the platform hands the buffer to the
+    software backend (handmade_render.c). The backend sorts by layer, then
+    command type, then material, runs of equal keys become batches, and
+    every tile of the target executes all batches clipped to itself.
+
+    Commands hold no pointers. Bitmaps are referenced by their index in
+    `bitmaps`, so a frame's buffer plus those bitmaps can be written out
+    and replayed offline (--dump-commands / --replay-commands).
+
+    Commands on the same layer may be reordered by material, anything that
+    has to end up on top of something else goes on a higher layer.
+*/
+enum {
+    RenderCommand_Clear,
+    RenderCommand_Gradient,
+    RenderCommand_Rectangle,
+    RenderCommand_Bitmap,
+    RenderCommand_Count
+};
+
+typedef struct {
+    uint16 type;        // RenderCommand_*
+    uint16 size;        // bytes including this header, the next command follows directly
+    uint32 layer;       // drawn back to front, lowest first
+    uint32 material;    // what a batch shares, the bitmap index for bitmaps
+} RenderCommandHeader;
+
+typedef struct {
+    RenderCommandHeader header;
+    uint32 color;       // 0xAARRGGBB
+} RenderCommandClear;
+
+typedef struct {
+    RenderCommandHeader header;
+    float32 t;          // seconds, scrolls the test gradient
+} RenderCommandGradient;
+
+// opaque fill of [min_x, max_x) x [min_y, max_y)
+typedef struct {
+    RenderCommandHeader header;
+    int32 min_x;
+    int32 min_y;
+    int32 max_x;
+    int32 max_y;
+    uint32 color;
+} RenderCommandRectangle;
+
+// alpha blended, top left corner at (x, y)
+typedef struct {
+    RenderCommandHeader header;
+    uint32 bitmap_index;
+    int32 x;
+    int32 y;
+} RenderCommandBitmap;
+
+#define MAX_RENDER_BITMAPS 256
+#define RENDER_COMMAND_ALIGNMENT 8
+#define RENDER_COMMAND_BUFFER_SIZE Megabytes(4)
+
+typedef struct RenderCommands {
+    uint32 width;               // of the target the commands were pushed for
+    uint32 height;
+
+    uint8 *push_buffer;
+    uint32 push_buffer_size;    // bytes used this frame
+    uint32 max_push_buffer_size;
+    uint32 command_count;
+
+    LoadedBitmap *bitmaps[MAX_RENDER_BITMAPS];  // read by the backend after the game returns
+    uint32 bitmap_count;
+} RenderCommands;
+
+internal_func inline void InitializeRenderCommands(RenderCommands *commands, void *push_buffer, uint32 max_push_buffer_size){
+    commands->push_buffer = (uint8 *)push_buffer;
+    commands->max_push_buffer_size = max_push_buffer_size;
+    commands->push_buffer_size = 0;
+    commands->command_count = 0;
+    commands->bitmap_count = 0;
+}
+
+// starts a frame's buffer over, the target size is only known once the platform has resized it
+internal_func inline void BeginRenderCommands(RenderCommands *commands, uint32 width, uint32 height){
+    commands->width = width;
+    commands->height = height;
+    commands->push_buffer_size = 0;
+    commands->command_count = 0;
+    commands->bitmap_count = 0;
+}
+
+// NULL once the buffer is full, the frame just loses the commands that did not fit
+internal_func inline void *PushRenderCommand_(RenderCommands *commands, uint32 type, uint32 size, uint32 layer, uint32 material){
+    size = (size + RENDER_COMMAND_ALIGNMENT - 1) & ~(uint32)(RENDER_COMMAND_ALIGNMENT - 1);
+    if(commands->push_buffer_size + size > commands->max_push_buffer_size){
+        Assert(!"Render command buffer is full");
+        return NULL;
+    }
+
+    RenderCommandHeader *header = (RenderCommandHeader *)(commands->push_buffer + commands->push_buffer_size);
+    header->type = (uint16)type;
+    header->size = (uint16)size;
+    header->layer = layer;
+    header->material = material;
+
+    commands->push_buffer_size += size;
+    ++commands->command_count;
+    return header;
+}
+
+#define PushRenderCommand(commands, type, layer, material) \
+    (type *)PushRenderCommand_(commands, type##_ID, sizeof(type), layer, material)
+#define RenderCommandClear_ID RenderCommand_Clear
+#define RenderCommandGradient_ID RenderCommand_Gradient
+#define RenderCommandRectangle_ID RenderCommand_Rectangle
+#define RenderCommandBitmap_ID RenderCommand_Bitmap
+
+internal_func inline void PushClear(RenderCommands *commands, uint32 layer, uint32 color){
+    RenderCommandClear *command = PushRenderCommand(commands, RenderCommandClear, layer, 0);
+    if(command){
+        command->color = color;
+    }
+}
+
+internal_func inline void PushGradient(RenderCommands *commands, uint32 layer, float32 t){
+    RenderCommandGradient *command = PushRenderCommand(commands, RenderCommandGradient, layer, 0);
+    if(command){
+        command->t = t;
+    }
+}
+
+internal_func inline void PushRectangle(RenderCommands *commands, uint32 layer, int32 min_x, int32 min_y, int32 max_x, int32 max_y, uint32 color){
+    RenderCommandRectangle *command = PushRenderCommand(commands, RenderCommandRectangle, layer, 0);
+    if(command){
+        command->min_x = min_x;
+        command->min_y = min_y;
+        command->max_x = max_x;
+        command->max_y = max_y;
+        command->color = color;
+    }
+}
+
+internal_func inline void PushBitmap(RenderCommands *commands, uint32 layer, LoadedBitmap *bitmap, int32 x, int32 y){
+    // sprites come in runs of the same bitmap, so the last slot is checked first
+    uint32 bitmap_index = commands->bitmap_count;
+    if(bitmap_index && commands->bitmaps[bitmap_index - 1] == bitmap){
+        --bitmap_index;
+    } else {
+        for(uint32 index = 0; index < commands->bitmap_count; ++index){
+            if(commands->bitmaps[index] == bitmap){
+                bitmap_index = index;
+                break;
+            }
+        }
+    }
+    if(bitmap_index == commands->bitmap_count){
+        if(commands->bitmap_count == MAX_RENDER_BITMAPS){
+            Assert(!"Too many bitmaps in one frame");
+            return;
+        }
+        commands->bitmaps[commands->bitmap_count++] = bitmap;
+    }
+
+    RenderCommandBitmap *command = PushRenderCommand(commands, RenderCommandBitmap, layer, bitmap_index);
+    if(command){
+        command->bitmap_index = bitmap_index;
+        command->x = x;
+        command->y = y;
+    }
+}
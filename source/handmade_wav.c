@@ -0,0 +1,430 @@
+#include "handmade_wav.h"
+#include "handmade_debug.h"
+#include <string.h>
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE    // the real format is the first two bytes of the sub format GUID
+#define WAV_RING_MASK (WAV_STREAM_RING_FRAMES - 1)
+
+// positions inside a block are floats relative to its first frame, short blocks keep them exact enough
+#define WAV_RESAMPLE_BLOCK 256
+
+// only used while opening, the header is a handful of bytes spread over the start of the file
+internal_func bool32 ReadWavRange(char *filename, uint64 offset, uint64 size, void *dest){
+    PlatformAsyncRead read = PlatformBeginAsyncRead(filename, offset, size, dest, NULL, NULL);
+    if(!read){
+        return false;
+    }
+    bool32 result = (PlatformWaitForAsyncRead(read) == AsyncRead_Done);
+    PlatformEndAsyncRead(read);
+    return result;
+}
+
+// ------------------------------------------------------------
+// Decoding, file frames to planar floats
+// ------------------------------------------------------------
+internal_func void DecodePCM16(int16 *source, float32 *dest0, float32 *dest1, uint32 frame_count, uint32 channel_count){
+    float32 scale = 1.0f / 32768.0f;
+    uint32 i = 0;
+#if HANDMADE_X86
+    __m128 scale_4 = _mm_set1_ps(scale);
+    if(channel_count == 2){
+        for(; i + 4 <= frame_count; i += 4){
+            // unpacking a register with itself puts each sample in the top half of a lane, the shift sign extends it
+            __m128i packed = _mm_loadu_si128((__m128i *)(source + 2 * i));
+            __m128 low = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16)), scale_4);
+            __m128 high = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16)), scale_4);
+            _mm_storeu_ps(dest0 + i, _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(dest1 + i, _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+    } else {
+        for(; i + 8 <= frame_count; i += 8){
+            __m128i packed = _mm_loadu_si128((__m128i *)(source + i));
+            _mm_storeu_ps(dest0 + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16)), scale_4));
+            _mm_storeu_ps(dest0 + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16)), scale_4));
+        }
+    }
+#endif
+    for(; i < frame_count; ++i){
+        dest0[i] = (float32)source[channel_count * i] * scale;
+        if(channel_count == 2){
+            dest1[i] = (float32)source[2 * i + 1] * scale;
+        }
+    }
+}
+
+internal_func void DecodeFloat32(float32 *source, float32 *dest0, float32 *dest1, uint32 frame_count, uint32 channel_count){
+    if(channel_count == 1){
+        memcpy(dest0, source, sizeof(float32) * frame_count);
+        return;
+    }
+
+    uint32 i = 0;
+#if HANDMADE_X86
+    for(; i + 4 <= frame_count; i += 4){
+        __m128 low = _mm_loadu_ps(source + 2 * i);
+        __m128 high = _mm_loadu_ps(source + 2 * i + 4);
+        _mm_storeu_ps(dest0 + i, _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(dest1 + i, _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#endif
+    for(; i < frame_count; ++i){
+        dest0[i] = source[2 * i];
+        dest1[i] = source[2 * i + 1];
+    }
+}
+
+// the caller made sure the ring has room for frame_count more frames
+internal_func void DecodeIntoRing(WavStream *stream, uint8 *source, uint32 frame_count){
+    stream->stats.frames_decoded += frame_count;
+    while(frame_count){
+        uint32 start = (uint32)stream->decoded_frames & WAV_RING_MASK;
+        uint32 count = WAV_STREAM_RING_FRAMES - start;
+        if(count > frame_count){
+            count = frame_count;
+        }
+
+        if(stream->format == WavFormat_PCM16){
+            DecodePCM16((int16 *)source, stream->samples[0] + start, stream->samples[1] + start, count, stream->channel_count);
+        } else {
+            DecodeFloat32((float32 *)source, stream->samples[0] + start, stream->samples[1] + start, count, stream->channel_count);
+        }
+
+        source += count * stream->frame_size;
+        stream->decoded_frames += count;
+        frame_count -= count;
+    }
+}
+
+// ------------------------------------------------------------
+// Resampling kernels
+// ------------------------------------------------------------
+// dest[k] = source at frac + step * k past ring index base, linearly interpolated, for k in [first, count)
+internal_func void ResampleLinearScalar(float32 *dest0, float32 *dest1, float32 *source0, float32 *source1,
+                                        uint32 first, uint32 count, uint32 base, float32 frac, float32 step){
+    for(uint32 k = first; k < count; ++k){
+        float32 position = frac + step * (float32)k;
+        uint32 whole = (uint32)position;
+        float32 t = position - (float32)whole;
+        uint32 index0 = (base + whole) & WAV_RING_MASK;
+        uint32 index1 = (index0 + 1) & WAV_RING_MASK;
+        dest0[k] = source0[index0] + t * (source0[index1] - source0[index0]);
+        dest1[k] = source1[index0] + t * (source1[index1] - source1[index0]);
+    }
+}
+
+#if HANDMADE_X86
+// SSE2 has no gather, the positions and blends are vectors and the eight loads are scalar
+internal_func void ResampleLinearSSE(float32 *dest0, float32 *dest1, float32 *source0, float32 *source1,
+                                     uint32 first, uint32 count, uint32 base, float32 frac, float32 step){
+    __m128 ramp = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 frac_4 = _mm_set1_ps(frac);
+    __m128 step_4 = _mm_set1_ps(step);
+    __m128i base_4 = _mm_set1_epi32((int32)base);
+    __m128i mask_4 = _mm_set1_epi32(WAV_RING_MASK);
+    __m128i one_4 = _mm_set1_epi32(1);
+
+    uint32 k = first;
+    for(; k + 4 <= count; k += 4){
+        __m128 position = _mm_add_ps(frac_4, _mm_mul_ps(step_4, _mm_add_ps(_mm_set1_ps((float32)k), ramp)));
+        __m128i whole = _mm_cvttps_epi32(position);
+        __m128 t = _mm_sub_ps(position, _mm_cvtepi32_ps(whole));
+        __m128i index0 = _mm_and_si128(_mm_add_epi32(whole, base_4), mask_4);
+        __m128i index1 = _mm_and_si128(_mm_add_epi32(index0, one_4), mask_4);
+
+        int32 i0[4], i1[4];
+        _mm_storeu_si128((__m128i *)i0, index0);
+        _mm_storeu_si128((__m128i *)i1, index1);
+
+        __m128 a0 = _mm_setr_ps(source0[i0[0]], source0[i0[1]], source0[i0[2]], source0[i0[3]]);
+        __m128 b0 = _mm_setr_ps(source0[i1[0]], source0[i1[1]], source0[i1[2]], source0[i1[3]]);
+        __m128 a1 = _mm_setr_ps(source1[i0[0]], source1[i0[1]], source1[i0[2]], source1[i0[3]]);
+        __m128 b1 = _mm_setr_ps(source1[i1[0]], source1[i1[1]], source1[i1[2]], source1[i1[3]]);
+        _mm_storeu_ps(dest0 + k, _mm_add_ps(a0, _mm_mul_ps(t, _mm_sub_ps(b0, a0))));
+        _mm_storeu_ps(dest1 + k, _mm_add_ps(a1, _mm_mul_ps(t, _mm_sub_ps(b1, a1))));
+    }
+    ResampleLinearScalar(dest0, dest1, source0, source1, k, count, base, frac, step);
+}
+
+__attribute__((target("avx2")))
+internal_func void ResampleLinearAVX2(float32 *dest0, float32 *dest1, float32 *source0, float32 *source1,
+                                      uint32 first, uint32 count, uint32 base, float32 frac, float32 step){
+    __m256 ramp = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 frac_8 = _mm256_set1_ps(frac);
+    __m256 step_8 = _mm256_set1_ps(step);
+    __m256i base_8 = _mm256_set1_epi32((int32)base);
+    __m256i mask_8 = _mm256_set1_epi32(WAV_RING_MASK);
+    __m256i one_8 = _mm256_set1_epi32(1);
+
+    uint32 k = first;
+    for(; k + 8 <= count; k += 8){
+        __m256 position = _mm256_add_ps(frac_8, _mm256_mul_ps(step_8, _mm256_add_ps(_mm256_set1_ps((float32)k), ramp)));
+        __m256i whole = _mm256_cvttps_epi32(position);
+        __m256 t = _mm256_sub_ps(position, _mm256_cvtepi32_ps(whole));
+        __m256i index0 = _mm256_and_si256(_mm256_add_epi32(whole, base_8), mask_8);
+        __m256i index1 = _mm256_and_si256(_mm256_add_epi32(index0, one_8), mask_8);
+
+        __m256 a0 = _mm256_i32gather_ps(source0, index0, 4);
+        __m256 b0 = _mm256_i32gather_ps(source0, index1, 4);
+        __m256 a1 = _mm256_i32gather_ps(source1, index0, 4);
+        __m256 b1 = _mm256_i32gather_ps(source1, index1, 4);
+        _mm256_storeu_ps(dest0 + k, _mm256_add_ps(a0, _mm256_mul_ps(t, _mm256_sub_ps(b0, a0))));
+        _mm256_storeu_ps(dest1 + k, _mm256_add_ps(a1, _mm256_mul_ps(t, _mm256_sub_ps(b1, a1))));
+    }
+    ResampleLinearSSE(dest0, dest1, source0, source1, k, count, base, frac, step);
+}
+#endif
+
+// ------------------------------------------------------------
+// Stream
+// ------------------------------------------------------------
+bool32 OpenWavStream(WavStream *stream, MemoryArena *arena, char *filename, bool32 looping){
+    memset(stream, 0, sizeof(*stream));
+
+    uint64 file_size = PlatformGetFileSize(filename);
+    uint8 riff[12];
+    if(file_size < sizeof(riff) || strlen(filename) >= sizeof(stream->filename) ||
+       !ReadWavRange(filename, 0, sizeof(riff), riff) || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)){
+        PlatformLog(LogLevel_Error, "'%s' is not a WAV file", filename);
+        return false;
+    }
+
+    // walk the chunks, anything that is not fmt or data (LIST, fact, ...) is skipped
+    uint16 format_tag = 0, channel_count = 0, block_align = 0, bits_per_sample = 0;
+    uint32 sample_rate = 0;
+    bool32 have_format = false;
+    uint64 data_offset = 0, data_size = 0;
+    uint64 offset = sizeof(riff);
+    while(offset + 8 <= file_size){
+        uint8 chunk_header[8];
+        if(!ReadWavRange(filename, offset, sizeof(chunk_header), chunk_header)){
+            break;
+        }
+        uint32 chunk_size = ReadU32(chunk_header + 4);
+
+        if(!memcmp(chunk_header, "fmt ", 4) && chunk_size >= 16){
+            uint8 format[40] = {0};
+            if(!ReadWavRange(filename, offset + 8, (chunk_size < sizeof(format)) ? chunk_size : sizeof(format), format)){
+                break;
+            }
+            format_tag = ReadU16(format + 0);
+            channel_count = ReadU16(format + 2);
+            sample_rate = ReadU32(format + 4);
+            block_align = ReadU16(format + 12);
+            bits_per_sample = ReadU16(format + 14);
+            if(format_tag == WAV_FORMAT_EXTENSIBLE && chunk_size >= 40){
+                format_tag = ReadU16(format + 24);
+            }
+            have_format = true;
+        } else if(!memcmp(chunk_header, "data", 4) && have_format){
+            data_offset = offset + 8;
+            data_size = (chunk_size < file_size - data_offset) ? chunk_size : file_size - data_offset;
+            break;
+        }
+        offset += 8 + (uint64)chunk_size + (chunk_size & 1);
+    }
+
+    if(format_tag == WAV_FORMAT_PCM && bits_per_sample == 16){
+        stream->format = WavFormat_PCM16;
+    } else if(format_tag == WAV_FORMAT_FLOAT && bits_per_sample == 32){
+        stream->format = WavFormat_Float32;
+    } else {
+        data_offset = 0;
+    }
+    if(!data_offset || (channel_count != 1 && channel_count != 2) || block_align != channel_count * bits_per_sample / 8 ||
+       sample_rate < 8000 || sample_rate > 192000){
+        PlatformLog(LogLevel_Error, "'%s' is not 16-bit PCM or 32-bit float WAV with 1 or 2 channels", filename);
+        return false;
+    }
+
+    stream->samples[0] = PushArrayAligned(arena, WAV_STREAM_RING_FRAMES, float32, 32);
+    stream->samples[1] = (channel_count == 2) ? PushArrayAligned(arena, WAV_STREAM_RING_FRAMES, float32, 32) : stream->samples[0];
+    stream->chunks[0].bytes = (uint8 *)PushSizeAligned(arena, WAV_STREAM_CHUNK_SIZE, 64);
+    stream->chunks[1].bytes = (uint8 *)PushSizeAligned(arena, WAV_STREAM_CHUNK_SIZE, 64);
+    if(!stream->samples[0] || !stream->samples[1] || !stream->chunks[0].bytes || !stream->chunks[1].bytes){
+        return false;
+    }
+
+    strcpy(stream->filename, filename);
+    stream->channel_count = channel_count;
+    stream->sample_rate = sample_rate;
+    stream->frame_size = block_align;
+    stream->data_offset = data_offset;
+    stream->data_frames = data_size / block_align;
+    stream->looping = looping;
+    stream->read_step = ((uint64)sample_rate << 32) / SOUND_FREQ;
+    stream->stats.sample_rate = sample_rate;
+    stream->stats.channel_count = channel_count;
+
+#if HANDMADE_X86
+    stream->use_avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    PlatformLog(LogLevel_Info, "Streaming '%s': %u Hz, %u channels, %s, %.1f seconds", filename, sample_rate, channel_count,
+                (stream->format == WavFormat_PCM16) ? "16-bit PCM" : "32-bit float",
+                (double)stream->data_frames / (double)sample_rate);
+
+    UpdateWavStream(stream);
+    return true;
+}
+
+// the next WAV_STREAM_CHUNK_SIZE of data, from the start again when looping
+internal_func void StartChunkRead(WavStream *stream, WavStreamChunk *chunk){
+    if(stream->next_read_frame == stream->data_frames && stream->looping){
+        stream->next_read_frame = 0;
+    }
+    uint64 frame_count = stream->data_frames - stream->next_read_frame;
+    uint64 chunk_frames = WAV_STREAM_CHUNK_SIZE / stream->frame_size;
+    if(frame_count > chunk_frames){
+        frame_count = chunk_frames;
+    }
+
+    chunk->first_frame = stream->next_read_frame;
+    chunk->frame_count = (uint32)frame_count;
+    chunk->frames_used = 0;
+    chunk->state = frame_count ? WavChunk_Idle : WavChunk_Done;
+    stream->next_read_frame += frame_count;
+}
+
+// Idle chunks get their read started, if the platform is out of read slots it is tried again next frame
+internal_func void BeginChunkRead(WavStream *stream, WavStreamChunk *chunk){
+    chunk->read = PlatformBeginAsyncRead(stream->filename, stream->data_offset + chunk->first_frame * stream->frame_size,
+                                         (uint64)chunk->frame_count * stream->frame_size, chunk->bytes, NULL, NULL);
+    if(chunk->read){
+        chunk->state = WavChunk_Reading;
+    }
+}
+
+void UpdateWavStream(WavStream *stream){
+    TIMED_FUNCTION();
+    uint64 start = PlatformGetWallClock();
+
+    // the chunk after next_chunk is only ever read ahead, decoding goes strictly in turn
+    for(uint32 chunk_index = 0; chunk_index < 2; ++chunk_index){
+        WavStreamChunk *chunk = stream->chunks + chunk_index;
+        if(chunk->state == WavChunk_Empty){
+            StartChunkRead(stream, chunk);
+        }
+        if(chunk->state == WavChunk_Idle){
+            BeginChunkRead(stream, chunk);
+        }
+    }
+
+    for(;;){
+        WavStreamChunk *chunk = stream->chunks + stream->next_chunk;
+        if(chunk->state == WavChunk_Reading){
+            uint32 read_state = PlatformGetAsyncReadState(chunk->read);
+            if(read_state == AsyncRead_Pending){
+                break;
+            }
+            if(read_state == AsyncRead_Invalid){
+                // a loop edit restore brought back a handle that has since ended, read the chunk again
+                chunk->state = WavChunk_Idle;
+                BeginChunkRead(stream, chunk);
+                break;
+            }
+            PlatformEndAsyncRead(chunk->read);
+            chunk->read = 0;
+            if(read_state == AsyncRead_Failed){
+                // the other chunk holds later frames, without this one they would only be a jump, so the track ends here
+                PlatformLog(LogLevel_Error, "Streaming '%s' failed, stopping at frame %llu", stream->filename,
+                            (unsigned long long)chunk->first_frame);
+                WavStreamChunk *other = stream->chunks + (stream->next_chunk ^ 1);
+                if(other->state == WavChunk_Reading){
+                    PlatformEndAsyncRead(other->read);
+                    other->read = 0;
+                }
+                other->state = WavChunk_Done;
+                chunk->state = WavChunk_Done;
+                stream->looping = false;
+                stream->next_read_frame = stream->data_frames;
+            } else {
+                chunk->state = WavChunk_Ready;
+            }
+        }
+
+        uint32 ring_free = WAV_STREAM_RING_FRAMES - ((uint32)stream->decoded_frames - (uint32)(stream->read_position >> 32));
+        if(chunk->state == WavChunk_Ready){
+            uint32 count = chunk->frame_count - chunk->frames_used;
+            if(count > ring_free){
+                count = ring_free;
+            }
+            DecodeIntoRing(stream, chunk->bytes + (uint64)chunk->frames_used * stream->frame_size, count);
+            chunk->frames_used += count;
+            if(chunk->frames_used < chunk->frame_count){
+                break;  // ring is full
+            }
+
+            // used up, it reads the chunk after the other one while that one decodes
+            StartChunkRead(stream, chunk);
+            if(chunk->state == WavChunk_Idle){
+                BeginChunkRead(stream, chunk);
+            }
+            stream->next_chunk ^= 1;
+        } else if(chunk->state == WavChunk_Done){
+            // one silent frame after the last, so the last real frame still has a neighbour to interpolate with
+            if(!stream->end_of_data && stream->chunks[stream->next_chunk ^ 1].state == WavChunk_Done && ring_free){
+                uint32 index = (uint32)stream->decoded_frames & WAV_RING_MASK;
+                stream->samples[0][index] = 0.0f;
+                stream->samples[1][index] = 0.0f;
+                ++stream->decoded_frames;
+                stream->end_of_data = true;
+            }
+            break;
+        } else {
+            break;
+        }
+    }
+
+    stream->stats.decode_ticks += PlatformGetWallClock() - start;
+}
+
+uint32 ReadWavStream(WavStream *stream, float32 *dest0, float32 *dest1, uint32 frame_count){
+    uint64 start = PlatformGetWallClock();
+
+    uint32 frames_read = 0;
+    while(frames_read < frame_count){
+        // output k needs ring frames floor(position + k * step) and the one after it
+        uint32 base = (uint32)(stream->read_position >> 32);
+        uint32 available = (uint32)stream->decoded_frames - base;
+        if(available < 2){
+            break;
+        }
+        uint64 frac = stream->read_position & 0xFFFFFFFF;
+        uint64 limit = (uint64)(available - 1) << 32;
+        uint64 possible = (limit - frac + stream->read_step - 1) / stream->read_step;
+
+        uint32 count = frame_count - frames_read;
+        if(count > WAV_RESAMPLE_BLOCK){
+            count = WAV_RESAMPLE_BLOCK;
+        }
+        if(count > possible){
+            count = (uint32)possible;
+        }
+
+        float32 frac_f = (float32)((double)frac * (1.0 / 4294967296.0));
+        float32 step_f = (float32)((double)stream->read_step * (1.0 / 4294967296.0));
+        float32 *out0 = dest0 + frames_read;
+        float32 *out1 = dest1 + frames_read;
+#if HANDMADE_X86
+        if(stream->use_avx2){
+            ResampleLinearAVX2(out0, out1, stream->samples[0], stream->samples[1], 0, count, base, frac_f, step_f);
+        } else {
+            ResampleLinearSSE(out0, out1, stream->samples[0], stream->samples[1], 0, count, base, frac_f, step_f);
+        }
+#else
+        ResampleLinearScalar(out0, out1, stream->samples[0], stream->samples[1], 0, count, base, frac_f, step_f);
+#endif
+        stream->read_position += (uint64)count * stream->read_step;
+        frames_read += count;
+    }
+
+    stream->stats.frames_resampled += frames_read;
+    stream->stats.resample_ticks += PlatformGetWallClock() - start;
+    return frames_read;
+}
+
+bool32 WavStreamFinished(WavStream *stream){
+    return stream->end_of_data && ((uint32)stream->decoded_frames - (uint32)(stream->read_position >> 32)) < 2;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "handmade.h"
+
+/*
+    ---------- Streamed WAV ---------------
+
+    Music and long ambient tracks never sit in memory whole. A WavStream
+    owns two raw chunks that the platform's I/O threads refill with async
+    reads, and a ring of decoded float frames at the file's own rate:
+
+        file --async read--> chunk --UpdateWavStream--> ring --ReadWavStream--> SOUND_FREQ
+
+    UpdateWavStream runs once a frame on the main thread, converts whatever
+    the chunks hold (PCM16 or float32, mono or stereo, deinterleaved with
+    SSE) into the ring and starts the next read as soon as a chunk is used
+    up. The mixer calls ReadWavStream, which linearly interpolates out of
+    the ring, four or eight output frames at a time, to SOUND_FREQ.
+
+    Everything is pushed once in OpenWavStream, a track of any length uses
+    the same ~260KB. Looping wraps the reads back to the start of the data,
+    so the seam is interpolated like any other pair of frames.
+
+    The read position is 32.32 fixed point source frames, it stays exact
+    for a day of 44.1 kHz audio and then wraps, which the ring mask hides.
+*/
+#define WAV_STREAM_CHUNK_SIZE Kilobytes(64)     // a multiple of every supported frame size
+#define WAV_STREAM_RING_FRAMES 16384            // power of two, ~370 ms at 44.1 kHz
+
+enum {
+    WavFormat_PCM16,
+    WavFormat_Float32,
+};
+
+enum {
+    WavChunk_Empty,         // not given a range yet
+    WavChunk_Idle,          // has a range, the read still has to be started
+    WavChunk_Reading,
+    WavChunk_Ready,
+    WavChunk_Done,          // nothing left to read, or a read failed
+};
+
+typedef struct {
+    uint32 state;                   // WavChunk_*
+    PlatformAsyncRead read;
+    uint8 *bytes;                   // WAV_STREAM_CHUNK_SIZE
+    uint64 first_frame;             // in data frames
+    uint32 frame_count;             // in this chunk
+    uint32 frames_used;             // already decoded into the ring
+} WavStreamChunk;
+
+typedef struct WavStream {
+    char filename[256];
+    uint32 format;                  // WavFormat_*
+    uint32 channel_count;           // 1 or 2, mono reads channel 0 twice
+    uint32 sample_rate;
+    uint32 frame_size;              // bytes per file frame
+    uint64 data_offset;             // of the first frame in the file
+    uint64 data_frames;
+    bool32 looping;
+
+    WavStreamChunk chunks[2];       // decoded in turn, next_chunk is the older one
+    uint32 next_chunk;
+    uint64 next_read_frame;         // where the next chunk read starts, in data frames
+    bool32 end_of_data;             // not looping and everything is in the ring, plus one silent frame
+
+    // planar, samples[1] == samples[0] for mono
+    float32 *samples[2];
+    uint64 decoded_frames;          // total ever written to the ring, the write index
+    uint64 read_position;           // 32.32 source frames, the read index is its integer part
+    uint64 read_step;               // sample_rate / SOUND_FREQ in 32.32
+    bool32 use_avx2;
+
+    StreamStats stats;
+} WavStream;
+
+// parses the header (blocking, a few small reads) and starts the first chunk reads, false if the
+// file is missing or not 16-bit PCM / 32-bit float with 1 or 2 channels
+bool32 OpenWavStream(WavStream *stream, MemoryArena *arena, char *filename, bool32 looping);
+
+// once a frame before mixing, decodes finished reads into the ring and starts the next ones
+void UpdateWavStream(WavStream *stream);
+
+// resamples up to frame_count SOUND_FREQ frames into dest0 and dest1 (the same for mono),
+// returns fewer when the ring runs dry and 0 once a non-looping track has played out
+uint32 ReadWavStream(WavStream *stream, float32 *dest0, float32 *dest1, uint32 frame_count);
+
+// true once a non-looping track has nothing more to give
+bool32 WavStreamFinished(WavStream *stream);
@@ -0,0 +1,421 @@
+#include "handmade_world.h"
+#include "handmade_debug.h"
+#include <string.h>
+#include <stddef.h>
+
+// chunk coordinates are tile coordinates shifted down, gcc shifts negative ones arithmetically so
+// -1 lands in chunk -1 and not in chunk 0
+internal_func inline int32 TileToChunk(int32 tile){
+    return tile >> TILE_CHUNK_SHIFT;
+}
+
+internal_func inline uint32 TileChunkHash(int32 chunk_x, int32 chunk_y){
+    uint32 hash = (uint32)chunk_x * 0x9E3779B1u + (uint32)chunk_y * 0x85EBCA77u;
+    return hash ^ (hash >> 16);
+}
+
+internal_func inline int32 ChunkDistance(int32 chunk_x, int32 chunk_y, int32 center_x, int32 center_y){
+    int32 dx = (chunk_x > center_x) ? chunk_x - center_x : center_x - chunk_x;
+    int32 dy = (chunk_y > center_y) ? chunk_y - center_y : center_y - chunk_y;
+    return (dx > dy) ? dx : dy;
+}
+
+internal_func void TileChunkFilename(TileWorld *world, int32 chunk_x, int32 chunk_y, char *filename, uint32 size){
+    snprintf(filename, size, "%s/%d_%d.hmc", world->directory, chunk_x, chunk_y);
+}
+
+// runs on an I/O thread, the main thread only looks at it after the handle reads Done or Failed
+internal_func void TileChunkIOFinished(void *dest, uint64 bytes, bool32 succeeded, void *data){
+    ((TileChunk *)data)->io_end = PlatformGetWallClock();
+}
+
+bool32 InitializeTileWorld(TileWorld *world, MemoryArena *arena, char *directory, uint32 radius){
+    memset(world, 0, sizeof(*world));
+    if(strlen(directory) >= sizeof(world->directory)){
+        PlatformLog(LogLevel_Error, "World directory '%s' is too long", directory);
+        return false;
+    }
+    if(radius > TILE_WORLD_MAX_RADIUS){
+        radius = TILE_WORLD_MAX_RADIUS;
+    }
+
+    // everything within radius + 1 can be resident at once, and a row and a column of evictions can still
+    // be on their way to disk when the camera crosses the next chunk edge
+    uint32 side = 2 * radius + 3;
+    uint32 chunk_count = side * side + 2 * side;
+    uint32 entry_count = 16;
+    while(entry_count < 2 * chunk_count){
+        entry_count *= 2;
+    }
+
+    world->chunks = PushArray(arena, chunk_count, TileChunk);
+    world->free_chunks = PushArray(arena, chunk_count, uint32);
+    world->entries = PushArray(arena, entry_count, TileChunkEntry);
+    if(!world->chunks || !world->free_chunks || !world->entries){
+        memset(world, 0, sizeof(*world));
+        return false;
+    }
+
+    strcpy(world->directory, directory);
+    world->radius = (int32)radius;
+    world->chunk_count = chunk_count;
+    world->entry_mask = entry_count - 1;
+    for(uint32 entry_index = 0; entry_index < entry_count; ++entry_index){
+        world->entries[entry_index].chunk_index = TILE_CHUNK_NONE;
+    }
+    // popped from the top, so chunk 0 goes first
+    for(uint32 chunk_index = 0; chunk_index < chunk_count; ++chunk_index){
+        world->free_chunks[chunk_index] = chunk_count - 1 - chunk_index;
+    }
+    world->free_count = chunk_count;
+    world->fill_pending = true;
+
+    world->stats.radius = radius;
+    world->stats.chunk_capacity = chunk_count;
+    world->stats.memory_size = sizeof(TileWorld) + chunk_count * (sizeof(TileChunk) + sizeof(uint32)) +
+                               entry_count * sizeof(TileChunkEntry);
+    return true;
+}
+
+// ------------------------------------------------------------
+// Hash table
+// ------------------------------------------------------------
+TileChunk *FindTileChunk(TileWorld *world, int32 chunk_x, int32 chunk_y){
+    uint32 index = TileChunkHash(chunk_x, chunk_y) & world->entry_mask;
+    for(;;){
+        TileChunkEntry *entry = world->entries + index;
+        if(entry->chunk_index == TILE_CHUNK_NONE){
+            return NULL;
+        }
+        if(entry->chunk_x == chunk_x && entry->chunk_y == chunk_y){
+            return world->chunks + entry->chunk_index;
+        }
+        index = (index + 1) & world->entry_mask;
+    }
+}
+
+// the table is never more than half full, there is always an empty entry to stop at
+internal_func void InsertTileChunkEntry(TileWorld *world, int32 chunk_x, int32 chunk_y, uint32 chunk_index){
+    uint32 index = TileChunkHash(chunk_x, chunk_y) & world->entry_mask;
+    while(world->entries[index].chunk_index != TILE_CHUNK_NONE){
+        index = (index + 1) & world->entry_mask;
+    }
+    world->entries[index].chunk_x = chunk_x;
+    world->entries[index].chunk_y = chunk_y;
+    world->entries[index].chunk_index = chunk_index;
+    world->probes_stale = true;
+}
+
+// every entry after the hole in the same run moves back into it unless its home is between the hole and
+// where it sits, that would put it before its home, where no lookup starts
+internal_func void RemoveTileChunkEntry(TileWorld *world, int32 chunk_x, int32 chunk_y){
+    uint32 mask = world->entry_mask;
+    uint32 hole = TileChunkHash(chunk_x, chunk_y) & mask;
+    for(;;){
+        TileChunkEntry *entry = world->entries + hole;
+        if(entry->chunk_index == TILE_CHUNK_NONE){
+            return;
+        }
+        if(entry->chunk_x == chunk_x && entry->chunk_y == chunk_y){
+            break;
+        }
+        hole = (hole + 1) & mask;
+    }
+
+    uint32 next = (hole + 1) & mask;
+    while(world->entries[next].chunk_index != TILE_CHUNK_NONE){
+        TileChunkEntry *entry = world->entries + next;
+        uint32 home = TileChunkHash(entry->chunk_x, entry->chunk_y) & mask;
+        if(((next - home) & mask) >= ((next - hole) & mask)){
+            world->entries[hole] = *entry;
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    world->entries[hole].chunk_index = TILE_CHUNK_NONE;
+    world->probes_stale = true;
+}
+
+// what a lookup of each chunk in the table walks, one entry when it sits at its home
+internal_func void MeasureTileChunkProbes(TileWorld *world){
+    uint64 total_probes = 0;
+    uint32 entry_count = 0;
+    uint32 longest = 0;
+    for(uint32 index = 0; index <= world->entry_mask; ++index){
+        TileChunkEntry *entry = world->entries + index;
+        if(entry->chunk_index != TILE_CHUNK_NONE){
+            uint32 home = TileChunkHash(entry->chunk_x, entry->chunk_y) & world->entry_mask;
+            uint32 probes = ((index - home) & world->entry_mask) + 1;
+            total_probes += probes;
+            longest = (probes > longest) ? probes : longest;
+            ++entry_count;
+        }
+    }
+    world->stats.average_probe = entry_count ? (float32)total_probes / (float32)entry_count : 0.0f;
+    world->stats.longest_probe = longest;
+    world->probes_stale = false;
+}
+
+// ------------------------------------------------------------
+// Residency
+// ------------------------------------------------------------
+internal_func void ReleaseTileChunk(TileWorld *world, TileChunk *chunk){
+    RemoveTileChunkEntry(world, chunk->chunk_x, chunk->chunk_y);
+    chunk->state = TileChunk_Free;
+    chunk->io = 0;
+    world->free_chunks[world->free_count++] = (uint32)(chunk - world->chunks);
+}
+
+// a chunk nobody wrote out yet, the same coordinate always makes the same tiles
+internal_func void GenerateTileChunk(TileChunk *chunk){
+    chunk->file.magic = TILE_CHUNK_MAGIC;
+    chunk->file.chunk_x = chunk->chunk_x;
+    chunk->file.chunk_y = chunk->chunk_y;
+    chunk->file.reserved = 0;
+    for(uint32 y = 0; y < TILE_CHUNK_DIM; ++y){
+        for(uint32 x = 0; x < TILE_CHUNK_DIM; ++x){
+            int32 tile_x = chunk->chunk_x * TILE_CHUNK_DIM + (int32)x;
+            int32 tile_y = chunk->chunk_y * TILE_CHUNK_DIM + (int32)y;
+            uint32 hash = TileChunkHash(tile_x, tile_y) * 0x2C1B3C6Du;
+            // mostly floor, one tile in sixteen a wall, the top bits pick a variant
+            chunk->file.tiles[y * TILE_CHUNK_DIM + x] = (uint16)((((hash >> 28) == 0) ? 2 : 1) | ((hash >> 8) & 0x0700));
+        }
+    }
+    chunk->dirty = false;
+    chunk->state = TileChunk_Resident;
+}
+
+// a chunk with a file starts its read, one without is made now, false if the platform is out of read slots
+internal_func bool32 StartTileChunkLoad(TileWorld *world, TileChunk *chunk){
+    char filename[320];
+    TileChunkFilename(world, chunk->chunk_x, chunk->chunk_y, filename, sizeof(filename));
+    if(PlatformGetFileSize(filename) != sizeof(TileChunkFile)){
+        GenerateTileChunk(chunk);
+        ++world->stats.chunks_generated;
+        return true;
+    }
+
+    chunk->io_start = PlatformGetWallClock();
+    chunk->io_end = 0;
+    chunk->io = PlatformBeginAsyncRead(filename, 0, sizeof(TileChunkFile), &chunk->file, TileChunkIOFinished, chunk);
+    if(!chunk->io){
+        return false;
+    }
+    chunk->state = TileChunk_Loading;
+    return true;
+}
+
+internal_func void FinishTileChunkIO(TileWorld *world, TileChunk *chunk, uint32 io_state){
+    if(io_state != AsyncRead_Invalid){
+        PlatformEndAsyncRead(chunk->io);
+    }
+    chunk->io = 0;
+
+    if(chunk->state == TileChunk_Loading){
+        if(io_state == AsyncRead_Invalid){
+            // a loop edit restore brought back a read that has since ended, read it again
+            if(!StartTileChunkLoad(world, chunk)){
+                ReleaseTileChunk(world, chunk);
+                world->fill_pending = true;
+            }
+            return;
+        }
+
+        TileChunkFile *file = &chunk->file;
+        if(io_state == AsyncRead_Done && file->magic == TILE_CHUNK_MAGIC &&
+           file->chunk_x == chunk->chunk_x && file->chunk_y == chunk->chunk_y){
+            uint64 ticks = (chunk->io_end > chunk->io_start) ? chunk->io_end - chunk->io_start : 0;
+            WorldStats *stats = &world->stats;
+            stats->load_ticks += ticks;
+            stats->load_ticks_min = (!stats->chunks_loaded || ticks < stats->load_ticks_min) ? ticks : stats->load_ticks_min;
+            stats->load_ticks_max = (ticks > stats->load_ticks_max) ? ticks : stats->load_ticks_max;
+            ++stats->chunks_loaded;
+            chunk->dirty = false;
+            chunk->state = TileChunk_Resident;
+        } else {
+            PlatformLog(LogLevel_Error, "Chunk %d,%d did not read back, its changes are lost", chunk->chunk_x, chunk->chunk_y);
+            GenerateTileChunk(chunk);
+            ++world->stats.chunks_generated;
+        }
+    } else if(chunk->state == TileChunk_Writing){
+        if(io_state == AsyncRead_Done){
+            ++world->stats.chunks_written;
+            chunk->dirty = false;
+            if(chunk->wanted){
+                chunk->state = TileChunk_Resident;
+            } else {
+                ReleaseTileChunk(world, chunk);
+            }
+        } else {
+            // still changed, the next step evicts it again if it is still out of range
+            chunk->dirty = true;
+            chunk->state = TileChunk_Resident;
+        }
+        chunk->wanted = false;
+    }
+}
+
+// takes a free chunk, or waits for a write that will free one, NULL if nothing can
+internal_func TileChunk *AllocateTileChunk(TileWorld *world){
+    if(!world->free_count){
+        for(uint32 chunk_index = 0; chunk_index < world->chunk_count; ++chunk_index){
+            TileChunk *chunk = world->chunks + chunk_index;
+            if(chunk->state == TileChunk_Writing && !chunk->wanted){
+                FinishTileChunkIO(world, chunk, PlatformWaitForAsyncRead(chunk->io));
+                if(world->free_count){
+                    break;
+                }
+            }
+        }
+    }
+    if(!world->free_count){
+        return NULL;
+    }
+
+    TileChunk *chunk = world->chunks + world->free_chunks[--world->free_count];
+    memset(chunk, 0, offsetof(TileChunk, file));
+    return chunk;
+}
+
+// a changed chunk goes out through an async write and stays in the table until it is on disk, an
+// unchanged one is just forgotten, false if the platform is out of slots and it has to stay for now
+internal_func bool32 EvictTileChunk(TileWorld *world, TileChunk *chunk){
+    if(chunk->dirty){
+        char filename[320];
+        TileChunkFilename(world, chunk->chunk_x, chunk->chunk_y, filename, sizeof(filename));
+        chunk->io_start = PlatformGetWallClock();
+        chunk->io_end = 0;
+        chunk->io = PlatformBeginAsyncWrite(filename, sizeof(TileChunkFile), &chunk->file, TileChunkIOFinished, chunk);
+        if(!chunk->io){
+            return false;
+        }
+        chunk->wanted = false;
+        chunk->state = TileChunk_Writing;
+    } else {
+        ReleaseTileChunk(world, chunk);
+    }
+    ++world->stats.chunks_evicted;
+    return true;
+}
+
+// false if there was no chunk or read slot for it, it is tried again next step
+internal_func bool32 BringInTileChunk(TileWorld *world, int32 chunk_x, int32 chunk_y){
+    TileChunk *chunk = FindTileChunk(world, chunk_x, chunk_y);
+    if(chunk){
+        if(chunk->state == TileChunk_Writing && !chunk->wanted){
+            chunk->wanted = true;
+            ++world->stats.chunks_revived;
+        }
+        return true;
+    }
+
+    chunk = AllocateTileChunk(world);
+    if(!chunk){
+        return false;
+    }
+    chunk->chunk_x = chunk_x;
+    chunk->chunk_y = chunk_y;
+    InsertTileChunkEntry(world, chunk_x, chunk_y, (uint32)(chunk - world->chunks));
+    if(!StartTileChunkLoad(world, chunk)){
+        ReleaseTileChunk(world, chunk);
+        return false;
+    }
+    return true;
+}
+
+void UpdateWorldResidency(TileWorld *world, int32 camera_tile_x, int32 camera_tile_y){
+    TIMED_FUNCTION();
+    int32 camera_x = TileToChunk(camera_tile_x);
+    int32 camera_y = TileToChunk(camera_tile_y);
+    int32 radius = world->radius;
+
+    for(uint32 chunk_index = 0; chunk_index < world->chunk_count; ++chunk_index){
+        TileChunk *chunk = world->chunks + chunk_index;
+        if(chunk->state == TileChunk_Loading || chunk->state == TileChunk_Writing){
+            uint32 io_state = PlatformGetAsyncReadState(chunk->io);
+            if(io_state != AsyncRead_Pending){
+                FinishTileChunkIO(world, chunk, io_state);
+            }
+        }
+        // reads still in flight are left to land, the next step evicts them
+        if(chunk->state == TileChunk_Resident && ChunkDistance(chunk->chunk_x, chunk->chunk_y, camera_x, camera_y) > radius + 1){
+            EvictTileChunk(world, chunk);
+        }
+    }
+
+    // rings outwards from the camera, so the chunks it needs soonest are the first reads queued
+    if(world->fill_pending || camera_x != world->camera_chunk_x || camera_y != world->camera_chunk_y){
+        world->camera_chunk_x = camera_x;
+        world->camera_chunk_y = camera_y;
+        bool32 filled = BringInTileChunk(world, camera_x, camera_y);
+        for(int32 ring = 1; ring <= radius; ++ring){
+            for(int32 i = -ring; i <= ring; ++i){
+                filled &= BringInTileChunk(world, camera_x + i, camera_y - ring);
+                filled &= BringInTileChunk(world, camera_x + i, camera_y + ring);
+            }
+            for(int32 i = -ring + 1; i <= ring - 1; ++i){
+                filled &= BringInTileChunk(world, camera_x - ring, camera_y + i);
+                filled &= BringInTileChunk(world, camera_x + ring, camera_y + i);
+            }
+        }
+        world->fill_pending = !filled;
+    }
+
+    // whatever stands under the camera is needed this step
+    TileChunk *camera_chunk = FindTileChunk(world, camera_x, camera_y);
+    if(camera_chunk && camera_chunk->state == TileChunk_Loading){
+        FinishTileChunkIO(world, camera_chunk, PlatformWaitForAsyncRead(camera_chunk->io));
+    }
+
+    if(world->probes_stale){
+        MeasureTileChunkProbes(world);
+    }
+    world->stats.resident_chunks = world->chunk_count - world->free_count;
+}
+
+void FinishTileChunkLoads(TileWorld *world){
+    for(uint32 chunk_index = 0; chunk_index < world->chunk_count; ++chunk_index){
+        TileChunk *chunk = world->chunks + chunk_index;
+        if(chunk->state == TileChunk_Loading){
+            FinishTileChunkIO(world, chunk, PlatformWaitForAsyncRead(chunk->io));
+        }
+    }
+}
+
+// ------------------------------------------------------------
+// Tiles
+// ------------------------------------------------------------
+uint16 GetTile(TileWorld *world, int32 tile_x, int32 tile_y){
+    TileChunk *chunk = FindTileChunk(world, TileToChunk(tile_x), TileToChunk(tile_y));
+    if(!chunk || chunk->state == TileChunk_Loading){
+        return TILE_UNLOADED;
+    }
+    return chunk->file.tiles[(tile_y & TILE_CHUNK_MASK) * TILE_CHUNK_DIM + (tile_x & TILE_CHUNK_MASK)];
+}
+
+bool32 SetTile(TileWorld *world, int32 tile_x, int32 tile_y, uint16 tile){
+    TileChunk *chunk = FindTileChunk(world, TileToChunk(tile_x), TileToChunk(tile_y));
+    if(!chunk || chunk->state != TileChunk_Resident){
+        return false;
+    }
+    chunk->file.tiles[(tile_y & TILE_CHUNK_MASK) * TILE_CHUNK_DIM + (tile_x & TILE_CHUNK_MASK)] = tile;
+    chunk->dirty = true;
+    return true;
+}
+
+uint64 HashTileWorld(TileWorld *world){
+    uint64 hash = 0xcbf29ce484222325ull;
+    int32 radius = world->radius;
+    for(int32 chunk_y = world->camera_chunk_y - radius; chunk_y <= world->camera_chunk_y + radius; ++chunk_y){
+        for(int32 chunk_x = world->camera_chunk_x - radius; chunk_x <= world->camera_chunk_x + radius; ++chunk_x){
+            TileChunk *chunk = FindTileChunk(world, chunk_x, chunk_y);
+            bool32 loaded = chunk && chunk->state != TileChunk_Loading;
+            for(uint32 tile_index = 0; tile_index < TILE_CHUNK_DIM * TILE_CHUNK_DIM; ++tile_index){
+                uint16 tile = loaded ? chunk->file.tiles[tile_index] : TILE_UNLOADED;
+                hash = (hash ^ (tile & 0xFF)) * 0x100000001b3ull;
+                hash = (hash ^ (tile >> 8)) * 0x100000001b3ull;
+            }
+        }
+    }
+    return hash;
+}
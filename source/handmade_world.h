@@ -0,0 +1,118 @@
+#pragma once
+#include "handmade.h"
+
+/*
+    ---------- Tile world ---------------
+
+    The world is an unbounded grid of uint16 tiles cut into TILE_CHUNK_DIM
+    square chunks, and only the chunks near the camera are in memory: a
+    fixed pool of TileChunks and an open addressed hash table keyed by chunk
+    coordinate, both pushed once into permanent storage. How far the world
+    reaches never changes how much memory it takes, only the radius does.
+
+    Every step UpdateWorldResidency brings in the square of chunks within
+    radius of the camera's chunk, nearest first, and sends out the ones
+    further than radius + 1. The ring in between keeps a camera wobbling
+    over a chunk edge from loading and evicting the same row every step.
+
+        Free -> Loading -> Resident -> Writing -> Free
+                              ^           |
+                              +-----------+  wanted back before the write finished
+
+    A chunk that was ever written out has a file of its own in the world's
+    directory and comes back through an async read, one that never was is
+    made on the spot from its coordinate. An evicted chunk nobody changed
+    is just forgotten, a changed one goes out through an async write and
+    stays in the table until it is on disk, so a read never races the write
+    of the same file and a chunk the camera turns back for comes from memory.
+    A loop edit restore puts the chunk files back too (the platform notes
+    every write since the snapshot), so a restored world reads what it had.
+
+    The table has twice as many entries as the pool has chunks and probes
+    linearly. Removing an entry shifts the rest of its run back instead of
+    leaving a tombstone, so a lookup stops at the first empty entry however
+    long the world has been streaming.
+*/
+#define TILE_CHUNK_SHIFT 4
+#define TILE_CHUNK_DIM (1 << TILE_CHUNK_SHIFT)
+#define TILE_CHUNK_MASK (TILE_CHUNK_DIM - 1)
+#define TILE_WORLD_MAX_RADIUS 32
+#define TILE_UNLOADED 0xFFFF            // GetTile's answer for a chunk that is not in, never a real tile
+#define TILE_CHUNK_NONE 0xFFFFFFFFu
+#define TILE_CHUNK_MAGIC 0x31434D48u    // "HMC1"
+
+enum {
+    TileChunk_Free,
+    TileChunk_Loading,              // its read is in flight, the tiles are not there yet
+    TileChunk_Resident,
+    TileChunk_Writing,              // evicted, readable but not writable until the write ends
+};
+
+// a chunk's file is exactly this, and reads land on it in place
+typedef struct {
+    uint32 magic;
+    int32 chunk_x;
+    int32 chunk_y;
+    uint32 reserved;
+    uint16 tiles[TILE_CHUNK_DIM * TILE_CHUNK_DIM];  // row major
+} TileChunkFile;
+
+typedef struct {
+    uint32 state;                   // TileChunk_*
+    bool32 dirty;                   // changed since it came in, eviction writes it out
+    bool32 wanted;                  // Writing, but back inside the radius, stays once the write is done
+    int32 chunk_x;                  // the table's key, the file's copy is only trusted once it is checked
+    int32 chunk_y;
+    PlatformAsyncRead io;           // the read or write in flight
+    uint64 io_start;                // wall clock when it was started
+    uint64 io_end;                  // set by the I/O thread as it finishes
+    TileChunkFile file;
+} TileChunk;
+
+typedef struct {
+    int32 chunk_x;
+    int32 chunk_y;
+    uint32 chunk_index;             // into TileWorld.chunks, TILE_CHUNK_NONE for an empty entry
+} TileChunkEntry;
+
+typedef struct TileWorld {
+    char directory[256];            // where chunk files go, without the trailing slash
+    int32 radius;
+    int32 camera_chunk_x;
+    int32 camera_chunk_y;
+    bool32 fill_pending;            // the last fill ran out of chunks or read slots, try it again next step
+    bool32 probes_stale;            // entries came or went since the probe lengths were measured
+
+    uint32 chunk_count;
+    TileChunk *chunks;
+    uint32 *free_chunks;            // a stack of pool indices
+    uint32 free_count;
+
+    uint32 entry_mask;              // entry count - 1
+    TileChunkEntry *entries;
+
+    WorldStats stats;
+} TileWorld;
+
+// pushes the pool and table for radius, false (and nothing usable) if the arena is out of room
+bool32 InitializeTileWorld(TileWorld *world, MemoryArena *arena, char *directory, uint32 radius);
+
+// finishes reads and writes that are done, evicts what the camera left behind and starts bringing in
+// what it came up to, the chunk under the camera itself is waited for
+void UpdateWorldResidency(TileWorld *world, int32 camera_tile_x, int32 camera_tile_y);
+
+// the chunk at a chunk coordinate if it is in the table, in any state
+TileChunk *FindTileChunk(TileWorld *world, int32 chunk_x, int32 chunk_y);
+
+// TILE_UNLOADED unless the tile's chunk is resident or being written
+uint16 GetTile(TileWorld *world, int32 tile_x, int32 tile_y);
+
+// false unless the tile's chunk is resident, the change goes to disk when the chunk is evicted
+bool32 SetTile(TileWorld *world, int32 tile_x, int32 tile_y, uint16 tile);
+
+// blocks until every read in flight has landed
+void FinishTileChunkLoads(TileWorld *world);
+
+// FNV-1a over the square of chunks within radius of the camera, row by row, a chunk still loading counts
+// as all TILE_UNLOADED, so once FinishTileChunkLoads returns it is the same whatever order they streamed in
+uint64 HashTileWorld(TileWorld *world);
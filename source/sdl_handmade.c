@@ -4,12 +4,24 @@
 #include "SDL3/SDL_stdinc.h"
 #define SDL_MAIN_USE_CALLBACKS 1
 #include "handmade.h"
+#include "handmade_asset.h"
+#include "handmade_render.h"
+#include "handmade_debug.h"
+#include "handmade_input.h"
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
 
 #include <unistd.h>
 #include <stdio.h>
 #include <limits.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <dirent.h>
+#include <time.h>
 
 
 // ------------------------------------------------------------
@@ -23,553 +35,4875 @@ global_variable SDL_Window *window = NULL;
 global_variable SDL_Renderer *renderer = NULL;
 global_variable RenderBuffer render_buffer = {0};
 global_variable AudioSystem audio_system = {0};
-global_variable SoundState sound_state = {0};
-global_variable SDL_Gamepad *controller = NULL;
 global_variable SDL_Texture *texture = NULL;
 global_variable SDL_AudioSpec audio_spec = {0};
 global_variable SDL_AudioStream *audio_stream = NULL;
 
 global_variable bool soundBufferNeedsFilling = true;
 
+// audio output, --audio picks how mixed frames reach the device
+enum {
+    AudioMode_Callback,     // SDL's audio thread pulls from audio_ring in AudioStreamCallback
+    AudioMode_Queue,        // the main thread keeps ~0.6s queued with SDL_PutAudioStreamData, kept to compare against
+    AudioMode_Count
+};
+global_variable uint32 audio_mode = AudioMode_Callback;
+global_variable char *audio_mode_names[AudioMode_Count] = { "callback", "queue" };
+
+// single producer, single consumer ring of interleaved frames: the main thread writes what the
+// game mixed, the callback reads. Indices count frames and wrap with uint32, the fill is write - read
+#define AUDIO_RING_FRAMES 16384             // power of two, ~340 ms at 48 kHz
+#define AUDIO_SILENCE_FRAMES 512
+#define AUDIO_MIN_LATENCY_MS 20
+#define AUDIO_MAX_LATENCY_MS 100
+#define AUDIO_START_LATENCY_MS 40
+#define AUDIO_LATENCY_UP_MS 10              // after a frame that saw new underruns
+#define AUDIO_LATENCY_DOWN_MS 2             // after every AUDIO_LATENCY_SETTLE_MS without one
+#define AUDIO_LATENCY_SETTLE_MS 2000
+
+typedef struct {
+    float32 *samples;                   // AUDIO_RING_FRAMES frames
+    SDL_AtomicInt write_index;          // only the main thread stores this
+    SDL_AtomicInt read_index;           // only the callback stores this
+    SDL_AtomicInt started;              // silence before the first write is not an underrun
+
+    SDL_AtomicInt underrun_count;       // callbacks that found too few frames
+    SDL_AtomicInt underrun_frames;      // silence they filled in instead
+} AudioRing;
+
+// main thread only
+typedef struct {
+    uint32 target_frames;               // queued after each write, between AUDIO_MIN and MAX_LATENCY_MS
+    uint32 lowest_target_frames;
+    uint32 highest_target_frames;
+    uint32 seen_underruns;
+    uint64 last_adjust_ms;
+
+    // ring plus SDL's stream, measured right before each write
+    uint32 min_queued_frames;
+    uint32 max_queued_frames;
+    uint64 queued_frames_sum;
+    uint32 queued_count;
+} AudioLatency;
+
+global_variable AudioRing audio_ring = {0};
+global_variable AudioLatency audio_latency = {0};
+global_variable float32 audio_silence[AUDIO_SILENCE_FRAMES * SOUND_CHANNELS] = {0};
+
+// game code, libhandmade.so next to the executable, swapped for a new build between frames
+#define GAME_CODE_FILENAME "libhandmade.so"
+
+typedef struct {
+    void *library;
+    struct timespec last_write_time;
+    uint32 load_count;                  // names the private copy that is actually loaded
+    char loaded_path[PATH_MAX];
+    GameUpdateAndRenderFunc *update_and_render;
+    bool is_valid;
+} GameCode;
+
+global_variable GameCode game_code = {0};
+global_variable char game_code_path[PATH_MAX] = {0};
+global_variable char asset_pack_path[PATH_MAX] = {0};
+
+// game memory
+#define GAME_MEMORY_DEFAULT_BASE Terabytes(2)  // fixed so pointers into game memory are the same every run
+
+enum {
+    MemoryMode_Reserve,     // reserve address space, the game commits it as it grows
+    MemoryMode_Calloc,      // one zeroed allocation of everything, kept to compare against
+    MemoryMode_Count
+};
+global_variable uint32 memory_mode = MemoryMode_Reserve;
+global_variable char *memory_mode_names[MemoryMode_Count] = { "reserve", "calloc" };
+global_variable uint64 memory_base_address = GAME_MEMORY_DEFAULT_BASE;   // --memory-base, 0 lets the OS pick
+global_variable bool use_huge_pages = false;                            // --huge-pages, permanent storage only
+global_variable uint64 startup_ticks = 0;
+
+// how the finished frame reaches the texture
+enum {
+    PresentMode_Copy,   // render into render_buffer, SDL_UpdateTexture copies the dirty rectangles over
+    PresentMode_Lock,   // render straight into SDL_LockTexture memory, no copy
+    PresentMode_Count
+};
+global_variable uint32 present_mode = PresentMode_Copy;
+global_variable char *present_mode_names[PresentMode_Count] = { "copy", "lock" };
+
+// dynamic resolution, the game renders at a fraction of the window size and the frame is stretched back over it
+enum {
+    UpscaleMode_Renderer,   // SDL_RenderTexture stretches the small texture, filtered by the SDL renderer
+    UpscaleMode_Nearest,    // UpscaleRenderBuffer into a window sized buffer, which is what gets uploaded
+    UpscaleMode_Bilinear,
+    UpscaleMode_Count
+};
+global_variable uint32 upscale_mode = UpscaleMode_Renderer;
+global_variable char *upscale_mode_names[UpscaleMode_Count] = { "renderer", "nearest", "bilinear" };
+
+#define RESOLUTION_SCALE_STEPS 16       // the render size moves in 1/16ths of the window size
+#define RESOLUTION_MIN_STEPS 8          // never below half the window each way
+#define RESOLUTION_SETTLE_FRAMES 30     // after a change, before the next one is considered
+#define RESOLUTION_DOWN_LOAD 0.90       // of the frame budget, above it the scale drops at once
+#define RESOLUTION_TARGET_LOAD 0.80     // where a drop aims for
+#define RESOLUTION_UP_LOAD 0.60         // below it the scale climbs one step, (9/8)^2 of it is still under the drop
+#define RESOLUTION_HISTORY_COUNT 32
+
+typedef struct {
+    uint64 frame;
+    double64 seconds;                   // since startup
+    uint32 width;                       // the new render size
+    uint32 height;
+    double64 work_ms;                   // smoothed main thread work that moved it
+} ResolutionChange;
+
+typedef struct {
+    bool dynamic;                       // --dynamic-res, on by default outside --bench
+    uint32 steps;                       // render size is window size * steps / RESOLUTION_SCALE_STEPS, --render-scale
+    uint32 window_width;
+    uint32 window_height;
+
+    double64 smoothed_ms;               // main thread work per frame, present's vsync wait left out
+    uint32 settle_frames;
+
+    uint64 frame_count;
+    uint64 steps_sum;                   // over every frame, for the average scale
+    uint32 min_steps;                   // lowest used
+    uint32 change_count;
+    ResolutionChange history[RESOLUTION_HISTORY_COUNT];    // ring, newest at change_count - 1
+} ResolutionScaler;
+
+global_variable ResolutionScaler resolution = {0};
+global_variable int dynamic_res_option = -1;            // --dynamic-res on|off, -1 leaves it to the mode
+global_variable RenderBuffer upscale_buffer = {0};      // window sized, only while a software upscale is stretching
+global_variable bool upscale_redraw_all = false;        // upscale_buffer or the texture is new, no band can be skipped
+
+// pixel memory, each buffer reserves address space once and commits more, at least doubling, only when a
+// size needs it, so resizing is pointer and pitch arithmetic. Rows start on 64 byte boundaries. The
+// renderer's scratch grows the same way.
+#define PIXEL_POOL_RESERVE_SIZE Megabytes(512)
+#define PIXEL_ROW_ALIGNMENT 64
+
+typedef struct {
+    uint8 *base;
+    uint64 committed;                   // readable and writable from base, never given back
+    uint32 grow_count;
+} PixelPool;
+
+global_variable PixelPool render_pixel_pool = {0};
+global_variable PixelPool upscale_pixel_pool = {0};
+global_variable PixelPool render_scratch_pool = {0};    // RenderFrame's, then UpscaleToWindow's, never both at once
+
+// the texture is only recreated to grow, by half again, and not while the window is still being dragged,
+// frames use its top left present_width x present_height
+#define WINDOW_SETTLE_MS 200
+global_variable uint32 texture_width = 0;
+global_variable uint32 texture_height = 0;
+global_variable uint32 present_width = 0;
+global_variable uint32 present_height = 0;
+global_variable uint64 window_settle_deadline = 0;      // SDL_GetTicks() when the last resize counts as final, 0 once it has
+global_variable uint32 texture_create_count = 0;
+global_variable uint32 deferred_resize_count = 0;       // sizes rendered smaller to fit a texture that was not grown yet
+
 // Timing globals
 global_variable uint64 perf_start = 0;
-global_variable uint64 last_counter = 0;
-global_variable double64 dt = 0;
 global_variable double64 t_total = 0;
 global_variable uint64 perf_freq = 0;
 
-// input
+// frame scheduler, paces frames to --fps and hands the game fixed --update-hz simulation steps
+#define SCHEDULER_MAX_UPDATES 8                 // per frame, after a longer stall the simulation drops time instead of catching up
+#define SCHEDULER_MIN_SLEEP_MARGIN_NS 200000    // wake at least this long before the deadline and spin the rest
+#define SCHEDULER_MAX_SLEEP_MARGIN_NS 4000000
+#define SCHEDULER_REPORT_SECONDS 5
+
+// one reporting window, the whole run is another one
+typedef struct {
+    uint32 frames;
+    uint32 missed_frames;               // started more than half a frame late
+    double64 interval_sum;              // ms between frame starts
+    double64 interval_sum_squares;
+    double64 max_interval;
+    uint64 work_ticks;                  // main thread, frame start to the end of present
+    uint64 sleep_ticks;
+    uint64 spin_ticks;
+    uint64 start_ticks;
+    uint64 start_cpu_ns;                // whole process, every thread
+} FramePacingStats;
+
+typedef struct {
+    uint32 target_hz;                   // --fps, 0 picks the display's refresh rate
+    uint32 update_hz;                   // --update-hz
+    bool paced;                         // false runs flat out, --bench does unless --fps is given
+    bool vsync;                         // --vsync, present blocks instead of the scheduler sleeping
+
+    uint64 frame_ticks;                 // performance counter ticks per frame
+    uint64 update_ticks;                // and per simulation step
+    uint64 accumulator;                 // real time not yet simulated
+    uint64 frame_start;
+    uint64 deadline;                    // when the next frame should start
+    uint64 sleep_margin_ns;             // grows with measured oversleep, decays slowly
+
+    FramePacingStats window;
+    FramePacingStats total;
+} FrameScheduler;
+
+global_variable FrameScheduler scheduler = {0};
+
+// profiler, the platform half of handmade_debug.h
+#define DEBUG_MAX_THREADS 32
+#define DEBUG_EVENT_RING_COUNT (1 << 18)        // collected events, power of two, 4MB
+#define DEBUG_FRAME_COUNT 240                   // frames a trace covers, if the event ring still holds them
+#define DEBUG_MAX_NAMES 512
+#define DEBUG_NAME_LENGTH 64
+#define DEBUG_NAME_CACHE_COUNT 1024             // power of two
+#define DEBUG_MAX_DEPTH 64                      // nested blocks per thread, deeper ones are not paired
+#define DEBUG_SUMMARY_ROWS 12
+#define DEFAULT_TRACE_FILENAME "handmade_trace.json"    // T without --trace, in the working directory
+
+typedef struct {
+    uint64 clock;
+    uint16 name_index;
+    uint8 type;                         // DebugEvent_*
+    uint8 thread_index;
+} StoredDebugEvent;
+
+typedef struct {
+    uint64 begin_clock;
+    uint64 end_clock;
+    uint64 first_event;                 // absolute index, masked into the event ring
+    uint32 event_count;
+} DebugFrame;
+
+typedef struct {
+    SDL_AtomicInt thread_count;                     // slots handed out, may run past DEBUG_MAX_THREADS
+    DebugThreadEvents *threads[DEBUG_MAX_THREADS];  // atomic pointers, NULL until the owner has set its slot up
+
+    // main thread only from here on
+    StoredDebugEvent *events;           // DEBUG_EVENT_RING_COUNT
+    uint64 event_count;                 // ever collected, the write index
+    DebugFrame frames[DEBUG_FRAME_COUNT];
+    uint64 frame_count;                 // ever ended
+    uint64 frame_begin_clock;
+    uint64 frame_first_event;
+
+    char names[DEBUG_MAX_NAMES][DEBUG_NAME_LENGTH];
+    uint32 name_count;
+    char *name_cache_keys[DEBUG_NAME_CACHE_COUNT];  // literal address to names index, forgotten on reload
+    uint16 name_cache_values[DEBUG_NAME_CACHE_COUNT];
+
+    uint64 calibration_clock;           // debug clock and performance counter read together at startup
+    uint64 calibration_counter;
+    char *trace_path;                   // --trace, written on exit and by the T key
+} DebugProfiler;
+
+global_variable DebugProfiler profiler = {0};
+
+// logger, PlatformLog and SDL_Log put records on a multi producer ring, one thread formats and writes them
+#define LOG_RING_COUNT 2048                     // power of two, 1MB of records
+#define LOG_MAX_ARGS 8                          // a '*' width or precision counts as one
+#define LOG_TEXT_SIZE 424                       // copied %s strings, or the whole of an SDL_Log message
+#define LOG_WRITE_INTERVAL_NS 2000000           // the writer sleeps this long whenever it finds the ring empty
+#define LOG_OUTPUT_BUFFER_SIZE Kilobytes(64)    // formatted lines, written out in one go
+
+// 512 bytes, a producer fills one in place and publishes it through sequence
+typedef struct {
+    SDL_AtomicInt sequence;             // ring index it is free for, that plus one once it holds a message
+    uint8 level;                        // LogLevel_*
+    uint8 arg_count;
+    uint8 truncated;                    // ran out of args or text, formatting stops there
+    uint64 counter;                     // performance counter when it was logged
+    char *format;                       // the caller's literal, NULL if text is an already formatted message
+    uint64 args[LOG_MAX_ARGS];          // integers, double bits, pointers, %s offsets into text
+    char text[LOG_TEXT_SIZE];
+} LogRecord;
+
+typedef struct {
+    LogRecord *records;                 // LOG_RING_COUNT, NULL while PlatformLog writes straight through SDL
+    SDL_AtomicInt write_index;          // producers claim records with compare and swap
+    SDL_AtomicInt written_index;        // everything before it has been written out, FlushLog waits on it
+    SDL_AtomicInt dropped_count;        // messages that found the ring full
+    SDL_AtomicInt quitting;
+    SDL_Thread *thread;
+
+    // writer thread only
+    uint32 read_index;
+    uint32 reported_dropped_count;
+    int fd;                             // stderr, or --log FILE
+    char *output;                       // LOG_OUTPUT_BUFFER_SIZE
+    uint32 output_used;
+    uint64 start_counter;
+    uint64 counter_frequency;
+} Logger;
+
+global_variable Logger logger = {0};
+global_variable uint32 log_level = LogLevel_Info;
+global_variable char *log_level_names[LogLevel_Count] = { "debug", "info", "warning", "error" };
+global_variable char *log_path = NULL;
+
+// worker threads
+#define WORK_QUEUE_SIZE 1024
+#define MAX_WORKER_THREADS 64
+
+typedef struct {
+    PlatformWorkQueueCallback *callback;
+    void *data;
+} PlatformWorkQueueEntry;
+
+struct PlatformWorkQueue {
+    SDL_AtomicInt completion_goal;
+    SDL_AtomicInt completion_count;
+
+    SDL_AtomicInt next_entry_to_write;  // only the main thread writes this
+    SDL_AtomicInt next_entry_to_read;   // workers race for this with compare and swap
+
+    SDL_AtomicInt quitting;
+    SDL_Semaphore *semaphore;           // counts entries not yet picked up, workers sleep on it
+    PlatformWorkQueueEntry entries[WORK_QUEUE_SIZE];
+
+    SDL_Thread *threads[MAX_WORKER_THREADS];
+    uint32 thread_count;
+    char *thread_name;                  // for SDL and the profiler
+};
+
+global_variable PlatformWorkQueue render_queue = {0};
+global_variable uint32 render_thread_count = 0;   // --threads, 0 means one per logical core
+
+// software renderer, runs the game's RenderCommands after every GameUpdateAndRender
+global_variable uint32 render_path = RenderPath_Auto;  // --render, resolved once at startup
+global_variable RenderStats render_stats = {0};             // of the last RenderFrame
+global_variable uint64 render_tile_hashes[MAX_RENDER_TILES];    // what each tile drew, RenderBuffer.tile_hashes
+
+// dirty squares merged into rectangles for upload, runs of a row grow down while the next row repeats them
+#define MAX_DIRTY_RECTANGLES (DIRTY_TILE_ROWS * DIRTY_TILE_COLUMNS / 2)
+
+// async file reads and writes, a second queue whose threads spend their time blocked in the kernel
+#define MAX_ASYNC_READS 128             // fewer than WORK_QUEUE_SIZE, so adding a read never has to drain the ring
+#define ASYNC_READ_INDEX_BITS 8
+
+typedef struct {
+    SDL_AtomicInt state;                // AsyncRead_*, the I/O thread sets Done/Failed after everything else
+    bool in_use;                        // main thread only
+    uint32 generation;                  // bumped when the handle ends so stale handles read as invalid
+    bool is_write;                      // dest is the source, written out with PlatformWriteEntireFile
+
+    char filename[PATH_MAX];
+    uint64 offset;
+    uint64 size;
+    void *dest;
+    PlatformAsyncReadCallback *callback;
+    void *data;
+
+    uint64 bytes_read;
+    uint64 io_ticks;                    // time the I/O thread spent on this read
+} AsyncReadSlot;
+
+global_variable PlatformWorkQueue io_queue = {0};
+global_variable uint32 io_thread_count = 2;     // --io-threads
+global_variable AsyncReadSlot async_reads[MAX_ASYNC_READS] = {0};
+global_variable SDL_Mutex *async_read_lock = NULL;
+global_variable SDL_Condition *async_read_finished = NULL;
+
+// input, gamepads are controllers 1..4 in the order of their slots, the keyboard is always 0
+#define MAX_GAMEPAD_COUNT (MAX_CONTROLLER_COUNT - 1)
+typedef struct {
+    SDL_JoystickID id;          // 0 when the slot is free
+    SDL_Gamepad *gamepad;
+} GamepadSlot;
 global_variable GameInputState input = {0};
-global_variable GameInputState input_prev = {0};
+global_variable GamepadSlot gamepad_slots[MAX_GAMEPAD_COUNT] = {0};
+global_variable bool input_test_enabled = false;
+
+// live loop editing, L records input from a snapshot of the game state, P loops it back
+#define REPLAY_STATE_FILENAME "loop_edit_state.hms"
+#define REPLAY_INPUT_FILENAME "loop_edit_input.hmi"
+#define REPLAY_BACKUP_SUFFIX ".loop"    // the snapshot's copy of a file the game wrote since
+
+typedef struct {
+    char *path;
+    bool existed;               // moved to path REPLAY_BACKUP_SUFFIX, or there was nothing to move
+} ReplayWrittenFile;
+
+typedef struct {
+    bool enabled;               // not under --bench, the state file is only made on the first recording
+    int snapshot_fd;
+    uint8 *snapshot_memory;     // shared mapping of the state file, permanent_storage_size long, NULL until then
+    uint64 snapshot_size;       // committed permanent storage when the recording started
+
+    // files the game wrote through PlatformBeginAsyncWrite since the snapshot, put back on every restore
+    ReplayWrittenFile *written_files;
+    uint32 written_count;
+    uint32 written_capacity;
+
+    SDL_IOStream *recording_handle;
+    bool recording;
+
+    PlatformFile playback_file;     // mapped view of the recorded inputs
+    GameInputState *playback_inputs;
+    uint32 playback_count;
+    uint32 playback_index;
+    bool playing;
+} ReplayState;
+
+global_variable ReplayState replay = {0};
+
+// benchmark mode (--bench), runs a fixed number of frames on dummy video/audio drivers
+// game timers followed by the platform's own
+enum {
+    BenchSample_Present = DebugTimer_Count,   // texture upload or unlock, render and present
+    BenchSample_Frame,                        // the whole SDL_AppIterate
+    BenchSample_Count
+};
+
+typedef struct {
+    bool enabled;
+    uint32 frame_count;
+    uint32 width;
+    uint32 height;
+    uint32 frames_run;
+    double64 *samples;  // milliseconds, BenchSample_Count rows of frame_count
+    uint64 checksum;    // of the last frame, taken before the texture is unlocked
+
+    // --sprites N, totals over every frame for pixels per cycle
+    uint64 sprite_pixels;
+    uint64 sprite_cycles;
+
+    // how much the game mixed, fills differ in size in callback mode
+    uint64 mix_frames;
+    uint64 mix_ticks;
+
+    // what the dirty tiles saved, against uploading the whole buffer every frame
+    uint64 upload_bytes;
+    uint64 full_upload_bytes;   // the whole frame, whatever size it had
+    uint64 upload_rectangles;
+    uint64 render_tiles;
+    uint64 skipped_tiles;
+
+    // --entities N, main thread time moving them and finding and resolving their collisions
+    uint64 entity_move_ticks;
+    uint64 entity_collide_ticks;
+
+    // --world-radius R, main thread time keeping the chunks around the camera in and looking tiles up
+    uint64 world_update_ticks;
+    uint64 world_lookup_ticks;
+
+    // --resize-drag, the window is dragged half as big again and back, holding until each drag settles
+    bool resize_drag;
+    uint32 drag_phase;          // growing, holding, shrinking, holding
+    uint32 drag_frame;
+} BenchState;
+
+global_variable BenchState bench = {0};
+global_variable char *bench_sample_names[BenchSample_Count] = {
+    "GameUpdateAndRender", "MixAudio", "MoveEntities", "BuildEntityGrid", "CollideEntities", "UpdateWorld", "LookupTiles",
+    "RenderCommands", "SortRenderCommands", "DrawGradient", "DrawBitmaps", "Upscale", "Present", "Frame"
+};
+global_variable char *render_path_names[RenderPath_Count] = {
+    "auto", "scalar", "separable", "sse2", "avx2"
+};
+
+// --async-load FILE keeps one read of FILE per I/O thread in flight for the whole bench,
+// so the frame times show what streaming costs the renderer and the totals show what it overlaps
+#define ASYNC_LOAD_CHUNK_SIZE Megabytes(4)
+
+typedef struct {
+    char *filename;
+    uint64 file_size;
+    uint64 next_offset;
+    uint8 *buffer;                      // one chunk per read in flight
+    PlatformAsyncRead reads[MAX_WORKER_THREADS];
+    uint32 read_count;
+
+    uint64 bytes_read;
+    uint32 reads_completed;
+    uint64 io_ticks;                    // summed over I/O threads, can exceed the wall time
+    uint64 start_ticks;
+} AsyncLoadBench;
+
+global_variable AsyncLoadBench async_load = {0};
+
+// render command dumps, --dump-commands writes the last bench frame, --replay-commands times it without the game
+#define RENDER_DUMP_MAGIC (((uint32)'h' << 0) | ((uint32)'h' << 8) | ((uint32)'r' << 16) | ((uint32)'c' << 24))
+#define RENDER_DUMP_VERSION 1
+
+// header, one RenderDumpBitmap per bitmap, the push buffer, then each bitmap's pixels 64 byte aligned
+typedef struct {
+    uint32 magic;
+    uint32 version;
+    uint32 width;
+    uint32 height;
+    uint32 command_count;
+    uint32 push_buffer_size;
+    uint32 bitmap_count;
+    uint32 reserved;
+} RenderDumpHeader;
+
+typedef struct {
+    uint32 width;
+    uint32 height;
+    uint32 pitch;
+    uint32 premultiplied;
+    uint64 offset;          // of the pixels from the start of the file
+} RenderDumpBitmap;
+
+global_variable char *dump_commands_path = NULL;
+global_variable char *replay_commands_path = NULL;
+
+// file benchmark (--io-bench), reads the same file with PlatformFile_Copy and PlatformFile_Map
+#define IO_BENCH_FILENAME "io_bench.tmp"
+global_variable bool io_bench_enabled = false;
+global_variable char *file_mode_names[] = { "copy", "map" };
+
+// tile world (--world-radius), evicted chunks are written under --world-dir, where play keeps its saved world,
+// a bench without --world-dir streams through a directory of its own and is the only thing that deletes chunks
+#define WORLD_DEFAULT_PATH "handmade_world"
+#define WORLD_BENCH_TEMPLATE "handmade_world_bench.XXXXXX"
+global_variable char world_bench_path[PATH_MAX] = {0};     // set once mkdtemp made it, removed on exit
 
 // ------------------------------------------------------------
 // Function Declarations
 // ------------------------------------------------------------
 internal_func bool InitGameMemory();
 
+// game code
+internal_func void LoadGameCode(GameCode *game_code);
+internal_func void UnloadGameCode(GameCode *game_code);
+internal_func bool GameCodeChanged(GameCode *game_code);
+internal_func void FreeGameMemory();
+internal_func void LogMemoryUsage(char *when);
+internal_func void ParseCommandLine(int argc, char *argv[]);
+
+// work queue
+internal_func bool InitWorkQueue(PlatformWorkQueue *queue, uint32 worker_count, char *thread_name);
+internal_func void DestroyWorkQueue(PlatformWorkQueue *queue);
+
+// async file reads
+internal_func bool InitAsyncReads();
+internal_func void WaitForAllAsyncReads();
+internal_func void EndAllAsyncReads();
+internal_func void DestroyAsyncReads();
+internal_func void RemoveWorldBenchDirectory(char *path);
+
+// benchmark
+internal_func bool InitBench(BenchState *bench);
+internal_func void RecordBenchFrame(BenchState *bench, uint64 present_ticks, uint64 frame_ticks);
+internal_func void PrintBenchResults(BenchState *bench, RenderBuffer *buffer);
+internal_func uint64 ChecksumRenderBuffer(RenderBuffer *buffer);
+internal_func void RunFileBenchmark();
+internal_func bool StartAsyncLoadBench(AsyncLoadBench *load);
+internal_func void UpdateAsyncLoadBench(AsyncLoadBench *load);
+internal_func void EndAsyncLoadBench(AsyncLoadBench *load);
+internal_func bool DumpRenderCommands(RenderCommands *commands, char *filename);
+internal_func void RunRenderReplay(char *filename);
+
 // game controller input
-internal_func void UpdateButton(ButtonState *oldBState, ButtonState *newBState, bool isDown);
-internal_func void ProcessKeyboardEvent(SDL_KeyboardEvent *e);
-internal_func void ProcessControllerButton(SDL_GamepadButtonEvent *e);
-internal_func void ProcessControllerAxis(SDL_GamepadAxisEvent *e);
+internal_func void ProcessInputEvent(GameInputState *input, SDL_Event *event);
+internal_func void BeginInputFrame(GameInputState *input);
+internal_func void OpenGamepad(GameInputState *input, SDL_JoystickID id, uint64 timestamp);
+internal_func void CloseGamepads(void);
+internal_func void ConnectControllers(GameInputState *input, uint64 timestamp);
+internal_func bool RunInputTest(void);
+
+// input recording and playback
+internal_func bool InitReplay(ReplayState *replay);
+internal_func void DestroyReplay(ReplayState *replay);
+internal_func void NoteReplayWrite(ReplayState *replay, char *filename);
+internal_func void ToggleRecording(ReplayState *replay);
+internal_func void TogglePlayback(ReplayState *replay);
+internal_func void RecordInput(ReplayState *replay, GameInputState *new_input);
+internal_func void PlaybackInput(ReplayState *replay, GameInputState *new_input);
 internal_func float NormalizeStickValue(int16 val);
 
 // audio and rendering
 
-internal_func void ResizeRenderBuffer(RenderBuffer *buffer, uint32 Width, uint32 Height);
-internal_func bool InitAudio(AudioSystem *audio_system, SoundState *sound_state);
+internal_func bool ResizeRenderBuffer(RenderBuffer *buffer, PixelPool *pool, uint32 width, uint32 height, uint64 *tile_hashes);
+internal_func void FreePixelPool(PixelPool *pool);
+internal_func bool GrowTexture(uint32 width, uint32 height);
+internal_func void RenderFrame(RenderCommands *commands, RenderBuffer *target);
+internal_func void UpscaleToWindow(RenderBuffer *source, RenderBuffer *dest, bool redraw_all);
+internal_func uint64 UploadDirtyRectangles(SDL_Texture *texture, RenderBuffer *buffer, uint32 *rectangle_count);
+internal_func bool InitAudio(AudioSystem *audio_system);
 internal_func void DestroyAudio(AudioSystem *audio_system);
 
+// dynamic resolution
+internal_func void ApplyRenderResolution(void);
+internal_func void UpdateDynamicResolution(ResolutionScaler *scaler, uint64 work_ticks);
+internal_func void LogResolutionHistory(ResolutionScaler *scaler);
+internal_func void DragBenchWindow(void *appstate);
 
-void *PlatformReadEntireFile(char *filename){
-    void *file_buffer = NULL;
-    SDL_IOStream *file_handle = NULL;
-    // get file stream/handle
-    file_handle = SDL_IOFromFile(filename, "r");
-    if (!file_handle) {
+// frame scheduler
+internal_func void InitScheduler(FrameScheduler *scheduler);
+internal_func void BeginSchedulerFrame(FrameScheduler *scheduler, uint64 now, GameInputState *input);
+internal_func void EndSchedulerFrame(FrameScheduler *scheduler);
+internal_func void LogFramePacing(FrameScheduler *scheduler, FramePacingStats *stats, char *what);
+
+// profiler
+internal_func bool InitProfiler(void);
+internal_func void DestroyProfiler(void);
+internal_func void NameDebugThread(char *name);
+internal_func void CollectDebugEvents(void);
+internal_func void EndDebugFrame(void);
+internal_func void ForgetDebugNames(void);
+internal_func bool WriteChromeTrace(char *filename);
+internal_func void LogProfileSummary(void);
+
+// logger
+internal_func bool InitLogger(void);
+internal_func void DestroyLogger(void);
+internal_func void FlushLog(void);
+internal_func void SDLCALL AudioStreamCallback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount);
+internal_func uint32 UpdateAudioLatency(AudioLatency *latency, AudioRing *ring, uint32 max_frames);
+internal_func void WriteAudioRing(AudioRing *ring, float32 *samples, uint32 frame_count);
+internal_func void LogAudioLatency(AudioLatency *latency, AudioRing *ring);
+
+
+PlatformFile PlatformReadEntireFile(char *filename, uint32 mode){
+    PlatformFile result = {0};
+    result.mode = mode;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
         SDL_Log("error getting file handle for '%s'", filename);
-        return NULL;
+        return result;
     }
 
     // Get the file size
-    Sint64 size = SDL_GetIOSize(file_handle);
-    if (size <= 0) {
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
         SDL_Log("file size invalid for '%s'", filename);
-        SDL_CloseIO(file_handle);
-        return NULL;
+        close(fd);
+        return result;
+    }
+    uint64 size = (uint64)file_stat.st_size;
+
+    if (mode == PlatformFile_Map) {
+        // pages come straight from the page cache as they are touched, the mapping outlives the fd
+        void *view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) {
+            SDL_Log("Failed to map '%s'", filename);
+        } else {
+            result.contents = view;
+            result.size = size;
+        }
+        close(fd);
+        return result;
     }
 
     // allocate memory for the file
-    file_buffer = SDL_malloc((size_t)size);
+    uint8 *file_buffer = (uint8 *)SDL_malloc((size_t)size);
     if (!file_buffer) {
         SDL_Log("error allocating memory for the file_buffer");
-        SDL_CloseIO(file_handle);
-        return NULL;
+        close(fd);
+        return result;
     }
 
-    // read the file
-    size_t bytesRead = SDL_ReadIO(file_handle, file_buffer, (size_t)size);
-    if (bytesRead != (size_t)size) {
+    // read the file, a single read may return short for very large files
+    uint64 bytes_read = 0;
+    while (bytes_read < size) {
+        ssize_t count = read(fd, file_buffer + bytes_read, (size_t)(size - bytes_read));
+        if (count <= 0) {
+            break;
+        }
+        bytes_read += (uint64)count;
+    }
+    close(fd);
+
+    if (bytes_read != size) {
         SDL_Log("Failed to read entire file '%s'", filename);
         SDL_free(file_buffer);
-        file_buffer = NULL;
-    } else {
-        SDL_Log("Read entire file '%s' successfully", filename);
+        return result;
     }
 
-    SDL_CloseIO(file_handle);
-    return file_buffer;
+    result.contents = file_buffer;
+    result.size = size;
+    return result;
 }
 
-void PlatformFreeFileMemory(void *memory){
-    SDL_free(memory);
-    SDL_Log("File memory freed");
+void PlatformFreeFileMemory(PlatformFile *file){
+    if (file->contents) {
+        if (file->mode == PlatformFile_Map) {
+            munmap(file->contents, file->size);
+        } else {
+            SDL_free(file->contents);
+        }
+    }
+    file->contents = NULL;
+    file->size = 0;
 }
-bool32 PlatformWriteEntireFile(char *filename, uint32 memory_size, void *memory){
-    return true;
+
+// callers also use this to ask whether a file is there at all, so a missing one is not worth a log line
+uint64 PlatformGetFileSize(char *filename){
+    struct stat file_status;
+    if (stat(filename, &file_status) != 0) {
+        if (errno != ENOENT) {
+            SDL_Log("error getting the size of '%s'", filename);
+        }
+        return 0;
+    }
+    return (file_status.st_size > 0) ? (uint64)file_status.st_size : 0;
 }
 
-bool InitGameMemory(){
-    game_memory.permanent_storage_size = Megabytes(64);
-    game_memory.transient_storage_size = Gigabytes(2);
+// reads the first `size` bytes of the file into memory the caller owns, usually an arena push
+bool32 PlatformReadFileIntoMemory(char *filename, uint64 size, void *memory){
+    SDL_IOStream *file_handle = SDL_IOFromFile(filename, "r");
+    if (!file_handle) {
+        SDL_Log("error getting file handle for '%s'", filename);
+        return false;
+    }
 
-    size_t total_size = game_memory.permanent_storage_size + game_memory.transient_storage_size;
+    size_t bytesRead = SDL_ReadIO(file_handle, memory, (size_t)size);
+    SDL_CloseIO(file_handle);
 
-    void *block = SDL_calloc(1, total_size);
-    if(!block){
-        SDL_LogError(SDL_LOG_CATEGORY_ERROR,
-                     "Failed to allocate %zu bytes for game memory",
-                     total_size);
+    if (bytesRead != (size_t)size) {
+        SDL_Log("Failed to read %llu bytes from '%s'", (unsigned long long)size, filename);
+        return false;
+    }
+    return true;
+}
+/*
+    Saves go to "<filename>.tmp" first, are fsynced, then renamed over the
+    real file. rename is atomic, so after a crash the file holds either the
+    old contents or the new ones, never a mix. The directory is synced too
+    so the rename itself survives a power cut.
+*/
+bool32 PlatformWriteEntireFile(char *filename, uint64 memory_size, void *memory){
+    char temp_filename[PATH_MAX];
+    SDL_snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", filename);
+
+    int fd = open(temp_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        SDL_Log("error opening '%s' for writing", temp_filename);
         return false;
     }
 
-    // split the block
-    game_memory.permanent_storage = block; // start of the game_memory_block
-    game_memory.transient_storage = (uint8 *)block + game_memory.permanent_storage_size;
+    uint8 *bytes = (uint8 *)memory;
+    uint64 bytes_written = 0;
+    while (bytes_written < memory_size) {
+        ssize_t count = write(fd, bytes + bytes_written, (size_t)(memory_size - bytes_written));
+        if (count <= 0) {
+            break;
+        }
+        bytes_written += (uint64)count;
+    }
+
+    bool32 result = (bytes_written == memory_size) && (fsync(fd) == 0);
+    result = (close(fd) == 0) && result;
+    if (result) {
+        result = (rename(temp_filename, filename) == 0);
+    }
+
+    if (!result) {
+        SDL_Log("Failed to write %llu bytes to '%s'", (unsigned long long)memory_size, filename);
+        unlink(temp_filename);
+        return false;
+    }
 
+    // the rename lives in the directory, sync that as well
+    char directory[PATH_MAX];
+    SDL_strlcpy(directory, filename, sizeof(directory));
+    char *last_slash = SDL_strrchr(directory, '/');
+    if (last_slash) {
+        last_slash[last_slash == directory ? 1 : 0] = 0;
+    } else {
+        SDL_strlcpy(directory, ".", sizeof(directory));
+    }
+    int directory_fd = open(directory, O_RDONLY);
+    if (directory_fd >= 0) {
+        fsync(directory_fd);
+        close(directory_fd);
+    }
     return true;
 }
 
+uint64 PlatformGetWallClock(void){
+    return SDL_GetPerformanceCounter();
+}
 
-// --- Called once at startup ---
-SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]){
+// ------------------------------------------------------------
+// Game code loading
+// ------------------------------------------------------------
+/*
+    The game lives in libhandmade.so so "./build.sh game" can rebuild it while
+    prog keeps running. Every frame the platform checks the library's mtime;
+    when it moves, the current copy is closed and the new build loaded between
+    frames. GameMemory is the platform's and is never touched, so the new code
+    picks up exactly where the old one left off.
 
-    char cwd[1000];
-    getcwd(cwd, sizeof(cwd));
-    SDL_Log("Current working directory: %s\n", cwd);
+    dlopen works on a private copy (libhandmade_loaded_N.so) rather than the
+    file the compiler writes, so a rebuild never changes code that is mapped.
+*/
+internal_func GAME_UPDATE_AND_RENDER(GameUpdateAndRenderStub){
+}
 
-    uint32 init_height = 480;
-    uint32 init_width = 640;
-    if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMEPAD | SDL_INIT_AUDIO)) {
-        SDL_Log("Failed to init SDL: %s", SDL_GetError());
-        return SDL_APP_FAILURE;
+internal_func struct timespec GetLastWriteTime(char *filename){
+    struct timespec result = {0};
+    struct stat file_stat;
+    if (stat(filename, &file_stat) == 0) {
+#ifdef __APPLE__
+        result = file_stat.st_mtimespec;
+#else
+        result = file_stat.st_mtim;
+#endif
+    }
+    return result;
+}
+
+internal_func bool CopyEntireFile(char *source, char *dest){
+    SDL_IOStream *in = SDL_IOFromFile(source, "rb");
+    if (!in) {
+        return false;
+    }
+    SDL_IOStream *out = SDL_IOFromFile(dest, "wb");
+    if (!out) {
+        SDL_CloseIO(in);
+        return false;
     }
 
-    // allocate game memory
-    if(!InitGameMemory()){
-        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to allocate game memory");
-        return SDL_APP_FAILURE; 
+    bool result = true;
+    uint8 chunk[Kilobytes(64)];
+    size_t bytes_read = 0;
+    while ((bytes_read = SDL_ReadIO(in, chunk, sizeof(chunk))) > 0) {
+        if (SDL_WriteIO(out, chunk, bytes_read) != bytes_read) {
+            result = false;
+            break;
+        }
     }
-    
-    window = SDL_CreateWindow("Handmade Hero", init_width, init_height, SDL_WINDOW_RESIZABLE);
 
-    // Initialize audio
-    sound_state.frequency = 256.0f;  // A4 note
-    sound_state.amplitude = 0.10f;
-    sound_state.phase = 0.0f;
+    SDL_CloseIO(in);
+    result = SDL_CloseIO(out) && result;
+    return result;
+}
 
-    if (!InitAudio(&audio_system, &sound_state)) {
-        SDL_Log("Audio failed to init");
+internal_func void LoadGameCode(GameCode *game_code){
+    uint64 start = SDL_GetPerformanceCounter();
+
+    game_code->last_write_time = GetLastWriteTime(game_code_path);
+    game_code->library = NULL;
+    game_code->update_and_render = GameUpdateAndRenderStub;
+    game_code->is_valid = false;
+
+    ++game_code->load_count;
+    SDL_snprintf(game_code->loaded_path, sizeof(game_code->loaded_path), "%.*slibhandmade_loaded_%u.so",
+                 (int)(SDL_strlen(game_code_path) - SDL_strlen(GAME_CODE_FILENAME)), game_code_path,
+                 game_code->load_count);
+
+    if (!CopyEntireFile(game_code_path, game_code->loaded_path)) {
+        SDL_Log("Could not copy '%s', game code not loaded", game_code_path);
+        unlink(game_code->loaded_path);
+        return;
     }
 
-    renderer = SDL_CreateRenderer(window, NULL);
-    if (!renderer) {
-        SDL_Log("Failed to create renderer: %s", SDL_GetError());
-        return SDL_APP_FAILURE;
+    game_code->library = dlopen(game_code->loaded_path, RTLD_NOW | RTLD_LOCAL);
+    if (!game_code->library) {
+        SDL_Log("dlopen failed (%s), game code not loaded", dlerror());
+        unlink(game_code->loaded_path);
+        return;
     }
-    
-    ResizeRenderBuffer(&render_buffer, init_width, init_height);
 
-    // Timing setup
-    perf_freq = SDL_GetPerformanceFrequency();
-    perf_start = SDL_GetPerformanceCounter();
-    last_counter = perf_start;
+    GameUpdateAndRenderFunc *update_and_render = (GameUpdateAndRenderFunc *)dlsym(game_code->library, "GameUpdateAndRender");
+    if (!update_and_render) {
+        SDL_Log("GameUpdateAndRender missing from '%s', game code not loaded", game_code_path);
+        UnloadGameCode(game_code);
+        return;
+    }
 
-    SDL_Log("High precision timer freq = %llu Hz", (uint64)perf_freq);
+    game_code->update_and_render = update_and_render;
+    game_code->is_valid = true;
+    SDL_Log("Loaded game code #%u in %.3f ms", game_code->load_count,
+            (double64)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double64)SDL_GetPerformanceFrequency());
+}
 
-    // --- Gamepad initialization ---
-    int count = 0;
-    SDL_JoystickID *ids = SDL_GetGamepads(&count);
-    SDL_Log("Found %d gamepads", count);
+internal_func void UnloadGameCode(GameCode *game_code){
+    if (game_code->library) {
+        dlclose(game_code->library);
+        game_code->library = NULL;
+        unlink(game_code->loaded_path);
+    }
+    game_code->update_and_render = GameUpdateAndRenderStub;
+    game_code->is_valid = false;
+}
 
-    controller = NULL;
-    for (int i = 0; i < count; ++i) {
-        controller = SDL_OpenGamepad(ids[i]);
-        if (controller) {
-            SDL_Log("Gamepad connected: %s", SDL_GetGamepadName(controller));
-            break;
+internal_func bool GameCodeChanged(GameCode *game_code){
+    struct timespec write_time = GetLastWriteTime(game_code_path);
+    return (write_time.tv_sec != game_code->last_write_time.tv_sec) ||
+           (write_time.tv_nsec != game_code->last_write_time.tv_nsec);
+}
+
+// ------------------------------------------------------------
+// Work queue
+// ------------------------------------------------------------
+/*
+    Single producer, multiple consumer ring of work entries.
+
+    The main thread writes an entry, publishes it by bumping next_entry_to_write
+    and signals the semaphore. Workers claim the entry at next_entry_to_read with
+    a compare and swap, so each entry runs exactly once. PlatformCompleteAllWork
+    has the main thread pull entries too until completion_count reaches the goal.
+*/
+internal_func bool DoNextWorkQueueEntry(PlatformWorkQueue *queue){
+    bool should_sleep = false;
+
+    int original_next_to_read = SDL_GetAtomicInt(&queue->next_entry_to_read);
+    int new_next_to_read = (original_next_to_read + 1) % WORK_QUEUE_SIZE;
+
+    if (original_next_to_read != SDL_GetAtomicInt(&queue->next_entry_to_write)) {
+        // copy before claiming, once next_entry_to_read moves on the producer may reuse the slot
+        PlatformWorkQueueEntry entry = queue->entries[original_next_to_read];
+        if (SDL_CompareAndSwapAtomicInt(&queue->next_entry_to_read, original_next_to_read, new_next_to_read)) {
+            entry.callback(queue, entry.data);
+            SDL_AddAtomicInt(&queue->completion_count, 1);
         }
+    } else {
+        should_sleep = true;
     }
 
-    SDL_free(ids);
+    return should_sleep;
+}
+
+void PlatformAddWorkEntry(PlatformWorkQueue *queue, PlatformWorkQueueCallback *callback, void *data){
+    int next_to_write = SDL_GetAtomicInt(&queue->next_entry_to_write);
+    int new_next_to_write = (next_to_write + 1) % WORK_QUEUE_SIZE;
 
-    if (!controller) {
-        SDL_Log("No gamepad connected.");
+    // ring is full, help drain it instead of overwriting an entry nobody has claimed
+    while (new_next_to_write == SDL_GetAtomicInt(&queue->next_entry_to_read)) {
+        DoNextWorkQueueEntry(queue);
     }
 
-    // stick defaults
-    input.start_x = 0.0f;
-    input.start_y = 0.0f;
-    input.end_x = 0.0f;
-    input.end_y = 0.0f;
+    PlatformWorkQueueEntry *entry = queue->entries + next_to_write;
+    entry->callback = callback;
+    entry->data = data;
+    SDL_AddAtomicInt(&queue->completion_goal, 1);
 
-    input.min_x = input.min_y = 9999.0f;
-    input.max_x = input.max_y = -9999.0f;
-    
-    SDL_Log("SDL initialized and window created");
-    return SDL_APP_CONTINUE;
+    // the entry has to be visible before the index that publishes it
+    SDL_MemoryBarrierRelease();
+    SDL_SetAtomicInt(&queue->next_entry_to_write, new_next_to_write);
+    SDL_SignalSemaphore(queue->semaphore);
 }
 
-// --- Called every time there’s an event (key press, mouse, etc.) ---
-SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event)
-{
-    switch(event->type){
-        case SDL_EVENT_MOUSE_MOTION:{
+void PlatformCompleteAllWork(PlatformWorkQueue *queue){
+    while (SDL_GetAtomicInt(&queue->completion_goal) != SDL_GetAtomicInt(&queue->completion_count)) {
+        DoNextWorkQueueEntry(queue);
+    }
 
-        }
-        break;
-        case SDL_EVENT_WINDOW_CLOSE_REQUESTED:{  // macOS close button
-            app_is_quitting = true;
-            SDL_Log("Window close requested -> exiting.");
-            return SDL_APP_SUCCESS;
-        }
-        break;
+    SDL_SetAtomicInt(&queue->completion_goal, 0);
+    SDL_SetAtomicInt(&queue->completion_count, 0);
+}
 
-        case SDL_EVENT_QUIT:{
-            app_is_quitting = true;
-            SDL_Log("SDL_EVENT_QUIT -> exiting.");
-            return SDL_APP_SUCCESS;
-        }
-        break;
-        case SDL_EVENT_WINDOW_RESIZED:{
-            uint32 width = event->window.data1;
-            uint32 height = event->window.data2;
-            ResizeRenderBuffer(&render_buffer, width, height);
+internal_func int WorkerThreadProc(void *data){
+    PlatformWorkQueue *queue = (PlatformWorkQueue *)data;
+    NameDebugThread(queue->thread_name);
+
+    while (!SDL_GetAtomicInt(&queue->quitting)) {
+        if (DoNextWorkQueueEntry(queue)) {
+            SDL_WaitSemaphore(queue->semaphore);
         }
-        break;
-        case SDL_EVENT_KEY_DOWN:
-        case SDL_EVENT_KEY_UP:
-            ProcessKeyboardEvent(&event->key);
-        break;
-        case SDL_EVENT_GAMEPAD_BUTTON_DOWN:
-        case SDL_EVENT_GAMEPAD_BUTTON_UP:
-            ProcessControllerButton(&event->gbutton);
-        break;
-        case SDL_EVENT_GAMEPAD_AXIS_MOTION:
-            ProcessControllerAxis(&event->gaxis);
-        break;
-        default:{
+    }
+    return 0;
+}
+
+internal_func bool InitWorkQueue(PlatformWorkQueue *queue, uint32 worker_count, char *thread_name){
+    if (worker_count > MAX_WORKER_THREADS) {
+        worker_count = MAX_WORKER_THREADS;
+    }
+
+    queue->semaphore = SDL_CreateSemaphore(0);
+    if (!queue->semaphore) {
+        SDL_Log("Failed to create work queue semaphore: %s", SDL_GetError());
+        return false;
+    }
+
+    queue->thread_count = 0;
+    queue->thread_name = thread_name;
+    for (uint32 i = 0; i < worker_count; ++i) {
+        SDL_Thread *thread = SDL_CreateThread(WorkerThreadProc, thread_name, queue);
+        if (!thread) {
+            SDL_Log("Failed to create %s thread: %s", thread_name, SDL_GetError());
             break;
         }
+        queue->threads[queue->thread_count++] = thread;
+    }
+
+    SDL_Log("Work queue: %u %s threads", queue->thread_count, thread_name);
+    return true;
+}
+
+internal_func void DestroyWorkQueue(PlatformWorkQueue *queue){
+    if (!queue->semaphore) {
+        return;
+    }
+
+    SDL_SetAtomicInt(&queue->quitting, 1);
+    for (uint32 i = 0; i < queue->thread_count; ++i) {
+        SDL_SignalSemaphore(queue->semaphore);
+    }
+    for (uint32 i = 0; i < queue->thread_count; ++i) {
+        SDL_WaitThread(queue->threads[i], NULL);
+        queue->threads[i] = NULL;
+    }
+    queue->thread_count = 0;
+
+    SDL_DestroySemaphore(queue->semaphore);
+    queue->semaphore = NULL;
+}
+
+// ------------------------------------------------------------
+// Async file reads
+// ------------------------------------------------------------
+/*
+    PlatformBeginAsyncRead fills a slot and hands it to io_queue, whose
+    threads open the file and pread straight into the caller's buffer. The
+    render queue's threads never block on the disk, and the main thread
+    only ever polls, unless it asks to wait. PlatformBeginAsyncWrite takes
+    a slot the same way and runs PlatformWriteEntireFile on the I/O thread,
+    fsyncs and all, so its handle goes through the same calls.
+
+    A handle is the slot index + 1 in the low bits and the slot's generation
+    above them. Ending a read bumps the generation, so a handle the game kept
+    around (in a loop edit snapshot, say) reads as AsyncRead_Invalid instead
+    of picking up whatever read reused the slot. Taking or restoring a
+    snapshot waits for everything in flight and ends every handle first, so
+    no I/O thread writes into storage mid copy and no slot is left behind
+    by a handle the restored game never heard of.
+*/
+internal_func AsyncReadSlot *GetAsyncReadSlot(PlatformAsyncRead handle){
+    uint32 index = (handle & ((1u << ASYNC_READ_INDEX_BITS) - 1)) - 1;
+    if (handle == 0 || index >= MAX_ASYNC_READS) {
+        return NULL;
+    }
+
+    AsyncReadSlot *slot = async_reads + index;
+    if (!slot->in_use || (slot->generation != (handle >> ASYNC_READ_INDEX_BITS))) {
+        return NULL;
+    }
+    return slot;
+}
+
+internal_func void DoAsyncReadWork(PlatformWorkQueue *queue, void *data){
+    TIMED_FUNCTION();
+    AsyncReadSlot *slot = (AsyncReadSlot *)data;
+    uint64 start = SDL_GetPerformanceCounter();
+
+    uint64 bytes_read = 0;
+    if (slot->is_write) {
+        // it logs its own failures
+        if (PlatformWriteEntireFile(slot->filename, slot->size, slot->dest)) {
+            bytes_read = slot->size;
+        }
+    } else {
+        int fd = open(slot->filename, O_RDONLY);
+        if (fd >= 0) {
+            // pread can return short, keep going until the whole range is in or the file ends
+            while (bytes_read < slot->size) {
+                ssize_t count = pread(fd, (uint8 *)slot->dest + bytes_read, (size_t)(slot->size - bytes_read),
+                                      (off_t)(slot->offset + bytes_read));
+                if (count <= 0) {
+                    break;
+                }
+                bytes_read += (uint64)count;
+            }
+            close(fd);
+        }
+    }
+
+    bool32 succeeded = (bytes_read == slot->size);
+    if (!succeeded && !slot->is_write) {
+        SDL_Log("Async read of '%s' got %llu of %llu bytes", slot->filename,
+                (unsigned long long)bytes_read, (unsigned long long)slot->size);
+    }
+    if (slot->callback) {
+        slot->callback(slot->dest, bytes_read, succeeded, slot->data);
+    }
+    slot->bytes_read = bytes_read;
+    slot->io_ticks = SDL_GetPerformanceCounter() - start;
+
+    SDL_LockMutex(async_read_lock);
+    SDL_SetAtomicInt(&slot->state, succeeded ? AsyncRead_Done : AsyncRead_Failed);
+    SDL_BroadcastCondition(async_read_finished);
+    SDL_UnlockMutex(async_read_lock);
+}
+
+internal_func PlatformAsyncRead BeginAsyncFileWork(char *filename, uint64 offset, uint64 size, void *dest,
+                                                   PlatformAsyncReadCallback *callback, void *data, bool is_write){
+    if (!io_queue.semaphore || SDL_strlen(filename) >= PATH_MAX) {
+        return 0;
+    }
+
+    for (uint32 index = 0; index < MAX_ASYNC_READS; ++index) {
+        AsyncReadSlot *slot = async_reads + index;
+        if (slot->in_use) {
+            continue;
+        }
+
+        slot->in_use = true;
+        slot->generation = (slot->generation + 1) & ((1u << (32 - ASYNC_READ_INDEX_BITS)) - 1);
+        if (slot->generation == 0) {
+            slot->generation = 1;
+        }
+        slot->is_write = is_write;
+        SDL_strlcpy(slot->filename, filename, sizeof(slot->filename));
+        slot->offset = offset;
+        slot->size = size;
+        slot->dest = dest;
+        slot->callback = callback;
+        slot->data = data;
+        slot->bytes_read = 0;
+        slot->io_ticks = 0;
+        SDL_SetAtomicInt(&slot->state, AsyncRead_Pending);
+        if (is_write) {
+            // set aside before the I/O thread can replace it, and only once a slot means it will be
+            NoteReplayWrite(&replay, filename);
+        }
+
+        PlatformAddWorkEntry(&io_queue, DoAsyncReadWork, slot);
+        return (slot->generation << ASYNC_READ_INDEX_BITS) | (index + 1);
+    }
+
+    SDL_Log("All %u async reads are in flight, '%s' was not queued", MAX_ASYNC_READS, filename);
+    return 0;
+}
+
+PlatformAsyncRead PlatformBeginAsyncRead(char *filename, uint64 offset, uint64 size, void *dest,
+                                         PlatformAsyncReadCallback *callback, void *data){
+    return BeginAsyncFileWork(filename, offset, size, dest, callback, data, false);
+}
+
+PlatformAsyncRead PlatformBeginAsyncWrite(char *filename, uint64 size, void *source,
+                                          PlatformAsyncReadCallback *callback, void *data){
+    return BeginAsyncFileWork(filename, 0, size, source, callback, data, true);
+}
+
+uint32 PlatformGetAsyncReadState(PlatformAsyncRead handle){
+    AsyncReadSlot *slot = GetAsyncReadSlot(handle);
+    return slot ? (uint32)SDL_GetAtomicInt(&slot->state) : AsyncRead_Invalid;
+}
+
+uint32 PlatformWaitForAsyncRead(PlatformAsyncRead handle){
+    AsyncReadSlot *slot = GetAsyncReadSlot(handle);
+    if (!slot) {
+        return AsyncRead_Invalid;
+    }
+
+    SDL_LockMutex(async_read_lock);
+    while (SDL_GetAtomicInt(&slot->state) == AsyncRead_Pending) {
+        SDL_WaitCondition(async_read_finished, async_read_lock);
+    }
+    SDL_UnlockMutex(async_read_lock);
+    return (uint32)SDL_GetAtomicInt(&slot->state);
+}
+
+void PlatformEndAsyncRead(PlatformAsyncRead handle){
+    AsyncReadSlot *slot = GetAsyncReadSlot(handle);
+    if (!slot) {
+        return;
+    }
+
+    // the I/O thread still writes into dest until the read finishes
+    PlatformWaitForAsyncRead(handle);
+    slot->in_use = false;
+    ++slot->generation;
+}
+
+// the chunk files the bench's world wrote and their temp files, then the directory, only ever the one
+// the bench made for itself
+internal_func void RemoveWorldBenchDirectory(char *path){
+    DIR *directory = opendir(path);
+    if (!directory) {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL) {
+        if (SDL_strstr(entry->d_name, ".hmc")) {
+            char filename[PATH_MAX];
+            SDL_snprintf(filename, sizeof(filename), "%s/%s", path, entry->d_name);
+            unlink(filename);
+        }
+    }
+    closedir(directory);
+    rmdir(path);
+}
+
+internal_func bool InitAsyncReads(){
+    async_read_lock = SDL_CreateMutex();
+    async_read_finished = SDL_CreateCondition();
+    if (!async_read_lock || !async_read_finished) {
+        SDL_Log("Failed to create async read lock: %s", SDL_GetError());
+        return false;
+    }
+
+    // reads spend their time blocked in the kernel, a couple of threads keep the disk busy
+    if (io_thread_count == 0) {
+        io_thread_count = 1;
+    }
+    return InitWorkQueue(&io_queue, io_thread_count, "io");
+}
+
+// callbacks may point into the game library, so this runs before it is unloaded
+internal_func void WaitForAllAsyncReads(){
+    if (!async_read_lock) {
+        return;
+    }
+
+    SDL_LockMutex(async_read_lock);
+    for (uint32 index = 0; index < MAX_ASYNC_READS; ++index) {
+        AsyncReadSlot *slot = async_reads + index;
+        while (slot->in_use && SDL_GetAtomicInt(&slot->state) == AsyncRead_Pending) {
+            SDL_WaitCondition(async_read_finished, async_read_lock);
+        }
+    }
+    SDL_UnlockMutex(async_read_lock);
+}
+
+// loop edits copy permanent storage in or out wholesale, so nothing may still be landing in it and no
+// handle the game holds may outlive the copy, every one reads as AsyncRead_Invalid and the game reissues it
+internal_func void EndAllAsyncReads(){
+    WaitForAllAsyncReads();
+    for (uint32 index = 0; index < MAX_ASYNC_READS; ++index) {
+        AsyncReadSlot *slot = async_reads + index;
+        if (slot->in_use) {
+            slot->in_use = false;
+            ++slot->generation;
+        }
+    }
+}
+
+internal_func void DestroyAsyncReads(){
+    WaitForAllAsyncReads();
+    DestroyWorkQueue(&io_queue);
+
+    if (async_read_finished) {
+        SDL_DestroyCondition(async_read_finished);
+        async_read_finished = NULL;
+    }
+    if (async_read_lock) {
+        SDL_DestroyMutex(async_read_lock);
+        async_read_lock = NULL;
+    }
+}
+
+// ------------------------------------------------------------
+// Game memory
+// ------------------------------------------------------------
+/*
+    The whole block is reserved PROT_NONE up front, which costs address space
+    but no memory and no commit charge, so strict overcommit systems are happy.
+    The game commits it front to back through PlatformCommitMemory as it needs
+    more, and the kernel still only backs pages once they are touched.
+*/
+internal_func void *ReserveMemory(uint64 base_address, uint64 size){
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    void *block = MAP_FAILED;
+
+    if (base_address) {
+#ifdef MAP_FIXED_NOREPLACE
+        block = mmap((void *)base_address, size, PROT_NONE, flags | MAP_FIXED_NOREPLACE, -1, 0);
+#else
+        block = mmap((void *)base_address, size, PROT_NONE, flags, -1, 0);
+#endif
+        // without MAP_FIXED_NOREPLACE the address is only a hint, anywhere else is no good
+        if (block != MAP_FAILED && block != (void *)base_address) {
+            munmap(block, size);
+            block = MAP_FAILED;
+        }
+        if (block == MAP_FAILED) {
+            SDL_Log("Could not reserve game memory at 0x%llx, letting the OS pick", (unsigned long long)base_address);
+        }
+    }
+
+    if (block == MAP_FAILED) {
+        // over-reserve so the block can start on a commit (and huge page) boundary
+        uint64 align = MEMORY_COMMIT_GRANULARITY;
+        uint8 *raw = (uint8 *)mmap(NULL, size + align, PROT_NONE, flags, -1, 0);
+        if (raw == MAP_FAILED) {
+            return NULL;
+        }
+
+        uint8 *aligned = (uint8 *)(((uintptr_t)raw + align - 1) & ~(uintptr_t)(align - 1));
+        uint8 *raw_end = raw + size + align;
+        if (aligned > raw) {
+            munmap(raw, aligned - raw);
+        }
+        if (raw_end > aligned + size) {
+            munmap(aligned + size, raw_end - (aligned + size));
+        }
+        block = aligned;
+    }
+
+    return block;
+}
+
+bool32 PlatformCommitMemory(void *address, uint64 size){
+    if (memory_mode == MemoryMode_Calloc) {
+        return true;
+    }
+
+    // fresh anonymous pages read as zero, so committed storage starts out cleared
+    if (mprotect(address, size, PROT_READ | PROT_WRITE) != 0) {
+        SDL_Log("Failed to commit %llu bytes of game memory at %p", (unsigned long long)size, address);
+        return false;
+    }
+    return true;
+}
+
+internal_func bool InitGameMemory(){
+    game_memory.permanent_storage_size = Megabytes(64);
+    game_memory.transient_storage_size = Gigabytes(2);
+
+    size_t total_size = game_memory.permanent_storage_size + game_memory.transient_storage_size;
+    uint64 start = SDL_GetPerformanceCounter();
+
+    void *block = NULL;
+    if (memory_mode == MemoryMode_Calloc) {
+        block = SDL_calloc(1, total_size);
+        game_memory.permanent_storage_committed = game_memory.permanent_storage_size;
+        game_memory.transient_storage_committed = game_memory.transient_storage_size;
+    } else {
+        block = ReserveMemory(memory_base_address, total_size);
+        game_memory.permanent_storage_committed = 0;
+        game_memory.transient_storage_committed = 0;
+    }
+
+    if(!block){
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR,
+                     "Failed to allocate %zu bytes for game memory",
+                     total_size);
+        return false;
+    }
+
+    // split the block
+    game_memory.permanent_storage = block; // start of the game_memory_block
+    game_memory.transient_storage = (uint8 *)block + game_memory.permanent_storage_size;
+
+    if (use_huge_pages) {
+#ifdef MADV_HUGEPAGE
+        // transparent huge pages, the permanent store starts on a 2MB boundary and commits in 2MB steps
+        if (madvise(game_memory.permanent_storage, game_memory.permanent_storage_size, MADV_HUGEPAGE) != 0) {
+            SDL_Log("madvise(MADV_HUGEPAGE) failed, permanent storage stays on normal pages");
+        }
+#else
+        SDL_Log("Huge pages are not supported on this platform");
+#endif
+    }
+
+    double64 init_ms = (double64)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double64)SDL_GetPerformanceFrequency();
+    SDL_Log("Game memory: %s, %zu MB at %p, %.3f ms", memory_mode_names[memory_mode],
+            total_size / Megabytes(1), block, init_ms);
+    return true;
+}
+
+internal_func void FreeGameMemory(){
+    if (!game_memory.permanent_storage) {
+        return;
+    }
+
+    if (memory_mode == MemoryMode_Calloc) {
+        SDL_free(game_memory.permanent_storage);    // start of memory block
+    } else {
+        munmap(game_memory.permanent_storage, game_memory.permanent_storage_size + game_memory.transient_storage_size);
+    }
+    game_memory.permanent_storage = NULL;
+    game_memory.transient_storage = NULL;
+}
+
+internal_func uint64 GetResidentBytes(){
+    long total_pages = 0;
+    long resident_pages = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        int matched = fscanf(statm, "%ld %ld", &total_pages, &resident_pages);
+        fclose(statm);
+        if (matched == 2) {
+            return (uint64)resident_pages * (uint64)sysconf(_SC_PAGESIZE);
+        }
+    }
+
+    // no procfs (macOS), peak resident size is the best we get
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return (uint64)usage.ru_maxrss;
+#else
+    return (uint64)usage.ru_maxrss * 1024;
+#endif
+}
+
+internal_func void LogMemoryUsage(char *when){
+    uint64 committed = game_memory.permanent_storage_committed + game_memory.transient_storage_committed;
+    SDL_Log("Memory %s: resident %.1f MB, game memory committed %.1f MB", when,
+            (double64)GetResidentBytes() / (double64)Megabytes(1), (double64)committed / (double64)Megabytes(1));
+}
+
+
+// --- Called once at startup ---
+SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]){
+    uint64 init_start = SDL_GetPerformanceCounter();
+
+    char cwd[1000];
+    getcwd(cwd, sizeof(cwd));
+    SDL_Log("Current working directory: %s\n", cwd);
+
+    uint32 init_height = 480;
+    uint32 init_width = 640;
+
+    ParseCommandLine(argc, argv);
+    render_path = ResolveRenderPath(render_path);
+    game_memory.debug_entity_path = render_path;
+    InitProfiler();
+    InitLogger();
+
+    // the main thread works the render queue too, so it counts as one of the threads
+    uint32 render_threads = render_thread_count ? render_thread_count : (uint32)SDL_GetNumLogicalCPUCores();
+    // without a queue the renderer draws everything on the main thread
+    if (InitWorkQueue(&render_queue, render_threads - 1, "render")) {
+        game_memory.render_queue = &render_queue;
+    }
+
+    if (io_bench_enabled) {
+        RunFileBenchmark();
+        return SDL_APP_SUCCESS;
+    }
+    if (input_test_enabled) {
+        return RunInputTest() ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+    }
+    if (replay_commands_path) {
+        RunRenderReplay(replay_commands_path);
+        return SDL_APP_SUCCESS;
+    }
+    if (bench.enabled) {
+        // no display or sound card on the CI boxes, env vars still take priority over these
+        SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "dummy");
+        SDL_SetHint(SDL_HINT_AUDIO_DRIVER, "dummy");
+        init_width = bench.width;
+        init_height = bench.height;
+    }
+    if (audio_mode == AudioMode_Callback) {
+        // 10 ms device buffers, so the callback asks for small blocks and the ring can stay short
+        SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, "480");
+    }
+
+    if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMEPAD | SDL_INIT_AUDIO)) {
+        SDL_Log("Failed to init SDL: %s", SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+
+    // allocate game memory
+    if(!InitGameMemory()){
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to allocate game memory");
+        return SDL_APP_FAILURE; 
+    }
+
+    if (bench.enabled && !InitBench(&bench)) {
+        return SDL_APP_FAILURE;
+    }
+
+    const char *base_path = SDL_GetBasePath();
+    SDL_snprintf(game_code_path, sizeof(game_code_path), "%s%s", base_path ? base_path : "", GAME_CODE_FILENAME);
+    LoadGameCode(&game_code);
+    SDL_snprintf(asset_pack_path, sizeof(asset_pack_path), "%s%s", base_path ? base_path : "", ASSET_PACK_FILENAME);
+    game_memory.asset_pack_path = asset_pack_path;
+
+    // without I/O threads PlatformBeginAsyncRead returns 0 and the game treats the load as failed
+    InitAsyncReads();
+    if (bench.enabled && async_load.filename && !StartAsyncLoadBench(&async_load)) {
+        return SDL_APP_FAILURE;
+    }
+
+    // a bench starts from an empty world of its own and never writes over the saved one, outside a
+    // bench (or with --world-dir) the chunks stay, so the world keeps its changes from one run to the next
+    if (game_memory.debug_world_radius && bench.enabled && !game_memory.world_path) {
+        SDL_strlcpy(world_bench_path, WORLD_BENCH_TEMPLATE, sizeof(world_bench_path));
+        if (mkdtemp(world_bench_path)) {
+            game_memory.world_path = world_bench_path;
+        } else {
+            SDL_Log("Failed to create a directory for the world bench, running without the world");
+            world_bench_path[0] = 0;
+            game_memory.debug_world_radius = 0;
+        }
+    }
+    if (game_memory.debug_world_radius && !world_bench_path[0]) {
+        if (!game_memory.world_path) {
+            game_memory.world_path = WORLD_DEFAULT_PATH;
+        }
+        if (mkdir(game_memory.world_path, 0755) != 0 && errno != EEXIST) {
+            SDL_Log("Failed to create world directory '%s'", game_memory.world_path);
+        }
+    }
+
+    if (!bench.enabled) {
+        InitReplay(&replay);
+    }
+    
+    window = SDL_CreateWindow("Handmade Hero", init_width, init_height, SDL_WINDOW_RESIZABLE);
+
+    // Initialize audio
+    if (!InitAudio(&audio_system)) {
+        SDL_Log("Audio failed to init");
+    }
+
+    renderer = SDL_CreateRenderer(window, NULL);
+    if (!renderer) {
+        SDL_Log("Failed to create renderer: %s", SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+    
+    resolution.window_width = init_width;
+    resolution.window_height = init_height;
+    resolution.dynamic = (dynamic_res_option >= 0) ? (dynamic_res_option != 0) : !bench.enabled;
+    if (!resolution.steps) {
+        resolution.steps = RESOLUTION_SCALE_STEPS;
+    }
+    resolution.min_steps = resolution.steps;
+    // the first frames load assets and fault in memory, they say nothing about the steady state
+    resolution.settle_frames = RESOLUTION_SETTLE_FRAMES;
+    ApplyRenderResolution();
+
+    // Timing setup
+    perf_freq = SDL_GetPerformanceFrequency();
+    perf_start = SDL_GetPerformanceCounter();
+    InitScheduler(&scheduler);
+
+    SDL_Log("High precision timer freq = %llu Hz", (uint64)perf_freq);
+
+    // --- Gamepad initialization ---
+    // SDL also sends an added event for each of these, OpenGamepad skips the ones already in a slot
+    int count = 0;
+    SDL_JoystickID *ids = SDL_GetGamepads(&count);
+    SDL_Log("Found %d gamepads", count);
+
+    uint64 input_start = SDL_GetTicksNS();
+    ConnectControllers(&input, input_start);
+    for (int i = 0; i < count; ++i) {
+        OpenGamepad(&input, ids[i], input_start);
+    }
+
+    SDL_free(ids);
+    
+    startup_ticks = SDL_GetPerformanceCounter() - init_start;
+    SDL_Log("Startup took %.3f ms", (double64)startup_ticks * 1000.0 / (double64)perf_freq);
+    LogMemoryUsage("after startup");
+
+    SDL_Log("SDL initialized and window created");
+    return SDL_APP_CONTINUE;
+}
+
+// --- Called every time there’s an event (key press, mouse, etc.) ---
+SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event)
+{
+    switch(event->type){
+        case SDL_EVENT_MOUSE_MOTION:{
+
+        }
+        break;
+        case SDL_EVENT_WINDOW_CLOSE_REQUESTED:{  // macOS close button
+            app_is_quitting = true;
+            SDL_Log("Window close requested -> exiting.");
+            return SDL_APP_SUCCESS;
+        }
+        break;
+
+        case SDL_EVENT_QUIT:{
+            app_is_quitting = true;
+            SDL_Log("SDL_EVENT_QUIT -> exiting.");
+            return SDL_APP_SUCCESS;
+        }
+        break;
+        case SDL_EVENT_WINDOW_RESIZED:{
+            resolution.window_width = (uint32)event->window.data1;
+            resolution.window_height = (uint32)event->window.data2;
+            // a drag sends one of these per mouse move, the texture waits until they stop
+            window_settle_deadline = SDL_GetTicks() + WINDOW_SETTLE_MS;
+            ApplyRenderResolution();
+        }
+        break;
+        case SDL_EVENT_KEY_DOWN:
+        case SDL_EVENT_KEY_UP:
+        case SDL_EVENT_GAMEPAD_BUTTON_DOWN:
+        case SDL_EVENT_GAMEPAD_BUTTON_UP:
+        case SDL_EVENT_GAMEPAD_AXIS_MOTION:
+        case SDL_EVENT_GAMEPAD_ADDED:
+        case SDL_EVENT_GAMEPAD_REMOVED:
+            ProcessInputEvent(&input, event);
+        break;
+        default:{
+            break;
+        }
+    }
+    return SDL_APP_CONTINUE;
+}
+
+// --- Called once per frame (your main loop logic goes here) ---
+SDL_AppResult SDL_AppIterate(void *appstate){
+
+    // If a quit was requested, return success immediately — do not run any frame work.
+    if (app_is_quitting) {
+        // Log once if you want:
+        SDL_Log("App iterate: quitting flag set, exiting iterate.");
+        return SDL_APP_SUCCESS;
+    }
+
+    // everything since the last call is one frame for the profiler
+    EndDebugFrame();
+
+    if (bench.enabled && bench.resize_drag) {
+        DragBenchWindow(appstate);
+    }
+    // the window has stopped changing size, the texture can grow to what it needs now
+    if (window_settle_deadline && SDL_GetTicks() >= window_settle_deadline) {
+        window_settle_deadline = 0;
+        ApplyRenderResolution();
+    }
+
+    // timing, the scheduler decides how many fixed steps the game simulates this frame
+    uint64 now = SDL_GetPerformanceCounter();
+    t_total = (double64)(now - perf_start) / (double64)perf_freq;
+    BeginSchedulerFrame(&scheduler, now, &input);
+    input.timestamp = SDL_GetTicksNS();
+
+    // Exit automatically after 5 seconds
+    if (!bench.enabled && t_total > 100) {
+        SDL_Log("Timeout reached, exiting...");
+        return SDL_APP_SUCCESS;
+    }
+
+    // the callback drains the ring in small blocks, the game mixes just enough to get back to the target latency
+    if (audio_mode == AudioMode_Callback) {
+        audio_system.frames_to_write = audio_ring.samples ?
+            UpdateAudioLatency(&audio_latency, &audio_ring, audio_system.frames_per_buffer) : 0;
+        soundBufferNeedsFilling = (audio_system.frames_to_write > 0);
+    } else {
+        uint32 queued_bytes = SDL_GetAudioStreamAvailable(audio_stream);
+        uint32 target_bytes = (uint32)(audio_system.buffer_size * 3);  // keep ~0.6s buffered
+        audio_system.frames_to_write = audio_system.frames_per_buffer;
+        soundBufferNeedsFilling = (queued_bytes < target_bytes);
+    }
+
+    if (bench.enabled) {
+        // one 60 Hz step a frame so runs are comparable, queue mode also mixes a whole buffer every frame
+        input.update_count = 1;
+        input.update_hz = 60;
+        input.interpolation = 0.0f;
+        if (audio_mode == AudioMode_Queue) {
+            soundBufferNeedsFilling = true;
+        }
+    }
+
+    // in lock mode the game draws into texture memory, pitch is whatever the texture uses,
+    // unless a software upscale stretches the game's frame into it
+    RenderBuffer frame_buffer = render_buffer;
+    RenderBuffer upscale_target = upscale_buffer;
+    bool upscaling = (upscale_buffer.pixels != NULL);
+    RenderBuffer *present_buffer = upscaling ? &upscale_target : &frame_buffer;
+    bool texture_locked = false;
+    if (present_mode == PresentMode_Lock && texture) {
+        void *texture_pixels = NULL;
+        int texture_pitch = 0;
+        SDL_Rect lock_rect = {0, 0, (int)present_width, (int)present_height};
+        if (SDL_LockTexture(texture, &lock_rect, &texture_pixels, &texture_pitch)) {
+            present_buffer->pixels = texture_pixels;
+            present_buffer->pitch = (uint32)texture_pitch;
+            // locked memory is write only, last frame's pixels are not in it
+            present_buffer->tile_hashes = NULL;
+            texture_locked = true;
+        } else {
+            PlatformLog(LogLevel_Warning, "SDL_LockTexture failed (%s), falling back to copy present", SDL_GetError());
+            present_mode = PresentMode_Copy;
+        }
+    }
+
+    // recorded input is what the game saw, events and all
+    if (replay.recording) {
+        RecordInput(&replay, &input);
+    }
+    if (replay.playing) {
+        PlaybackInput(&replay, &input);
+    }
+
+    // the last frame finished all its queued work, so nothing still runs inside the old library
+    // a build that fails to load leaves the previous one running
+    if (GameCodeChanged(&game_code)) {
+        WaitForAllAsyncReads();
+        ForgetDebugNames();
+        FlushLog();
+        GameCode new_code = game_code;
+        LoadGameCode(&new_code);
+        if (new_code.is_valid || !game_code.is_valid) {
+            UnloadGameCode(&game_code);
+            game_code = new_code;
+        } else {
+            game_code.last_write_time = new_code.last_write_time;
+            game_code.load_count = new_code.load_count;
+        }
+    }
+
+    if (async_load.buffer) {
+        UpdateAsyncLoadBench(&async_load);
+    }
+
+    SDL_memset(game_memory.debug_timers, 0, sizeof(game_memory.debug_timers));
+    game_memory.debug_entity_checksum_wanted = bench.enabled && (bench.frames_run + 1 == bench.frame_count);
+    game_memory.debug_world_checksum_wanted = game_memory.debug_entity_checksum_wanted;
+    game_code.update_and_render(&game_memory, &frame_buffer, &audio_system, soundBufferNeedsFilling, &input);
+
+    // a stub frame pushes nothing, the last frame's commands are still in transient storage and draw again
+    if (game_memory.render_commands && frame_buffer.pixels) {
+        RenderFrame(game_memory.render_commands, &frame_buffer);
+    }
+    if (upscaling && frame_buffer.pixels) {
+        UpscaleToWindow(&frame_buffer, &upscale_target, texture_locked || upscale_redraw_all);
+        upscale_redraw_all = false;
+    }
+
+    if (soundBufferNeedsFilling && audio_system.sound_buffer) {
+        TIMED_BLOCK("UpdateAudio");
+        if (bench.enabled) {
+            bench.mix_frames += audio_system.frames_to_write;
+        }
+        if (audio_mode == AudioMode_Callback) {
+            WriteAudioRing(&audio_ring, audio_system.sound_buffer, audio_system.frames_to_write);
+        } else if (!bench.enabled) {
+            // benchmark frames would queue 200ms of audio each, nothing is listening anyway
+            SDL_PutAudioStreamData(audio_stream, audio_system.sound_buffer, audio_system.buffer_size);
+        }
+    }
+
+    if (bench.enabled && bench.frames_run + 1 == bench.frame_count) {
+        bench.checksum = ChecksumRenderBuffer(&frame_buffer);
+        if (dump_commands_path && game_memory.render_commands) {
+            DumpRenderCommands(game_memory.render_commands, dump_commands_path);
+        }
+    }
+
+    uint64 present_start = SDL_GetPerformanceCounter();
+    if (texture_locked) {
+        TIMED_BLOCK("SDL_UnlockTexture");
+        SDL_UnlockTexture(texture);
+    } else {
+        TIMED_BLOCK("SDL_UpdateTexture");
+        uint32 rectangle_count = 0;
+        uint64 upload_bytes = UploadDirtyRectangles(texture, present_buffer, &rectangle_count);
+        if (bench.enabled) {
+            bench.upload_bytes += upload_bytes;
+            bench.full_upload_bytes += (uint64)present_width * present_height * 4;
+            bench.upload_rectangles += rectangle_count;
+        }
+    }
+    if (bench.enabled) {
+        bench.render_tiles += render_stats.tile_count;
+        bench.skipped_tiles += render_stats.skipped_tiles;
+    }
+    // the frame's buffers were copies, the next frame starts with everything uploaded
+    SDL_memset(render_buffer.dirty_tiles, 0, sizeof(render_buffer.dirty_tiles));
+    SDL_memset(upscale_buffer.dirty_tiles, 0, sizeof(upscale_buffer.dirty_tiles));
+    uint64 work_end = SDL_GetPerformanceCounter();
+    {
+        TIMED_BLOCK("SDL_RenderPresent");
+        SDL_FRect source = {0.0f, 0.0f, (float)present_width, (float)present_height};
+        SDL_RenderTexture(renderer, texture, &source, NULL);
+        SDL_RenderPresent(renderer);
+    }
+    uint64 present_end = SDL_GetPerformanceCounter();
+
+    // the next frame renders at whatever size this one's work time asks for
+    UpdateDynamicResolution(&resolution, work_end - now);
+
+    // the game has seen this frame's events, what arrives from now on is the next frame's
+    BeginInputFrame(&input);
+
+    if (bench.enabled) {
+        RecordBenchFrame(&bench, present_end - present_start, present_end - now);
+        if (bench.frames_run == bench.frame_count) {
+            PrintBenchResults(&bench, &render_buffer);
+            return SDL_APP_SUCCESS;
+        }
+    }
+
+    EndSchedulerFrame(&scheduler);
+    return SDL_APP_CONTINUE;
+}
+
+// --- Called once on shutdown ---
+void SDL_AppQuit(void *appstate, SDL_AppResult result){
+    app_is_quitting = true;
+    SDL_Log("Cleaning up...");
+
+    game_memory.render_queue = NULL;
+    DestroyWorkQueue(&render_queue);
+    FreePixelPool(&render_scratch_pool);
+    EndAsyncLoadBench(&async_load);
+    DestroyAsyncReads();
+    if (world_bench_path[0]) {
+        RemoveWorldBenchDirectory(world_bench_path);
+    }
+    DestroyReplay(&replay);
+    // the trace still names blocks by the game library's literals until they are collected
+    if (profiler.trace_path) {
+        WriteChromeTrace(profiler.trace_path);
+    }
+    ForgetDebugNames();
+    FlushLog();
+    UnloadGameCode(&game_code);
+    if (!bench.enabled) {
+        LogAudioLatency(&audio_latency, &audio_ring);
+        LogFramePacing(&scheduler, &scheduler.total, "whole run");
+        LogResolutionHistory(&resolution);
+    }
+    DestroyAudio(&audio_system);
+
+    if (texture) {
+        SDL_DestroyTexture(texture);
+        texture = NULL;
+    }
+    render_buffer.pixels = NULL;
+    upscale_buffer.pixels = NULL;
+    FreePixelPool(&render_pixel_pool);
+    FreePixelPool(&upscale_pixel_pool);
+    if (renderer) {
+        SDL_DestroyRenderer(renderer);
+        renderer = NULL;
+    }
+    if (window) {
+        SDL_DestroyWindow(window);
+        window = NULL;
+    }
+    CloseGamepads();
+
+    FreeGameMemory();
+
+    if (bench.samples) {
+        SDL_free(bench.samples);
+        bench.samples = NULL;
+    }
+    DestroyProfiler();
+    DestroyLogger();
+}
+
+// ------------------------------------------------------------
+// Input recording and looped playback
+// ------------------------------------------------------------
+/*
+    The state snapshot lives in a file made and mapped MAP_SHARED the first
+    time L is pressed (a run that never records never creates the 64MB
+    file) and kept to the end of the run, so taking or restoring one is a
+    memcpy of the committed part of permanent storage (a few MB, not the
+    full 64MB) into pages that are already mapped.
+    The kernel writes the file back in its own time, nothing on the frame
+    thread waits on disk. Input is appended to its own file every frame and
+    read back in one go when playback starts.
+
+    Files the game writes are part of its state too, an evicted world chunk
+    reads back from its file. So from the first snapshot on, the first
+    async write to each file moves the copy the snapshot knew aside (a
+    rename, on the main thread as the write is queued) and notes the path.
+    Every restore puts those copies back and deletes files the snapshot
+    never had, so each pass of the loop starts from the same disk as well.
+    The next snapshot, or the end of the run, keeps what is there now.
+*/
+internal_func bool InitReplay(ReplayState *replay){
+    replay->enabled = true;
+    replay->snapshot_fd = -1;
+    SDL_Log("Loop editing ready: L to record, P to loop playback");
+    return true;
+}
+
+internal_func bool MapReplaySnapshot(ReplayState *replay){
+    uint64 size = game_memory.permanent_storage_size;
+
+    replay->snapshot_fd = open(REPLAY_STATE_FILENAME, O_RDWR | O_CREAT, 0644);
+    if (replay->snapshot_fd < 0) {
+        SDL_Log("Failed to open '%s', loop editing disabled", REPLAY_STATE_FILENAME);
+        return false;
+    }
+
+    if (ftruncate(replay->snapshot_fd, (off_t)size) != 0) {
+        SDL_Log("Failed to size '%s', loop editing disabled", REPLAY_STATE_FILENAME);
+        close(replay->snapshot_fd);
+        replay->snapshot_fd = -1;
+        return false;
+    }
+
+    void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, replay->snapshot_fd, 0);
+    if (mapping == MAP_FAILED) {
+        SDL_Log("Failed to map '%s', loop editing disabled", REPLAY_STATE_FILENAME);
+        close(replay->snapshot_fd);
+        replay->snapshot_fd = -1;
+        return false;
+    }
+
+    replay->snapshot_memory = (uint8 *)mapping;
+    return true;
+}
+
+internal_func void NoteReplayWrite(ReplayState *replay, char *filename){
+    if (!replay->snapshot_size) {
+        return;
+    }
+    for (uint32 index = 0; index < replay->written_count; ++index) {
+        if (SDL_strcmp(replay->written_files[index].path, filename) == 0) {
+            return;
+        }
+    }
+
+    if (replay->written_count == replay->written_capacity) {
+        uint32 capacity = replay->written_capacity ? replay->written_capacity * 2 : 64;
+        ReplayWrittenFile *files = (ReplayWrittenFile *)SDL_realloc(replay->written_files, capacity * sizeof(ReplayWrittenFile));
+        if (!files) {
+            SDL_Log("Out of memory noting '%s', a loop restart keeps its newer contents", filename);
+            return;
+        }
+        replay->written_files = files;
+        replay->written_capacity = capacity;
+    }
+
+    char backup[PATH_MAX + sizeof(REPLAY_BACKUP_SUFFIX)];
+    SDL_snprintf(backup, sizeof(backup), "%s" REPLAY_BACKUP_SUFFIX, filename);
+    bool existed = (rename(filename, backup) == 0);
+    if (!existed && errno != ENOENT) {
+        SDL_Log("Failed to set '%s' aside, a loop restart keeps its newer contents", filename);
+        return;
+    }
+    char *path = SDL_strdup(filename);
+    if (!path) {
+        if (existed) {
+            rename(backup, filename);
+        }
+        return;
+    }
+    replay->written_files[replay->written_count++] = (ReplayWrittenFile){.path = path, .existed = existed};
+}
+
+// restore puts the snapshot's files back, keep drops the copies set aside, either way nothing is noted after
+internal_func void EndReplayWrites(ReplayState *replay, bool restore){
+    char backup[PATH_MAX + sizeof(REPLAY_BACKUP_SUFFIX)];
+    for (uint32 index = 0; index < replay->written_count; ++index) {
+        ReplayWrittenFile *file = replay->written_files + index;
+        SDL_snprintf(backup, sizeof(backup), "%s" REPLAY_BACKUP_SUFFIX, file->path);
+        if (restore && file->existed) {
+            if (rename(backup, file->path) != 0) {
+                SDL_Log("Failed to put '%s' back as it was", file->path);
+            }
+        } else if (restore) {
+            unlink(file->path);
+        } else if (file->existed) {
+            unlink(backup);
+        }
+        SDL_free(file->path);
+    }
+    replay->written_count = 0;
+}
+
+internal_func void DestroyReplay(ReplayState *replay){
+    if (replay->recording_handle) {
+        SDL_CloseIO(replay->recording_handle);
+        replay->recording_handle = NULL;
+    }
+    if (replay->playback_inputs) {
+        PlatformFreeFileMemory(&replay->playback_file);
+        replay->playback_inputs = NULL;
+    }
+    if (replay->snapshot_memory) {
+        munmap(replay->snapshot_memory, game_memory.permanent_storage_size);
+        close(replay->snapshot_fd);
+        replay->snapshot_memory = NULL;
+        replay->snapshot_fd = -1;
+    }
+    EndReplayWrites(replay, false);
+    SDL_free(replay->written_files);
+    replay->written_files = NULL;
+    replay->written_capacity = 0;
+    replay->snapshot_size = 0;
+    replay->recording = false;
+    replay->playing = false;
+}
+
+internal_func double64 TicksToMs(uint64 ticks){
+    return (double64)ticks * 1000.0 / (double64)SDL_GetPerformanceFrequency();
+}
+
+internal_func void RestoreSnapshot(ReplayState *replay){
+    uint64 start = SDL_GetPerformanceCounter();
+
+    EndAllAsyncReads();
+    EndReplayWrites(replay, true);
+    SDL_memcpy(game_memory.permanent_storage, replay->snapshot_memory, replay->snapshot_size);
+
+    // memory the game committed after the snapshot has to look freshly committed again
+    if (game_memory.permanent_storage_committed > replay->snapshot_size) {
+        SDL_memset(game_memory.permanent_storage + replay->snapshot_size, 0,
+                   game_memory.permanent_storage_committed - replay->snapshot_size);
+    }
+
+    SDL_Log("Loop restart: restored %.1f MB in %.3f ms", (double64)replay->snapshot_size / (double64)Megabytes(1),
+            TicksToMs(SDL_GetPerformanceCounter() - start));
+}
+
+internal_func void BeginRecording(ReplayState *replay){
+    replay->recording_handle = SDL_IOFromFile(REPLAY_INPUT_FILENAME, "wb");
+    if (!replay->recording_handle) {
+        SDL_Log("Failed to open '%s' for recording", REPLAY_INPUT_FILENAME);
+        return;
+    }
+
+    uint64 start = SDL_GetPerformanceCounter();
+    EndAllAsyncReads();
+    EndReplayWrites(replay, false);
+    replay->snapshot_size = game_memory.permanent_storage_committed;
+    SDL_memcpy(replay->snapshot_memory, game_memory.permanent_storage, replay->snapshot_size);
+
+    replay->recording = true;
+    SDL_Log("Recording input, snapshot of %.1f MB took %.3f ms",
+            (double64)replay->snapshot_size / (double64)Megabytes(1), TicksToMs(SDL_GetPerformanceCounter() - start));
+}
+
+internal_func void EndRecording(ReplayState *replay){
+    SDL_CloseIO(replay->recording_handle);
+    replay->recording_handle = NULL;
+    replay->recording = false;
+    SDL_Log("Recording stopped");
+}
+
+internal_func void BeginPlayback(ReplayState *replay){
+    uint64 file_size = PlatformGetFileSize(REPLAY_INPUT_FILENAME);
+    uint32 count = (uint32)(file_size / sizeof(GameInputState));
+    if (count == 0) {
+        SDL_Log("Nothing recorded yet, press L to record");
+        return;
+    }
+
+    // mapped once when playback starts, the loop itself only moves an index
+    replay->playback_file = PlatformReadEntireFile(REPLAY_INPUT_FILENAME, PlatformFile_Map);
+    replay->playback_inputs = (GameInputState *)replay->playback_file.contents;
+    if (!replay->playback_inputs) {
+        return;
+    }
+    replay->playback_count = count;
+    replay->playback_index = 0;
+    replay->playing = true;
+
+    RestoreSnapshot(replay);
+    SDL_Log("Looping %u recorded frames", count);
+}
+
+internal_func void EndPlayback(ReplayState *replay){
+    PlatformFreeFileMemory(&replay->playback_file);
+    replay->playback_inputs = NULL;
+    replay->playing = false;
+
+    // hand control back with nothing held down, the game hears that from the connect events
+    SDL_memset(&input, 0, sizeof(input));
+    ConnectControllers(&input, SDL_GetTicksNS());
+    SDL_Log("Playback stopped");
+}
+
+internal_func void ToggleRecording(ReplayState *replay){
+    if (!replay->enabled) {
+        return;
+    }
+    if (!replay->snapshot_memory && !MapReplaySnapshot(replay)) {
+        replay->enabled = false;
+        return;
+    }
+
+    if (replay->recording) {
+        EndRecording(replay);
+    } else {
+        if (replay->playing) {
+            EndPlayback(replay);
+        }
+        BeginRecording(replay);
+    }
+}
+
+internal_func void TogglePlayback(ReplayState *replay){
+    if (!replay->enabled) {
+        return;
+    }
+    // an input file left by an earlier run has no snapshot of this run to start from
+    if (!replay->snapshot_memory) {
+        SDL_Log("Nothing recorded yet, press L to record");
+        return;
+    }
+
+    if (replay->playing) {
+        EndPlayback(replay);
+    } else {
+        if (replay->recording) {
+            EndRecording(replay);
+        }
+        BeginPlayback(replay);
+    }
+}
+
+internal_func void RecordInput(ReplayState *replay, GameInputState *new_input){
+    if (SDL_WriteIO(replay->recording_handle, new_input, sizeof(*new_input)) != sizeof(*new_input)) {
+        SDL_Log("Failed to write recorded input, stopping");
+        EndRecording(replay);
+    }
+}
+
+internal_func void PlaybackInput(ReplayState *replay, GameInputState *new_input){
+    if (replay->playback_index == replay->playback_count) {
+        replay->playback_index = 0;
+        RestoreSnapshot(replay);
+    }
+    *new_input = replay->playback_inputs[replay->playback_index++];
+}
+
+// ------------------------------------------------------------
+// Command line / benchmark mode
+// ------------------------------------------------------------
+/*
+    prog --bench [--frames N] [--width W] [--height H]
+    prog [--render auto|scalar|separable|sse2|avx2] [--threads N] [--present copy|lock]
+    prog [--memory reserve|calloc] [--memory-base ADDRESS] [--huge-pages]
+    prog --io-bench
+    prog --input-test
+    prog --bench [--async-load FILE] [--io-threads N]
+    prog --bench [--sprites N] [--premultiplied] [--still] [--dump-commands FILE]
+    prog --replay-commands FILE [--frames N] [--render PATH] [--threads N]
+    prog --bench [--voices N]
+    prog --bench [--entities N] [--render scalar|sse2|avx2]
+    prog --bench [--world-radius R] [--world-dir DIR]
+    prog [--audio callback|queue] [--music FILE]
+    prog [--fps N] [--update-hz N] [--vsync]
+    prog [--dynamic-res on|off] [--render-scale S] [--upscale renderer|nearest|bilinear]
+    prog --bench [--resize-drag]
+    prog [--trace FILE]
+    prog [--log FILE] [--log-level debug|info|warning|error]
+
+    Runs N frames headless at W x H and prints min/median/p99 times for
+    each DebugTimer plus the whole platform frame, and a checksum of the
+    final RenderBuffer so a changed image shows up next to a changed time.
+    --render forces the renderer's fill and blend paths so they can be compared.
+    --threads sets how many threads render tiles, main thread included.
+    --present lock renders straight into the locked streaming texture.
+    --memory-base picks where game memory is reserved, 0 lets the OS choose.
+    --io-bench times PlatformReadEntireFile copy against map and exits.
+    --input-test replays made up key, gamepad and hot-plug event streams through the input queue and exits.
+    --async-load streams FILE through the async reads while the bench renders.
+    --sprites draws N alpha blended test sprites a frame and reports pixels per cycle.
+    --still stops the background gradient moving, so the bench's Upload line shows what unchanged tiles save.
+    --dump-commands writes the last frame's render commands and bitmaps to FILE,
+    --replay-commands runs such a file through the renderer N times without the game.
+    --entities moves and collides N entities a step, --render picks the integration's vector width.
+    --world-radius streams a tile world with R chunks resident around a moving camera, evicted chunks
+    go to DIR (default handmade_world), the bench reports lookup cost and chunk load latency. Without
+    --world-dir a bench uses a fresh directory of its own and deletes it afterwards.
+    --voices starts N extra mixer voices (tones and looping buffers) and reports ms per 10 ms block.
+    --audio queue tops the stream up from the main thread instead of the callback's ring.
+    --music streams a 16-bit or float WAV, looped, and the bench reports decoded seconds per CPU second.
+    --fps paces frames (default the display's refresh rate, --bench runs unpaced unless it is given),
+    --update-hz sets the fixed simulation rate, --vsync lets present do the waiting.
+    --dynamic-res scales the render size to hold --fps (on by default, off under --bench),
+    --render-scale starts it at S of the window (0.5 to 1), --upscale picks what stretches it back.
+    --resize-drag sends the bench a stream of window resizes, to see what a drag costs and allocates.
+    --trace writes the last frames' timed blocks as Chrome trace JSON on exit, T writes them any time.
+    --log sends PlatformLog and SDL_Log output to FILE instead of stderr, --log-level drops what is below it.
+*/
+internal_func void ParseCommandLine(int argc, char *argv[]){
+    bench.frame_count = 600;
+    bench.width = 1920;
+    bench.height = 1080;
+
+    for (int i = 1; i < argc; ++i) {
+        char *arg = argv[i];
+        char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (SDL_strcmp(arg, "--bench") == 0) {
+            bench.enabled = true;
+        } else if (SDL_strcmp(arg, "--frames") == 0 && value) {
+            bench.frame_count = (uint32)SDL_atoi(value);
+            ++i;
+        } else if (SDL_strcmp(arg, "--width") == 0 && value) {
+            bench.width = (uint32)SDL_atoi(value);
+            ++i;
+        } else if (SDL_strcmp(arg, "--height") == 0 && value) {
+            bench.height = (uint32)SDL_atoi(value);
+            ++i;
+        } else if (SDL_strcmp(arg, "--render") == 0 && value) {
+            for (uint32 path = 0; path < RenderPath_Count; ++path) {
+                if (SDL_strcmp(value, render_path_names[path]) == 0) {
+                    render_path = path;
+                }
+            }
+            ++i;
+        } else if (SDL_strcmp(arg, "--present") == 0 && value) {
+            for (uint32 mode = 0; mode < PresentMode_Count; ++mode) {
+                if (SDL_strcmp(value, present_mode_names[mode]) == 0) {
+                    present_mode = mode;
+                }
+            }
+            ++i;
+        } else if (SDL_strcmp(arg, "--audio") == 0 && value) {
+            for (uint32 mode = 0; mode < AudioMode_Count; ++mode) {
+                if (SDL_strcmp(value, audio_mode_names[mode]) == 0) {
+                    audio_mode = mode;
+                }
+            }
+            ++i;
+        } else if (SDL_strcmp(arg, "--memory") == 0 && value) {
+            for (uint32 mode = 0; mode < MemoryMode_Count; ++mode) {
+                if (SDL_strcmp(value, memory_mode_names[mode]) == 0) {
+                    memory_mode = mode;
+                }
+            }
+            ++i;
+        } else if (SDL_strcmp(arg, "--memory-base") == 0 && value) {
+            uint64 align = MEMORY_COMMIT_GRANULARITY;
+            memory_base_address = (SDL_strtoull(value, NULL, 0) + align - 1) & ~(align - 1);
+            ++i;
+        } else if (SDL_strcmp(arg, "--huge-pages") == 0) {
+            use_huge_pages = true;
+        } else if (SDL_strcmp(arg, "--sprites") == 0 && value) {
+            game_memory.debug_sprite_count = (uint32)SDL_atoi(value);
+            ++i;
+        } else if (SDL_strcmp(arg, "--still") == 0) {
+            game_memory.debug_still_background = true;
+        } else if (SDL_strcmp(arg, "--resize-drag") == 0) {
+            bench.resize_drag = true;
+        } else if (SDL_strcmp(arg, "--entities") == 0 && value) {
+            game_memory.debug_entity_count = (uint32)SDL_atoi(value);
+            ++i;
+        } else if (SDL_strcmp(arg, "--world-radius") == 0 && value) {
+            game_memory.debug_world_radius = (uint32)SDL_atoi(value);
+            ++i;
+        } else if (SDL_strcmp(arg, "--world-dir") == 0 && value) {
+            game_memory.world_path = value;
+            ++i;
+        } else if (SDL_strcmp(arg, "--voices") == 0 && value) {
+            game_memory.debug_voice_count = (uint32)SDL_atoi(value);
+            ++i;
+        } else if (SDL_strcmp(arg, "--fps") == 0 && value) {
+            scheduler.target_hz = (uint32)SDL_atoi(value);
+            ++i;
+        } else if (SDL_strcmp(arg, "--update-hz") == 0 && value) {
+            scheduler.update_hz = (uint32)SDL_atoi(value);
+            ++i;
+        } else if (SDL_strcmp(arg, "--vsync") == 0) {
+            scheduler.vsync = true;
+        } else if (SDL_strcmp(arg, "--dynamic-res") == 0 && value) {
+            dynamic_res_option = (SDL_strcmp(value, "off") != 0);
+            ++i;
+        } else if (SDL_strcmp(arg, "--render-scale") == 0 && value) {
+            uint32 steps = (uint32)(SDL_atof(value) * RESOLUTION_SCALE_STEPS + 0.5);
+            resolution.steps = SDL_clamp(steps, RESOLUTION_MIN_STEPS, RESOLUTION_SCALE_STEPS);
+            ++i;
+        } else if (SDL_strcmp(arg, "--upscale") == 0 && value) {
+            for (uint32 mode = 0; mode < UpscaleMode_Count; ++mode) {
+                if (SDL_strcmp(value, upscale_mode_names[mode]) == 0) {
+                    upscale_mode = mode;
+                }
+            }
+            ++i;
+        } else if (SDL_strcmp(arg, "--log") == 0 && value) {
+            log_path = value;
+            ++i;
+        } else if (SDL_strcmp(arg, "--log-level") == 0 && value) {
+            for (uint32 level = 0; level < LogLevel_Count; ++level) {
+                if (SDL_strcmp(value, log_level_names[level]) == 0) {
+                    log_level = level;
+                }
+            }
+            ++i;
+        } else if (SDL_strcmp(arg, "--trace") == 0 && value) {
+            profiler.trace_path = value;
+            ++i;
+        } else if (SDL_strcmp(arg, "--music") == 0 && value) {
+            game_memory.music_path = value;
+            ++i;
+        } else if (SDL_strcmp(arg, "--premultiplied") == 0) {
+            game_memory.debug_sprites_premultiplied = true;
+        } else if (SDL_strcmp(arg, "--dump-commands") == 0 && value) {
+            dump_commands_path = value;
+            ++i;
+        } else if (SDL_strcmp(arg, "--replay-commands") == 0 && value) {
+            replay_commands_path = value;
+            ++i;
+        } else if (SDL_strcmp(arg, "--io-bench") == 0) {
+            io_bench_enabled = true;
+        } else if (SDL_strcmp(arg, "--input-test") == 0) {
+            input_test_enabled = true;
+        } else if (SDL_strcmp(arg, "--threads") == 0 && value) {
+            render_thread_count = (uint32)SDL_atoi(value);
+            ++i;
+        } else if (SDL_strcmp(arg, "--async-load") == 0 && value) {
+            async_load.filename = value;
+            ++i;
+        } else if (SDL_strcmp(arg, "--io-threads") == 0 && value) {
+            io_thread_count = (uint32)SDL_atoi(value);
+            ++i;
+        } else {
+            SDL_Log("Ignoring unknown argument '%s'", arg);
+        }
+    }
+
+    if (bench.frame_count == 0) bench.frame_count = 1;
+    if (bench.width == 0) bench.width = 1;
+    if (bench.height == 0) bench.height = 1;
+}
+
+internal_func bool InitBench(BenchState *bench){
+    // allocate every sample up front so the measured frames do no heap work
+    size_t total_bytes = sizeof(double64) * BenchSample_Count * bench->frame_count;
+    bench->samples = (double64 *)SDL_malloc(total_bytes);
+    if (!bench->samples) {
+        SDL_Log("Failed to allocate %zu bytes for benchmark samples", total_bytes);
+        return false;
+    }
+    bench->frames_run = 0;
+
+    SDL_Log("Benchmark: %u frames at %ux%u", bench->frame_count, bench->width, bench->height);
+    return true;
+}
+
+internal_func void RecordBenchFrame(BenchState *bench, uint64 present_ticks, uint64 frame_ticks){
+    double64 ms_per_tick = 1000.0 / (double64)perf_freq;
+    uint32 frame = bench->frames_run;
+
+    for (uint32 i = 0; i < DebugTimer_Count; ++i) {
+        bench->samples[i * bench->frame_count + frame] = (double64)game_memory.debug_timers[i].elapsed * ms_per_tick;
+    }
+    bench->sprite_pixels += game_memory.debug_sprite_pixels;
+    bench->sprite_cycles += game_memory.debug_timers[DebugTimer_DrawBitmaps].cycles;
+    bench->mix_ticks += game_memory.debug_timers[DebugTimer_MixAudio].elapsed;
+    bench->entity_move_ticks += game_memory.debug_timers[DebugTimer_MoveEntities].elapsed;
+    bench->entity_collide_ticks += game_memory.debug_timers[DebugTimer_BuildEntityGrid].elapsed +
+                                   game_memory.debug_timers[DebugTimer_CollideEntities].elapsed;
+    bench->world_update_ticks += game_memory.debug_timers[DebugTimer_UpdateWorld].elapsed;
+    bench->world_lookup_ticks += game_memory.debug_timers[DebugTimer_LookupTiles].elapsed;
+    bench->samples[BenchSample_Present * bench->frame_count + frame] = (double64)present_ticks * ms_per_tick;
+    bench->samples[BenchSample_Frame * bench->frame_count + frame] = (double64)frame_ticks * ms_per_tick;
+
+    ++bench->frames_run;
+}
+
+internal_func int CompareDouble(const void *a, const void *b){
+    double64 x = *(const double64 *)a;
+    double64 y = *(const double64 *)b;
+    return (x > y) - (x < y);
+}
+
+internal_func uint64 ChecksumRenderBuffer(RenderBuffer *buffer){
+    // FNV-1a over the visible bytes of every row, pitch padding is skipped
+    uint64 hash = 14695981039346656037ULL;
+    uint8 *row = (uint8 *)buffer->pixels;
+    uint32 row_bytes = buffer->width * buffer->bytesPerPixel;
+
+    for (uint32 y = 0; y < buffer->height; ++y) {
+        for (uint32 x = 0; x < row_bytes; ++x) {
+            hash ^= row[x];
+            hash *= 1099511628211ULL;
+        }
+        row += buffer->pitch;
+    }
+    return hash;
+}
+
+internal_func void PrintBenchResults(BenchState *bench, RenderBuffer *buffer){
+    uint32 n = bench->frames_run;
+    uint32 median_index = n / 2;
+    uint32 p99_index = (uint32)ceil(0.99 * (double64)n) - 1;
+
+    SDL_Log("Benchmark results: %u frames at %ux%u, render path %s, %u threads, %s present (ms)",
+            n, buffer->width, buffer->height,
+            render_path_names[render_path], render_queue.thread_count + 1, present_mode_names[present_mode]);
+    SDL_Log("%-20s %10s %10s %10s", "block", "min", "median", "p99");
+
+    for (uint32 i = 0; i < BenchSample_Count; ++i) {
+        double64 *samples = bench->samples + i * bench->frame_count;
+        SDL_qsort(samples, n, sizeof(double64), CompareDouble);
+        SDL_Log("%-20s %10.3f %10.3f %10.3f", bench_sample_names[i],
+                samples[0], samples[median_index], samples[p99_index]);
+    }
+
+    SDL_Log("RenderBuffer checksum: 0x%016llx", (unsigned long long)bench->checksum);
+
+    // fills differ in size, so the total mix time is scaled to the 10 ms blocks a low latency device asks for
+    if (bench->mix_frames) {
+        double64 blocks = (double64)bench->mix_frames / ((double64)SOUND_FREQ / 100.0);
+        SDL_Log("Mixer: %u voices, %s mode, %.0f frames per fill, %.3f ms per 10 ms block",
+                game_memory.debug_voices_mixed, audio_mode_names[audio_mode], (double64)bench->mix_frames / (double64)n,
+                (double64)bench->mix_ticks * 1000.0 / (double64)perf_freq / blocks);
+    }
+    LogAudioLatency(&audio_latency, &audio_ring);
+    LogProfileSummary();
+    if (scheduler.paced) {
+        LogFramePacing(&scheduler, &scheduler.total, "whole run");
+    }
+    LogResolutionHistory(&resolution);
+
+    // audio seconds out per second of main thread time spent producing them
+    StreamStats *stream = &game_memory.debug_stream_stats;
+    if (stream->sample_rate) {
+        double64 decode_seconds = (double64)stream->decode_ticks / (double64)perf_freq;
+        double64 resample_seconds = (double64)stream->resample_ticks / (double64)perf_freq;
+        double64 audio_seconds = (double64)stream->frames_resampled / (double64)SOUND_FREQ;
+        SDL_Log("Music: %u Hz %u channels, %.1f s played (%.1f s decoded), decode %.0f, resample %.0f, "
+                "together %.0f decoded seconds per CPU second, %u starved mixes",
+                stream->sample_rate, stream->channel_count, audio_seconds,
+                (double64)stream->frames_decoded / (double64)stream->sample_rate,
+                decode_seconds > 0.0 ? ((double64)stream->frames_decoded / (double64)stream->sample_rate) / decode_seconds : 0.0,
+                resample_seconds > 0.0 ? audio_seconds / resample_seconds : 0.0,
+                (decode_seconds + resample_seconds) > 0.0 ? audio_seconds / (decode_seconds + resample_seconds) : 0.0,
+                stream->starved_mixes);
+    }
+    if (game_memory.debug_sprite_count) {
+        // time stamp counter cycles summed over the render threads, they tick at the base clock, not the boosted one
+        SDL_Log("Sprites: %u %s per frame, %.0f pixels per frame, %.3f pixels per cycle",
+                game_memory.debug_sprite_count, game_memory.debug_sprites_premultiplied ? "premultiplied" : "straight alpha",
+                (double64)bench->sprite_pixels / (double64)n,
+                bench->sprite_cycles ? (double64)bench->sprite_pixels / (double64)bench->sprite_cycles : 0.0);
+    }
+    EntityStats *entities = &game_memory.debug_entity_stats;
+    if (entities->steps) {
+        double64 steps = (double64)entities->steps;
+        double64 entity_steps = steps * (double64)entities->entity_count;
+        SDL_Log("Entities: %u, %s integration %.2f ns each, grid and collisions %.1f ns each, %u buckets used",
+                entities->entity_count, render_path_names[render_path],
+                (double64)bench->entity_move_ticks * 1e9 / (double64)perf_freq / entity_steps,
+                (double64)bench->entity_collide_ticks * 1e9 / (double64)perf_freq / entity_steps,
+                entities->occupied_buckets);
+        SDL_Log("Entities: %.2f pairs tested and %.3f overlapping per entity a step, %.1f results per query, checksum 0x%016llx",
+                (double64)entities->pairs_tested / entity_steps, (double64)entities->overlaps / entity_steps,
+                entities->queries ? (double64)entities->query_results / (double64)entities->queries : 0.0,
+                (unsigned long long)entities->checksum);
+    }
+    WorldStats *world = &game_memory.debug_world_stats;
+    if (world->steps) {
+        double64 ms_per_tick = 1000.0 / (double64)perf_freq;
+        SDL_Log("World: radius %u, %u of %u chunks resident, %.1f KB however far it streams, %.2f ms per step keeping them in",
+                world->radius, world->resident_chunks, world->chunk_capacity, (double64)world->memory_size / 1024.0,
+                (double64)bench->world_update_ticks * ms_per_tick / (double64)world->steps);
+        SDL_Log("World: %.2f ns per tile lookup, %.2f probes on average (longest %u), %.3f%% of lookups not in yet",
+                (double64)bench->world_lookup_ticks * 1e6 * ms_per_tick / (double64)world->lookups,
+                world->average_probe, world->longest_probe,
+                100.0 * (double64)world->lookup_misses / (double64)world->lookups);
+        SDL_Log("World: %llu chunks generated, %llu loaded, %llu evicted, %llu written, %llu picked up again before their write ended",
+                (unsigned long long)world->chunks_generated, (unsigned long long)world->chunks_loaded,
+                (unsigned long long)world->chunks_evicted, (unsigned long long)world->chunks_written,
+                (unsigned long long)world->chunks_revived);
+        if (world->chunks_loaded) {
+            SDL_Log("World: chunk load latency min %.3f, avg %.3f, max %.3f ms, checksum 0x%016llx",
+                    (double64)world->load_ticks_min * ms_per_tick,
+                    (double64)world->load_ticks * ms_per_tick / (double64)world->chunks_loaded,
+                    (double64)world->load_ticks_max * ms_per_tick, (unsigned long long)world->checksum);
+        } else {
+            SDL_Log("World: no chunk was read back, checksum 0x%016llx", (unsigned long long)world->checksum);
+        }
+    }
+    // lock mode renders straight into the texture, every tile is drawn and nothing is copied
+    if (present_mode == PresentMode_Lock) {
+        SDL_Log("Upload: none, rendered in place, %.0f of %.0f tiles drawn per frame",
+                (double64)(bench->render_tiles - bench->skipped_tiles) / (double64)n, (double64)bench->render_tiles / (double64)n);
+    } else {
+        double64 full_kb = (double64)bench->full_upload_bytes / 1024.0 / (double64)n;
+        double64 upload_kb = (double64)bench->upload_bytes / 1024.0 / (double64)n;
+        SDL_Log("Upload: %.0f of %.0f KB per frame (%.1f%% saved) in %.1f rectangles, %.0f of %.0f tiles drawn per frame",
+                upload_kb, full_kb, full_kb > 0.0 ? 100.0 * (1.0 - upload_kb / full_kb) : 0.0,
+                (double64)bench->upload_rectangles / (double64)n,
+                (double64)(bench->render_tiles - bench->skipped_tiles) / (double64)n, (double64)bench->render_tiles / (double64)n);
+    }
+
+    AssetStats *assets = &game_memory.debug_asset_stats;
+    uint32 lookups = assets->hits + assets->misses;
+    SDL_Log("Assets: pack opened in %.3f ms, %u lookups, %.1f%% hits, %u evictions, %.3f ms decoding, cache %.2f of %.1f MB",
+            (double64)assets->open_ticks * 1000.0 / (double64)perf_freq, lookups,
+            lookups ? 100.0 * (double64)assets->hits / (double64)lookups : 0.0, assets->evictions,
+            (double64)assets->decode_ticks * 1000.0 / (double64)perf_freq,
+            (double64)assets->cache_used / (double64)Megabytes(1), (double64)assets->cache_size / (double64)Megabytes(1));
+    if (async_load.buffer) {
+        double64 wall_ms = (double64)(SDL_GetPerformanceCounter() - async_load.start_ticks) * 1000.0 / (double64)perf_freq;
+        double64 io_ms = (double64)async_load.io_ticks * 1000.0 / (double64)perf_freq;
+        double64 megabytes = (double64)async_load.bytes_read / (double64)Megabytes(1);
+        SDL_Log("Async load: %.1f MB in %u reads over %.1f ms of frames, %.1f MB/s, %u I/O threads busy %.1f ms",
+                megabytes, async_load.reads_completed, wall_ms, megabytes / (wall_ms / 1000.0),
+                io_queue.thread_count, io_ms);
+    }
+    SDL_Log("Startup: %.3f ms, %s game memory", (double64)startup_ticks * 1000.0 / (double64)perf_freq,
+            memory_mode_names[memory_mode]);
+    LogMemoryUsage("at exit");
+}
+
+internal_func bool StartAsyncLoadBench(AsyncLoadBench *load){
+    load->file_size = PlatformGetFileSize(load->filename);
+    load->read_count = io_queue.thread_count;
+    if (load->file_size == 0 || load->read_count == 0) {
+        SDL_Log("Nothing to stream for --async-load '%s'", load->filename);
+        return false;
+    }
+
+    load->buffer = (uint8 *)SDL_malloc(ASYNC_LOAD_CHUNK_SIZE * load->read_count);
+    if (!load->buffer) {
+        SDL_Log("Failed to allocate the --async-load buffers");
+        return false;
+    }
+
+    load->start_ticks = SDL_GetPerformanceCounter();
+    SDL_Log("Streaming '%s' (%llu MB) in %llu MB reads on %u I/O threads", load->filename,
+            (unsigned long long)(load->file_size / Megabytes(1)), (unsigned long long)(ASYNC_LOAD_CHUNK_SIZE / Megabytes(1)),
+            load->read_count);
+    return true;
+}
+
+// collects finished reads and starts the next chunk in their place, wrapping at the end of the file
+internal_func void UpdateAsyncLoadBench(AsyncLoadBench *load){
+    for (uint32 i = 0; i < load->read_count; ++i) {
+        PlatformAsyncRead read = load->reads[i];
+        if (read) {
+            uint32 state = PlatformGetAsyncReadState(read);
+            if (state == AsyncRead_Pending) {
+                continue;
+            }
+            AsyncReadSlot *slot = GetAsyncReadSlot(read);
+            load->bytes_read += slot->bytes_read;
+            load->io_ticks += slot->io_ticks;
+            ++load->reads_completed;
+            PlatformEndAsyncRead(read);
+        }
+
+        if (load->next_offset >= load->file_size) {
+            load->next_offset = 0;
+        }
+        uint64 size = load->file_size - load->next_offset;
+        if (size > ASYNC_LOAD_CHUNK_SIZE) {
+            size = ASYNC_LOAD_CHUNK_SIZE;
+        }
+        load->reads[i] = PlatformBeginAsyncRead(load->filename, load->next_offset, size,
+                                                load->buffer + i * ASYNC_LOAD_CHUNK_SIZE, NULL, NULL);
+        load->next_offset += size;
+    }
+}
+
+internal_func void EndAsyncLoadBench(AsyncLoadBench *load){
+    for (uint32 i = 0; i < load->read_count; ++i) {
+        PlatformEndAsyncRead(load->reads[i]);
+        load->reads[i] = 0;
+    }
+    if (load->buffer) {
+        SDL_free(load->buffer);
+        load->buffer = NULL;
+    }
+}
+
+internal_func uint64 AlignDumpOffset(uint64 offset){
+    return (offset + 63) & ~(uint64)63;
+}
+
+// the push buffer holds no pointers, so the commands plus a copy of every bitmap are the whole frame
+internal_func bool DumpRenderCommands(RenderCommands *commands, char *filename){
+    uint64 pixels_offset = sizeof(RenderDumpHeader) + commands->bitmap_count * sizeof(RenderDumpBitmap) +
+                           commands->push_buffer_size;
+    uint64 total_size = pixels_offset;
+    for (uint32 i = 0; i < commands->bitmap_count; ++i) {
+        LoadedBitmap *bitmap = commands->bitmaps[i];
+        total_size = AlignDumpOffset(total_size) + (uint64)bitmap->pitch * bitmap->height;
+    }
+
+    uint8 *dump = (uint8 *)SDL_calloc(1, total_size);
+    if (!dump) {
+        SDL_Log("Failed to allocate %llu bytes for the command dump", (unsigned long long)total_size);
+        return false;
+    }
+
+    RenderDumpHeader *header = (RenderDumpHeader *)dump;
+    header->magic = RENDER_DUMP_MAGIC;
+    header->version = RENDER_DUMP_VERSION;
+    header->width = commands->width;
+    header->height = commands->height;
+    header->command_count = commands->command_count;
+    header->push_buffer_size = commands->push_buffer_size;
+    header->bitmap_count = commands->bitmap_count;
+
+    RenderDumpBitmap *bitmaps = (RenderDumpBitmap *)(header + 1);
+    SDL_memcpy(bitmaps + commands->bitmap_count, commands->push_buffer, commands->push_buffer_size);
+
+    uint64 offset = pixels_offset;
+    for (uint32 i = 0; i < commands->bitmap_count; ++i) {
+        LoadedBitmap *bitmap = commands->bitmaps[i];
+        offset = AlignDumpOffset(offset);
+        bitmaps[i].width = bitmap->width;
+        bitmaps[i].height = bitmap->height;
+        bitmaps[i].pitch = bitmap->pitch;
+        bitmaps[i].premultiplied = bitmap->premultiplied;
+        bitmaps[i].offset = offset;
+        SDL_memcpy(dump + offset, bitmap->pixels, (size_t)bitmap->pitch * bitmap->height);
+        offset += (uint64)bitmap->pitch * bitmap->height;
+    }
+
+    bool written = PlatformWriteEntireFile(filename, total_size, dump);
+    SDL_free(dump);
+    SDL_Log(written ? "Wrote %u render commands (%u bitmaps) to '%s'" : "Failed to write %u render commands (%u bitmaps) to '%s'",
+            commands->command_count, commands->bitmap_count, filename);
+    return written;
+}
+
+/*
+    Runs a --dump-commands file through RenderCommandsToOutput --frames
+    times on a heap target of the recorded size, nothing else happens in
+    the process. The checksum matches the bench run that wrote the file
+    for the same render path, so a renderer change can be timed and
+    checked against one fixed frame.
+*/
+internal_func void RunRenderReplay(char *filename){
+    PlatformFile file = PlatformReadEntireFile(filename, PlatformFile_Map);
+    RenderDumpHeader *header = (RenderDumpHeader *)file.contents;
+    if (!header || file.size < sizeof(RenderDumpHeader) || header->magic != RENDER_DUMP_MAGIC ||
+        header->version != RENDER_DUMP_VERSION || header->bitmap_count > MAX_RENDER_BITMAPS ||
+        sizeof(RenderDumpHeader) + header->bitmap_count * sizeof(RenderDumpBitmap) + (uint64)header->push_buffer_size > file.size) {
+        SDL_Log("'%s' is not a version %u render command dump", filename, RENDER_DUMP_VERSION);
+        PlatformFreeFileMemory(&file);
+        return;
+    }
+
+    RenderDumpBitmap *dump_bitmaps = (RenderDumpBitmap *)(header + 1);
+    LoadedBitmap bitmaps[MAX_RENDER_BITMAPS] = {0};
+    RenderCommands commands = {0};
+    InitializeRenderCommands(&commands, dump_bitmaps + header->bitmap_count, header->push_buffer_size);
+    commands.width = header->width;
+    commands.height = header->height;
+    commands.push_buffer_size = header->push_buffer_size;
+    commands.command_count = header->command_count;
+    for (uint32 i = 0; i < header->bitmap_count; ++i) {
+        RenderDumpBitmap *dump_bitmap = dump_bitmaps + i;
+        // a bitmap that runs past the file is left empty, the renderer skips empty bitmaps
+        if (dump_bitmap->offset + (uint64)dump_bitmap->pitch * dump_bitmap->height <= file.size) {
+            bitmaps[i].width = dump_bitmap->width;
+            bitmaps[i].height = dump_bitmap->height;
+            bitmaps[i].pitch = dump_bitmap->pitch;
+            bitmaps[i].premultiplied = dump_bitmap->premultiplied;
+            bitmaps[i].pixels = (uint32 *)((uint8 *)file.contents + dump_bitmap->offset);
+        }
+        commands.bitmaps[commands.bitmap_count++] = bitmaps + i;
+    }
+
+    RenderBuffer target = {0};
+    target.width = header->width;
+    target.height = header->height;
+    target.bytesPerPixel = 4;
+    target.pitch = target.width * target.bytesPerPixel;
+    target.pixels = SDL_calloc(1, (size_t)target.pitch * target.height);
+
+    uint32 frame_count = bench.frame_count;
+    double64 *samples = (double64 *)SDL_malloc(sizeof(double64) * 4 * frame_count);
+    if (!target.pixels || !samples) {
+        SDL_Log("Failed to allocate the %ux%u replay target", target.width, target.height);
+        SDL_free(target.pixels);
+        SDL_free(samples);
+        PlatformFreeFileMemory(&file);
+        return;
+    }
+
+    uint32 timers[] = { DebugTimer_RenderCommands, DebugTimer_SortRenderCommands, DebugTimer_DrawGradient, DebugTimer_DrawBitmaps };
+    double64 ms_per_tick = 1000.0 / (double64)SDL_GetPerformanceFrequency();
+    uint64 bitmap_pixels = 0;
+    uint64 bitmap_cycles = 0;
+    for (uint32 frame = 0; frame < frame_count; ++frame) {
+        SDL_memset(game_memory.debug_timers, 0, sizeof(game_memory.debug_timers));
+        RenderFrame(&commands, &target);
+        for (uint32 i = 0; i < SDL_arraysize(timers); ++i) {
+            samples[i * frame_count + frame] = (double64)game_memory.debug_timers[timers[i]].elapsed * ms_per_tick;
+        }
+        bitmap_pixels += game_memory.debug_sprite_pixels;
+        bitmap_cycles += game_memory.debug_timers[DebugTimer_DrawBitmaps].cycles;
+    }
+
+    SDL_Log("Replay of '%s': %u commands, %u bitmaps, %u frames at %ux%u, render path %s, %u threads (ms)",
+            filename, commands.command_count, commands.bitmap_count, frame_count, target.width, target.height,
+            render_path_names[render_path], render_queue.thread_count + 1);
+    SDL_Log("%-20s %10s %10s %10s", "block", "min", "median", "p99");
+    uint32 median_index = frame_count / 2;
+    uint32 p99_index = (uint32)ceil(0.99 * (double64)frame_count) - 1;
+    for (uint32 i = 0; i < SDL_arraysize(timers); ++i) {
+        double64 *row = samples + i * frame_count;
+        SDL_qsort(row, frame_count, sizeof(double64), CompareDouble);
+        SDL_Log("%-20s %10.3f %10.3f %10.3f", bench_sample_names[timers[i]], row[0], row[median_index], row[p99_index]);
+    }
+    SDL_Log("RenderBuffer checksum: 0x%016llx", (unsigned long long)ChecksumRenderBuffer(&target));
+    SDL_Log("Bitmaps: %.0f pixels per frame, %.3f pixels per cycle", (double64)bitmap_pixels / (double64)frame_count,
+            bitmap_cycles ? (double64)bitmap_pixels / (double64)bitmap_cycles : 0.0);
+
+    SDL_free(samples);
+    SDL_free(target.pixels);
+    PlatformFreeFileMemory(&file);
+}
+
+// reads every byte, so a mapped file pays for its page faults the way a copy pays for read()
+internal_func uint64 SumFileContents(PlatformFile *file){
+    uint64 sum = 0;
+    uint64 *words = (uint64 *)file->contents;
+    uint64 word_count = file->size / sizeof(uint64);
+    for (uint64 i = 0; i < word_count; ++i) {
+        sum += words[i];
+    }
+    return sum;
+}
+
+// drops the file from the page cache so the next read comes from the disk
+internal_func void EvictFileFromCache(char *filename){
+#ifdef POSIX_FADV_DONTNEED
+    int fd = open(filename, O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#endif
+}
+
+/*
+    For 1MB, 64MB and 1GB files: time the atomic PlatformWriteEntireFile,
+    then read the file back with each PlatformFile mode, cold (evicted from
+    the page cache first) and warm. "read" is PlatformReadEntireFile alone,
+    "read+use" also sums every byte. Map returns almost at once but pays
+    page faults when the data is used, so the second column is the fair one.
+*/
+internal_func void RunFileBenchmark(){
+    uint64 sizes[] = { Megabytes(1), Megabytes(64), Gigabytes(1) };
+    double64 ms_per_tick = 1000.0 / (double64)SDL_GetPerformanceFrequency();
+
+    SDL_Log("File benchmark, medians in ms");
+    SDL_Log("%-8s %-6s %-6s %10s %10s %10s", "size", "mode", "cache", "read", "read+use", "GB/s");
+
+    for (uint32 size_index = 0; size_index < SDL_arraysize(sizes); ++size_index) {
+        uint64 size = sizes[size_index];
+        uint32 run_count = (size <= Megabytes(1)) ? 50 : ((size <= Megabytes(64)) ? 10 : 3);
+
+        uint64 *data = (uint64 *)SDL_malloc(size);
+        if (!data) {
+            SDL_Log("Skipping %llu MB, could not allocate the test data", (unsigned long long)(size / Megabytes(1)));
+            continue;
+        }
+        uint64 expected_sum = 0;
+        for (uint64 i = 0; i < size / sizeof(uint64); ++i) {
+            data[i] = i * 2654435761ULL;
+            expected_sum += data[i];
+        }
+
+        uint64 write_start = PlatformGetWallClock();
+        bool32 written = PlatformWriteEntireFile(IO_BENCH_FILENAME, size, data);
+        double64 write_ms = (double64)(PlatformGetWallClock() - write_start) * ms_per_tick;
+        SDL_free(data);
+        if (!written) {
+            SDL_Log("Skipping %llu MB, could not write '%s'", (unsigned long long)(size / Megabytes(1)), IO_BENCH_FILENAME);
+            continue;
+        }
+        SDL_Log("%-8llu write (temp + fsync + rename) %10.3f ms", (unsigned long long)(size / Megabytes(1)), write_ms);
+
+        double64 read_samples[50];
+        double64 total_samples[50];
+        for (uint32 mode = PlatformFile_Copy; mode <= PlatformFile_Map; ++mode) {
+            for (uint32 pass = 0; pass < 2; ++pass) {
+                bool cold = (pass == 0);
+                bool sums_match = true;
+                for (uint32 run = 0; run < run_count; ++run) {
+                    if (cold) {
+                        EvictFileFromCache(IO_BENCH_FILENAME);
+                    }
+
+                    uint64 start = PlatformGetWallClock();
+                    PlatformFile file = PlatformReadEntireFile(IO_BENCH_FILENAME, mode);
+                    uint64 read_end = PlatformGetWallClock();
+                    uint64 sum = file.contents ? SumFileContents(&file) : 0;
+                    uint64 end = PlatformGetWallClock();
+                    PlatformFreeFileMemory(&file);
+
+                    sums_match = sums_match && (sum == expected_sum);
+                    read_samples[run] = (double64)(read_end - start) * ms_per_tick;
+                    total_samples[run] = (double64)(end - start) * ms_per_tick;
+                }
+
+                SDL_qsort(read_samples, run_count, sizeof(double64), CompareDouble);
+                SDL_qsort(total_samples, run_count, sizeof(double64), CompareDouble);
+                double64 total_ms = total_samples[run_count / 2];
+                SDL_Log("%-8llu %-6s %-6s %10.3f %10.3f %10.2f%s", (unsigned long long)(size / Megabytes(1)),
+                        file_mode_names[mode], cold ? "cold" : "warm", read_samples[run_count / 2], total_ms,
+                        ((double64)size / (double64)Gigabytes(1)) / (total_ms / 1000.0),
+                        sums_match ? "" : "  CONTENTS MISMATCH");
+            }
+        }
+    }
+
+    unlink(IO_BENCH_FILENAME);
+}
+
+internal_func bool GrowPixelPool(PixelPool *pool, uint64 needed){
+    if (needed <= pool->committed) {
+        return true;
+    }
+    if (!pool->base) {
+        pool->base = (uint8 *)ReserveMemory(0, PIXEL_POOL_RESERVE_SIZE);
+        if (!pool->base) {
+            PlatformLog(LogLevel_Error, "Failed to reserve %u MB for pixels", (uint32)(PIXEL_POOL_RESERVE_SIZE / Megabytes(1)));
+            return false;
+        }
+    }
+
+    uint64 size = SDL_max(needed, pool->committed * 2);
+    size = (size + MEMORY_COMMIT_GRANULARITY - 1) & ~(uint64)(MEMORY_COMMIT_GRANULARITY - 1);
+    size = SDL_min(size, PIXEL_POOL_RESERVE_SIZE);
+    if (needed > size) {
+        PlatformLog(LogLevel_Error, "%llu bytes do not fit the pixel reservation", (unsigned long long)needed);
+        return false;
+    }
+    // committed straight away whatever --memory says, that only picks how game memory is allocated
+    if (mprotect(pool->base + pool->committed, size - pool->committed, PROT_READ | PROT_WRITE) != 0) {
+        PlatformLog(LogLevel_Error, "Failed to commit %llu bytes of pixels", (unsigned long long)(size - pool->committed));
+        return false;
+    }
+    pool->committed = size;
+    ++pool->grow_count;
+    return true;
+}
+
+internal_func void FreePixelPool(PixelPool *pool){
+    if (pool->base) {
+        munmap(pool->base, PIXEL_POOL_RESERVE_SIZE);
+    }
+    *pool = (PixelPool){0};
+}
+
+// the pixels are whatever the pool held, but the buffer is all dirty and no tile was drawn yet, so
+// the next frame draws all of it, tile_hashes is NULL for buffers the renderer never draws into
+internal_func bool ResizeRenderBuffer(RenderBuffer *buffer, PixelPool *pool, uint32 width, uint32 height, uint64 *tile_hashes){
+    uint32 pitch = (width * 4 + PIXEL_ROW_ALIGNMENT - 1) & ~(uint32)(PIXEL_ROW_ALIGNMENT - 1);
+    if (!GrowPixelPool(pool, (uint64)pitch * height)) {
+        buffer->pixels = NULL;
+        return false;
+    }
+
+    buffer->width = width;
+    buffer->height = height;
+    buffer->bytesPerPixel = 4; // ARGB8888
+    buffer->pitch = pitch;
+    buffer->pixels = pool->base;
+
+    if (tile_hashes) {
+        SDL_memset(tile_hashes, 0, sizeof(uint64) * MAX_RENDER_TILES);
+    }
+    buffer->tile_hashes = tile_hashes;
+    SDL_memset(buffer->dirty_tiles, 0, sizeof(buffer->dirty_tiles));
+    MarkDirtyRectangle(buffer, 0, 0, width, height);
+    return true;
+}
+
+// true when there is a new texture, which holds nothing yet, a grown one is half as big again as it has to be
+internal_func bool GrowTexture(uint32 width, uint32 height){
+    uint32 new_width = width;
+    uint32 new_height = height;
+    if (texture) {
+        new_width = (width > texture_width) ? SDL_max(width, texture_width + texture_width / 2) : texture_width;
+        new_height = (height > texture_height) ? SDL_max(height, texture_height + texture_height / 2) : texture_height;
+    }
+
+    SDL_Texture *new_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                                 new_width, new_height);
+    if (!new_texture && (new_width != width || new_height != height)) {
+        // past the renderer's size limit, exactly what is needed may still fit
+        new_width = width;
+        new_height = height;
+        new_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                        new_width, new_height);
+    }
+    if (!new_texture) {
+        PlatformLog(LogLevel_Error, "Failed to create a %ux%u texture: %s", new_width, new_height, SDL_GetError());
+        return false;
+    }
+
+    if (texture) {
+        SDL_DestroyTexture(texture);
+    }
+    texture = new_texture;
+    texture_width = new_width;
+    texture_height = new_height;
+    ++texture_create_count;
+    PlatformLog(LogLevel_Info, "Texture created: %ux%u for %ux%u frames", new_width, new_height, width, height);
+    return true;
+}
+
+// the renderer's scratch arena covers all of the pool that is committed, a bigger frame commits more of
+// the reservation (at least doubling) instead of reallocating, so a drag that keeps growing rarely pays
+internal_func bool GrowRenderScratch(MemoryArena *scratch, uint64 scratch_size){
+    bool grown = GrowPixelPool(&render_scratch_pool, scratch_size);
+    InitializeArena(scratch, render_scratch_pool.committed, render_scratch_pool.base, NULL);
+    return grown;
+}
+
+internal_func void RenderFrame(RenderCommands *commands, RenderBuffer *target){
+    TIMED_FUNCTION();
+    BEGIN_DEBUG_TIMER(&game_memory, RenderCommands);
+
+    MemoryArena scratch;
+    GrowRenderScratch(&scratch, RenderCommandsScratchSize(commands, target->width, target->height));
+    RenderCommandsToOutput(commands, target, game_memory.render_queue, render_path, &scratch,
+                           game_memory.debug_timers, &render_stats);
+    game_memory.debug_sprite_pixels = render_stats.bitmap_pixels;
+
+    END_DEBUG_TIMER(&game_memory, RenderCommands);
+}
+
+// the software upscale modes, the render scratch is free again once RenderFrame returned
+internal_func void UpscaleToWindow(RenderBuffer *source, RenderBuffer *dest, bool redraw_all){
+    TIMED_FUNCTION();
+    BEGIN_DEBUG_TIMER(&game_memory, Upscale);
+
+    MemoryArena scratch;
+    if (GrowRenderScratch(&scratch, UpscaleScratchSize(source, dest))) {
+        uint32 filter = (upscale_mode == UpscaleMode_Bilinear) ? UpscaleFilter_Bilinear : UpscaleFilter_Nearest;
+        UpscaleRenderBuffer(source, dest, filter, redraw_all, game_memory.render_queue, render_path, &scratch);
+    }
+
+    END_DEBUG_TIMER(&game_memory, Upscale);
+}
+
+// copies what changed since the last upload into the texture, runs of dirty squares in a row become
+// one rectangle and grow downwards while the rows below have the same run, returns the bytes copied
+internal_func uint64 UploadDirtyRectangles(SDL_Texture *texture, RenderBuffer *buffer, uint32 *rectangle_count){
+    *rectangle_count = 0;
+    if (!texture || !buffer->pixels || !buffer->width || !buffer->height) {
+        return 0;
+    }
+
+    uint32 columns = (buffer->width + DIRTY_TILE_SIZE - 1) >> DIRTY_TILE_SHIFT;
+    uint32 rows = (buffer->height + DIRTY_TILE_SIZE - 1) >> DIRTY_TILE_SHIFT;
+    if (columns > DIRTY_TILE_COLUMNS) columns = DIRTY_TILE_COLUMNS;
+    if (rows > DIRTY_TILE_ROWS) rows = DIRTY_TILE_ROWS;
+    uint64 used_columns = (columns == 64) ? ~0ull : ((1ull << columns) - 1);
+
+    // in squares, max exclusive
+    local_persist struct { uint32 min_x, min_y, max_x, max_y; } rects[MAX_DIRTY_RECTANGLES];
+    uint32 rect_count = 0;
+    // the rects that reach down to the row above, a row has at most 32 runs
+    uint32 open_rects[DIRTY_TILE_COLUMNS / 2];
+    uint32 open_count = 0;
+    bool everything_dirty = true;
+
+    for (uint32 y = 0; y < rows; ++y) {
+        uint64 bits = buffer->dirty_tiles[y] & used_columns;
+        if (bits != used_columns) {
+            everything_dirty = false;
+        }
+        uint32 row_rects[DIRTY_TILE_COLUMNS / 2];
+        uint32 row_count = 0;
+        while (bits) {
+            uint32 min_x = (uint32)__builtin_ctzll(bits);
+            uint64 from_min = bits >> min_x;
+            uint32 max_x = (~from_min) ? min_x + (uint32)__builtin_ctzll(~from_min) : 64;
+            bits = (max_x == 64) ? 0 : bits & ~((1ull << max_x) - 1);
+
+            uint32 rect_index = rect_count;
+            for (uint32 open_index = 0; open_index < open_count; ++open_index) {
+                if (rects[open_rects[open_index]].min_x == min_x && rects[open_rects[open_index]].max_x == max_x) {
+                    rect_index = open_rects[open_index];
+                    break;
+                }
+            }
+            if (rect_index == rect_count) {
+                rects[rect_count].min_x = min_x;
+                rects[rect_count].max_x = max_x;
+                rects[rect_count].min_y = y;
+                ++rect_count;
+            }
+            rects[rect_index].max_y = y + 1;
+            row_rects[row_count++] = rect_index;
+        }
+        SDL_memcpy(open_rects, row_rects, row_count * sizeof(row_rects[0]));
+        open_count = row_count;
+    }
+
+    uint64 bytes_per_pixel = buffer->bytesPerPixel;
+    if (everything_dirty) {
+        // the texture can be bigger than the buffer, only its top left is used
+        SDL_Rect rect = {0, 0, (int)buffer->width, (int)buffer->height};
+        SDL_UpdateTexture(texture, &rect, buffer->pixels, buffer->pitch);
+        *rectangle_count = 1;
+        return (uint64)buffer->width * buffer->height * bytes_per_pixel;
+    }
+
+    uint64 bytes = 0;
+    for (uint32 rect_index = 0; rect_index < rect_count; ++rect_index) {
+        // the last row and column of squares reach the edge of the buffer, whatever its size
+        uint32 min_x = rects[rect_index].min_x << DIRTY_TILE_SHIFT;
+        uint32 min_y = rects[rect_index].min_y << DIRTY_TILE_SHIFT;
+        uint32 max_x = (rects[rect_index].max_x == columns) ? buffer->width : rects[rect_index].max_x << DIRTY_TILE_SHIFT;
+        uint32 max_y = (rects[rect_index].max_y == rows) ? buffer->height : rects[rect_index].max_y << DIRTY_TILE_SHIFT;
+        if (max_x > buffer->width) max_x = buffer->width;
+        if (max_y > buffer->height) max_y = buffer->height;
+        if (min_x >= max_x || min_y >= max_y) {
+            continue;
+        }
+
+        SDL_Rect rect = {(int)min_x, (int)min_y, (int)(max_x - min_x), (int)(max_y - min_y)};
+        uint8 *pixels = (uint8 *)buffer->pixels + (uint64)min_y * buffer->pitch + min_x * bytes_per_pixel;
+        SDL_UpdateTexture(texture, &rect, pixels, buffer->pitch);
+        bytes += (uint64)rect.w * rect.h * bytes_per_pixel;
+        ++*rectangle_count;
+    }
+    return bytes;
+}
+
+internal_func bool InitAudio(AudioSystem *audio_system){
+
+    audio_spec.format = SDL_AUDIO_F32;   // 32-bit float audio
+    audio_spec.channels = SOUND_CHANNELS;
+    audio_spec.freq = SOUND_FREQ;
+
+    audio_stream = SDL_OpenAudioDeviceStream(
+        SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, 
+        &audio_spec, NULL, NULL);
+    if (!audio_stream) {
+        SDL_Log("Couldn't create audio stream: %s", SDL_GetError());
+        return SDL_APP_FAILURE;
+    }
+
+    // the ring has to exist before the device starts calling back
+    if (audio_mode == AudioMode_Callback) {
+        audio_ring.samples = (float32 *)SDL_calloc(AUDIO_RING_FRAMES * SOUND_CHANNELS, sizeof(float32));
+        if (!audio_ring.samples || !SDL_SetAudioStreamGetCallback(audio_stream, AudioStreamCallback, &audio_ring)) {
+            SDL_Log("Couldn't set up the audio callback (%s), falling back to queue mode", SDL_GetError());
+            SDL_free(audio_ring.samples);
+            audio_ring.samples = NULL;
+            audio_mode = AudioMode_Queue;
+        }
+        audio_latency.target_frames = SOUND_FREQ * AUDIO_START_LATENCY_MS / 1000;
+        audio_latency.lowest_target_frames = audio_latency.target_frames;
+        audio_latency.highest_target_frames = audio_latency.target_frames;
+        audio_latency.min_queued_frames = UINT32_MAX;
+        audio_latency.last_adjust_ms = SDL_GetTicks();
+    }
+
+    /* SDL_OpenAudioDeviceStream starts the device paused. You have to tell it to start! */
+    SDL_ResumeAudioStreamDevice(audio_stream);
+
+
+    // Allocate buffer for our generated samples
+    audio_system->frames_per_buffer = (uint32)(audio_spec.freq * BUFFER_SECONDS);
+    audio_system->samples_per_buffer = audio_system->frames_per_buffer * audio_spec.channels;
+    audio_system->buffer_size = audio_system->samples_per_buffer * sizeof(float);
+    audio_system->sound_buffer = (float *)SDL_malloc(audio_system->buffer_size);
+
+    if (!audio_system->sound_buffer) {
+        SDL_Log("Failed to allocate audio buffer");
+        return false;
+    }
+
+    // zero the memory
+    SDL_memset(audio_system->sound_buffer, 0, audio_system->buffer_size);
+
+
+    SDL_Log("Audio initialized: %s mode, %.1f sec buffer, %d Hz, %d channels",
+        audio_mode_names[audio_mode], BUFFER_SECONDS, audio_spec.freq, audio_spec.channels);
+
+    return true;
+}
+
+internal_func void DestroyAudio(AudioSystem *audio_system) {
+    if (audio_stream) {
+        // Pause the stream device (if available) to stop callbacks/processing
+        int device = SDL_GetAudioStreamDevice(audio_stream);
+        if (device >= 0) {
+            SDL_PauseAudioDevice(device);
+        }
+
+        // Destroy the audio stream, after this the callback no longer runs
+        SDL_DestroyAudioStream(audio_stream);
+        audio_stream = NULL;
+    }
+    SDL_free(audio_ring.samples);
+    audio_ring.samples = NULL;
+
+    // Free our buffers
+    if (audio_system && audio_system->sound_buffer) {
+        SDL_free(audio_system->sound_buffer);
+        audio_system->sound_buffer = NULL;
+    }
+
+    SDL_Log("Audio system cleaned up");
+}
+
+// runs on SDL's audio thread whenever the device wants more, additional_amount is in bytes
+internal_func void SDLCALL AudioStreamCallback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount){
+    if (!debug_thread_events) {
+        NameDebugThread("audio");
+    }
+    TIMED_FUNCTION();
+    AudioRing *ring = (AudioRing *)userdata;
+    uint32 frame_bytes = SOUND_CHANNELS * sizeof(float32);
+    uint32 frames_wanted = (additional_amount > 0) ? (uint32)additional_amount / frame_bytes : 0;
+
+    uint32 read_index = (uint32)SDL_GetAtomicInt(&ring->read_index);
+    uint32 available = (uint32)SDL_GetAtomicInt(&ring->write_index) - read_index;
+    uint32 frame_count = SDL_min(frames_wanted, available);
+
+    // at most two pieces, the end of the ring and its start
+    uint32 start = read_index & (AUDIO_RING_FRAMES - 1);
+    uint32 first_count = SDL_min(frame_count, AUDIO_RING_FRAMES - start);
+    if (first_count) {
+        SDL_PutAudioStreamData(stream, ring->samples + start * SOUND_CHANNELS, (int)(first_count * frame_bytes));
+    }
+    if (frame_count > first_count) {
+        SDL_PutAudioStreamData(stream, ring->samples, (int)((frame_count - first_count) * frame_bytes));
+    }
+    SDL_SetAtomicInt(&ring->read_index, (int)(read_index + frame_count));
+
+    // the game fell behind, play silence rather than stall the device and let the main thread raise its target
+    uint32 missing = frames_wanted - frame_count;
+    if (missing && SDL_GetAtomicInt(&ring->started)) {
+        SDL_AddAtomicInt(&ring->underrun_count, 1);
+        SDL_AddAtomicInt(&ring->underrun_frames, (int)missing);
+    }
+    while (missing) {
+        uint32 silence_count = SDL_min(missing, AUDIO_SILENCE_FRAMES);
+        SDL_PutAudioStreamData(stream, audio_silence, (int)(silence_count * frame_bytes));
+        missing -= silence_count;
+    }
+}
+
+// called once a frame before the game runs, returns how many frames it should mix
+internal_func uint32 UpdateAudioLatency(AudioLatency *latency, AudioRing *ring, uint32 max_frames){
+    uint32 min_target = SOUND_FREQ * AUDIO_MIN_LATENCY_MS / 1000;
+    uint32 max_target = SOUND_FREQ * AUDIO_MAX_LATENCY_MS / 1000;
+    uint64 now_ms = SDL_GetTicks();
+
+    // every frame with new underruns backs off quickly, a long quiet stretch walks the target back down slowly
+    uint32 underruns = (uint32)SDL_GetAtomicInt(&ring->underrun_count);
+    if (underruns != latency->seen_underruns) {
+        latency->seen_underruns = underruns;
+        latency->last_adjust_ms = now_ms;
+        if (latency->target_frames < max_target) {
+            latency->target_frames = SDL_min(latency->target_frames + SOUND_FREQ * AUDIO_LATENCY_UP_MS / 1000, max_target);
+            PlatformLog(LogLevel_Warning, "Audio underrun, latency target raised to %.1f ms",
+                    (double64)latency->target_frames * 1000.0 / SOUND_FREQ);
+        }
+    } else if (now_ms - latency->last_adjust_ms >= AUDIO_LATENCY_SETTLE_MS && latency->target_frames > min_target) {
+        latency->last_adjust_ms = now_ms;
+        uint32 step = SOUND_FREQ * AUDIO_LATENCY_DOWN_MS / 1000;
+        latency->target_frames = (latency->target_frames > min_target + step) ? latency->target_frames - step : min_target;
+    }
+    latency->lowest_target_frames = SDL_min(latency->lowest_target_frames, latency->target_frames);
+    latency->highest_target_frames = SDL_max(latency->highest_target_frames, latency->target_frames);
+
+    // what the device has yet to play, minus whatever sits in its own hardware buffer
+    uint32 ring_frames = (uint32)SDL_GetAtomicInt(&ring->write_index) - (uint32)SDL_GetAtomicInt(&ring->read_index);
+    int stream_bytes = SDL_GetAudioStreamQueued(audio_stream);
+    uint32 queued = ring_frames + ((stream_bytes > 0) ? (uint32)stream_bytes / (SOUND_CHANNELS * sizeof(float32)) : 0);
+
+    if (SDL_GetAtomicInt(&ring->started)) {
+        latency->min_queued_frames = SDL_min(latency->min_queued_frames, queued);
+        latency->max_queued_frames = SDL_max(latency->max_queued_frames, queued);
+        latency->queued_frames_sum += queued;
+        ++latency->queued_count;
+    }
+
+    uint32 frame_count = (latency->target_frames > queued) ? latency->target_frames - queued : 0;
+    frame_count = SDL_min(frame_count, AUDIO_RING_FRAMES - ring_frames);
+    return SDL_min(frame_count, max_frames);
+}
+
+// only after the samples are in does the new write index publish them to the callback
+internal_func void WriteAudioRing(AudioRing *ring, float32 *samples, uint32 frame_count){
+    uint32 write_index = (uint32)SDL_GetAtomicInt(&ring->write_index);
+    uint32 start = write_index & (AUDIO_RING_FRAMES - 1);
+    uint32 first_count = SDL_min(frame_count, AUDIO_RING_FRAMES - start);
+
+    SDL_memcpy(ring->samples + start * SOUND_CHANNELS, samples, first_count * SOUND_CHANNELS * sizeof(float32));
+    SDL_memcpy(ring->samples, samples + first_count * SOUND_CHANNELS,
+               (frame_count - first_count) * SOUND_CHANNELS * sizeof(float32));
+
+    SDL_SetAtomicInt(&ring->write_index, (int)(write_index + frame_count));
+    SDL_SetAtomicInt(&ring->started, 1);
+}
+
+internal_func void LogAudioLatency(AudioLatency *latency, AudioRing *ring){
+    if (audio_mode != AudioMode_Callback || !latency->queued_count) {
+        return;
+    }
+    double64 ms_per_frame = 1000.0 / (double64)SOUND_FREQ;
+    SDL_Log("Audio latency: target %.1f ms (%.1f..%.1f), queued %.1f / %.1f / %.1f ms min/avg/max, %d underruns, %.1f ms of silence",
+            latency->target_frames * ms_per_frame, latency->lowest_target_frames * ms_per_frame,
+            latency->highest_target_frames * ms_per_frame, latency->min_queued_frames * ms_per_frame,
+            (double64)latency->queued_frames_sum / (double64)latency->queued_count * ms_per_frame,
+            latency->max_queued_frames * ms_per_frame, SDL_GetAtomicInt(&ring->underrun_count),
+            SDL_GetAtomicInt(&ring->underrun_frames) * ms_per_frame);
+}
+
+// ------------------------------------------------------------
+// Frame scheduler
+// ------------------------------------------------------------
+/*
+    Frames start on a fixed grid of deadlines, target_hz apart. After present
+    the main thread sleeps until sleep_margin_ns before the deadline and spins
+    the rest, the margin follows how late the OS actually wakes us, so the
+    spin stays short on a quiet machine and covers the oversleep on a busy one.
+    With --vsync present already blocks and the scheduler only measures.
+
+    The simulation is decoupled from that, BeginSchedulerFrame adds the real
+    time since the last frame to an accumulator and tells the game how many
+    update_hz steps to run and how far past the last one to draw. A stall
+    longer than SCHEDULER_MAX_UPDATES steps is dropped rather than caught up.
+*/
+internal_func uint64 GetProcessCpuNs(){
+    struct timespec cpu_time;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_time) != 0) {
+        return 0;
+    }
+    return (uint64)cpu_time.tv_sec * SDL_NS_PER_SECOND + (uint64)cpu_time.tv_nsec;
+}
+
+internal_func uint64 TicksToNs(uint64 ticks){
+    return (uint64)((double64)ticks * (double64)SDL_NS_PER_SECOND / (double64)perf_freq);
+}
+
+internal_func void ResetFramePacing(FramePacingStats *stats, uint64 now){
+    SDL_zerop(stats);
+    stats->start_ticks = now;
+    stats->start_cpu_ns = GetProcessCpuNs();
+}
+
+internal_func void InitScheduler(FrameScheduler *scheduler){
+    // the benchmark wants frames back to back unless asked to pace them
+    scheduler->paced = !bench.enabled || scheduler->target_hz;
+
+    uint32 refresh_hz = 0;
+    SDL_DisplayID display = SDL_GetDisplayForWindow(window);
+    const SDL_DisplayMode *mode = display ? SDL_GetCurrentDisplayMode(display) : NULL;
+    if (mode && mode->refresh_rate > 0.0f) {
+        refresh_hz = (uint32)(mode->refresh_rate + 0.5f);
+    }
+    if (!scheduler->target_hz) {
+        scheduler->target_hz = refresh_hz ? refresh_hz : 60;
+    }
+    if (!scheduler->update_hz) {
+        scheduler->update_hz = 60;
+    }
+
+    // present every n-th refresh, the nearest the display gets to the target
+    if (scheduler->vsync) {
+        int interval = refresh_hz ? (int)SDL_max(1, (refresh_hz + scheduler->target_hz / 2) / scheduler->target_hz) : 1;
+        if (!SDL_SetRenderVSync(renderer, interval)) {
+            SDL_Log("SDL_SetRenderVSync(%d) failed (%s), the scheduler sleeps instead", interval, SDL_GetError());
+            scheduler->vsync = false;
+        }
+    }
+
+    scheduler->frame_ticks = perf_freq / scheduler->target_hz;
+    scheduler->update_ticks = perf_freq / scheduler->update_hz;
+    scheduler->sleep_margin_ns = SCHEDULER_MIN_SLEEP_MARGIN_NS * 4;
+
+    uint64 now = SDL_GetPerformanceCounter();
+    ResetFramePacing(&scheduler->window, now);
+    ResetFramePacing(&scheduler->total, now);
+
+    SDL_Log("Frame scheduler: %s at %u Hz (display %u Hz), simulation at %u Hz",
+            scheduler->vsync ? "vsync" : (scheduler->paced ? "paced" : "unpaced"),
+            scheduler->target_hz, refresh_hz, scheduler->update_hz);
+}
+
+internal_func void BeginSchedulerFrame(FrameScheduler *scheduler, uint64 now, GameInputState *input){
+    if (!scheduler->frame_start) {
+        // the first frame always simulates one step, so there is something to draw
+        scheduler->accumulator = scheduler->update_ticks;
+        scheduler->deadline = now;
+    } else {
+        uint64 interval = now - scheduler->frame_start;
+        scheduler->accumulator += interval;
+
+        double64 interval_ms = TicksToMs(interval);
+        bool missed = (scheduler->paced || scheduler->vsync) && interval * 2 > scheduler->frame_ticks * 3;
+        FramePacingStats *all_stats[2] = { &scheduler->window, &scheduler->total };
+        for (uint32 stats_index = 0; stats_index < 2; ++stats_index) {
+            FramePacingStats *stats = all_stats[stats_index];
+            ++stats->frames;
+            stats->missed_frames += missed;
+            stats->interval_sum += interval_ms;
+            stats->interval_sum_squares += interval_ms * interval_ms;
+            stats->max_interval = SDL_max(stats->max_interval, interval_ms);
+        }
+    }
+    scheduler->frame_start = now;
+
+    // the grid only slips when a frame ran over by a whole period, a little late is made up next frame
+    scheduler->deadline += scheduler->frame_ticks;
+    if (scheduler->deadline < now) {
+        scheduler->deadline = now + scheduler->frame_ticks;
+    }
+
+    uint64 update_count = scheduler->accumulator / scheduler->update_ticks;
+    if (update_count > SCHEDULER_MAX_UPDATES) {
+        update_count = SCHEDULER_MAX_UPDATES;
+        scheduler->accumulator = scheduler->update_ticks * SCHEDULER_MAX_UPDATES;
+    }
+    scheduler->accumulator -= update_count * scheduler->update_ticks;
+
+    input->update_count = (uint32)update_count;
+    input->update_hz = scheduler->update_hz;
+    input->interpolation = (float32)((double64)scheduler->accumulator / (double64)scheduler->update_ticks);
+}
+
+// after present, waits for the next deadline unless vsync already did
+internal_func void EndSchedulerFrame(FrameScheduler *scheduler){
+    uint64 work_end = SDL_GetPerformanceCounter();
+    uint64 sleep_ticks = 0;
+    uint64 spin_ticks = 0;
+
+    if (scheduler->paced && !scheduler->vsync && work_end < scheduler->deadline) {
+        TIMED_BLOCK("WaitForFrameDeadline");
+        uint64 remaining_ns = TicksToNs(scheduler->deadline - work_end);
+        uint64 wake = work_end;
+        if (remaining_ns > scheduler->sleep_margin_ns) {
+            uint64 sleep_ns = remaining_ns - scheduler->sleep_margin_ns;
+            SDL_DelayNS(sleep_ns);
+            wake = SDL_GetPerformanceCounter();
+            sleep_ticks = wake - work_end;
+
+            // grow straight to what the OS overslept by, plus a quarter, then decay slowly
+            uint64 slept_ns = TicksToNs(sleep_ticks);
+            uint64 oversleep_ns = (slept_ns > sleep_ns) ? slept_ns - sleep_ns : 0;
+            uint64 margin = scheduler->sleep_margin_ns - scheduler->sleep_margin_ns / 64;
+            margin = SDL_max(margin, oversleep_ns + oversleep_ns / 4);
+            scheduler->sleep_margin_ns = SDL_clamp(margin, SCHEDULER_MIN_SLEEP_MARGIN_NS, SCHEDULER_MAX_SLEEP_MARGIN_NS);
+        }
+
+        uint64 spin_now = wake;
+        while (spin_now < scheduler->deadline) {
+            SDL_CPUPauseInstruction();
+            spin_now = SDL_GetPerformanceCounter();
+        }
+        spin_ticks = spin_now - wake;
+    }
+
+    FramePacingStats *all_stats[2] = { &scheduler->window, &scheduler->total };
+    for (uint32 stats_index = 0; stats_index < 2; ++stats_index) {
+        all_stats[stats_index]->work_ticks += work_end - scheduler->frame_start;
+        all_stats[stats_index]->sleep_ticks += sleep_ticks;
+        all_stats[stats_index]->spin_ticks += spin_ticks;
+    }
+
+    uint64 now = SDL_GetPerformanceCounter();
+    if (now - scheduler->window.start_ticks >= SCHEDULER_REPORT_SECONDS * perf_freq) {
+        if (!bench.enabled) {
+            char what[32];
+            SDL_snprintf(what, sizeof(what), "last %d s", SCHEDULER_REPORT_SECONDS);
+            LogFramePacing(scheduler, &scheduler->window, what);
+        }
+        ResetFramePacing(&scheduler->window, now);
+    }
+}
+
+// jitter is the standard deviation of the time between frame starts, CPU is the whole process so workers count too
+internal_func void LogFramePacing(FrameScheduler *scheduler, FramePacingStats *stats, char *what){
+    if (!stats->frames) {
+        return;
+    }
+    uint64 now = SDL_GetPerformanceCounter();
+    double64 wall_ms = TicksToMs(now - stats->start_ticks);
+    double64 mean_ms = stats->interval_sum / (double64)stats->frames;
+    double64 variance = stats->interval_sum_squares / (double64)stats->frames - mean_ms * mean_ms;
+    double64 jitter_ms = SDL_sqrt(SDL_max(variance, 0.0));
+    double64 cpu_ms = (double64)(GetProcessCpuNs() - stats->start_cpu_ns) / 1.0e6;
+
+    PlatformLog(LogLevel_Info, "Frame pacing (%s): %u frames, %.2f ms avg (target %.2f), jitter %.2f ms, worst %.2f ms, %u missed",
+            what, stats->frames, mean_ms, 1000.0 / (double64)scheduler->target_hz, jitter_ms,
+            stats->max_interval, stats->missed_frames);
+    PlatformLog(LogLevel_Info, "Frame pacing (%s): main thread %.1f%% working, %.1f%% sleeping, %.1f%% spinning, process CPU %.1f%% of one core",
+            what, 100.0 * TicksToMs(stats->work_ticks) / wall_ms, 100.0 * TicksToMs(stats->sleep_ticks) / wall_ms,
+            100.0 * TicksToMs(stats->spin_ticks) / wall_ms, 100.0 * cpu_ms / wall_ms);
+}
+
+// ------------------------------------------------------------
+// Dynamic resolution
+// ------------------------------------------------------------
+/*
+    The window size and the size the game renders at are separate: the
+    render buffer is the window size times steps / RESOLUTION_SCALE_STEPS
+    and is stretched back over the window by the SDL renderer or, with
+    --upscale nearest|bilinear, by UpscaleRenderBuffer on the render
+    threads into a window sized buffer that is uploaded instead.
+
+    Every frame the main thread's work, frame start to just before
+    present, goes into a moving average. Over RESOLUTION_DOWN_LOAD of the
+    scheduler's frame budget the scale drops straight to where the pixel
+    count, which goes with its square, should land at RESOLUTION_TARGET_LOAD.
+    Under RESOLUTION_UP_LOAD it climbs back one step at a time. Either way
+    the next RESOLUTION_SETTLE_FRAMES frames only measure the new size.
+
+    Neither a scale change nor a window resize allocates. The buffers'
+    pixels live in PixelPools that only commit more of their reservation
+    when a size outgrows them, and the texture is only ever recreated
+    bigger, half as big again as asked. While the window is being dragged
+    (resizes less than WINDOW_SETTLE_MS apart) a size that does not fit the
+    texture renders as big as fits and the SDL renderer stretches it, the
+    texture grows once the drag stops.
+*/
+internal_func void ApplyRenderResolution(void){
+    uint32 window_width = SDL_max(resolution.window_width, 1);
+    uint32 window_height = SDL_max(resolution.window_height, 1);
+    uint32 width = SDL_max((window_width * resolution.steps + RESOLUTION_SCALE_STEPS / 2) / RESOLUTION_SCALE_STEPS, 1);
+    uint32 height = SDL_max((window_height * resolution.steps + RESOLUTION_SCALE_STEPS / 2) / RESOLUTION_SCALE_STEPS, 1);
+    bool software = (upscale_mode != UpscaleMode_Renderer) && (width != window_width || height != window_height);
+    uint32 frame_width = software ? window_width : width;
+    uint32 frame_height = software ? window_height : height;
+
+    bool new_texture = false;
+    if (!texture || frame_width > texture_width || frame_height > texture_height) {
+        if (texture && window_settle_deadline) {
+            // still dragging, render what the texture has room for and let SDL stretch it
+            double64 fit = SDL_min(1.0, SDL_min((double64)texture_width / width, (double64)texture_height / height));
+            width = SDL_max((uint32)(width * fit), 1);
+            height = SDL_max((uint32)(height * fit), 1);
+            software = false;
+            frame_width = width;
+            frame_height = height;
+            ++deferred_resize_count;
+        } else {
+            new_texture = GrowTexture(frame_width, frame_height);
+        }
+    }
+
+    if (!render_buffer.pixels || render_buffer.width != width || render_buffer.height != height) {
+        ResizeRenderBuffer(&render_buffer, &render_pixel_pool, width, height, render_tile_hashes);
+    } else if (new_texture) {
+        SDL_memset(render_tile_hashes, 0, sizeof(render_tile_hashes));
+        MarkDirtyRectangle(&render_buffer, 0, 0, width, height);
+    }
+
+    if (!software) {
+        // the pool keeps the memory for next time
+        upscale_buffer.pixels = NULL;
+    } else if (!upscale_buffer.pixels || upscale_buffer.width != window_width || upscale_buffer.height != window_height) {
+        ResizeRenderBuffer(&upscale_buffer, &upscale_pixel_pool, window_width, window_height, NULL);
+        upscale_redraw_all = true;
+    } else if (new_texture) {
+        MarkDirtyRectangle(&upscale_buffer, 0, 0, window_width, window_height);
+        upscale_redraw_all = true;
+    }
+
+    present_width = frame_width;
+    present_height = frame_height;
+}
+
+internal_func void UpdateDynamicResolution(ResolutionScaler *scaler, uint64 work_ticks){
+    ++scaler->frame_count;
+    scaler->steps_sum += scaler->steps;
+    scaler->min_steps = SDL_min(scaler->min_steps, scaler->steps);
+    if (!scaler->dynamic) {
+        return;
+    }
+
+    double64 work_ms = TicksToMs(work_ticks);
+    scaler->smoothed_ms = (scaler->smoothed_ms > 0.0) ? scaler->smoothed_ms + (work_ms - scaler->smoothed_ms) * 0.1 : work_ms;
+    if (scaler->settle_frames) {
+        --scaler->settle_frames;
+        return;
+    }
+
+    double64 budget_ms = TicksToMs(scheduler.frame_ticks);
+    uint32 steps = scaler->steps;
+    if (scaler->smoothed_ms > budget_ms * RESOLUTION_DOWN_LOAD && steps > RESOLUTION_MIN_STEPS) {
+        uint32 target = (uint32)((double64)steps * SDL_sqrt(budget_ms * RESOLUTION_TARGET_LOAD / scaler->smoothed_ms));
+        steps = SDL_clamp(target, RESOLUTION_MIN_STEPS, steps - 1);
+    } else if (scaler->smoothed_ms < budget_ms * RESOLUTION_UP_LOAD && steps < RESOLUTION_SCALE_STEPS) {
+        ++steps;
+    }
+    if (steps == scaler->steps) {
+        return;
+    }
+
+    scaler->steps = steps;
+    ApplyRenderResolution();
+
+    ResolutionChange *change = scaler->history + (scaler->change_count++ % RESOLUTION_HISTORY_COUNT);
+    change->frame = scaler->frame_count;
+    change->seconds = TicksToMs(SDL_GetPerformanceCounter() - perf_start) / 1000.0;
+    change->width = render_buffer.width;
+    change->height = render_buffer.height;
+    change->work_ms = scaler->smoothed_ms;
+    PlatformLog(LogLevel_Info, "Render resolution %ux%u (%.0f%% of %ux%u), work %.2f ms of a %.2f ms frame",
+                change->width, change->height, 100.0 * (double64)steps / RESOLUTION_SCALE_STEPS,
+                scaler->window_width, scaler->window_height, change->work_ms, budget_ms);
+
+    // the new size's cost is measured from scratch
+    scaler->settle_frames = RESOLUTION_SETTLE_FRAMES;
+    scaler->smoothed_ms = 0.0;
+}
+
+// the metric: how often the size moved, where it spent its time and the last changes in order
+internal_func void LogResolutionHistory(ResolutionScaler *scaler){
+    if (!scaler->frame_count) {
+        return;
+    }
+    PlatformLog(LogLevel_Info, "Resolution: %s, %s upscale, window %ux%u, rendering %ux%u",
+                scaler->dynamic ? "dynamic" : "fixed", upscale_mode_names[upscale_mode],
+                scaler->window_width, scaler->window_height, render_buffer.width, render_buffer.height);
+    PlatformLog(LogLevel_Info, "Resolution: %u changes over %llu frames, average scale %.2f, lowest %.2f",
+                scaler->change_count, (unsigned long long)scaler->frame_count,
+                (double64)scaler->steps_sum / (double64)scaler->frame_count / RESOLUTION_SCALE_STEPS,
+                (double64)scaler->min_steps / RESOLUTION_SCALE_STEPS);
+    PlatformLog(LogLevel_Info, "Resize: %u textures created (now %ux%u), %u sizes deferred, pixel pools grown %u times to %.1f MB, "
+                "scratch %u times to %.1f MB",
+                texture_create_count, texture_width, texture_height, deferred_resize_count,
+                render_pixel_pool.grow_count + upscale_pixel_pool.grow_count,
+                (double64)(render_pixel_pool.committed + upscale_pixel_pool.committed) / (double64)Megabytes(1),
+                render_scratch_pool.grow_count, (double64)render_scratch_pool.committed / (double64)Megabytes(1));
+
+    uint32 first = (scaler->change_count > RESOLUTION_HISTORY_COUNT) ? scaler->change_count - RESOLUTION_HISTORY_COUNT : 0;
+    for (uint32 change_index = first; change_index < scaler->change_count; ++change_index) {
+        ResolutionChange *change = scaler->history + (change_index % RESOLUTION_HISTORY_COUNT);
+        PlatformLog(LogLevel_Info, "    frame %6llu at %7.2f s: %ux%u after %.2f ms frames",
+                    (unsigned long long)change->frame, change->seconds, change->width, change->height, change->work_ms);
+    }
+}
+
+// what a user dragging the window's corner sends, one resize per frame for
+// RESIZE_DRAG_FRAMES frames, then nothing until the size has settled
+#define RESIZE_DRAG_FRAMES 60
+
+internal_func void DragBenchWindow(void *appstate){
+    bool holding = (bench.drag_phase & 1);
+    if (holding) {
+        if (!window_settle_deadline) {
+            bench.drag_phase = (bench.drag_phase + 1) & 3;
+            bench.drag_frame = 0;
+        }
+        return;
+    }
+
+    bool growing = (bench.drag_phase == 0);
+    uint32 step = ++bench.drag_frame;
+    uint32 grown = growing ? step : RESIZE_DRAG_FRAMES - step;
+    SDL_Event event = {0};
+    event.type = SDL_EVENT_WINDOW_RESIZED;
+    event.window.data1 = (int)(bench.width + bench.width / 2 * grown / RESIZE_DRAG_FRAMES);
+    event.window.data2 = (int)(bench.height + bench.height / 2 * grown / RESIZE_DRAG_FRAMES);
+    SDL_AppEvent(appstate, &event);
+
+    if (step == RESIZE_DRAG_FRAMES) {
+        ++bench.drag_phase;
+        bench.drag_frame = 0;
+    }
+}
+
+// ------------------------------------------------------------
+// Profiler
+// ------------------------------------------------------------
+/*
+    The collecting side of handmade_debug.h. Every frame the main thread
+    drains each registered thread's ring into one big ring of
+    StoredDebugEvents, turning the literal names into indices into a table
+    of copies, and closes a DebugFrame over what it just drained. A frame is
+    one SDL_AppIterate call, so the scheduler's sleep is inside it.
+
+    Nothing is paired up while the game runs. WriteChromeTrace and
+    LogProfileSummary walk the frames still held, match every end with its
+    begin on the same thread and hand out complete blocks.
+*/
+DebugThreadEvents *PlatformGetDebugThreadEvents(void){
+    uint64 thread_id = (uint64)SDL_GetCurrentThreadID();
+    uint32 thread_count = SDL_min((uint32)SDL_GetAtomicInt(&profiler.thread_count), DEBUG_MAX_THREADS);
+    for (uint32 thread_index = 0; thread_index < thread_count; ++thread_index) {
+        // the game library and the platform both ask, a thread keeps one slot however many modules record
+        DebugThreadEvents *thread = (DebugThreadEvents *)SDL_GetAtomicPointer((void **)&profiler.threads[thread_index]);
+        if (thread && thread->thread_id == thread_id) {
+            return thread;
+        }
+    }
+
+    int thread_index = SDL_AddAtomicInt(&profiler.thread_count, 1);
+    if (thread_index >= DEBUG_MAX_THREADS) {
+        return NULL;
+    }
+    DebugThreadEvents *thread = (DebugThreadEvents *)SDL_calloc(1, sizeof(DebugThreadEvents));
+    if (!thread) {
+        return NULL;
+    }
+    thread->thread_id = thread_id;
+    SDL_snprintf(thread->name, sizeof(thread->name), "thread %d", thread_index);
+    SDL_SetAtomicPointer((void **)&profiler.threads[thread_index], thread);
+    return thread;
+}
+
+internal_func bool InitProfiler(void){
+    profiler.events = (StoredDebugEvent *)SDL_calloc(DEBUG_EVENT_RING_COUNT, sizeof(StoredDebugEvent));
+    if (!profiler.events) {
+        SDL_Log("Failed to allocate the profiler's event ring");
+        return false;
+    }
+    profiler.calibration_counter = SDL_GetPerformanceCounter();
+    profiler.calibration_clock = ReadDebugClock();
+    profiler.frame_begin_clock = profiler.calibration_clock;
+    NameDebugThread("main");
+    return true;
+}
+
+// threads may still record after this, they find no profiler and their events are never collected
+internal_func void DestroyProfiler(void){
+    SDL_free(profiler.events);
+    profiler.events = NULL;
+}
+
+// shows up in traces instead of "thread N"
+internal_func void NameDebugThread(char *name){
+    DebugThreadEvents *thread = PlatformGetDebugThreadEvents();
+    if (thread) {
+        SDL_strlcpy(thread->name, name, sizeof(thread->name));
+    }
+}
+
+internal_func uint16 InternDebugName(char *name){
+    uint32 slot = (uint32)(((uintptr_t)name >> 3) * 2654435761u) & (DEBUG_NAME_CACHE_COUNT - 1);
+    for (uint32 probe = 0; probe < DEBUG_NAME_CACHE_COUNT; ++probe) {
+        uint32 index = (slot + probe) & (DEBUG_NAME_CACHE_COUNT - 1);
+        if (profiler.name_cache_keys[index] == name) {
+            return profiler.name_cache_values[index];
+        }
+        if (!profiler.name_cache_keys[index]) {
+            slot = index;
+            break;
+        }
+    }
+
+    // a new address, the same text may already be in from before a reload
+    uint16 name_index = 0;
+    for (; name_index < profiler.name_count; ++name_index) {
+        if (SDL_strncmp(profiler.names[name_index], name, DEBUG_NAME_LENGTH - 1) == 0) {
+            break;
+        }
+    }
+    if (name_index == profiler.name_count) {
+        if (profiler.name_count == DEBUG_MAX_NAMES) {
+            return DEBUG_MAX_NAMES - 1;
+        }
+        // names go into JSON as they are, no quotes or backslashes
+        char *dest = profiler.names[profiler.name_count++];
+        SDL_strlcpy(dest, name, DEBUG_NAME_LENGTH);
+        for (char *at = dest; *at; ++at) {
+            if (*at == '"' || *at == '\\' || (uint8)*at < ' ') {
+                *at = '_';
+            }
+        }
+    }
+
+    if (!profiler.name_cache_keys[slot]) {
+        profiler.name_cache_keys[slot] = name;
+        profiler.name_cache_values[slot] = name_index;
+    }
+    return name_index;
+}
+
+internal_func void CollectDebugEvents(void){
+    if (!profiler.events) {
+        return;
+    }
+    uint32 thread_count = SDL_min((uint32)SDL_GetAtomicInt(&profiler.thread_count), DEBUG_MAX_THREADS);
+    for (uint32 thread_index = 0; thread_index < thread_count; ++thread_index) {
+        DebugThreadEvents *thread = (DebugThreadEvents *)SDL_GetAtomicPointer((void **)&profiler.threads[thread_index]);
+        if (!thread) {
+            continue;
+        }
+        uint32 read_index = thread->read_index;
+        uint32 write_index = __atomic_load_n(&thread->write_index, __ATOMIC_ACQUIRE);
+        for (; read_index != write_index; ++read_index) {
+            DebugEvent *event = thread->events + (read_index & (DEBUG_THREAD_EVENT_COUNT - 1));
+            StoredDebugEvent *stored = profiler.events + (profiler.event_count++ & (DEBUG_EVENT_RING_COUNT - 1));
+            stored->clock = event->clock;
+            stored->name_index = InternDebugName(event->name);
+            stored->type = (uint8)event->type;
+            stored->thread_index = (uint8)thread_index;
+        }
+        // the slots are the thread's again only once the copies are done
+        __atomic_store_n(&thread->read_index, read_index, __ATOMIC_RELEASE);
+    }
+}
+
+// once per SDL_AppIterate, everything drained since the last call becomes one frame
+internal_func void EndDebugFrame(void){
+    if (!profiler.events) {
+        return;
+    }
+    CollectDebugEvents();
+    uint64 clock = ReadDebugClock();
+    DebugFrame *frame = profiler.frames + (profiler.frame_count++ % DEBUG_FRAME_COUNT);
+    frame->begin_clock = profiler.frame_begin_clock;
+    frame->end_clock = clock;
+    frame->first_event = profiler.frame_first_event;
+    frame->event_count = (uint32)(profiler.event_count - profiler.frame_first_event);
+    profiler.frame_begin_clock = clock;
+    profiler.frame_first_event = profiler.event_count;
+}
+
+// before game code is unloaded, its literals are about to go and a new library may reuse the addresses
+internal_func void ForgetDebugNames(void){
+    CollectDebugEvents();
+    SDL_zeroa(profiler.name_cache_keys);
+}
+
+// oldest frame whose events the ring has not overwritten yet
+internal_func uint64 FirstHeldDebugFrame(void){
+    uint64 first = (profiler.frame_count > DEBUG_FRAME_COUNT) ? profiler.frame_count - DEBUG_FRAME_COUNT : 0;
+    while (first < profiler.frame_count &&
+           profiler.event_count - profiler.frames[first % DEBUG_FRAME_COUNT].first_event > DEBUG_EVENT_RING_COUNT) {
+        ++first;
+    }
+    return first;
+}
+
+internal_func double64 DebugClocksPerMicrosecond(void){
+#if DEBUG_CLOCK_IS_CYCLE_COUNTER
+    uint64 clock = ReadDebugClock();
+    uint64 counter = SDL_GetPerformanceCounter();
+    double64 microseconds = (double64)(counter - profiler.calibration_counter) * 1.0e6 / (double64)perf_freq;
+    if (microseconds > 0.0 && clock > profiler.calibration_clock) {
+        return (double64)(clock - profiler.calibration_clock) / microseconds;
+    }
+#endif
+    return (double64)perf_freq / 1.0e6;
+}
+
+typedef void DebugBlockCallback(void *data, uint32 name_index, uint32 thread_index, uint64 begin_clock, uint64 end_clock);
+
+typedef struct {
+    uint16 name_index;
+    uint64 clock;
+} OpenDebugBlock;
+
+// pairs begins and ends per thread, in collection order, which per thread is the order they happened in
+internal_func void WalkDebugBlocks(uint64 first_frame, DebugBlockCallback *callback, void *data){
+    local_persist OpenDebugBlock stacks[DEBUG_MAX_THREADS][DEBUG_MAX_DEPTH];
+    uint32 depths[DEBUG_MAX_THREADS] = {0};
+
+    for (uint64 frame_index = first_frame; frame_index < profiler.frame_count; ++frame_index) {
+        DebugFrame *frame = profiler.frames + (frame_index % DEBUG_FRAME_COUNT);
+        for (uint64 event_index = frame->first_event; event_index < frame->first_event + frame->event_count; ++event_index) {
+            StoredDebugEvent *event = profiler.events + (event_index & (DEBUG_EVENT_RING_COUNT - 1));
+            uint32 *depth = depths + event->thread_index;
+            OpenDebugBlock *stack = stacks[event->thread_index];
+            if (event->type == DebugEvent_BeginBlock) {
+                if (*depth < DEBUG_MAX_DEPTH) {
+                    stack[*depth].name_index = event->name_index;
+                    stack[*depth].clock = event->clock;
+                }
+                ++*depth;
+                continue;
+            }
+
+            // an end with no begin started before the first frame held, or its begin was dropped
+            uint32 match = *depth;
+            while (match && (match > DEBUG_MAX_DEPTH || stack[match - 1].name_index != event->name_index)) {
+                --match;
+            }
+            if (match) {
+                callback(data, event->name_index, event->thread_index, stack[match - 1].clock, event->clock);
+                *depth = match - 1;
+            }
+        }
+    }
+}
+
+typedef struct {
+    char *at;
+    char *end;
+    uint64 origin;                      // clock of the first frame, trace time 0
+    double64 clocks_per_us;
+    uint32 block_count;
+} ChromeTraceWriter;
+
+internal_func void WriteTraceText(ChromeTraceWriter *writer, char *format, ...){
+    va_list args;
+    va_start(args, format);
+    int length = SDL_vsnprintf(writer->at, (size_t)(writer->end - writer->at), format, args);
+    va_end(args);
+    if (length > 0) {
+        writer->at = SDL_min(writer->at + length, writer->end - 1);
+    }
+}
+
+internal_func void WriteTraceBlock(void *data, uint32 name_index, uint32 thread_index, uint64 begin_clock, uint64 end_clock){
+    ChromeTraceWriter *writer = (ChromeTraceWriter *)data;
+    double64 begin_us = (double64)(int64_t)(begin_clock - writer->origin) / writer->clocks_per_us;
+    double64 duration_us = (double64)(end_clock - begin_clock) / writer->clocks_per_us;
+    WriteTraceText(writer, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                   profiler.names[name_index], begin_us, duration_us, thread_index);
+    ++writer->block_count;
+}
+
+// the frames still held as chrome://tracing JSON, one complete ("X") event per block, frame starts as global instants
+internal_func bool WriteChromeTrace(char *filename){
+    CollectDebugEvents();
+    uint64 first_frame = FirstHeldDebugFrame();
+    if (!profiler.events || first_frame == profiler.frame_count) {
+        SDL_Log("Trace: no frames recorded yet");
+        return false;
+    }
+
+    uint64 event_count = profiler.event_count - profiler.frames[first_frame % DEBUG_FRAME_COUNT].first_event;
+    uint64 frame_count = profiler.frame_count - first_frame;
+    uint64 size = (event_count / 2 + 1) * 128 + (frame_count + DEBUG_MAX_THREADS + 4) * 128;
+    char *text = (char *)SDL_malloc(size);
+    if (!text) {
+        SDL_Log("Trace: failed to allocate %.1f MB", (double64)size / (double64)Megabytes(1));
+        return false;
+    }
+
+    ChromeTraceWriter writer = {0};
+    writer.at = text;
+    writer.end = text + size;
+    writer.origin = profiler.frames[first_frame % DEBUG_FRAME_COUNT].begin_clock;
+    writer.clocks_per_us = DebugClocksPerMicrosecond();
+
+    WriteTraceText(&writer, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"handmade\"}}");
+    uint32 thread_count = SDL_min((uint32)SDL_GetAtomicInt(&profiler.thread_count), DEBUG_MAX_THREADS);
+    for (uint32 thread_index = 0; thread_index < thread_count; ++thread_index) {
+        DebugThreadEvents *thread = (DebugThreadEvents *)SDL_GetAtomicPointer((void **)&profiler.threads[thread_index]);
+        if (thread) {
+            WriteTraceText(&writer, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                           thread_index, thread->name);
+        }
+    }
+    for (uint64 frame_index = first_frame; frame_index < profiler.frame_count; ++frame_index) {
+        DebugFrame *frame = profiler.frames + (frame_index % DEBUG_FRAME_COUNT);
+        WriteTraceText(&writer, ",\n{\"name\":\"frame %llu\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":0}",
+                       (unsigned long long)frame_index, (double64)(frame->begin_clock - writer.origin) / writer.clocks_per_us);
+    }
+    WalkDebugBlocks(first_frame, WriteTraceBlock, &writer);
+    WriteTraceText(&writer, "\n]}\n");
+
+    bool written = PlatformWriteEntireFile(filename, (uint64)(writer.at - text), text);
+    SDL_free(text);
+    if (written) {
+        SDL_Log("Trace: %llu frames, %u blocks written to %s", (unsigned long long)frame_count, writer.block_count, filename);
+    } else {
+        SDL_Log("Trace: failed to write %s", filename);
+    }
+    return written;
+}
+
+typedef struct {
+    uint64 ticks[DEBUG_MAX_NAMES];
+    uint32 hit_count[DEBUG_MAX_NAMES];
+} ProfileSummary;
+
+internal_func void AddSummaryBlock(void *data, uint32 name_index, uint32 thread_index, uint64 begin_clock, uint64 end_clock){
+    ProfileSummary *summary = (ProfileSummary *)data;
+    summary->ticks[name_index] += end_clock - begin_clock;
+    ++summary->hit_count[name_index];
+}
+
+// the costliest blocks over the frames held, inclusive of what they call and summed over threads
+internal_func void LogProfileSummary(void){
+    CollectDebugEvents();
+    uint64 first_frame = FirstHeldDebugFrame();
+    uint64 frame_count = profiler.frame_count - first_frame;
+    if (!profiler.events || !frame_count) {
+        return;
+    }
+
+    local_persist ProfileSummary summary;
+    SDL_zero(summary);
+    WalkDebugBlocks(first_frame, AddSummaryBlock, &summary);
+
+    uint32 dropped_count = 0;
+    uint32 thread_count = SDL_min((uint32)SDL_GetAtomicInt(&profiler.thread_count), DEBUG_MAX_THREADS);
+    for (uint32 thread_index = 0; thread_index < thread_count; ++thread_index) {
+        DebugThreadEvents *thread = (DebugThreadEvents *)SDL_GetAtomicPointer((void **)&profiler.threads[thread_index]);
+        if (thread) {
+            dropped_count += __atomic_load_n(&thread->dropped_count, __ATOMIC_RELAXED);
+        }
+    }
+    SDL_Log("Profile: last %llu frames, %u threads, %u events dropped, ms per frame (calls per frame)",
+            (unsigned long long)frame_count, thread_count, dropped_count);
+
+    double64 clocks_per_ms = DebugClocksPerMicrosecond() * 1000.0;
+    for (uint32 row = 0; row < DEBUG_SUMMARY_ROWS; ++row) {
+        uint32 best = DEBUG_MAX_NAMES;
+        for (uint32 name_index = 0; name_index < profiler.name_count; ++name_index) {
+            if (summary.hit_count[name_index] && (best == DEBUG_MAX_NAMES || summary.ticks[name_index] > summary.ticks[best])) {
+                best = name_index;
+            }
+        }
+        if (best == DEBUG_MAX_NAMES) {
+            break;
+        }
+        SDL_Log("  %-28s %9.3f ms (%.1f)", profiler.names[best],
+                (double64)summary.ticks[best] / clocks_per_ms / (double64)frame_count,
+                (double64)summary.hit_count[best] / (double64)frame_count);
+        summary.hit_count[best] = 0;
+    }
+}
+
+// ------------------------------------------------------------
+// Logger
+// ------------------------------------------------------------
+/*
+    Bounded multi producer, single consumer ring of fixed size LogRecords.
+    A producer claims the record at write_index with a compare and swap,
+    fills it in place and publishes it by storing index + 1 in its sequence;
+    the writer thread takes records in order once their sequence says so and
+    hands them back with index + LOG_RING_COUNT. Nothing blocks, a full ring
+    drops the message and counts it.
+
+    PlatformLog never formats. It walks the format once to pull each
+    argument off the va_list as what it is, and copies %s strings into the
+    record, so the cost on the calling thread is a few hundred bytes of
+    stores however slow the terminal or disk is. The writer formats with
+    the caller's literal later, which is why game code reloads wait for
+    FlushLog first. SDL_Log output is routed onto the same ring as text, so
+    the two keep their order.
+*/
+enum {
+    LogArg_Int,
+    LogArg_Unsigned,
+    LogArg_Double,
+    LogArg_Pointer,
+    LogArg_String,
+    LogArg_Unsupported,
+};
+
+// one conversion in a printf format, at points at its '%'
+typedef struct {
+    uint32 length;                      // the whole specifier
+    uint32 prefix_length;               // '%', flags, width and precision, without the length modifier
+    uint32 star_count;                  // int arguments taken by '*' before the value
+    uint32 arg_type;                    // LogArg_*
+    char size;                          // 'H' hh, 'h', 'l', 'q' ll, 'z', 'j', 't' or 0
+    char conversion;
+} LogSpec;
+
+internal_func bool IsLogDigit(char c){
+    return c >= '0' && c <= '9';
+}
+
+internal_func LogSpec ParseLogSpec(char *at){
+    LogSpec spec = {0};
+    char *start = at++;
+    while (*at == '-' || *at == '+' || *at == ' ' || *at == '#' || *at == '0') {
+        ++at;
+    }
+    if (*at == '*') {
+        ++spec.star_count;
+        ++at;
+    }
+    while (IsLogDigit(*at)) {
+        ++at;
+    }
+    if (*at == '.') {
+        ++at;
+        if (*at == '*') {
+            ++spec.star_count;
+            ++at;
+        }
+        while (IsLogDigit(*at)) {
+            ++at;
+        }
     }
-    return SDL_APP_CONTINUE;
+    spec.prefix_length = (uint32)(at - start);
+
+    if (at[0] == 'h' && at[1] == 'h') {
+        spec.size = 'H';
+        at += 2;
+    } else if (at[0] == 'l' && at[1] == 'l') {
+        spec.size = 'q';
+        at += 2;
+    } else if (*at == 'h' || *at == 'l' || *at == 'z' || *at == 'j' || *at == 't') {
+        spec.size = *at++;
+    }
+
+    spec.conversion = *at;
+    switch (spec.conversion) {
+        case 'd': case 'i': case 'c': spec.arg_type = LogArg_Int; break;
+        case 'u': case 'x': case 'X': case 'o': spec.arg_type = LogArg_Unsigned; break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': spec.arg_type = LogArg_Double; break;
+        case 'p': spec.arg_type = LogArg_Pointer; break;
+        case 's': spec.arg_type = LogArg_String; break;
+        default: spec.arg_type = LogArg_Unsupported; break;
+    }
+    if (*at) {
+        ++at;
+    }
+    spec.length = (uint32)(at - start);
+    return spec;
 }
 
-// --- Called once per frame (your main loop logic goes here) ---
-SDL_AppResult SDL_AppIterate(void *appstate){
+// NULL when the ring is full, index is what the record's sequence must be set to, plus one, to publish it
+internal_func LogRecord *ClaimLogRecord(uint32 *index){
+    uint32 write_index = (uint32)SDL_GetAtomicInt(&logger.write_index);
+    for (;;) {
+        LogRecord *record = logger.records + (write_index & (LOG_RING_COUNT - 1));
+        int32 difference = (int32)((uint32)SDL_GetAtomicInt(&record->sequence) - write_index);
+        if (difference == 0) {
+            if (SDL_CompareAndSwapAtomicInt(&logger.write_index, (int)write_index, (int)(write_index + 1))) {
+                *index = write_index;
+                return record;
+            }
+        } else if (difference < 0) {
+            SDL_AddAtomicInt(&logger.dropped_count, 1);
+            return NULL;
+        }
+        write_index = (uint32)SDL_GetAtomicInt(&logger.write_index);
+    }
+}
 
-    // If a quit was requested, return success immediately — do not run any frame work.
-    if (app_is_quitting) {
-        // Log once if you want:
-        SDL_Log("App iterate: quitting flag set, exiting iterate.");
-        return SDL_APP_SUCCESS;
+internal_func SDL_LogPriority LogLevelToPriority(uint32 level){
+    switch (level) {
+        case LogLevel_Debug: return SDL_LOG_PRIORITY_DEBUG;
+        case LogLevel_Warning: return SDL_LOG_PRIORITY_WARN;
+        case LogLevel_Error: return SDL_LOG_PRIORITY_ERROR;
+        default: return SDL_LOG_PRIORITY_INFO;
     }
+}
 
-    // timing
-    uint64 now = SDL_GetPerformanceCounter();
+void PlatformLog(uint32 level, char *format, ...){
+    if (level < log_level) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    if (!logger.records) {
+        SDL_LogMessageV(SDL_LOG_CATEGORY_APPLICATION, LogLevelToPriority(level), format, args);
+        va_end(args);
+        return;
+    }
+
+    uint32 index = 0;
+    LogRecord *record = ClaimLogRecord(&index);
+    if (!record) {
+        va_end(args);
+        return;
+    }
+    record->level = (uint8)level;
+    record->arg_count = 0;
+    record->truncated = false;
+    record->counter = SDL_GetPerformanceCounter();
+    record->format = format;
 
-    dt = (double64)(now - last_counter) / (double64)perf_freq;
-    last_counter = now;
+    uint32 text_used = 0;
+    for (char *at = format; *at;) {
+        if (at[0] != '%') {
+            ++at;
+            continue;
+        }
+        if (at[1] == '%') {
+            at += 2;
+            continue;
+        }
+        LogSpec spec = ParseLogSpec(at);
+        at += spec.length;
+        if (spec.arg_type == LogArg_Unsupported || record->arg_count + spec.star_count + 1 > LOG_MAX_ARGS) {
+            record->truncated = true;
+            break;
+        }
 
-    t_total = (double64)(now - perf_start) / (double64)perf_freq;
+        uint64 *arg = record->args + record->arg_count;
+        for (uint32 star_index = 0; star_index < spec.star_count; ++star_index) {
+            *arg++ = (uint64)(int64_t)va_arg(args, int);
+        }
+        switch (spec.arg_type) {
+            case LogArg_Int: {
+                int64_t value;
+                switch (spec.size) {
+                    case 'l': value = va_arg(args, long); break;
+                    case 'q': value = va_arg(args, long long); break;
+                    case 'z': case 't': value = va_arg(args, ptrdiff_t); break;
+                    case 'j': value = va_arg(args, intmax_t); break;
+                    case 'H': value = (signed char)va_arg(args, int); break;
+                    case 'h': value = (short)va_arg(args, int); break;
+                    default: value = va_arg(args, int); break;
+                }
+                *arg = (uint64)value;
+            } break;
 
-    // Debug output
-    // static uint32 frame_count = 0;
-    // if (++frame_count % 60 == 0) {
-    //     SDL_Log("FPS: %.1f   dt: %.6f   t_total: %.2f",
-    //         1.0 / dt, dt, t_total);
-    // }
+            case LogArg_Unsigned: {
+                switch (spec.size) {
+                    case 'l': *arg = va_arg(args, unsigned long); break;
+                    case 'q': *arg = va_arg(args, unsigned long long); break;
+                    case 'z': case 't': *arg = va_arg(args, size_t); break;
+                    case 'j': *arg = va_arg(args, uintmax_t); break;
+                    case 'H': *arg = (unsigned char)va_arg(args, unsigned int); break;
+                    case 'h': *arg = (unsigned short)va_arg(args, unsigned int); break;
+                    default: *arg = va_arg(args, unsigned int); break;
+                }
+            } break;
 
-    // Exit automatically after 5 seconds
-    if (t_total > 100) {
-        SDL_Log("Timeout reached, exiting...");
-        return SDL_APP_SUCCESS;
+            case LogArg_Double: {
+                double64 value = va_arg(args, double);
+                SDL_memcpy(arg, &value, sizeof(value));
+            } break;
+
+            case LogArg_Pointer: {
+                *arg = (uint64)(uintptr_t)va_arg(args, void *);
+            } break;
+
+            case LogArg_String: {
+                char *string = va_arg(args, char *);
+                if (!string) {
+                    string = "(null)";
+                }
+                if (text_used == LOG_TEXT_SIZE) {
+                    record->truncated = true;
+                    break;
+                }
+                // a string that does not fit is cut short, the message still goes out
+                uint32 length = 0;
+                while (string[length] && text_used + length + 1 < LOG_TEXT_SIZE) {
+                    record->text[text_used + length] = string[length];
+                    ++length;
+                }
+                record->text[text_used + length] = 0;
+                *arg = text_used;
+                text_used += length + 1;
+            } break;
+        }
+        if (record->truncated) {
+            break;
+        }
+        record->arg_count = (uint8)(arg + 1 - record->args);
     }
+    va_end(args);
 
-    input.is_analog = false;
+    SDL_SetAtomicInt(&record->sequence, (int)(index + 1));
+}
 
-    // copy analog values for next frame
-    input.start_x = input.end_x;
-    input.start_y = input.end_y;
+internal_func void SDLCALL LogSDLMessage(void *userdata, int category, SDL_LogPriority priority, const char *message){
+    uint32 level = (priority <= SDL_LOG_PRIORITY_DEBUG) ? LogLevel_Debug :
+                   (priority == SDL_LOG_PRIORITY_INFO) ? LogLevel_Info :
+                   (priority == SDL_LOG_PRIORITY_WARN) ? LogLevel_Warning : LogLevel_Error;
+    if (level < log_level) {
+        return;
+    }
+    uint32 index = 0;
+    LogRecord *record = ClaimLogRecord(&index);
+    if (!record) {
+        return;
+    }
+    record->level = (uint8)level;
+    record->arg_count = 0;
+    record->counter = SDL_GetPerformanceCounter();
+    record->format = NULL;
+    record->truncated = (SDL_strlcpy(record->text, message, LOG_TEXT_SIZE) >= LOG_TEXT_SIZE);
+    SDL_SetAtomicInt(&record->sequence, (int)(index + 1));
+}
 
-    // determine if stick is currently moved outside deadzone
-    input.is_analog = (fabsf(input.end_x) >= STICK_DEADZONE || fabsf(input.end_y) >= STICK_DEADZONE);
+// the writer's half of PlatformLog, one conversion at a time with the argument the caller passed
+internal_func uint32 FormatLogRecord(LogRecord *record, char *dest, uint32 size){
+    if (!record->format) {
+        return (uint32)SDL_min(SDL_strlcpy(dest, record->text, size), size - 1);
+    }
 
-    // Determine how much audio is currently queued in the stream
-    uint32 queued_bytes = SDL_GetAudioStreamAvailable(audio_stream);
-    uint32 target_bytes = (uint32)(audio_system.buffer_size * 3);  // keep ~0.6s buffered
+    uint32 used = 0;
+    uint32 arg_index = 0;
+    for (char *at = record->format; *at && used + 1 < size;) {
+        if (at[0] != '%') {
+            dest[used++] = *at++;
+            continue;
+        }
+        if (at[1] == '%') {
+            dest[used++] = '%';
+            at += 2;
+            continue;
+        }
+        LogSpec spec = ParseLogSpec(at);
+        if (arg_index + spec.star_count + 1 > record->arg_count) {
+            break;
+        }
 
-    soundBufferNeedsFilling = (queued_bytes < target_bytes);
+        // flags, width and precision as the caller wrote them, the value widened to 64 bits
+        char spec_text[32];
+        uint32 prefix_length = SDL_min(spec.prefix_length, (uint32)sizeof(spec_text) - 4);
+        SDL_memcpy(spec_text, at, prefix_length);
+        char *end = spec_text + prefix_length;
+        if (spec.arg_type == LogArg_Int || spec.arg_type == LogArg_Unsigned) {
+            if (spec.conversion != 'c') {
+                *end++ = 'l';
+                *end++ = 'l';
+            }
+        }
+        *end++ = spec.conversion;
+        *end = 0;
+        at += spec.length;
 
-    GameUpdateAndRender(&game_memory, &render_buffer, (float32) t_total, &audio_system, &sound_state, soundBufferNeedsFilling, &input);
+        int stars[2] = {0};
+        for (uint32 star_index = 0; star_index < spec.star_count; ++star_index) {
+            stars[star_index] = (int)(int64_t)record->args[arg_index++];
+        }
+        uint64 arg = record->args[arg_index++];
+        char *out = dest + used;
+        size_t room = size - used;
+        int length = 0;
 
-    if(soundBufferNeedsFilling){
-        SDL_PutAudioStreamData(audio_stream, audio_system.sound_buffer, audio_system.buffer_size);
+#define FORMAT_LOG_ARG(value) \
+        length = (spec.star_count == 2) ? SDL_snprintf(out, room, spec_text, stars[0], stars[1], value) : \
+                 (spec.star_count == 1) ? SDL_snprintf(out, room, spec_text, stars[0], value) : \
+                                          SDL_snprintf(out, room, spec_text, value)
+        switch (spec.arg_type) {
+            case LogArg_Int: {
+                if (spec.conversion == 'c') {
+                    FORMAT_LOG_ARG((int)arg);
+                } else {
+                    FORMAT_LOG_ARG((long long)(int64_t)arg);
+                }
+            } break;
+            case LogArg_Unsigned: FORMAT_LOG_ARG((unsigned long long)arg); break;
+            case LogArg_Double: {
+                double64 value;
+                SDL_memcpy(&value, &arg, sizeof(value));
+                FORMAT_LOG_ARG(value);
+            } break;
+            case LogArg_Pointer: FORMAT_LOG_ARG((void *)(uintptr_t)arg); break;
+            case LogArg_String: FORMAT_LOG_ARG(record->text + arg); break;
+        }
+#undef FORMAT_LOG_ARG
+        if (length > 0) {
+            used = SDL_min(used + (uint32)length, size - 1);
+        }
     }
+    dest[used] = 0;
+    return used;
+}
 
-    SDL_UpdateTexture(texture, NULL, render_buffer.pixels, render_buffer.pitch);
-    // (buffer.width * 4 ) = how far to move in memory from one row of pixels to the next.
-    SDL_RenderTexture(renderer, texture, NULL, NULL);
-    SDL_RenderPresent(renderer);
+internal_func void WriteLogOutput(void){
+    uint32 written = 0;
+    while (written < logger.output_used) {
+        ssize_t count = write(logger.fd, logger.output + written, logger.output_used - written);
+        if (count <= 0) {
+            break;
+        }
+        written += (uint32)count;
+    }
+    logger.output_used = 0;
+}
 
-    // Copy current input to previous at the start of the frame
-    input_prev = input;
-    
-    return SDL_APP_CONTINUE;
+internal_func void AppendLogLine(uint32 level, uint64 counter, char *message, uint32 message_length, bool truncated){
+    local_persist char *level_tags[LogLevel_Count] = { "DEBUG", "INFO ", "WARN ", "ERROR" };
+    uint32 max_line = message_length + 64;
+    if (logger.output_used + max_line > LOG_OUTPUT_BUFFER_SIZE) {
+        WriteLogOutput();
+    }
+    double64 seconds = (double64)(counter - logger.start_counter) / (double64)logger.counter_frequency;
+    logger.output_used += (uint32)SDL_snprintf(logger.output + logger.output_used, LOG_OUTPUT_BUFFER_SIZE - logger.output_used,
+                                               "[%10.4f] %s %s%s\n", seconds, level_tags[SDL_min(level, LogLevel_Error)],
+                                               message, truncated ? " [truncated]" : "");
 }
 
-// --- Called once on shutdown ---
-void SDL_AppQuit(void *appstate, SDL_AppResult result){
-    app_is_quitting = true;
-    SDL_Log("Cleaning up...");
+// everything published so far, returns how many records it took
+internal_func uint32 DrainLog(void){
+    char line[LOG_TEXT_SIZE * 4];
+    uint32 count = 0;
+    for (;;) {
+        LogRecord *record = logger.records + (logger.read_index & (LOG_RING_COUNT - 1));
+        if ((uint32)SDL_GetAtomicInt(&record->sequence) != logger.read_index + 1) {
+            break;
+        }
+        uint32 length = FormatLogRecord(record, line, sizeof(line));
+        AppendLogLine(record->level, record->counter, line, length, record->truncated);
+        SDL_SetAtomicInt(&record->sequence, (int)(logger.read_index + LOG_RING_COUNT));
+        ++logger.read_index;
+        ++count;
+    }
 
-    DestroyAudio(&audio_system);
+    uint32 dropped_count = (uint32)SDL_GetAtomicInt(&logger.dropped_count);
+    if (dropped_count != logger.reported_dropped_count) {
+        int length = SDL_snprintf(line, sizeof(line), "log ring full, %u messages dropped",
+                                  dropped_count - logger.reported_dropped_count);
+        AppendLogLine(LogLevel_Warning, SDL_GetPerformanceCounter(), line, (uint32)length, false);
+        logger.reported_dropped_count = dropped_count;
+    }
 
-    if (texture) {
-        SDL_DestroyTexture(texture);
-        texture = NULL;
+    if (logger.output_used) {
+        WriteLogOutput();
     }
-    if (render_buffer.pixels) {
-        SDL_free(render_buffer.pixels);
-        render_buffer.pixels = NULL;
+    SDL_SetAtomicInt(&logger.written_index, (int)logger.read_index);
+    return count;
+}
+
+internal_func int LogWriterProc(void *data){
+    NameDebugThread("log");
+    for (;;) {
+        // checked before draining, so whatever was logged before quitting was set still goes out
+        bool quitting = SDL_GetAtomicInt(&logger.quitting);
+        if (!DrainLog()) {
+            if (quitting) {
+                break;
+            }
+            SDL_DelayNS(LOG_WRITE_INTERVAL_NS);
+        }
     }
-    if (renderer) {
-        SDL_DestroyRenderer(renderer);
-        renderer = NULL;
+    return 0;
+}
+
+internal_func bool InitLogger(void){
+    logger.records = (LogRecord *)SDL_calloc(LOG_RING_COUNT, sizeof(LogRecord));
+    logger.output = (char *)SDL_malloc(LOG_OUTPUT_BUFFER_SIZE);
+    if (!logger.records || !logger.output) {
+        SDL_Log("Failed to allocate the log ring, logging straight through SDL");
+        DestroyLogger();
+        return false;
     }
-    if (window) {
-        SDL_DestroyWindow(window);
-        window = NULL;
+    for (uint32 index = 0; index < LOG_RING_COUNT; ++index) {
+        SDL_SetAtomicInt(&logger.records[index].sequence, (int)index);
     }
-    if (controller){
-        SDL_CloseGamepad(controller);
-        controller = NULL;
+
+    logger.fd = STDERR_FILENO;
+    if (log_path) {
+        int fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            SDL_Log("Failed to open log file '%s', logging to stderr", log_path);
+        } else {
+            logger.fd = fd;
+        }
     }
+    logger.start_counter = SDL_GetPerformanceCounter();
+    logger.counter_frequency = SDL_GetPerformanceFrequency();
 
-    if (game_memory.permanent_storage) {
-        SDL_free(game_memory.permanent_storage);    // start of memory block
-        game_memory.permanent_storage = NULL;
-        game_memory.transient_storage = NULL; 
+    logger.thread = SDL_CreateThread(LogWriterProc, "log", NULL);
+    if (!logger.thread) {
+        SDL_Log("Failed to create the log thread: %s", SDL_GetError());
+        DestroyLogger();
+        return false;
     }
+    SDL_SetLogOutputFunction(LogSDLMessage, NULL);
+    return true;
 }
 
-internal_func void ResizeRenderBuffer(RenderBuffer *render_buffer, uint32 width, uint32 height){
-    
-    // Free old buffer if it exists
-    if (render_buffer->pixels) {
-        free(render_buffer->pixels);
-        render_buffer->pixels = NULL;
+// last thing on the way out, every other thread that logs has stopped by now
+internal_func void DestroyLogger(void){
+    if (logger.thread) {
+        SDL_SetLogOutputFunction(SDL_GetDefaultLogOutputFunction(), NULL);
+        SDL_SetAtomicInt(&logger.quitting, 1);
+        SDL_WaitThread(logger.thread, NULL);
+        logger.thread = NULL;
     }
-    // clear old texture
-    if (texture) {
-        SDL_DestroyTexture(texture);
-        texture = NULL;
+    if (logger.fd > STDERR_FILENO) {
+        close(logger.fd);
     }
+    logger.fd = STDERR_FILENO;
+    SDL_free(logger.records);
+    logger.records = NULL;
+    SDL_free(logger.output);
+    logger.output = NULL;
+}
 
-    // update the buffer
-    render_buffer->height = height;
-    render_buffer->width = width;
-    render_buffer->bytesPerPixel = 4; // ARGB8888  
-    render_buffer->pitch = render_buffer->width * render_buffer->bytesPerPixel;
-
-    // allocate space for pixels
-    size_t total_bytes = (size_t)width * (size_t)height * render_buffer->bytesPerPixel;
-    render_buffer->pixels = SDL_malloc(total_bytes);
-
-    if (!render_buffer->pixels) {
-        SDL_Log("Failed to allocate memory for render buffer pixels");
+// waits until everything logged so far has been written, messages hold pointers to the caller's format literals
+internal_func void FlushLog(void){
+    if (!logger.thread) {
         return;
     }
-
-    // zero the memory
-    SDL_memset(render_buffer->pixels, 0, total_bytes);
-
-    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
-                                         SDL_TEXTUREACCESS_STREAMING,
-                                         width, height);
-
-    if (!texture) {
-        SDL_Log("Failed to recreate texture: %s", SDL_GetError());
-    } else {
-        SDL_Log("Texture recreated: %dx%d", width, height);
+    uint32 target = (uint32)SDL_GetAtomicInt(&logger.write_index);
+    while ((int32)((uint32)SDL_GetAtomicInt(&logger.written_index) - target) < 0) {
+        SDL_DelayNS(100000);
     }
 }
 
-internal_func bool InitAudio(AudioSystem *audio_system, SoundState *sound_state){
 
-    audio_spec.format = SDL_AUDIO_F32;   // 32-bit float audio
-    audio_spec.channels = SOUND_CHANNELS;
-    audio_spec.freq = SOUND_FREQ;
+// ------------------------------------------------------------
+// Input
+// ------------------------------------------------------------
+/*
+    Every key, gamepad button, stick and hot-plug event becomes an
+    InputEvent in input.events with the SDL_Event's timestamp, see
+    handmade_input.h for what the game does with them. PushInputEvent also
+    applies it to input.controllers right away and keeps the events sorted,
+    SDL hands them over in order nearly always, so the insert only walks
+    back when two devices' timestamps cross.
 
-    audio_stream = SDL_OpenAudioDeviceStream(
-        SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, 
-        &audio_spec, NULL, NULL);
-    if (!audio_stream) {
-        SDL_Log("Couldn't create audio stream: %s", SDL_GetError());
-        return SDL_APP_FAILURE;
+    The keyboard is controller 0. A gamepad takes the lowest free of slots
+    1..4 when it is plugged in and keeps it until it is pulled, a fifth is
+    ignored. BeginInputFrame runs once the game has had a frame and clears
+    the transitions and events for the next one.
+*/
+internal_func void PushInputEvent(GameInputState *input, InputEvent event){
+    ApplyInputEvent(input->controllers, &event);
+    if (input->event_count == INPUT_EVENT_COUNT) {
+        ++input->dropped_event_count;
+        return;
     }
 
-    //UpdateAudio(audio_system, sound_state);
-
-    /* SDL_OpenAudioDeviceStream starts the device paused. You have to tell it to start! */
-    SDL_ResumeAudioStreamDevice(audio_stream);
-
+    uint32 insert_index = input->event_count++;
+    while (insert_index > 0 && input->events[insert_index - 1].timestamp > event.timestamp) {
+        input->events[insert_index] = input->events[insert_index - 1];
+        --insert_index;
+    }
+    input->events[insert_index] = event;
+}
 
-    // Allocate buffer for our generated samples
-    audio_system->frames_per_buffer = (uint32)(audio_spec.freq * BUFFER_SECONDS);
-    audio_system->samples_per_buffer = audio_system->frames_per_buffer * audio_spec.channels;
-    audio_system->buffer_size = audio_system->samples_per_buffer * sizeof(float);
-    audio_system->sound_buffer = (float *)SDL_malloc(audio_system->buffer_size);
+internal_func void BeginInputFrame(GameInputState *input){
+    ClearInputTransitions(input->controllers);
+    for (uint32 controller_index = 0; controller_index < MAX_CONTROLLER_COUNT; ++controller_index) {
+        GameControllerInput *controller = input->controllers + controller_index;
+        controller->start_x = controller->min_x = controller->max_x = controller->end_x;
+        controller->start_y = controller->min_y = controller->max_y = controller->end_y;
+    }
+    input->event_count = 0;
+    input->dropped_event_count = 0;
+}
 
-    if (!audio_system->sound_buffer) {
-        SDL_Log("Failed to allocate audio buffer");
-        return false;
+// -1 when the gamepad has no slot
+internal_func int32 FindGamepadSlot(SDL_JoystickID id){
+    for (int32 slot_index = 0; slot_index < MAX_GAMEPAD_COUNT; ++slot_index) {
+        if (gamepad_slots[slot_index].id == id) {
+            return slot_index;
+        }
     }
+    return -1;
+}
 
-    // zero the memory
-    SDL_memset(audio_system->sound_buffer, 0, audio_system->buffer_size);
+// gamepad may be NULL, the input test plugs in pads that were never opened
+internal_func int32 ConnectGamepad(GameInputState *input, SDL_JoystickID id, SDL_Gamepad *gamepad, uint64 timestamp){
+    int32 slot_index = FindGamepadSlot(0);
+    if (slot_index < 0) {
+        return -1;
+    }
+    gamepad_slots[slot_index].id = id;
+    gamepad_slots[slot_index].gamepad = gamepad;
 
+    InputEvent event = {.timestamp = timestamp, .type = InputEvent_Connected, .controller_index = (uint8)(slot_index + 1)};
+    PushInputEvent(input, event);
+    return slot_index;
+}
 
-    SDL_Log("Audio initialized: %.1f sec buffer, %d Hz, %d channels",
-        BUFFER_SECONDS, audio_spec.freq, audio_spec.channels);
+internal_func void DisconnectGamepad(GameInputState *input, SDL_JoystickID id, uint64 timestamp){
+    int32 slot_index = FindGamepadSlot(id);
+    if (id == 0 || slot_index < 0) {
+        return;
+    }
+    if (gamepad_slots[slot_index].gamepad) {
+        SDL_CloseGamepad(gamepad_slots[slot_index].gamepad);
+        PlatformLog(LogLevel_Info, "Gamepad on controller %d disconnected", slot_index + 1);
+    }
+    gamepad_slots[slot_index].id = 0;
+    gamepad_slots[slot_index].gamepad = NULL;
 
-    return true;
+    InputEvent event = {.timestamp = timestamp, .type = InputEvent_Disconnected, .controller_index = (uint8)(slot_index + 1)};
+    PushInputEvent(input, event);
 }
 
-internal_func void DestroyAudio(AudioSystem *audio_system) {
-    if (audio_stream) {
-        // Pause the stream device (if available) to stop callbacks/processing
-        int device = SDL_GetAudioStreamDevice(audio_stream);
-        if (device >= 0) {
-            SDL_PauseAudioDevice(device);
-        }
-
-        // Destroy the audio stream
-        SDL_DestroyAudioStream(audio_stream);
-        audio_stream = NULL;
+// pads already open at startup get an added event too, the second one finds them in their slot
+internal_func void OpenGamepad(GameInputState *input, SDL_JoystickID id, uint64 timestamp){
+    if (id == 0 || FindGamepadSlot(id) >= 0) {
+        return;
     }
-
-    // Free our buffers
-    if (audio_system && audio_system->sound_buffer) {
-        SDL_free(audio_system->sound_buffer);
-        audio_system->sound_buffer = NULL;
+    SDL_Gamepad *gamepad = SDL_OpenGamepad(id);
+    if (!gamepad) {
+        PlatformLog(LogLevel_Warning, "Could not open gamepad %u: %s", (uint32)id, SDL_GetError());
+        return;
     }
-
-    SDL_Log("Audio system cleaned up");
+    int32 slot_index = ConnectGamepad(input, id, gamepad, timestamp);
+    if (slot_index < 0) {
+        PlatformLog(LogLevel_Warning, "Ignoring gamepad %s, all %d controller slots are taken",
+                    SDL_GetGamepadName(gamepad), MAX_GAMEPAD_COUNT);
+        SDL_CloseGamepad(gamepad);
+        return;
+    }
+    PlatformLog(LogLevel_Info, "Gamepad connected as controller %d: %s", slot_index + 1, SDL_GetGamepadName(gamepad));
 }
 
+internal_func void CloseGamepads(void){
+    for (uint32 slot_index = 0; slot_index < MAX_GAMEPAD_COUNT; ++slot_index) {
+        if (gamepad_slots[slot_index].gamepad) {
+            SDL_CloseGamepad(gamepad_slots[slot_index].gamepad);
+        }
+    }
+    SDL_memset(gamepad_slots, 0, sizeof(gamepad_slots));
+}
 
-internal_func void UpdateButton(ButtonState *oldBState, ButtonState *newBState, bool isDown){
-    newBState->ended_down = isDown;
-    newBState->half_transition_count = (oldBState->ended_down != isDown) ? 1 : 0;
+// the keyboard and every pad in a slot start out connected with nothing held
+internal_func void ConnectControllers(GameInputState *input, uint64 timestamp){
+    InputEvent event = {.timestamp = timestamp, .type = InputEvent_Connected, .controller_index = 0};
+    PushInputEvent(input, event);
+    for (uint32 slot_index = 0; slot_index < MAX_GAMEPAD_COUNT; ++slot_index) {
+        if (gamepad_slots[slot_index].id) {
+            event.controller_index = (uint8)(slot_index + 1);
+            PushInputEvent(input, event);
+        }
+    }
 }
 
-internal_func void ProcessKeyboardEvent(SDL_KeyboardEvent *e) {
+internal_func void ProcessKeyboardEvent(GameInputState *input, SDL_KeyboardEvent *e) {
     SDL_Scancode sc = e->scancode;
     bool isDown = (e->type == SDL_EVENT_KEY_DOWN);
+    bool pressed = isDown && !e->repeat;
+    uint32 button = GameButton_Count;
     switch (sc) {
+    case SDL_SCANCODE_L:
+        if (pressed) ToggleRecording(&replay);
+        break;
+    case SDL_SCANCODE_P:
+        if (pressed) TogglePlayback(&replay);
+        break;
+    case SDL_SCANCODE_T:
+        if (pressed) WriteChromeTrace(profiler.trace_path ? profiler.trace_path : DEFAULT_TRACE_FILENAME);
+        break;
     case SDL_SCANCODE_W:
-        UpdateButton(&input_prev.move_up, &input.move_up, isDown);
+        button = GameButton_MoveUp;
         break;
     case SDL_SCANCODE_S:
-        UpdateButton(&input_prev.move_down, &input.move_down, isDown);
+        button = GameButton_MoveDown;
         break;
     case SDL_SCANCODE_A:
-        UpdateButton(&input_prev.move_left, &input.move_left, isDown);
+        button = GameButton_MoveLeft;
         break;
     case SDL_SCANCODE_D:
-        UpdateButton(&input_prev.move_right, &input.move_right, isDown);
+        button = GameButton_MoveRight;
         break;
     case SDL_SCANCODE_Q:
-        UpdateButton(&input_prev.action_A, &input.action_A, isDown);
+        button = GameButton_ActionA;
         break;
     case SDL_SCANCODE_E:
-        UpdateButton(&input_prev.action_B, &input.action_B, isDown);
+        button = GameButton_ActionB;
         break;
     default:
         break;
     }
+
+    // key repeat changes nothing, the button is already down
+    if (button < GameButton_Count && !e->repeat) {
+        InputEvent event = {.timestamp = e->timestamp, .type = InputEvent_Button, .controller_index = 0,
+                            .index = (uint8)button, .is_down = isDown};
+        PushInputEvent(input, event);
+    }
 }
 
-internal_func void ProcessControllerButton(SDL_GamepadButtonEvent *e) {
-    if (!controller) return;
+internal_func void ProcessControllerButton(GameInputState *input, SDL_GamepadButtonEvent *e) {
+    int32 slot_index = FindGamepadSlot(e->which);
+    if (slot_index < 0) return;
     bool isDown = (e->type == SDL_EVENT_GAMEPAD_BUTTON_DOWN);
+    uint32 button = GameButton_Count;
     switch (e->button) {
-        case SDL_GAMEPAD_BUTTON_LABEL_A:{
-            UpdateButton(&input_prev.action_A, &input.action_A, isDown); 
+        // positions, not labels, so A is the bottom face button whatever is printed on it
+        case SDL_GAMEPAD_BUTTON_SOUTH:{
+            button = GameButton_ActionA;
         } 
         break;
-        case SDL_GAMEPAD_BUTTON_LABEL_B:{
-            UpdateButton(&input_prev.action_B, &input.action_B, isDown);
+        case SDL_GAMEPAD_BUTTON_EAST:{
+            button = GameButton_ActionB;
         } 
         break;
         case SDL_GAMEPAD_BUTTON_DPAD_UP:{
-            UpdateButton(&input_prev.move_up, &input.move_up, isDown);
+            button = GameButton_MoveUp;
         }
         break;
         case SDL_GAMEPAD_BUTTON_DPAD_DOWN:{
-            UpdateButton(&input_prev.move_down, &input.move_down, isDown);
+            button = GameButton_MoveDown;
         }
         break;
         case SDL_GAMEPAD_BUTTON_DPAD_LEFT:{
-            UpdateButton(&input_prev.move_left, &input.move_left, isDown);
+            button = GameButton_MoveLeft;
         }  
         break;
         case SDL_GAMEPAD_BUTTON_DPAD_RIGHT:{
-            UpdateButton(&input_prev.move_right, &input.move_right, isDown);
+            button = GameButton_MoveRight;
         } 
         break;
     }
+
+    if (button < GameButton_Count) {
+        InputEvent event = {.timestamp = e->timestamp, .type = InputEvent_Button, .controller_index = (uint8)(slot_index + 1),
+                            .index = (uint8)button, .is_down = isDown};
+        PushInputEvent(input, event);
+    }
 }
 
-internal_func void ProcessControllerAxis(SDL_GamepadAxisEvent *e) {
-    if (!controller) return;
-    
+internal_func void ProcessControllerAxis(GameInputState *input, SDL_GamepadAxisEvent *e) {
+    int32 slot_index = FindGamepadSlot(e->which);
+    if (slot_index < 0) return;
+    if (e->axis != SDL_GAMEPAD_AXIS_LEFTX && e->axis != SDL_GAMEPAD_AXIS_LEFTY) return;
+
     float32 val = NormalizeStickValue(e->value);
 
     if (fabsf(val) < STICK_DEADZONE){
         val = 0.0f;
+    }
+
+    // a resting stick still reports noise, inside the deadzone it is all the same 0
+    GameControllerInput *controller = input->controllers + slot_index + 1;
+    uint32 axis = (e->axis == SDL_GAMEPAD_AXIS_LEFTX) ? GameAxis_StickX : GameAxis_StickY;
+    if (val == ((axis == GameAxis_StickX) ? controller->end_x : controller->end_y)) {
+        return;
+    }
+
+    InputEvent event = {.timestamp = e->timestamp, .type = InputEvent_Axis, .controller_index = (uint8)(slot_index + 1),
+                        .index = (uint8)axis, .value = val};
+    PushInputEvent(input, event);
+}
+
+internal_func void ProcessInputEvent(GameInputState *input, SDL_Event *event){
+    switch (event->type) {
+        case SDL_EVENT_KEY_DOWN:
+        case SDL_EVENT_KEY_UP:
+            ProcessKeyboardEvent(input, &event->key);
+        break;
+        case SDL_EVENT_GAMEPAD_BUTTON_DOWN:
+        case SDL_EVENT_GAMEPAD_BUTTON_UP:
+            ProcessControllerButton(input, &event->gbutton);
+        break;
+        case SDL_EVENT_GAMEPAD_AXIS_MOTION:
+            ProcessControllerAxis(input, &event->gaxis);
+        break;
+        case SDL_EVENT_GAMEPAD_ADDED:
+            OpenGamepad(input, event->gdevice.which, event->gdevice.timestamp);
+        break;
+        case SDL_EVENT_GAMEPAD_REMOVED:
+            DisconnectGamepad(input, event->gdevice.which, event->gdevice.timestamp);
+        break;
+    }
+}
+
+internal_func float NormalizeStickValue(int16 raw){
+    // normalize the value
+    if (raw < 0) {
+        return (float)raw / 32768.0f;   // maps -32768 -> -1.0
     } else {
-        //SDL_Log("Gamepad axis %d raw=%d norm=%.4f", e->axis, e->value, val);
+        return (float)raw / 32767.0f;   // maps  32767 ->  1.0
     }
+}
 
-    
+// ------------------------------------------------------------
+// Input self test
+// ------------------------------------------------------------
+/*
+    --input-test feeds made up SDL event streams through the same
+    ProcessInputEvent the real events take, walks them the way the game
+    does and checks what every step saw. No window, no devices, pads are
+    plugged in without being opened.
+*/
+#define INPUT_TEST_T0 1000000000ull     // 1 s, any time will do
+#define INPUT_TEST_MS 1000000ull
 
-    switch(e->axis){
-        case SDL_GAMEPAD_AXIS_LEFTX:
-            input.end_x = val;
+internal_func SDL_Event TestKeyEvent(SDL_Scancode scancode, bool down, uint64 timestamp){
+    SDL_Event event = {0};
+    event.type = down ? SDL_EVENT_KEY_DOWN : SDL_EVENT_KEY_UP;
+    event.key.timestamp = timestamp;
+    event.key.scancode = scancode;
+    event.key.down = down;
+    return event;
+}
 
-            if (val < input.min_x) input.min_x = val;
-            if (val > input.max_x) input.max_x = val;
-            break;
+internal_func SDL_Event TestButtonEvent(SDL_JoystickID which, uint8 button, bool down, uint64 timestamp){
+    SDL_Event event = {0};
+    event.type = down ? SDL_EVENT_GAMEPAD_BUTTON_DOWN : SDL_EVENT_GAMEPAD_BUTTON_UP;
+    event.gbutton.timestamp = timestamp;
+    event.gbutton.which = which;
+    event.gbutton.button = button;
+    event.gbutton.down = down;
+    return event;
+}
 
-        case SDL_GAMEPAD_AXIS_LEFTY:
-            input.end_y = val;
+internal_func SDL_Event TestAxisEvent(SDL_JoystickID which, uint8 axis, int16 value, uint64 timestamp){
+    SDL_Event event = {0};
+    event.type = SDL_EVENT_GAMEPAD_AXIS_MOTION;
+    event.gaxis.timestamp = timestamp;
+    event.gaxis.which = which;
+    event.gaxis.axis = axis;
+    event.gaxis.value = value;
+    return event;
+}
 
-            if (val < input.min_y) input.min_y = val;
-            if (val > input.max_y) input.max_y = val;
-            break;
+internal_func void FeedTestEvents(GameInputState *input, SDL_Event *events, uint32 event_count){
+    for (uint32 event_index = 0; event_index < event_count; ++event_index) {
+        ProcessInputEvent(input, events + event_index);
+    }
+}
+
+internal_func bool CheckInputTest(bool passed, char *what, uint32 *failures){
+    SDL_Log("  %-58s %s", what, passed ? "ok" : "FAILED");
+    if (!passed) {
+        ++*failures;
+    }
+    return passed;
+}
+
+// the controllers' buttons and stick, transitions left out
+internal_func bool SameControllerState(GameControllerInput *a, GameControllerInput *b){
+    for (uint32 controller_index = 0; controller_index < MAX_CONTROLLER_COUNT; ++controller_index) {
+        if (a[controller_index].is_connected != b[controller_index].is_connected ||
+            a[controller_index].end_x != b[controller_index].end_x ||
+            a[controller_index].end_y != b[controller_index].end_y) {
+            return false;
+        }
+        for (uint32 button_index = 0; button_index < GameButton_Count; ++button_index) {
+            if (a[controller_index].keys[button_index].ended_down != b[controller_index].keys[button_index].ended_down) {
+                return false;
+            }
+        }
     }
+    return true;
+}
 
+internal_func bool RunInputTest(void){
+    // a couple of KB of events each, off the stack
+    local_persist GameInputState test_input;
+    local_persist GameControllerInput stepped[MAX_CONTROLLER_COUNT];
+    GameInputState *input = &test_input;
+    uint32 failures = 0;
+    SDL_memset(gamepad_slots, 0, sizeof(gamepad_slots));
 
-    // using sticks like dpad
-    bool up    = (input.end_y < -0.5f);
-    bool down  = (input.end_y >  0.5f);
-    bool left  = (input.end_x < -0.5f);
-    bool right = (input.end_x >  0.5f);
+    SDL_Log("Input test:");
 
-    UpdateButton(&input_prev.move_up,    &input.move_up,    up);
-    UpdateButton(&input_prev.move_down,  &input.move_down,  down);
-    UpdateButton(&input_prev.move_left,  &input.move_left,  left);
-    UpdateButton(&input_prev.move_right, &input.move_right, right);
+    // taps faster than a frame are all still there
+    {
+        SDL_memset(input, 0, sizeof(*input));
+        ConnectControllers(input, INPUT_TEST_T0);
+        BeginInputFrame(input);
+        SDL_Event events[6];
+        for (uint32 tap = 0; tap < 3; ++tap) {
+            events[tap * 2 + 0] = TestKeyEvent(SDL_SCANCODE_Q, true, INPUT_TEST_T0 + (2 * tap + 1) * INPUT_TEST_MS);
+            events[tap * 2 + 1] = TestKeyEvent(SDL_SCANCODE_Q, false, INPUT_TEST_T0 + (2 * tap + 2) * INPUT_TEST_MS);
+        }
+        FeedTestEvents(input, events, SDL_arraysize(events));
+        ButtonState *action_A = &input->controllers[0].action_A;
+        CheckInputTest(input->event_count == 6 && action_A->half_transition_count == 6 && !action_A->ended_down,
+                       "3 taps in one frame keep 6 transitions", &failures);
 
-}
+        // repeat is not a transition
+        SDL_Event repeat = TestKeyEvent(SDL_SCANCODE_E, true, INPUT_TEST_T0 + 8 * INPUT_TEST_MS);
+        ProcessInputEvent(input, &repeat);
+        repeat.key.repeat = true;
+        ProcessInputEvent(input, &repeat);
+        CheckInputTest(input->event_count == 7 && input->controllers[0].action_B.half_transition_count == 1,
+                       "key repeat adds no event", &failures);
+    }
 
-internal_func float NormalizeStickValue(int16 raw){
-    // normalize the value
-    if (raw < 0) {
-        return (float)raw / 32768.0f;   // maps -32768 -> -1.0
+    // every step sees exactly the events from before it ended
+    {
+        SDL_memset(input, 0, sizeof(*input));
+        ConnectControllers(input, INPUT_TEST_T0);
+        ConnectGamepad(input, 101, NULL, INPUT_TEST_T0);
+        // the game's copy starts where the platform's was
+        SDL_memset(stepped, 0, sizeof(stepped));
+        for (uint32 i = 0; i < input->event_count; ++i) {
+            ApplyInputEvent(stepped, input->events + i);
+        }
+        BeginInputFrame(input);
+        ClearInputTransitions(stepped);
+
+        // three 60 Hz steps, half a step left over, so they end at 8.33, 25 and 41.67 ms
+        input->timestamp = INPUT_TEST_T0 + 50 * INPUT_TEST_MS;
+        input->update_count = 3;
+        input->update_hz = 60;
+        input->interpolation = 0.5f;
+        SDL_Event events[] = {
+            TestKeyEvent(SDL_SCANCODE_W, true, INPUT_TEST_T0 + 10 * INPUT_TEST_MS),
+            TestKeyEvent(SDL_SCANCODE_W, false, INPUT_TEST_T0 + 20 * INPUT_TEST_MS),
+            TestButtonEvent(101, SDL_GAMEPAD_BUTTON_SOUTH, true, INPUT_TEST_T0 + 40 * INPUT_TEST_MS),
+            TestButtonEvent(101, SDL_GAMEPAD_BUTTON_SOUTH, false, INPUT_TEST_T0 + 45 * INPUT_TEST_MS),
+            TestKeyEvent(SDL_SCANCODE_D, true, INPUT_TEST_T0 + 5 * INPUT_TEST_MS),  // arrives late, belongs first
+        };
+        FeedTestEvents(input, events, SDL_arraysize(events));
+
+        bool sorted = true;
+        for (uint32 i = 1; i < input->event_count; ++i) {
+            sorted = sorted && input->events[i - 1].timestamp <= input->events[i].timestamp;
+        }
+        CheckInputTest(sorted && input->events[0].index == GameButton_MoveRight, "a late arrival is sorted in by timestamp", &failures);
+
+        uint32 expected_counts[4] = {1, 2, 1, 1};   // steps 0, 1, 2 and what is left for the next frame
+        uint32 expected_up[4] = {0, 2, 0, 0};        // move_up transitions each step saw
+        bool steps_match = true;
+        bool held_in_last_step = false;
+        uint32 event_index = 0;
+        for (uint32 step = 0; step <= input->update_count; ++step) {
+            uint64 until = (step < input->update_count) ? InputStepEndTime(input, step) : UINT64_MAX;
+            uint32 count = 0;
+            InputEvent *event;
+            while ((event = NextInputEvent(input, &event_index, until))) {
+                ApplyInputEvent(stepped, event);
+                ++count;
+            }
+            steps_match = steps_match && count == expected_counts[step] &&
+                          stepped[0].move_up.half_transition_count == expected_up[step];
+            if (step == 2) {
+                held_in_last_step = stepped[1].action_A.ended_down;
+            }
+            if (step < input->update_count) {
+                ClearInputTransitions(stepped);
+            }
+        }
+        CheckInputTest(steps_match, "events land in the step they happened in", &failures);
+        CheckInputTest(held_in_last_step, "a release after the last step waits for the next frame", &failures);
+        CheckInputTest(SameControllerState(stepped, input->controllers), "walking the events ends at the platform's state", &failures);
+    }
+
+    // the stick only moves buttons when it crosses the threshold, and only on its own axis
+    {
+        SDL_memset(input, 0, sizeof(*input));
+        SDL_memset(gamepad_slots, 0, sizeof(gamepad_slots));
+        ConnectControllers(input, INPUT_TEST_T0);
+        ConnectGamepad(input, 101, NULL, INPUT_TEST_T0);
+        BeginInputFrame(input);
+        SDL_Event events[] = {
+            TestButtonEvent(101, SDL_GAMEPAD_BUTTON_DPAD_UP, true, INPUT_TEST_T0 + 1 * INPUT_TEST_MS),
+            TestAxisEvent(101, SDL_GAMEPAD_AXIS_LEFTX, 20000, INPUT_TEST_T0 + 2 * INPUT_TEST_MS),
+            TestAxisEvent(101, SDL_GAMEPAD_AXIS_LEFTX, 18000, INPUT_TEST_T0 + 3 * INPUT_TEST_MS),
+            TestAxisEvent(101, SDL_GAMEPAD_AXIS_LEFTY, 1000, INPUT_TEST_T0 + 4 * INPUT_TEST_MS),    // deadzone, dropped
+            TestAxisEvent(101, SDL_GAMEPAD_AXIS_LEFTY, 2000, INPUT_TEST_T0 + 5 * INPUT_TEST_MS),    // still 0, dropped
+            TestAxisEvent(101, SDL_GAMEPAD_AXIS_LEFTX, -32768, INPUT_TEST_T0 + 6 * INPUT_TEST_MS),
+        };
+        FeedTestEvents(input, events, SDL_arraysize(events));
+        GameControllerInput *pad = input->controllers + 1;
+        CheckInputTest(input->event_count == 4, "deadzone noise is not queued", &failures);
+        CheckInputTest(pad->move_up.ended_down && pad->move_up.half_transition_count == 1 &&
+                       !pad->move_right.ended_down && pad->move_right.half_transition_count == 2 &&
+                       pad->move_left.ended_down && pad->move_left.half_transition_count == 1 &&
+                       pad->end_x == -1.0f && pad->min_x == -1.0f && pad->max_x > 0.6f && pad->is_analog,
+                       "stick crosses move only their own buttons", &failures);
+    }
+
+    // hot-plug, four pads fit, a fifth waits, pulling one releases what it held
+    {
+        SDL_memset(input, 0, sizeof(*input));
+        SDL_memset(gamepad_slots, 0, sizeof(gamepad_slots));
+        ConnectControllers(input, INPUT_TEST_T0);
+        int32 slots[5];
+        for (uint32 pad = 0; pad < 5; ++pad) {
+            slots[pad] = ConnectGamepad(input, 101 + pad, NULL, INPUT_TEST_T0 + pad * INPUT_TEST_MS);
+        }
+        CheckInputTest(slots[0] == 0 && slots[3] == 3 && slots[4] == -1 && input->controllers[4].is_connected,
+                       "four pads get controllers 1..4, a fifth none", &failures);
+
+        BeginInputFrame(input);
+        SDL_Event held = TestButtonEvent(102, SDL_GAMEPAD_BUTTON_EAST, true, INPUT_TEST_T0 + 10 * INPUT_TEST_MS);
+        SDL_Event ignored = TestButtonEvent(105, SDL_GAMEPAD_BUTTON_EAST, true, INPUT_TEST_T0 + 11 * INPUT_TEST_MS);
+        ProcessInputEvent(input, &held);
+        ProcessInputEvent(input, &ignored);
+        DisconnectGamepad(input, 102, INPUT_TEST_T0 + 12 * INPUT_TEST_MS);
+        GameControllerInput *pad = input->controllers + 2;
+        CheckInputTest(input->event_count == 2 && !pad->is_connected && !pad->action_B.ended_down &&
+                       pad->action_B.half_transition_count == 2,
+                       "unplugging releases held buttons, unslotted pads are ignored", &failures);
+
+        int32 slot = ConnectGamepad(input, 106, NULL, INPUT_TEST_T0 + 13 * INPUT_TEST_MS);
+        CheckInputTest(slot == 1 && input->controllers[2].is_connected, "the next pad takes the free slot", &failures);
+    }
+
+    // more events than fit, the state is still right and the game can catch up with it
+    {
+        SDL_memset(input, 0, sizeof(*input));
+        SDL_memset(gamepad_slots, 0, sizeof(gamepad_slots));
+        SDL_memset(stepped, 0, sizeof(stepped));
+        ConnectControllers(input, INPUT_TEST_T0);
+        for (uint32 i = 0; i < input->event_count; ++i) {
+            ApplyInputEvent(stepped, input->events + i);
+        }
+        BeginInputFrame(input);
+        ClearInputTransitions(stepped);
+        // 256 transitions as well, which saturates the count
+        uint32 pushed = INPUT_EVENT_COUNT + 11;
+        for (uint32 i = 0; i < pushed; ++i) {
+            SDL_Event event = TestKeyEvent(SDL_SCANCODE_S, (i & 1) == 0, INPUT_TEST_T0 + i * 1000);
+            ProcessInputEvent(input, &event);
+        }
+        uint32 event_index = 0;
+        InputEvent *event;
+        while ((event = NextInputEvent(input, &event_index, UINT64_MAX))) {
+            ApplyInputEvent(stepped, event);
+        }
+        bool differs = !SameControllerState(stepped, input->controllers);
+        CopyControllerState(stepped, input->controllers);
+        CheckInputTest(input->event_count == INPUT_EVENT_COUNT && input->dropped_event_count == 11 &&
+                       input->controllers[0].move_down.ended_down && differs &&
+                       SameControllerState(stepped, input->controllers) &&
+                       stepped[0].move_down.half_transition_count == 255,
+                       "overflow is counted and the state copied over", &failures);
+    }
+
+    SDL_memset(gamepad_slots, 0, sizeof(gamepad_slots));
+    if (failures) {
+        SDL_Log("Input test: %u FAILED", failures);
     } else {
-        return (float)raw / 32767.0f;   // maps  32767 ->  1.0
+        SDL_Log("Input test: all passed");
     }
+    return failures == 0;
 }
@@ -0,0 +1,157 @@
+/*
+    Offline asset packer, builds the .hha file the game maps at startup.
+
+        asset_packer OUT.hha name=path [name=path ...]
+
+    name is one of asset_id_names in handmade_asset.h, the asset lands at
+    that AssetID_* slot of the index. The type comes from the extension
+    (.txt is text, anything else raw). Ids left out are written as empty
+    entries so the game reports them missing instead of reading garbage.
+*/
+#define HANDMADE_ASSET_PACKER 1
+#include "../handmade_asset.h"
+#include <string.h>
+
+typedef struct {
+    char *path;
+    bool present;                   // named on the command line, contents is NULL for an empty file
+    uint8 *contents;
+    uint64 size;
+} PackerInput;
+
+// an empty file reads fine, with no contents and size 0
+internal_func bool ReadWholeFile(char *path, uint8 **contents, uint64 *size){
+    *contents = NULL;
+    *size = 0;
+
+    FILE *file = fopen(path, "rb");
+    if(!file){
+        return false;
+    }
+
+    bool read = (fseek(file, 0, SEEK_END) == 0);
+    long file_size = read ? ftell(file) : -1;
+    read = (file_size >= 0) && (fseek(file, 0, SEEK_SET) == 0);
+
+    if(read && file_size > 0){
+        *contents = (uint8 *)malloc((size_t)file_size);
+        read = *contents && (fread(*contents, 1, (size_t)file_size, file) == (size_t)file_size);
+        if(!read){
+            free(*contents);
+            *contents = NULL;
+        }
+    }
+    fclose(file);
+
+    *size = read ? (uint64)file_size : 0;
+    return read;
+}
+
+internal_func uint32 AssetTypeFromPath(char *path){
+    char *extension = strrchr(path, '.');
+    if(extension && strcmp(extension, ".txt") == 0){
+        return AssetType_Text;
+    }
+    return AssetType_Raw;
+}
+
+internal_func uint64 AlignOffset(uint64 offset){
+    return (offset + ASSET_DATA_ALIGNMENT - 1) & ~(uint64)(ASSET_DATA_ALIGNMENT - 1);
+}
+
+int main(int argc, char *argv[]){
+    if(argc < 3){
+        fprintf(stderr, "usage: %s OUT.hha name=path [name=path ...]\n", argv[0]);
+        return 1;
+    }
+
+    PackerInput inputs[AssetID_Count] = {0};
+    PackedAsset index[AssetID_Count] = {0};
+
+    for(int arg = 2; arg < argc; ++arg){
+        char *equals = strchr(argv[arg], '=');
+        if(!equals){
+            fprintf(stderr, "'%s' is not name=path\n", argv[arg]);
+            return 1;
+        }
+        *equals = 0;
+
+        uint32 asset_id = AssetID_Count;
+        for(uint32 id = 0; id < AssetID_Count; ++id){
+            if(strcmp(argv[arg], asset_id_names[id]) == 0){
+                asset_id = id;
+            }
+        }
+        if(asset_id == AssetID_Count){
+            fprintf(stderr, "unknown asset name '%s'\n", argv[arg]);
+            return 1;
+        }
+
+        PackerInput *input = inputs + asset_id;
+        input->path = equals + 1;
+        input->present = ReadWholeFile(input->path, &input->contents, &input->size);
+        if(!input->present){
+            fprintf(stderr, "could not read '%s'\n", input->path);
+            return 1;
+        }
+        index[asset_id].type = AssetTypeFromPath(input->path);
+    }
+
+    // header, index, then every blob on its own aligned offset
+    AssetPackHeader header = {0};
+    header.magic = ASSET_PACK_MAGIC;
+    header.version = ASSET_PACK_VERSION;
+    header.asset_count = AssetID_Count;
+    header.index_offset = sizeof(AssetPackHeader);
+
+    uint64 offset = header.index_offset + sizeof(index);
+    // an empty asset still gets an offset, the game takes offset 0 to mean missing
+    for(uint32 asset_id = 0; asset_id < AssetID_Count; ++asset_id){
+        if(inputs[asset_id].present){
+            offset = AlignOffset(offset);
+            index[asset_id].offset = offset;
+            index[asset_id].size = inputs[asset_id].size;
+            offset += inputs[asset_id].size;
+        }
+    }
+    header.total_size = offset;
+
+    // written next to the target and renamed, a running game never maps half a pack
+    char temp_path[4096];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", argv[1]);
+    FILE *out = fopen(temp_path, "wb");
+    if(!out){
+        fprintf(stderr, "could not create '%s'\n", temp_path);
+        return 1;
+    }
+
+    bool written = (fwrite(&header, sizeof(header), 1, out) == 1) && (fwrite(index, sizeof(index), 1, out) == 1);
+    uint64 position = header.index_offset + sizeof(index);
+    uint8 padding[ASSET_DATA_ALIGNMENT] = {0};
+    for(uint32 asset_id = 0; written && asset_id < AssetID_Count; ++asset_id){
+        if(!inputs[asset_id].present){
+            continue;
+        }
+        uint64 pad = index[asset_id].offset - position;
+        written = (fwrite(padding, 1, (size_t)pad, out) == pad) &&
+                  ((inputs[asset_id].size == 0) ||
+                   (fwrite(inputs[asset_id].contents, 1, (size_t)inputs[asset_id].size, out) == inputs[asset_id].size));
+        position = index[asset_id].offset + inputs[asset_id].size;
+    }
+    written = (fclose(out) == 0) && written;
+
+    if(!written || rename(temp_path, argv[1]) != 0){
+        fprintf(stderr, "could not write '%s'\n", argv[1]);
+        remove(temp_path);
+        return 1;
+    }
+
+    for(uint32 asset_id = 0; asset_id < AssetID_Count; ++asset_id){
+        if(inputs[asset_id].present){
+            printf("  %-20s %10llu bytes at %llu\n", asset_id_names[asset_id],
+                   (unsigned long long)index[asset_id].size, (unsigned long long)index[asset_id].offset);
+        }
+    }
+    printf("Packed %s, %llu bytes\n", argv[1], (unsigned long long)header.total_size);
+    return 0;
+}